@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Finding the ACPI tables that efilinux looks at.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "acpi.h"
+
+static BOOLEAN sig_equal(const char *a, const char *b, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++) {
+		if (a[i] != b[i])
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * acpi_find_rsdp - Find the ACPI tables in the EFI system table
+ *
+ * Prefers the ACPI 2.0 RSDP. Returns NULL if there are no tables.
+ */
+struct acpi_rsdp *acpi_find_rsdp(void)
+{
+	EFI_CONFIGURATION_TABLE *t = sys_table->ConfigurationTable;
+	struct acpi_rsdp *rsdp = NULL;
+	UINTN i;
+
+	for (i = 0; i < sys_table->NumberOfTableEntries; i++) {
+		if (!CompareGuid(&t[i].VendorGuid, &Acpi20TableGuid)) {
+			rsdp = t[i].VendorTable;
+			break;
+		}
+
+		if (!CompareGuid(&t[i].VendorGuid, &AcpiTableGuid))
+			rsdp = t[i].VendorTable;
+	}
+
+	if (rsdp && !sig_equal(rsdp->signature, ACPI_RSDP_SIGNATURE, 8))
+		rsdp = NULL;
+
+	return rsdp;
+}
+
+/**
+ * acpi_find_table - Find an ACPI table by signature
+ * @rsdp: the root system description pointer
+ * @sig: the four character signature of the table
+ */
+struct acpi_header *acpi_find_table(struct acpi_rsdp *rsdp, char *sig)
+{
+	struct acpi_header *root, *table;
+	UINTN i, nr, entry_size;
+	char *entries;
+
+	if (rsdp->revision >= 2 && rsdp->xsdt_address) {
+		root = (struct acpi_header *)(UINTN)rsdp->xsdt_address;
+		entry_size = sizeof(UINT64);
+	} else {
+		root = (struct acpi_header *)(UINTN)rsdp->rsdt_address;
+		entry_size = sizeof(UINT32);
+	}
+
+	nr = (root->length - sizeof(*root)) / entry_size;
+	entries = (char *)(root + 1);
+
+	for (i = 0; i < nr; i++) {
+		UINT64 addr;
+
+		if (entry_size == sizeof(UINT64))
+			addr = *(UINT64 *)(entries + i * entry_size);
+		else
+			addr = *(UINT32 *)(entries + i * entry_size);
+
+		table = (struct acpi_header *)(UINTN)addr;
+		if (table && sig_equal(table->signature, sig, 4))
+			return table;
+	}
+
+	return NULL;
+}
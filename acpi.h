@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The parts of the ACPI tables that efilinux looks at.
+ */
+
+#ifndef __ACPI_H__
+#define __ACPI_H__
+
+#define ACPI_RSDP_SIGNATURE	"RSD PTR "
+#define ACPI_XSDT_SIGNATURE	"XSDT"
+#define ACPI_RSDT_SIGNATURE	"RSDT"
+#define ACPI_SRAT_SIGNATURE	"SRAT"
+#define ACPI_HMAT_SIGNATURE	"HMAT"
+#define ACPI_SPCR_SIGNATURE	"SPCR"
+
+struct acpi_rsdp {
+	char signature[8];
+	UINT8 checksum;
+	char oem_id[6];
+	UINT8 revision;
+	UINT32 rsdt_address;
+	/* The rest is only valid if revision >= 2 */
+	UINT32 length;
+	UINT64 xsdt_address;
+	UINT8 ext_checksum;
+	UINT8 reserved[3];
+} __attribute__((packed));
+
+struct acpi_header {
+	char signature[4];
+	UINT32 length;
+	UINT8 revision;
+	UINT8 checksum;
+	char oem_id[6];
+	char oem_table_id[8];
+	UINT32 oem_revision;
+	UINT32 creator_id;
+	UINT32 creator_revision;
+} __attribute__((packed));
+
+/*
+ * System Resource Affinity Table: which proximity domain each
+ * processor and range of memory belongs to.
+ */
+struct acpi_srat {
+	struct acpi_header hdr;
+	UINT32 reserved1;
+	UINT64 reserved2;
+} __attribute__((packed));
+
+#define ACPI_SRAT_CPU_AFFINITY		0
+#define ACPI_SRAT_MEM_AFFINITY		1
+#define ACPI_SRAT_X2APIC_AFFINITY	2
+
+#define ACPI_SRAT_ENABLED		(1 << 0)
+#define ACPI_SRAT_MEM_HOTPLUGGABLE	(1 << 1)
+#define ACPI_SRAT_MEM_NON_VOLATILE	(1 << 2)
+
+struct acpi_subtable {
+	UINT8 type;
+	UINT8 length;
+} __attribute__((packed));
+
+struct acpi_srat_cpu_affinity {
+	UINT8 type;
+	UINT8 length;
+	UINT8 proximity_lo;
+	UINT8 apic_id;
+	UINT32 flags;
+	UINT8 sapic_eid;
+	UINT8 proximity_hi[3];
+	UINT32 clock_domain;
+} __attribute__((packed));
+
+struct acpi_srat_mem_affinity {
+	UINT8 type;
+	UINT8 length;
+	UINT32 proximity_domain;
+	UINT16 reserved1;
+	UINT64 base;
+	UINT64 size;
+	UINT32 reserved2;
+	UINT32 flags;
+	UINT64 reserved3;
+} __attribute__((packed));
+
+struct acpi_srat_x2apic_affinity {
+	UINT8 type;
+	UINT8 length;
+	UINT16 reserved1;
+	UINT32 proximity_domain;
+	UINT32 apic_id;
+	UINT32 flags;
+	UINT32 clock_domain;
+	UINT32 reserved2;
+} __attribute__((packed));
+
+/*
+ * Heterogeneous Memory Attribute Table: the latency and bandwidth
+ * between initiator (processor) and target (memory) domains.
+ */
+struct acpi_hmat {
+	struct acpi_header hdr;
+	UINT32 reserved;
+} __attribute__((packed));
+
+#define ACPI_HMAT_LOCALITY		1
+
+#define ACPI_HMAT_ACCESS_LATENCY	0
+#define ACPI_HMAT_READ_LATENCY		1
+#define ACPI_HMAT_WRITE_LATENCY		2
+#define ACPI_HMAT_ACCESS_BANDWIDTH	3
+#define ACPI_HMAT_READ_BANDWIDTH	4
+#define ACPI_HMAT_WRITE_BANDWIDTH	5
+
+#define ACPI_HMAT_MEMORY_HIERARCHY	0x0f	/* 0 is memory, not cache */
+
+struct acpi_hmat_structure {
+	UINT16 type;
+	UINT16 reserved;
+	UINT32 length;
+} __attribute__((packed));
+
+/*
+ * Followed by UINT32 initiators[nr_initiators], UINT32
+ * targets[nr_targets] and a UINT16 entry for each initiator/target
+ * pair, one row per initiator.
+ */
+struct acpi_hmat_locality {
+	struct acpi_hmat_structure hdr;
+	UINT8 flags;
+	UINT8 data_type;
+	UINT8 min_transfer_size;
+	UINT8 reserved1;
+	UINT32 nr_initiators;
+	UINT32 nr_targets;
+	UINT32 reserved2;
+	UINT64 entry_base_unit;
+} __attribute__((packed));
+
+/*
+ * Generic Address Structure: a register in memory or I/O space.
+ */
+struct acpi_gas {
+	UINT8 space_id;
+	UINT8 bit_width;
+	UINT8 bit_offset;
+	UINT8 access_size;
+	UINT64 address;
+} __attribute__((packed));
+
+#define ACPI_GAS_MEMORY			0
+#define ACPI_GAS_IO			1
+
+#define ACPI_GAS_ACCESS_BYTE		1
+#define ACPI_GAS_ACCESS_DWORD		3
+
+/*
+ * Serial Port Console Redirection table: the UART that the firmware
+ * uses as its console.
+ */
+struct acpi_spcr {
+	struct acpi_header hdr;
+	UINT8 interface_type;
+	UINT8 reserved1[3];
+	struct acpi_gas base;
+	UINT8 interrupt_type;
+	UINT8 irq;
+	UINT32 gsi;
+	UINT8 baud_rate;
+	UINT8 parity;
+	UINT8 stop_bits;
+	UINT8 flow_control;
+	UINT8 terminal_type;
+	UINT8 language;
+	UINT16 pci_device_id;
+	UINT16 pci_vendor_id;
+	UINT8 pci_bus;
+	UINT8 pci_device;
+	UINT8 pci_function;
+	UINT32 pci_flags;
+	UINT8 pci_segment;
+	UINT32 reserved2;
+} __attribute__((packed));
+
+/* Interface types, from the DBG2 serial port subtypes */
+#define ACPI_SPCR_16550			0x00
+#define ACPI_SPCR_16450			0x01
+#define ACPI_SPCR_16550_GAS		0x12
+
+/* baud_rate, 0 means leave it as the firmware set it */
+#define ACPI_SPCR_BAUD_9600		3
+#define ACPI_SPCR_BAUD_19200		4
+#define ACPI_SPCR_BAUD_57600		6
+#define ACPI_SPCR_BAUD_115200		7
+
+extern struct acpi_rsdp *acpi_find_rsdp(void);
+extern struct acpi_header *acpi_find_table(struct acpi_rsdp *rsdp, char *sig);
+
+#endif /* __ACPI_H__ */
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Split efilinux's arguments into tokens.
+ *
+ * The arguments come from efilinux.cfg or from the image's load
+ * options, converted to ASCII. Either way they are in a buffer that
+ * we own, so the tokens are simply spans of that buffer and the
+ * kernel command line is squeezed together in place at the end.
+ *
+ * Tokens are separated by whitespace, including newlines, so the
+ * config file may be split over as many lines as is convenient. A
+ * token starting with '#' begins a comment that runs to the end of
+ * the line. Whitespace inside double quotes doesn't end a token, and
+ * the quotes are kept, which is what the kernel expects of things
+ * like dyndbg="file foo.c +p".
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "stdlib.h"
+#include "config.h"
+
+typedef UINTN __attribute__((may_alias)) word_t;
+
+#define WORD_SIZE	sizeof(UINTN)
+#define ONES		((UINTN)-1 / 0xff)
+#define HIGHS		(ONES << 7)
+
+static inline BOOLEAN is_space(char ch)
+{
+	return (unsigned char)ch <= ' ';
+}
+
+/*
+ * Might any byte of 'w' end a token or start a quote? That is, is
+ * any byte below '#'? There can be false positives, but only after
+ * a byte that really is below '#'.
+ */
+static inline BOOLEAN has_special(UINTN w)
+{
+	return ((w - ONES * '#') & ~w & HIGHS) != 0;
+}
+
+/*
+ * Might any byte of 'w' be a control character, such as a newline or
+ * the terminating NUL, or a '#'?
+ */
+static inline BOOLEAN has_break(UINTN w)
+{
+	UINTN hash = w ^ (ONES * '#');
+
+	return ((((w - ONES * ' ') & ~w) | ((hash - ONES) & ~hash)) & HIGHS) != 0;
+}
+
+/*
+ * Return the NUL at the end of 'p' if there are no comments or
+ * control characters on the way, or NULL.
+ */
+static char *plain_text(char *p)
+{
+	for (;;) {
+		while (!((UINTN)p & (WORD_SIZE - 1)) &&
+		       !has_break(*(word_t *)p))
+			p += WORD_SIZE;
+
+		if (!*p)
+			return p;
+
+		if ((unsigned char)*p < ' ' || *p == '#')
+			return NULL;
+
+		p++;
+	}
+}
+
+/**
+ * token_init - Start splitting a buffer into tokens
+ * @t: the tokenizer to initialise
+ * @buf: the buffer, which is modified in place
+ * @size: the number of bytes in @buf, which must have room for a
+ *	  NUL after them; parsing also stops at an earlier NUL
+ */
+void token_init(struct tokenizer *t, char *buf, UINTN size)
+{
+	buf[size] = '\0';
+	t->pos = buf;
+}
+
+/**
+ * token_next - Find the next token
+ * @t: the tokenizer
+ * @tok: used to return the token
+ *
+ * Returns FALSE once there are no more tokens.
+ */
+BOOLEAN token_next(struct tokenizer *t, struct token *tok)
+{
+	char *p = t->pos;
+
+	for (;;) {
+		while (*p && is_space(*p))
+			p++;
+
+		if (*p != '#')
+			break;
+
+		while (*p && *p != '\n')
+			p++;
+	}
+
+	if (!*p) {
+		t->pos = p;
+		return FALSE;
+	}
+
+	tok->str = p;
+	while (!is_space(*p)) {
+		/*
+		 * Skip whole words of ordinary characters. The loads
+		 * are aligned, so they can't run off the end of the
+		 * buffer's last page.
+		 */
+		while (!((UINTN)p & (WORD_SIZE - 1)) &&
+		       !has_special(*(word_t *)p))
+			p += WORD_SIZE;
+
+		if (is_space(*p))
+			break;
+
+		if (*p++ != '"')
+			continue;
+
+		while (*p && *p != '"')
+			p++;
+		if (*p)
+			p++;
+	}
+
+	tok->len = p - tok->str;
+	t->pos = p;
+
+	return TRUE;
+}
+
+/**
+ * token_rest - Join the remaining tokens into a string
+ * @t: the tokenizer
+ *
+ * The remaining tokens are moved down in the buffer so that they are
+ * separated by single spaces, with comments and newlines removed,
+ * and NUL terminated. Returns the string, which is empty if there
+ * are no tokens left.
+ *
+ * A single line without comments, which is the common case, is left
+ * where it is apart from trimming trailing whitespace.
+ */
+char *token_rest(struct tokenizer *t)
+{
+	struct token tok;
+	char *str, *dst;
+	UINTN i;
+
+	if (token_next(t, &tok)) {
+		token_unget(t, &tok);
+
+		dst = plain_text(tok.str);
+		if (dst) {
+			while (is_space(dst[-1]))
+				dst--;
+			*dst = '\0';
+			t->pos = dst;
+			return tok.str;
+		}
+	}
+
+	str = dst = NULL;
+	while (token_next(t, &tok)) {
+		if (!str)
+			str = dst = tok.str;
+		else
+			*dst++ = ' ';
+
+		/* Usually the tokens are already where they belong */
+		if (dst == tok.str) {
+			dst += tok.len;
+			continue;
+		}
+
+		/* dst never passes tok.str, so this is safe in place */
+		for (i = 0; i < tok.len; i++)
+			*dst++ = tok.str[i];
+	}
+
+	if (!str)
+		str = dst = t->pos;
+
+	*dst = '\0';
+	return str;
+}
+
+/**
+ * token_is - Does a token consist of exactly @word?
+ * @tok: the token
+ * @word: a NUL-terminated string
+ */
+BOOLEAN token_is(struct token *tok, char *word)
+{
+	UINTN i;
+
+	for (i = 0; i < tok->len; i++) {
+		if (tok->str[i] != word[i])
+			return FALSE;
+	}
+
+	return !word[i];
+}
+
+/**
+ * token_atoi - Convert a token to a number
+ * @tok: the token, in decimal
+ *
+ * Conversion stops at the first character that isn't a digit.
+ */
+UINTN token_atoi(struct token *tok)
+{
+	UINTN i, n = 0;
+
+	for (i = 0; i < tok->len; i++) {
+		if (tok->str[i] < '0' || tok->str[i] > '9')
+			break;
+		n = n * 10 + tok->str[i] - '0';
+	}
+
+	return n;
+}
+
+/**
+ * token_wide - Make a NUL-terminated UTF-16 copy of a token
+ * @tok: the token
+ *
+ * The firmware wants file names as UTF-16. Returns NULL if memory
+ * can't be allocated; the copy must be freed with free().
+ */
+CHAR16 *token_wide(struct token *tok)
+{
+	CHAR16 *str;
+	UINTN i;
+
+	str = malloc((tok->len + 1) * sizeof(CHAR16));
+	if (!str)
+		return NULL;
+
+	for (i = 0; i < tok->len; i++)
+		str[i] = tok->str[i];
+	str[i] = '\0';
+
+	return str;
+}
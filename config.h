@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __CONFIG_H__
+#define __CONFIG_H__
+
+/*
+ * A token is a span of the buffer being parsed, it isn't NUL
+ * terminated.
+ */
+struct token {
+	char *str;
+	UINTN len;
+};
+
+struct tokenizer {
+	char *pos;
+};
+
+extern void token_init(struct tokenizer *t, char *buf, UINTN size);
+extern BOOLEAN token_next(struct tokenizer *t, struct token *tok);
+extern char *token_rest(struct tokenizer *t);
+extern BOOLEAN token_is(struct token *tok, char *word);
+extern UINTN token_atoi(struct token *tok);
+extern CHAR16 *token_wide(struct token *tok);
+
+/**
+ * token_unget - Push a token back so that it is returned again
+ * @t: the tokenizer that returned @tok
+ * @tok: the last token returned by token_next()
+ */
+static inline void token_unget(struct tokenizer *t, struct token *tok)
+{
+	t->pos = tok->str;
+}
+
+#endif /* __CONFIG_H__ */
@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Refuse to boot files whose SHA-256 doesn't match the one given with
+ * "-d <file>=<digest>".
+ *
+ * Hashing a large initrd after reading it would mean a second pass
+ * over hundreds of megabytes, so files are hashed as the stream code
+ * retires each chunk, while the firmware is reading the next one.
+ * Each chunk is hashed by an mp job, which runs on an AP when there
+ * are any, so the BSP can keep the reads going and several initrds
+ * are hashed at once.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "fs.h"
+#include "fat.h"
+#include "aio.h"
+#include "stream.h"
+#include "stdlib.h"
+#include "sha256.h"
+#include "mp.h"
+#include "digest.h"
+#include "profile.h"
+#include "log.h"
+
+struct pin {
+	struct pin *next;
+	CHAR16 *name;
+	UINT8 digest[SHA256_DIGEST_SIZE];
+};
+
+struct digest_stats digest_stats;
+
+static struct pin *pins;
+
+static int hex_value(char ch)
+{
+	if (ch >= '0' && ch <= '9')
+		return ch - '0';
+	if (ch >= 'a' && ch <= 'f')
+		return ch - 'a' + 10;
+	if (ch >= 'A' && ch <= 'F')
+		return ch - 'A' + 10;
+
+	return -1;
+}
+
+/**
+ * digest_pin - Record the digest that a file must have
+ * @arg: "<file>=<digest>", where <file> is written exactly as it is
+ *	 given to -f or initrd= and <digest> is the SHA-256 in hex
+ * @arg_len: the length of @arg, which needn't be NUL-terminated
+ */
+EFI_STATUS digest_pin(char *arg, UINTN arg_len)
+{
+	char *hex = NULL, *p;
+	struct pin *pin;
+	UINTN len;
+	int i;
+
+	/* The digest follows the last '=' */
+	for (p = arg; p < arg + arg_len; p++) {
+		if (*p == '=')
+			hex = p;
+	}
+
+	if (!hex || hex == arg ||
+	    arg + arg_len - (hex + 1) != SHA256_DIGEST_SIZE * 2)
+		return EFI_INVALID_PARAMETER;
+
+	pin = malloc(sizeof(*pin));
+	if (!pin)
+		return EFI_OUT_OF_RESOURCES;
+
+	for (i = 0; i < SHA256_DIGEST_SIZE; i++) {
+		int hi = hex_value(hex[1 + i * 2]);
+		int lo = hex_value(hex[2 + i * 2]);
+
+		if (hi < 0 || lo < 0) {
+			free(pin);
+			return EFI_INVALID_PARAMETER;
+		}
+
+		pin->digest[i] = (hi << 4) | lo;
+	}
+
+	len = hex - arg;
+	pin->name = malloc((len + 1) * sizeof(CHAR16));
+	if (!pin->name) {
+		free(pin);
+		return EFI_OUT_OF_RESOURCES;
+	}
+
+	for (i = 0; i < len; i++)
+		pin->name[i] = arg[i];
+	pin->name[len] = '\0';
+
+	pin->next = pins;
+	pins = pin;
+
+	return EFI_SUCCESS;
+}
+
+static struct pin *find_pin(CHAR16 *name)
+{
+	struct pin *pin;
+
+	for (pin = pins; pin; pin = pin->next) {
+		if (!StrCmp(pin->name, name))
+			break;
+	}
+
+	return pin;
+}
+
+/**
+ * digest_pinned - Does a file have a pinned digest?
+ * @name: the file's name, as given on the command line
+ */
+BOOLEAN digest_pinned(CHAR16 *name)
+{
+	return find_pin(name) != NULL;
+}
+
+/**
+ * digest_start - Start hashing a file, if it has a pinned digest
+ * @d: the hashing state to initialise
+ * @name: the file's name, as given on the command line
+ *
+ * Returns FALSE if @name has no pinned digest, in which case @d
+ * mustn't be used.
+ */
+BOOLEAN digest_start(struct digest *d, CHAR16 *name)
+{
+	struct pin *pin = find_pin(name);
+
+	if (!pin)
+		return FALSE;
+
+	d->name = pin->name;
+	d->expect = pin->digest;
+	d->queued = FALSE;
+	d->read_ticks = 0;
+	sha256_init(&d->ctx);
+
+	return TRUE;
+}
+
+/*
+ * Runs on any processor, so mustn't call the firmware.
+ */
+static void hash_chunk(void *arg)
+{
+	struct digest *d = arg;
+	UINT64 start;
+
+	start = rdtsc();
+	sha256_update(&d->ctx, d->buf, d->len);
+	__atomic_fetch_add(&digest_stats.hash_ticks, rdtsc() - start,
+			   __ATOMIC_RELAXED);
+}
+
+/*
+ * Wait for the chunk being hashed, helping out with other jobs.
+ */
+static void wait_chunk(struct digest *d)
+{
+	UINT64 start;
+
+	if (!d->queued)
+		return;
+
+	start = rdtsc();
+	mp_wait(&d->job);
+	digest_stats.wait_ticks += rdtsc() - start;
+
+	d->queued = FALSE;
+}
+
+/**
+ * digest_update - Hash the next part of a file
+ * @d: the file's hashing state
+ * @buf: the data, which must not change until the next call on @d
+ * @len: the number of bytes at @buf
+ *
+ * The hashing may not have finished when this returns.
+ */
+void digest_update(struct digest *d, const void *buf, UINTN len)
+{
+	UINT64 start;
+
+	/* A file's chunks have to be hashed in order */
+	wait_chunk(d);
+
+	d->buf = buf;
+	d->len = len;
+	d->queued = TRUE;
+	digest_stats.bytes += len;
+
+	/* Without workers the chunk is hashed here and now */
+	start = rdtsc();
+	mp_submit(&d->job, hash_chunk, d);
+	if (!mp_nr_workers())
+		digest_stats.wait_ticks += rdtsc() - start;
+}
+
+/**
+ * digest_hook - A stream hook that hashes each chunk of the stream
+ * @s: the stream
+ * @buf: the chunk being retired
+ * @len: the length of the chunk
+ * @data: the struct digest for the stream's file
+ */
+void digest_hook(struct stream *s, void *buf, UINTN len, void *data)
+{
+	struct digest *d = data;
+
+	d->read_ticks = s->ticks;
+	digest_update(d, buf, len);
+}
+
+/**
+ * digest_finish - Check a file against its pinned digest
+ * @d: the file's hashing state, after the whole file has been passed
+ *     to digest_update()
+ *
+ * Returns EFI_SECURITY_VIOLATION if the file doesn't match.
+ */
+EFI_STATUS digest_finish(struct digest *d)
+{
+	UINT8 digest[SHA256_DIGEST_SIZE], diff = 0;
+	int i;
+
+	wait_chunk(d);
+	sha256_final(&d->ctx, digest);
+	digest_stats.read_ticks += d->read_ticks;
+
+	for (i = 0; i < SHA256_DIGEST_SIZE; i++)
+		diff |= digest[i] ^ d->expect[i];
+
+	if (diff) {
+		log_print(LOG_ERR, L"%s: SHA-256 mismatch, refusing to boot\n",
+			  d->name);
+		return EFI_SECURITY_VIOLATION;
+	}
+
+	return EFI_SUCCESS;
+}
+
+/**
+ * digest_cancel - Give up on hashing a file
+ * @d: the file's hashing state
+ *
+ * Wait for any hashing still in progress, so that @d and the buffers
+ * passed to digest_update() can be freed.
+ */
+void digest_cancel(struct digest *d)
+{
+	wait_chunk(d);
+}
+
+/**
+ * digest_report - Print how fast files were hashed, if any were
+ */
+void digest_report(void)
+{
+	UINT64 bytes = digest_stats.bytes;
+
+	if (!bytes)
+		return;
+
+	/* MB/s is the same as bytes/us */
+	log_print(LOG_INFO, L"sha256: %ld bytes, hashed at %ld MB/s (%a), "
+		  "read at %ld MB/s, %ld us waiting for hashes\n", bytes,
+		  bytes * tsc_per_us() / (digest_stats.hash_ticks + 1),
+		  sha256_impl(),
+		  bytes * tsc_per_us() / (digest_stats.read_ticks + 1),
+		  ticks_to_us(digest_stats.wait_ticks));
+}
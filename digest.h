@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Pinned SHA-256 digests for the files that efilinux loads.
+ */
+
+#ifndef __DIGEST_H__
+#define __DIGEST_H__
+
+/*
+ * Hashing state for one file. The file is hashed a chunk at a time as
+ * it is read, each chunk by an mp job, so the hashing overlaps with
+ * the read of the next chunk and files are hashed in parallel.
+ */
+struct digest {
+	CHAR16 *name;
+	UINT8 *expect;
+	struct sha256 ctx;
+
+	/* The chunk being hashed, if queued is set */
+	struct mp_job job;
+	BOOLEAN queued;
+	const void *buf;
+	UINTN len;
+
+	UINT64 read_ticks;
+};
+
+struct stream;
+
+struct digest_stats {
+	UINT64 bytes;
+	UINT64 hash_ticks;	/* spent hashing, on any processor */
+	UINT64 read_ticks;	/* spent waiting for the reads being hashed */
+	UINT64 wait_ticks;	/* the BSP spent waiting for hashes */
+};
+
+extern struct digest_stats digest_stats;
+
+extern EFI_STATUS digest_pin(char *arg, UINTN arg_len);
+extern BOOLEAN digest_pinned(CHAR16 *name);
+extern BOOLEAN digest_start(struct digest *d, CHAR16 *name);
+extern void digest_update(struct digest *d, const void *buf, UINTN len);
+extern void digest_hook(struct stream *s, void *buf, UINTN len, void *data);
+extern EFI_STATUS digest_finish(struct digest *d);
+extern void digest_cancel(struct digest *d);
+extern void digest_report(void);
+
+#endif /* __DIGEST_H__ */
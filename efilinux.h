@@ -183,8 +183,116 @@ exit(EFI_HANDLE image, EFI_STATUS status, UINTN size, CHAR16 *reason)
 	return uefi_call_wrapper(boot->Exit, 4, image, status, size, reason);
 }
 
+/**
+ * stall - Busy-wait for a number of microseconds
+ * @usecs: the number of microseconds to stall execution for
+ */
+static inline EFI_STATUS stall(UINTN usecs)
+{
+	return uefi_call_wrapper(boot->Stall, 1, usecs);
+}
+
+/**
+ * create_event - Create an event that can be waited on
+ * @event: used to return the new event
+ *
+ * The event has no notification function, it is only ever checked
+ * with check_event() or waited on with wait_for_event().
+ */
+static inline EFI_STATUS create_event(EFI_EVENT *event)
+{
+	return uefi_call_wrapper(boot->CreateEvent, 5, 0, TPL_CALLBACK,
+				 NULL, NULL, event);
+}
+
+/**
+ * close_event - Free an event created by create_event()
+ * @event: the event to close
+ */
+static inline EFI_STATUS close_event(EFI_EVENT event)
+{
+	return uefi_call_wrapper(boot->CloseEvent, 1, event);
+}
+
+/**
+ * check_event - Check whether an event is in the signaled state
+ * @event: the event to check
+ *
+ * Returns EFI_SUCCESS if @event was signaled, in which case it is
+ * reset to the waiting state, or EFI_NOT_READY if it was not.
+ */
+static inline EFI_STATUS check_event(EFI_EVENT event)
+{
+	return uefi_call_wrapper(boot->CheckEvent, 1, event);
+}
+
+/**
+ * wait_for_event - Stop execution until one of a set of events is signaled
+ * @nr_events: the number of events in @events
+ * @events: the events to wait on
+ * @index: used to return the index of the event that was signaled
+ *
+ * The signaled event is reset to the waiting state.
+ */
+static inline EFI_STATUS
+wait_for_event(UINTN nr_events, EFI_EVENT *events, UINTN *index)
+{
+	return uefi_call_wrapper(boot->WaitForEvent, 3, nr_events,
+				 events, index);
+}
+
+/**
+ * rdtsc - Read the processor's time-stamp counter
+ *
+ * The TSC counts at a constant rate on every processor that efilinux
+ * is likely to run on, which makes it a cheap way of timing firmware
+ * calls. Use stall() to work out how many ticks make up a microsecond.
+ */
+static inline UINT64 rdtsc(void)
+{
+	UINT32 lo, hi;
+
+	asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((UINT64)hi << 32) | lo;
+}
+
+/**
+ * cpuid - Query processor identification and feature information
+ * @leaf: the value of %eax, selecting the information to return
+ * @subleaf: the value of %ecx, for leaves that have sub-leaves
+ * @regs: used to return %eax, %ebx, %ecx and %edx, in that order
+ */
+static inline void cpuid(UINT32 leaf, UINT32 subleaf, UINT32 regs[4])
+{
+	asm volatile ("cpuid"
+		      : "=a" (regs[0]), "=b" (regs[1]),
+			"=c" (regs[2]), "=d" (regs[3])
+		      : "0" (leaf), "2" (subleaf));
+}
+
+/**
+ * xgetbv - Read an extended control register
+ * @index: the XCR to read, 0 being XCR0
+ *
+ * XCR0 tells us which register state the firmware has enabled, for
+ * instance whether it is safe to touch the upper halves of the %ymm
+ * registers. Only call this if cpuid() reports OSXSAVE.
+ */
+static inline UINT64 xgetbv(UINT32 index)
+{
+	UINT32 lo, hi;
+
+	asm volatile ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (index));
+	return ((UINT64)hi << 32) | lo;
+}
+
 #define PAGE_SIZE	4096
 
+/* Older gnu-efi doesn't know about specific-purpose memory */
+#ifndef EFI_MEMORY_SP
+#define EFI_MEMORY_SP	0x0000000000040000ULL
+#endif
+
 static const CHAR16 *memory_types[] = {
 	L"EfiReservedMemoryType",
 	L"EfiLoaderCode",
@@ -31,13 +31,27 @@
 #include <efilib.h>
 #include "efilinux.h"
 #include "fs.h"
+#include "fat.h"
+#include "aio.h"
+#include "stream.h"
 #include "protocol.h"
 #include "loader.h"
+#include "profile.h"
 #include "stdlib.h"
+#include "numa.h"
+#include "mp.h"
+#include "sha256.h"
+#include "digest.h"
+#include "config.h"
+#include "log.h"
+#include "uart.h"
+#include "fbcon.h"
+#include "gop.h"
 
 #define ERROR_STRING_LENGTH	32
 
 static CHAR16 *banner = L"efilinux loader %d.%d\n";
+static BOOLEAN quiet = FALSE;
 
 EFI_SYSTEM_TABLE *sys_table;
 EFI_BOOT_SERVICES *boot;
@@ -76,7 +90,7 @@ get_map:
 	err = allocate_pool(EfiLoaderData, *map_size,
 			    (void **)map_buf);
 	if (err != EFI_SUCCESS) {
-		Print(L"Failed to allocate pool for memory map");
+		log_print(LOG_ERR, L"Failed to allocate pool for memory map");
 		goto failed;
 	}
 
@@ -92,7 +106,7 @@ get_map:
 			goto get_map;
 		}
 
-		Print(L"Failed to get memory map");
+		log_print(LOG_ERR, L"Failed to get memory map");
 		goto failed;
 	}
 
@@ -115,10 +129,10 @@ static EFI_STATUS print_memory_map(void)
 	if (err != EFI_SUCCESS)
 		return err;
 
-	Print(L"System Memory Map\n");
-	Print(L"System Memory Map Size: %d\n", size);
-	Print(L"Descriptor Version: %d\n", desc_version);
-	Print(L"Descriptor Size: %d\n", desc_size);
+	con_print(L"System Memory Map\n");
+	con_print(L"System Memory Map Size: %d\n", size);
+	con_print(L"Descriptor Version: %d\n", desc_version);
+	con_print(L"Descriptor Size: %d\n", desc_size);
 
 	desc = buf;
 	i = 0;
@@ -128,20 +142,20 @@ static EFI_STATUS print_memory_map(void)
 
 		mapping_size = desc->NumberOfPages * PAGE_SIZE;
 
-		Print(L"[#%.2d] Type: %s\n", i,
-		      memory_type_to_str(desc->Type));
+		con_print(L"[#%.2d] Type: %s\n", i,
+			  memory_type_to_str(desc->Type));
 
-		Print(L"      Attr: 0x%016llx\n", desc->Attribute);
+		con_print(L"      Attr: 0x%016llx\n", desc->Attribute);
 
-		Print(L"      Phys: [0x%016llx - 0x%016llx]\n",
-		      desc->PhysicalStart,
-		      desc->PhysicalStart + mapping_size);
+		con_print(L"      Phys: [0x%016llx - 0x%016llx]\n",
+			  desc->PhysicalStart,
+			  desc->PhysicalStart + mapping_size);
 
-		Print(L"      Virt: [0x%016llx - 0x%016llx]",
-		      desc->VirtualStart,
-		      desc->VirtualStart + mapping_size);
+		con_print(L"      Virt: [0x%016llx - 0x%016llx]",
+			  desc->VirtualStart,
+			  desc->VirtualStart + mapping_size);
 
-		Print(L"\n");
+		con_print(L"\n");
 		desc = (void *)desc + desc_size;
 		i++;
 	}
@@ -150,118 +164,202 @@ static EFI_STATUS print_memory_map(void)
 	return err;
 }
 
-static inline BOOLEAN isspace(CHAR16 ch)
+/*
+ * Find the argument of the switch 'tok', either the rest of the
+ * token, as in "-c512", or the next token.
+ */
+static BOOLEAN switch_arg(struct tokenizer *t, struct token *tok,
+			  struct token *arg)
 {
-	return ((unsigned char)ch <= ' ');
+	if (tok->len > 2) {
+		arg->str = tok->str + 2;
+		arg->len = tok->len - 2;
+		return TRUE;
+	}
+
+	if (!token_next(t, arg)) {
+		log_print(LOG_ERR, L"Missing argument to -%c\n", tok->str[1]);
+		return FALSE;
+	}
+
+	return TRUE;
 }
 
+/*
+ * Switches are parsed until the first token that isn't one, which
+ * starts the kernel command line. '*cmdline' is left pointing into
+ * 'options'.
+ */
 static EFI_STATUS
-parse_args(CHAR16 *options, UINT32 size, CHAR16 **name, char **cmdline)
+parse_args(char *options, UINTN size, CHAR16 **name, char **cmdline)
 {
-	CHAR16 *n, *o, *filename = NULL;
+	struct tokenizer t;
+	struct token tok, arg;
 	EFI_STATUS err;
-	int i = 0;
 
 	*cmdline = NULL;
 	*name = NULL;
 
-	/* Skip whitespace */
-	for (i = 0; i < size && isspace(options[i]); i++)
-		     ;
+	token_init(&t, options, size);
 
 	/* No arguments */
-	if (i == size)
+	if (!token_next(&t, &tok))
 		goto usage;
+	token_unget(&t, &tok);
 
-	n = &options[i];
-	while (n <= &options[size]) {
-		if (*n == '-') {
-			switch (*++n) {
-			case 'h':
+	while (token_next(&t, &tok)) {
+		if (tok.str[0] != '-' || tok.len < 2) {
+			token_unget(&t, &tok);
+			break;
+		}
+
+		/* Switches that take an argument */
+		switch (tok.str[1]) {
+		case 'c':
+		case 'd':
+		case 'f':
+		case 'j':
+		case 'n':
+		case 'u':
+		case 'v':
+			if (!switch_arg(&t, &tok, &arg))
+				goto usage;
+			break;
+		default:
+			if (tok.len > 2) {
+				log_print(LOG_ERR,
+					  L"Unknown command-line switch\n");
+				goto usage;
+			}
+			break;
+		}
+
+		switch (tok.str[1]) {
+		case 'h':
+			goto usage;
+		case 'c':
+			stream_chunk_size = token_atoi(&arg) * 1024;
+			break;
+		case 'd':
+			err = digest_pin(arg.str, arg.len);
+			if (err == EFI_OUT_OF_RESOURCES) {
+				log_print(LOG_ERR,
+					  L"Unable to alloc digest memory\n");
+				goto out;
+			}
+			if (err != EFI_SUCCESS) {
+				log_print(LOG_ERR,
+					  L"Expected -d <file>=<sha256>\n");
 				goto usage;
-			case 'f':
-				n++;	/* Skip 'f' */
-
-				/* Skip whitespace */
-				while (isspace(*n))
-					n++;
-
-				filename = n;
-				i = 0;	
-				while (*n && !isspace(*n)) {
-					i++;
-					n++;
-				}
-				*n++ = '\0';
-
-				o = malloc(sizeof(*o) * (i + 1));
-				if (!o) {
-					Print(L"Unable to alloc filename memory\n");
-					err = EFI_OUT_OF_RESOURCES;
-					goto out;
-				}
-				o[i--] = '\0';
-
-				StrCpy(o, filename);
-				*name = o;
-				break;
-			case 'l':
-				list_boot_devices();
-				goto fail;
-			case 'm':
-				print_memory_map();
-				n++;
-				goto fail;
-			default:
-				Print(L"Unknown command-line switch\n");
+			}
+			break;
+		case 'j':
+			mp_max_workers = token_atoi(&arg);
+			break;
+		case 'n':
+			if (token_is(&arg, "off"))
+				numa_policy = NUMA_OFF;
+			else if (token_is(&arg, "local"))
+				numa_policy = NUMA_LOCAL;
+			else if (token_is(&arg, "fastest"))
+				numa_policy = NUMA_FASTEST;
+			else {
+				log_print(LOG_ERR,
+					  L"Unknown placement policy\n");
 				goto usage;
 			}
-		} else {
-			char *s1;
-			CHAR16 *s2;
-			int j;
-
-			j = StrLen(n);
-			*cmdline = malloc(j + 1);
-			if (!*cmdline) {
-				Print(L"Unable to alloc cmdline memory\n");
+			break;
+		case 'g':
+			/* Not fatal, we fall back to ConOut */
+			fbcon_init();
+			break;
+		case 'f':
+			if (*name)
+				free(*name);
+
+			*name = token_wide(&arg);
+			if (!*name) {
+				log_print(LOG_ERR,
+					  L"Unable to alloc filename memory\n");
 				err = EFI_OUT_OF_RESOURCES;
-				goto free_name;
+				goto out;
 			}
-			
-			s1 = *cmdline;
-			s2 = n;
-
-			while (j--)
-				*s1++ = *s2++;
-
-			*s1 = '\0';
-
-			/* Consume the rest of the args */
-			n = &options[size] + 1;
+			break;
+		case 'l':
+			log_flush();
+			list_boot_devices();
+			goto fail;
+		case 'm':
+			log_flush();
+			print_memory_map();
+			goto fail;
+		case 'p':
+			profile_enabled = TRUE;
+			break;
+		case 'q':
+			quiet = TRUE;
+			break;
+		case 'r':
+			fat_direct = TRUE;
+			break;
+		case 's':
+			aio_enabled = FALSE;
+			break;
+		case 't':
+			stream_verbose = TRUE;
+			break;
+		case 'u':
+			/* Not fatal, we fall back to ConOut */
+			uart_init(arg.str, arg.len);
+			break;
+		case 'v':
+			/* Only a bad policy is fatal, we keep the mode */
+			err = gop_set_policy(&arg);
+			if (err == EFI_INVALID_PARAMETER) {
+				log_print(LOG_ERR,
+					  L"Unknown graphics mode policy\n");
+				goto usage;
+			}
+			break;
+		default:
+			log_print(LOG_ERR, L"Unknown command-line switch\n");
+			goto usage;
 		}
 	}
 
-	if (filename)
+	/* Everything else is for the kernel */
+	*cmdline = token_rest(&t);
+
+	if (*name)
 		return EFI_SUCCESS;
 
 usage:
-	Print(L"usage: efilinux [-hlm] -f <filename> <args>\n\n");
-	Print(L"\t-h:             display this help menu\n");
-	Print(L"\t-l:             list boot devices\n");
-	Print(L"\t-m:             print memory map\n");
-	Print(L"\t-f <filename>:  image to load\n");
+	log_flush();
+	con_print(L"usage: efilinux [-ghlmpqrst] [-c <KiB>] [-d <file>=<hex>] [-j <n>] [-n <policy>] [-u <uart>] [-v <mode>] -f <filename> <args>\n\n");
+	con_print(L"\t-g:             draw the console in the framebuffer\n");
+	con_print(L"\t-h:             display this help menu\n");
+	con_print(L"\t-l:             list boot devices\n");
+	con_print(L"\t-m:             print memory map\n");
+	con_print(L"\t-p:             print boot phase timings\n");
+	con_print(L"\t-q:             quiet, only print messages on error\n");
+	con_print(L"\t-r:             read FAT files directly from the disk\n");
+	con_print(L"\t-s:             read files synchronously\n");
+	con_print(L"\t-t:             report read throughput per chunk\n");
+	con_print(L"\t-c <KiB>:       read files in chunks of <KiB>\n");
+	con_print(L"\t-d <file>=<hex>: refuse to boot unless <file> has this SHA-256\n");
+	con_print(L"\t-j <n>:         use at most <n> other processors\n");
+	con_print(L"\t-n <policy>:    kernel placement: off, local or fastest\n");
+	con_print(L"\t-u <uart>:      print to a 16550 UART, spcr or io|mmio|mmio32,<addr>[,<baud>]\n");
+	con_print(L"\t-v <mode>:      graphics mode: keep, lowest, <w>x<h> or max:<w>x<h>\n");
+	con_print(L"\t-f <filename>:  image to load\n");
 
 fail:
 	err = EFI_INVALID_PARAMETER;
-
-	if (*cmdline)
-		free(*cmdline);
-
-free_name:
+out:
 	if (*name)
 		free(*name);
-out:
+	*name = NULL;
+
 	return err;
 }
 
@@ -273,7 +371,7 @@ get_path(EFI_LOADED_IMAGE *image, CHAR16 *path, UINTN len)
 
 	dev = handle_to_dev(image->DeviceHandle);
 	if (dev == -1) {
-		Print(L"Couldn't find boot device handle\n");
+		log_print(LOG_ERR, L"Couldn't find boot device handle\n");
 		return FALSE;
 	}
 
@@ -287,9 +385,9 @@ get_path(EFI_LOADED_IMAGE *image, CHAR16 *path, UINTN len)
 		i--;
 	}
 
-	buf = malloc(i * sizeof(CHAR16));
+	buf = malloc((i + 1) * sizeof(CHAR16));
 	if (!buf) {
-		Print(L"Failed to allocate buf\n");
+		log_print(LOG_ERR, L"Failed to allocate buf\n");
 		FreePool(p);
 		return FALSE;
 	}
@@ -299,21 +397,24 @@ get_path(EFI_LOADED_IMAGE *image, CHAR16 *path, UINTN len)
 
 	buf[i] = '\0';
 	SPrint(path, len, L"%d:%s\\%s", dev, buf, EFILINUX_CONFIG);
+	free(buf);
 
 	return TRUE;
 }
 
+/*
+ * Read efilinux.cfg, from the directory that efilinux was loaded
+ * from, into a NUL-terminated buffer.
+ */
 static BOOLEAN
-read_config_file(EFI_LOADED_IMAGE *image, CHAR16 **options,
-		 UINT32 *options_size)
+read_config_file(EFI_LOADED_IMAGE *image, char **options, UINTN *options_size)
 {
 	struct file *file;
 	EFI_STATUS err;
 	CHAR16 path[4096];
-	CHAR16 *u_buf, *q;
-	char *a_buf, *p;
+	char *buf;
 	UINT64 size;
-	int i;
+	UINTN len;
 
 	err = get_path(image, path, sizeof(path));
 	if (err != TRUE)
@@ -327,68 +428,75 @@ read_config_file(EFI_LOADED_IMAGE *image, CHAR16 **options,
 	if (err != EFI_SUCCESS)
 		goto fail;
 
-	/*
-	 * The config file contains ASCII characters, but the command
-	 * line parser expects arguments to be UTF-16. Convert them
-	 * once we've read them into 'a_buf'.
-	 */
-
-	/* Make sure we don't overflow the UINT32 */
-	if (size > 0xffffffff || (size * 2) > 0xffffffff ) {
-		Print(L"Config file size too large. Ignoring.\n");
+	if (size > 0xffffffff) {
+		log_print(LOG_WARN, L"Config file size too large. Ignoring.\n");
 		goto fail;
 	}
 
-	a_buf = malloc((UINTN)size);
-	if (!a_buf) {
-		Print(L"Failed to alloc buffer %d bytes\n", size);
+	/* Leave room for the NUL */
+	buf = malloc((UINTN)size + 1);
+	if (!buf) {
+		log_print(LOG_ERR, L"Failed to alloc buffer %d bytes\n", size);
 		goto fail;
 	}
 
-	u_buf = malloc((UINTN)size * 2);
-	if (!u_buf) {
-		Print(L"Failed to alloc buffer %d bytes\n", size);
-		free(a_buf);
+	len = (UINTN)size;
+	err = file_read(file, &len, buf);
+	if (err != EFI_SUCCESS) {
+		free(buf);
 		goto fail;
 	}
 
-	err = file_read(file, (UINTN *)&size, a_buf);
-	if (err != EFI_SUCCESS)
-		goto fail;
+	buf[len] = '\0';
+
+	log_print(LOG_INFO, L"Using efilinux config file\n");
+
+	*options = buf;
+	*options_size = len;
+
+	file_close(file);
+	return TRUE;
+fail:
+	file_close(file);
+	return FALSE;
+}
+
+/*
+ * Without a config file the arguments come from the load options,
+ * which are UTF-16. The kernel wants its command line in ASCII, so
+ * narrow them once, here.
+ */
+static EFI_STATUS
+read_load_options(EFI_LOADED_IMAGE *image, char **options, UINTN *options_size)
+{
+	CHAR16 *o = image->LoadOptions;
+	UINTN nr, i;
+	char *buf, *p;
 
-	Print(L"Using efilinux config file\n");
+	nr = image->LoadOptionsSize / sizeof(CHAR16);
 
 	/*
-	 * Read one line. Stamp a NUL-byte into the buffer once we've
-	 * read the end of the first line.
+	 * Skip the first word, that's probably our name. Stop when we
+	 * hit a word delimiter (' ') or the start of an efilinux
+	 * argument ('-').
 	 */
-	for (p = a_buf, i = 0; *p && *p != '\n' && i < size; p++, i++)
-		;
-	if (*p == '\n')
-		*p++ = '\0';
-
-	if (i == size && *p) {
-		Print(L"Error: missing newline at end of config file?\n");
-		goto fail;
+	for (i = 0; i < nr && o[i]; i++) {
+		if (o[i] == ' ' || o[i] == '-')
+			break;
 	}
 
-	if ((p - a_buf) < size)
-		Print(L"Warning: config file contains multiple lines?\n");
+	buf = malloc(nr - i + 1);
+	if (!buf)
+		return EFI_OUT_OF_RESOURCES;
 
-	p = a_buf;
-	q = u_buf;
-	for (i = 0; i < size; i++)
-		*q++ = *p++;
-	free(a_buf);
+	for (p = buf; i < nr && o[i]; i++)
+		*p++ = (char)o[i];
+	*p = '\0';
 
-	*options = u_buf;
-	*options_size = (UINT32)size * 2;
+	*options = buf;
+	*options_size = p - buf;
 
-	file_close(file);
-	return TRUE;
-fail:
-	file_close(file);
-	return FALSE;
+	return EFI_SUCCESS;
 }
 
 /**
@@ -402,52 +510,49 @@ efi_main(EFI_HANDLE image, EFI_SYSTEM_TABLE *_table)
 	WCHAR *error_buf;
 	EFI_STATUS err;
 	EFI_LOADED_IMAGE *info;
-	CHAR16 *name, *options;
-	UINT32 options_size;
-	char *cmdline;
+	char *options, *cmdline;
+	UINTN options_size;
+	CHAR16 *name;
 
 	InitializeLib(image, _table);
 	sys_table = _table;
 	boot = sys_table->BootServices;
 	runtime = sys_table->RuntimeServices;
 
+	profile_init();
+
 	if (CheckCrc(sys_table->Hdr.HeaderSize, &sys_table->Hdr) != TRUE)
 		return EFI_LOAD_ERROR;
 
-	Print(banner, EFILINUX_VERSION_MAJOR, EFILINUX_VERSION_MINOR);
+	log_print(LOG_INFO, banner, EFILINUX_VERSION_MAJOR,
+		  EFILINUX_VERSION_MINOR);
 
 	err = fs_init();
 	if (err != EFI_SUCCESS)
 		goto failed;
 
+	profile_stamp("fs_init", 0);
+
 	err = handle_protocol(image, &LoadedImageProtocol, (void **)&info);
 	if (err != EFI_SUCCESS)
 		goto fs_deinit;
 
 	if (!read_config_file(info, &options, &options_size)) {
-		int i;
-
-		options = info->LoadOptions;
-		options_size = info->LoadOptionsSize;
-
-		/*
-		 * Skip the first word, that's probably our name. Stop
-		 * when we hit a word delimiter (' ') or the start of an
-		 * efilinux argument ('-').
-		 */
-		i = 0;
-		while (i < options_size) {
-			if (options[i] == ' ' || options[i] == '-')
-				break;
-			i++;
-		}
-
-		options = &options[i];
-		options_size -= i;
+		err = read_load_options(info, &options, &options_size);
+		if (err != EFI_SUCCESS)
+			goto fs_deinit;
 	}
 
-	if (options && options_size != 0) {
-		err = parse_args(options, options_size, &name, &cmdline);
+	profile_stamp("read_config", options_size);
+
+	err = parse_args(options, options_size, &name, &cmdline);
+
+	/* Messages are held until we know whether to be quiet */
+	log_quiet = quiet;
+	if (!quiet)
+		log_flush();
+	if (err != EFI_SUCCESS) {
+		free(options);
 
 		/* We print the usage message in case of invalid args */
 		if (err == EFI_INVALID_PARAMETER) {
@@ -455,10 +560,17 @@ efi_main(EFI_HANDLE image, EFI_SYSTEM_TABLE *_table)
 			return EFI_SUCCESS;
 		}
 
-		if (err != EFI_SUCCESS)
-			goto fs_deinit;
+		goto fs_deinit;
 	}
 
+	profile_stamp("parse_args", 0);
+
+	numa_init();
+	profile_stamp("numa", 0);
+
+	mp_init();
+	profile_stamp("mp", mp_nr_workers());
+
 	err = load_image(image, name, cmdline);
 	if (err != EFI_SUCCESS)
 		goto free_args;
@@ -466,7 +578,8 @@ efi_main(EFI_HANDLE image, EFI_SYSTEM_TABLE *_table)
 	return EFI_SUCCESS;
 
 free_args:
-	free(cmdline);
+	mp_fini();
+	free(options);
 	free(name);
 fs_deinit:
 	fs_exit();
@@ -478,11 +591,12 @@ failed:
 	 */
 	if (allocate_pool(EfiLoaderData, ERROR_STRING_LENGTH,
 			  (void **)&error_buf) != EFI_SUCCESS) {
-		Print(L"Couldn't allocate pages for error string\n");
+		log_print(LOG_ERR,
+			  L"Couldn't allocate pages for error string\n");
 		return err;
 	}
 
 	StatusToString(error_buf, err);
-	Print(L": %s\n", error_buf);
+	log_print(LOG_ERR, L": %s\n", error_buf);
 	return exit(image, err, ERROR_STRING_LENGTH, error_buf);
 }
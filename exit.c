@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Getting out of boot services.
+ *
+ * Once ExitBootServices() has been called, successfully or not, only
+ * the firmware's memory allocation services may be used, and between
+ * the final GetMemoryMap() and ExitBootServices() nothing may change
+ * the map or the key goes stale. So the buffer for the final map,
+ * along with whatever room the loader needs to convert it, is
+ * reserved well before we leave, with headroom for the descriptors
+ * that closing files, freeing the arena and the firmware's own timer
+ * callbacks add in the meantime. Leaving is then just GetMemoryMap()
+ * and ExitBootServices() in a loop, retried while the key moves under
+ * us.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "stdlib.h"
+#include "profile.h"
+#include "exit.h"
+#include "log.h"
+
+struct exit_map exit_map;
+struct exit_stats exit_stats;
+
+/* The reservation, and how much of it is the map */
+static EFI_PHYSICAL_ADDRESS reserved;
+static UINTN reserved_size;
+static UINTN map_room;
+
+static UINTN extra_per_desc;
+static UINTN extra_fixed;
+
+/*
+ * (Re)reserve room for a map of 'size' bytes, plus headroom, plus
+ * the caller's extra room for that many descriptors.
+ */
+static EFI_STATUS reserve(UINTN size, UINTN desc_size)
+{
+	UINTN nr, total;
+	EFI_STATUS err;
+
+	if (reserved_size) {
+		efree(reserved, reserved_size);
+		reserved_size = 0;
+	}
+
+	if (desc_size < sizeof(EFI_MEMORY_DESCRIPTOR))
+		desc_size = sizeof(EFI_MEMORY_DESCRIPTOR);
+
+	nr = size / desc_size;
+	nr += nr / 8 + EXIT_MAP_HEADROOM;
+
+	map_room = nr * desc_size;
+	total = ((map_room + 7) & ~7) + extra_fixed + nr * extra_per_desc;
+
+	err = emalloc(total, 8, &reserved);
+	if (err != EFI_SUCCESS)
+		return err;
+
+	reserved_size = total;
+	exit_map.map = (EFI_MEMORY_DESCRIPTOR *)(UINTN)reserved;
+	exit_map.max_desc = nr;
+	exit_map.extra = (void *)(UINTN)(reserved + ((map_room + 7) & ~7));
+
+	return EFI_SUCCESS;
+}
+
+/**
+ * exit_reserve - Reserve room for the final memory map
+ * @per_desc: extra bytes the caller wants per memory map descriptor
+ * @fixed: extra bytes the caller wants regardless of the map's size
+ *
+ * Call this as early as is convenient once it's clear we are going to
+ * exit boot services. The caller's extra room is at exit_map.extra,
+ * sized for exit_map.max_desc descriptors, and both stay put unless
+ * exit_boot() finds the map outgrew the headroom.
+ */
+EFI_STATUS exit_reserve(UINTN per_desc, UINTN fixed)
+{
+	UINTN size = 0, key, desc_size = 0;
+	UINT32 desc_version;
+	EFI_STATUS err;
+
+	extra_per_desc = per_desc;
+	extra_fixed = fixed;
+
+	/* We're just interested in the map's size for now */
+	err = get_memory_map(&size, NULL, &key, &desc_size, &desc_version);
+	if (err != EFI_SUCCESS && err != EFI_BUFFER_TOO_SMALL)
+		return err;
+
+	return reserve(size, desc_size);
+}
+
+/**
+ * exit_boot - Take the final memory map and exit boot services
+ * @image: firmware-allocated handle that identifies the image
+ *
+ * Nothing is allocated between taking the final map and calling
+ * ExitBootServices(). If the firmware changed the map in between,
+ * e.g. from a timer callback, ExitBootServices() fails with
+ * EFI_INVALID_PARAMETER and we take the map again and retry. On
+ * success the map is described by exit_map; on failure boot services
+ * may be partially shut down and only memory allocation is safe.
+ */
+EFI_STATUS exit_boot(EFI_HANDLE image)
+{
+	UINT64 start, final, now;
+	EFI_STATUS err;
+	UINTN size;
+
+	if (!reserved_size) {
+		err = exit_reserve(extra_per_desc, extra_fixed);
+		if (err != EFI_SUCCESS)
+			return err;
+	}
+
+	start = rdtsc();
+	for (;;) {
+		final = rdtsc();
+		size = map_room;
+		err = get_memory_map(&size, exit_map.map, &exit_map.key,
+				     &exit_map.desc_size,
+				     &exit_map.desc_version);
+
+		/*
+		 * The headroom wasn't enough. Allocating a larger
+		 * buffer changes the key again, but that's still
+		 * allowed after a failed ExitBootServices().
+		 */
+		if (err == EFI_BUFFER_TOO_SMALL) {
+			exit_stats.reallocs++;
+			err = reserve(size, exit_map.desc_size);
+			if (err != EFI_SUCCESS)
+				return err;
+			continue;
+		}
+
+		if (err != EFI_SUCCESS)
+			return err;
+
+		if (!exit_stats.attempts)
+			profile_stamp("memory_map", size);
+
+		err = exit_boot_services(image, exit_map.key);
+		exit_stats.attempts++;
+
+		if (err != EFI_INVALID_PARAMETER ||
+		    exit_stats.attempts == EXIT_MAX_ATTEMPTS)
+			break;
+
+		log_print(LOG_DEBUG, L"Memory map changed, retrying "
+			  "ExitBootServices\n");
+	}
+
+	if (err != EFI_SUCCESS)
+		return err;
+
+	now = rdtsc();
+	exit_stats.ticks = now - start;
+	exit_stats.final_ticks = now - final;
+	exit_map.size = size;
+
+	profile_stamp("exit_boot_svc", exit_stats.attempts);
+	/* Too late to calibrate the TSC, if nothing has yet */
+	log_print(LOG_DEBUG, L"Exited boot services in %ld TSC ticks\n",
+		  exit_stats.ticks);
+
+	return EFI_SUCCESS;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Getting out of boot services.
+ */
+
+#ifndef __EXIT_H__
+#define __EXIT_H__
+
+/*
+ * Descriptors of headroom reserved on top of the memory map's size
+ * when exit_reserve() is called, for whatever we and the firmware
+ * allocate between then and exit_boot().
+ */
+#define EXIT_MAP_HEADROOM	32
+
+/* ExitBootServices() calls before we give up on a moving map key */
+#define EXIT_MAX_ATTEMPTS	8
+
+/*
+ * The final memory map, valid once exit_boot() has succeeded. 'extra'
+ * is the caller's room for converting the map, reserved alongside it.
+ */
+struct exit_map {
+	EFI_MEMORY_DESCRIPTOR *map;
+	UINTN size;
+	UINTN key;
+	UINTN desc_size;
+	UINT32 desc_version;
+
+	UINTN max_desc;		/* descriptors the buffer has room for */
+	void *extra;
+};
+
+struct exit_stats {
+	UINTN attempts;		/* ExitBootServices() calls */
+	UINTN reallocs;		/* times the reserved buffer was too small */
+	UINT64 ticks;		/* from the first GetMemoryMap() to success */
+	UINT64 final_ticks;	/* from the final GetMemoryMap() to success */
+};
+
+extern struct exit_map exit_map;
+extern struct exit_stats exit_stats;
+
+extern EFI_STATUS exit_reserve(UINTN per_desc, UINTN fixed);
+extern EFI_STATUS exit_boot(EFI_HANDLE image);
+
+#endif /* __EXIT_H__ */
@@ -0,0 +1,365 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * A text console drawn straight into the GOP framebuffer.
+ *
+ * ConOut on a high resolution GOP mode renders every character
+ * through the firmware's HII font and Blt() and scrolls by redrawing,
+ * so printing the memory map of a big machine can take seconds. "-g"
+ * draws efilinux's output into the framebuffer itself instead, using
+ * a built-in 5x7 font in an 8x16 cell, doubled on 1440 line modes and
+ * up. Each row of a glyph is written as whole words from patterns
+ * prepared for the current colours, and scrolling is a single
+ * memmove() of the framebuffer. Reading the framebuffer back is slow
+ * on real hardware, so we scroll a quarter of the screen at a time.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "stdlib.h"
+#include "log.h"
+#include "gop.h"
+#include "fbcon.h"
+
+#define FONT_FIRST	' '
+#define FONT_LAST	'~'
+#define CELL_WIDTH	8
+#define CELL_HEIGHT	16	/* each of the 8 font rows is drawn twice */
+#define MAX_SCALE	2
+
+/* EFI_LIGHTGRAY on EFI_BLACK, like ConOut */
+#define FG_LEVEL	0xaa
+
+/*
+ * 5x7 glyphs for printable ASCII, one byte per row with the leftmost
+ * pixel in bit 7. They sit in columns 1-5 and rows 0-6 of the cell,
+ * which spaces them out, apart from the descenders in row 7.
+ */
+static const UINT8 font[FONT_LAST - FONT_FIRST + 1][8] = {
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	/* ' ' */
+	{ 0x10, 0x10, 0x10, 0x10, 0x10, 0x00, 0x10, 0x00 },	/* '!' */
+	{ 0x28, 0x28, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00 },	/* '"' */
+	{ 0x28, 0x28, 0x7c, 0x28, 0x7c, 0x28, 0x28, 0x00 },	/* '#' */
+	{ 0x10, 0x3c, 0x50, 0x38, 0x14, 0x78, 0x10, 0x00 },	/* '$' */
+	{ 0x60, 0x64, 0x08, 0x10, 0x20, 0x4c, 0x0c, 0x00 },	/* '%' */
+	{ 0x30, 0x48, 0x50, 0x20, 0x54, 0x48, 0x34, 0x00 },	/* '&' */
+	{ 0x30, 0x10, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00 },	/* '\'' */
+	{ 0x08, 0x10, 0x20, 0x20, 0x20, 0x10, 0x08, 0x00 },	/* '(' */
+	{ 0x20, 0x10, 0x08, 0x08, 0x08, 0x10, 0x20, 0x00 },	/* ')' */
+	{ 0x00, 0x10, 0x54, 0x38, 0x54, 0x10, 0x00, 0x00 },	/* '*' */
+	{ 0x00, 0x10, 0x10, 0x7c, 0x10, 0x10, 0x00, 0x00 },	/* '+' */
+	{ 0x00, 0x00, 0x00, 0x00, 0x30, 0x10, 0x20, 0x00 },	/* ',' */
+	{ 0x00, 0x00, 0x00, 0x7c, 0x00, 0x00, 0x00, 0x00 },	/* '-' */
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x30, 0x00 },	/* '.' */
+	{ 0x00, 0x04, 0x08, 0x10, 0x20, 0x40, 0x00, 0x00 },	/* '/' */
+	{ 0x38, 0x44, 0x4c, 0x54, 0x64, 0x44, 0x38, 0x00 },	/* '0' */
+	{ 0x10, 0x30, 0x10, 0x10, 0x10, 0x10, 0x38, 0x00 },	/* '1' */
+	{ 0x38, 0x44, 0x04, 0x08, 0x10, 0x20, 0x7c, 0x00 },	/* '2' */
+	{ 0x7c, 0x08, 0x10, 0x08, 0x04, 0x44, 0x38, 0x00 },	/* '3' */
+	{ 0x08, 0x18, 0x28, 0x48, 0x7c, 0x08, 0x08, 0x00 },	/* '4' */
+	{ 0x7c, 0x40, 0x78, 0x04, 0x04, 0x44, 0x38, 0x00 },	/* '5' */
+	{ 0x18, 0x20, 0x40, 0x78, 0x44, 0x44, 0x38, 0x00 },	/* '6' */
+	{ 0x7c, 0x04, 0x08, 0x10, 0x20, 0x20, 0x20, 0x00 },	/* '7' */
+	{ 0x38, 0x44, 0x44, 0x38, 0x44, 0x44, 0x38, 0x00 },	/* '8' */
+	{ 0x38, 0x44, 0x44, 0x3c, 0x04, 0x08, 0x30, 0x00 },	/* '9' */
+	{ 0x00, 0x30, 0x30, 0x00, 0x30, 0x30, 0x00, 0x00 },	/* ':' */
+	{ 0x00, 0x30, 0x30, 0x00, 0x30, 0x10, 0x20, 0x00 },	/* ';' */
+	{ 0x08, 0x10, 0x20, 0x40, 0x20, 0x10, 0x08, 0x00 },	/* '<' */
+	{ 0x00, 0x00, 0x7c, 0x00, 0x7c, 0x00, 0x00, 0x00 },	/* '=' */
+	{ 0x20, 0x10, 0x08, 0x04, 0x08, 0x10, 0x20, 0x00 },	/* '>' */
+	{ 0x38, 0x44, 0x04, 0x08, 0x10, 0x00, 0x10, 0x00 },	/* '?' */
+	{ 0x38, 0x44, 0x04, 0x34, 0x54, 0x54, 0x38, 0x00 },	/* '@' */
+	{ 0x38, 0x44, 0x44, 0x44, 0x7c, 0x44, 0x44, 0x00 },	/* 'A' */
+	{ 0x78, 0x44, 0x44, 0x78, 0x44, 0x44, 0x78, 0x00 },	/* 'B' */
+	{ 0x38, 0x44, 0x40, 0x40, 0x40, 0x44, 0x38, 0x00 },	/* 'C' */
+	{ 0x70, 0x48, 0x44, 0x44, 0x44, 0x48, 0x70, 0x00 },	/* 'D' */
+	{ 0x7c, 0x40, 0x40, 0x78, 0x40, 0x40, 0x7c, 0x00 },	/* 'E' */
+	{ 0x7c, 0x40, 0x40, 0x78, 0x40, 0x40, 0x40, 0x00 },	/* 'F' */
+	{ 0x38, 0x44, 0x40, 0x5c, 0x44, 0x44, 0x3c, 0x00 },	/* 'G' */
+	{ 0x44, 0x44, 0x44, 0x7c, 0x44, 0x44, 0x44, 0x00 },	/* 'H' */
+	{ 0x38, 0x10, 0x10, 0x10, 0x10, 0x10, 0x38, 0x00 },	/* 'I' */
+	{ 0x1c, 0x08, 0x08, 0x08, 0x08, 0x48, 0x30, 0x00 },	/* 'J' */
+	{ 0x44, 0x48, 0x50, 0x60, 0x50, 0x48, 0x44, 0x00 },	/* 'K' */
+	{ 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x7c, 0x00 },	/* 'L' */
+	{ 0x44, 0x6c, 0x54, 0x54, 0x44, 0x44, 0x44, 0x00 },	/* 'M' */
+	{ 0x44, 0x44, 0x64, 0x54, 0x4c, 0x44, 0x44, 0x00 },	/* 'N' */
+	{ 0x38, 0x44, 0x44, 0x44, 0x44, 0x44, 0x38, 0x00 },	/* 'O' */
+	{ 0x78, 0x44, 0x44, 0x78, 0x40, 0x40, 0x40, 0x00 },	/* 'P' */
+	{ 0x38, 0x44, 0x44, 0x44, 0x54, 0x48, 0x34, 0x00 },	/* 'Q' */
+	{ 0x78, 0x44, 0x44, 0x78, 0x50, 0x48, 0x44, 0x00 },	/* 'R' */
+	{ 0x3c, 0x40, 0x40, 0x38, 0x04, 0x04, 0x78, 0x00 },	/* 'S' */
+	{ 0x7c, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00 },	/* 'T' */
+	{ 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x38, 0x00 },	/* 'U' */
+	{ 0x44, 0x44, 0x44, 0x44, 0x44, 0x28, 0x10, 0x00 },	/* 'V' */
+	{ 0x44, 0x44, 0x44, 0x54, 0x54, 0x54, 0x28, 0x00 },	/* 'W' */
+	{ 0x44, 0x44, 0x28, 0x10, 0x28, 0x44, 0x44, 0x00 },	/* 'X' */
+	{ 0x44, 0x44, 0x44, 0x28, 0x10, 0x10, 0x10, 0x00 },	/* 'Y' */
+	{ 0x7c, 0x04, 0x08, 0x10, 0x20, 0x40, 0x7c, 0x00 },	/* 'Z' */
+	{ 0x38, 0x20, 0x20, 0x20, 0x20, 0x20, 0x38, 0x00 },	/* '[' */
+	{ 0x00, 0x40, 0x20, 0x10, 0x08, 0x04, 0x00, 0x00 },	/* '\\' */
+	{ 0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x38, 0x00 },	/* ']' */
+	{ 0x10, 0x28, 0x44, 0x00, 0x00, 0x00, 0x00, 0x00 },	/* '^' */
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7c, 0x00 },	/* '_' */
+	{ 0x20, 0x10, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00 },	/* '`' */
+	{ 0x00, 0x00, 0x38, 0x04, 0x3c, 0x44, 0x3c, 0x00 },	/* 'a' */
+	{ 0x40, 0x40, 0x58, 0x64, 0x44, 0x44, 0x78, 0x00 },	/* 'b' */
+	{ 0x00, 0x00, 0x38, 0x40, 0x40, 0x44, 0x38, 0x00 },	/* 'c' */
+	{ 0x04, 0x04, 0x34, 0x4c, 0x44, 0x44, 0x3c, 0x00 },	/* 'd' */
+	{ 0x00, 0x00, 0x38, 0x44, 0x7c, 0x40, 0x38, 0x00 },	/* 'e' */
+	{ 0x18, 0x24, 0x20, 0x70, 0x20, 0x20, 0x20, 0x00 },	/* 'f' */
+	{ 0x00, 0x00, 0x3c, 0x44, 0x44, 0x3c, 0x04, 0x38 },	/* 'g' */
+	{ 0x40, 0x40, 0x58, 0x64, 0x44, 0x44, 0x44, 0x00 },	/* 'h' */
+	{ 0x10, 0x00, 0x30, 0x10, 0x10, 0x10, 0x38, 0x00 },	/* 'i' */
+	{ 0x08, 0x00, 0x18, 0x08, 0x08, 0x08, 0x48, 0x30 },	/* 'j' */
+	{ 0x40, 0x40, 0x48, 0x50, 0x60, 0x50, 0x48, 0x00 },	/* 'k' */
+	{ 0x30, 0x10, 0x10, 0x10, 0x10, 0x10, 0x38, 0x00 },	/* 'l' */
+	{ 0x00, 0x00, 0x68, 0x54, 0x54, 0x44, 0x44, 0x00 },	/* 'm' */
+	{ 0x00, 0x00, 0x58, 0x64, 0x44, 0x44, 0x44, 0x00 },	/* 'n' */
+	{ 0x00, 0x00, 0x38, 0x44, 0x44, 0x44, 0x38, 0x00 },	/* 'o' */
+	{ 0x00, 0x00, 0x78, 0x44, 0x44, 0x78, 0x40, 0x40 },	/* 'p' */
+	{ 0x00, 0x00, 0x3c, 0x44, 0x44, 0x3c, 0x04, 0x04 },	/* 'q' */
+	{ 0x00, 0x00, 0x58, 0x64, 0x40, 0x40, 0x40, 0x00 },	/* 'r' */
+	{ 0x00, 0x00, 0x38, 0x40, 0x38, 0x04, 0x78, 0x00 },	/* 's' */
+	{ 0x20, 0x20, 0x70, 0x20, 0x20, 0x24, 0x18, 0x00 },	/* 't' */
+	{ 0x00, 0x00, 0x44, 0x44, 0x44, 0x4c, 0x34, 0x00 },	/* 'u' */
+	{ 0x00, 0x00, 0x44, 0x44, 0x44, 0x28, 0x10, 0x00 },	/* 'v' */
+	{ 0x00, 0x00, 0x44, 0x44, 0x54, 0x54, 0x28, 0x00 },	/* 'w' */
+	{ 0x00, 0x00, 0x44, 0x28, 0x10, 0x28, 0x44, 0x00 },	/* 'x' */
+	{ 0x00, 0x00, 0x44, 0x44, 0x44, 0x3c, 0x04, 0x38 },	/* 'y' */
+	{ 0x00, 0x00, 0x7c, 0x08, 0x10, 0x20, 0x7c, 0x00 },	/* 'z' */
+	{ 0x08, 0x10, 0x10, 0x20, 0x10, 0x10, 0x08, 0x00 },	/* '{' */
+	{ 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00 },	/* '|' */
+	{ 0x20, 0x10, 0x10, 0x08, 0x10, 0x10, 0x20, 0x00 },	/* '}' */
+	{ 0x00, 0x00, 0x20, 0x54, 0x08, 0x00, 0x00, 0x00 },	/* '~' */
+};
+
+BOOLEAN fbcon_enabled = FALSE;
+
+static struct {
+	UINT32 *base;
+	UINTN stride;		/* in pixels */
+	UINTN width, height;	/* in pixels */
+	UINTN cols, rows;	/* in characters */
+	UINTN x, y;		/* the cursor, in characters */
+	UINTN scale;
+	UINT32 bg;
+
+	/* Each nibble of a glyph row as pixels, two to a word */
+	UINT64 pattern[16][2 * MAX_SCALE];
+} fb;
+
+/* Scale an 8-bit colour level into the bits of 'mask' */
+static UINT32 component(UINT32 mask, UINT8 level)
+{
+	UINT32 pos = 0, size = 0;
+
+	if (!mask)
+		return 0;
+
+	while (!(mask & (1 << pos)))
+		pos++;
+	while (pos + size < 32 && (mask & (1 << (pos + size))))
+		size++;
+
+	if (size < 8)
+		return (UINT32)(level >> (8 - size)) << pos;
+	return (UINT32)level << (pos + size - 8);
+}
+
+/*
+ * Work out the pixel value for a grey 'level'. Returns FALSE if the
+ * mode doesn't have 32-bit pixels in a framebuffer.
+ */
+static BOOLEAN grey(EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *info,
+		    UINT8 level, UINT32 *pixel)
+{
+	EFI_PIXEL_BITMASK *m = &info->PixelInformation;
+
+	switch (info->PixelFormat) {
+	case PixelRedGreenBlueReserved8BitPerColor:
+	case PixelBlueGreenRedReserved8BitPerColor:
+		*pixel = level * 0x010101;
+		return TRUE;
+	case PixelBitMask:
+		if (!((m->RedMask | m->GreenMask | m->BlueMask |
+		       m->ReservedMask) >> 24))
+			return FALSE;
+
+		*pixel = component(m->RedMask, level) |
+			component(m->GreenMask, level) |
+			component(m->BlueMask, level);
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+static void fill(UINTN top, UINTN lines)
+{
+	UINT32 *p = fb.base + top * fb.stride;
+	UINTN x;
+
+	for (; lines; lines--, p += fb.stride) {
+		for (x = 0; x < fb.width; x++)
+			p[x] = fb.bg;
+	}
+}
+
+static void draw(UINT8 c)
+{
+	UINTN words = 2 * fb.scale, row, i, j;
+	const UINT8 *glyph;
+	UINT64 *p;
+
+	if (c < FONT_FIRST || c > FONT_LAST)
+		c = '?';
+	glyph = font[c - FONT_FIRST];
+
+	p = (UINT64 *)(fb.base + fb.y * CELL_HEIGHT * fb.scale * fb.stride +
+		       fb.x * CELL_WIDTH * fb.scale);
+
+	for (row = 0; row < 8; row++) {
+		const UINT64 *hi = fb.pattern[glyph[row] >> 4];
+		const UINT64 *lo = fb.pattern[glyph[row] & 0xf];
+
+		for (i = 0; i < 2 * fb.scale; i++) {
+			for (j = 0; j < words; j++) {
+				p[j] = hi[j];
+				p[words + j] = lo[j];
+			}
+			p = (UINT64 *)((UINT32 *)p + fb.stride);
+		}
+	}
+}
+
+static void newline(void)
+{
+	UINTN lines, line_pixels;
+
+	fb.x = 0;
+	if (++fb.y < fb.rows)
+		return;
+
+	lines = fb.rows / 4;
+	if (!lines)
+		lines = 1;
+
+	line_pixels = CELL_HEIGHT * fb.scale * fb.stride;
+	memmove(fb.base, fb.base + lines * line_pixels,
+		(fb.rows - lines) * line_pixels * sizeof(UINT32));
+	fill((fb.rows - lines) * CELL_HEIGHT * fb.scale,
+	     lines * CELL_HEIGHT * fb.scale);
+
+	fb.y -= lines;
+}
+
+/**
+ * fbcon_init - Take over the screen from ConOut
+ *
+ * Clears the screen of the first GOP that can report its mode. The
+ * mode must have a framebuffer with 32-bit pixels. On failure the
+ * console stays off, even if it was on in an earlier mode.
+ */
+EFI_STATUS fbcon_init(void)
+{
+	EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *info;
+	EFI_GRAPHICS_OUTPUT_PROTOCOL *gop;
+	EFI_STATUS err;
+	UINT32 fg, pixels[4 * MAX_SCALE];
+	UINTN n, i;
+
+	/* fb describes the old mode until we're done */
+	fbcon_enabled = FALSE;
+
+	err = gop_find(&gop, &info);
+	if (err != EFI_SUCCESS) {
+		log_print(LOG_WARN, L"No graphics for the console\n");
+		return err;
+	}
+
+	if (!grey(info, FG_LEVEL, &fg) || !grey(info, 0, &fb.bg) ||
+	    !gop->Mode->FrameBufferBase) {
+		log_print(LOG_WARN, L"Unsupported framebuffer format\n");
+		err = EFI_UNSUPPORTED;
+		goto out;
+	}
+
+	fb.base = (UINT32 *)(UINTN)gop->Mode->FrameBufferBase;
+	fb.stride = info->PixelsPerScanLine;
+	fb.width = info->HorizontalResolution;
+	fb.height = info->VerticalResolution;
+	fb.scale = fb.height >= 1440 ? 2 : 1;
+	fb.cols = fb.width / (CELL_WIDTH * fb.scale);
+	fb.rows = fb.height / (CELL_HEIGHT * fb.scale);
+	fb.x = fb.y = 0;
+
+	for (n = 0; n < 16; n++) {
+		for (i = 0; i < 4 * fb.scale; i++)
+			pixels[i] = (n & (8 >> (i / fb.scale))) ? fg : fb.bg;
+		memcpy(fb.pattern[n], pixels, 4 * fb.scale * sizeof(UINT32));
+	}
+
+	fill(0, fb.height);
+	fbcon_enabled = TRUE;
+
+out:
+	free_pool(info);
+	return err;
+}
+
+/**
+ * fbcon_write - Draw text at the cursor
+ * @buf: ASCII text
+ * @len: number of bytes in @buf
+ */
+void fbcon_write(const char *buf, UINTN len)
+{
+	UINTN i;
+
+	for (i = 0; i < len; i++) {
+		switch (buf[i]) {
+		case '\n':
+			newline();
+			break;
+		case '\r':
+			fb.x = 0;
+			break;
+		case '\t':
+			fb.x = (fb.x + 8) & ~7UL;
+			if (fb.x >= fb.cols)
+				newline();
+			break;
+		default:
+			draw(buf[i]);
+			if (++fb.x == fb.cols)
+				newline();
+			break;
+		}
+	}
+}
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Revision 2 of the File Protocol added ReadEx(), which takes a token
+ * carrying an event and returns as soon as the read has been queued.
+ * The firmware signals the event when the data has arrived, so reads
+ * on several files, and on several devices, can be in flight while we
+ * get on with something else.
+ *
+ * Not every filesystem driver implements ReadEx(), and some of those
+ * that claim to don't like it. A request on such a file is simply
+ * performed with a blocking Read() and is complete by the time
+ * aio_read() returns, so callers never need to care which happened.
+ *
+ * Files that fat.c reads straight from the disk use DiskIo2 in the
+ * same way, sharing the request's event.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "fs.h"
+#include "fat.h"
+#include "aio.h"
+
+BOOLEAN aio_enabled = TRUE;
+
+/**
+ * aio_init - Prepare a request for use
+ * @io: the request to initialise
+ */
+void aio_init(struct aio *io)
+{
+	io->token.Event = NULL;
+	io->token.Status = EFI_SUCCESS;
+	io->token.BufferSize = 0;
+	io->token.Buffer = NULL;
+	io->pending = FALSE;
+	io->done = FALSE;
+	io->disk = FALSE;
+	io->file = NULL;
+}
+
+/*
+ * Queue a read from a file that is being read straight from the disk.
+ */
+static EFI_STATUS direct_read(struct aio *io, struct file *f)
+{
+	EFI_STATUS err;
+
+	if (f->pos >= f->fat->size)
+		return EFI_UNSUPPORTED;
+
+	io->disk_token.event = io->token.Event;
+	io->disk_token.status = EFI_SUCCESS;
+
+	err = fat_read(f->fat, f->pos, &io->token.BufferSize,
+		       io->token.Buffer, &io->disk_token);
+	if (err == EFI_SUCCESS) {
+		f->pos += io->token.BufferSize;
+		io->disk = TRUE;
+	}
+
+	return err;
+}
+
+/**
+ * aio_read - Start reading from the current position of a file
+ * @io: the request, which must not be pending
+ * @f: the file to read from
+ * @buf: where to store the data read
+ * @len: the number of bytes to read
+ *
+ * Only one request may be in flight on a file at any one time. Fewer
+ * than @len bytes may be read, aio_wait() says how many.
+ */
+EFI_STATUS aio_read(struct aio *io, struct file *f, void *buf, UINTN len)
+{
+	EFI_STATUS err;
+
+	io->token.Buffer = buf;
+	io->token.BufferSize = len;
+	io->disk = FALSE;
+	io->file = NULL;
+
+	if (aio_enabled && (f->fat ? fat_async(f->fat) : f->async)) {
+		if (!io->token.Event) {
+			err = create_event(&io->token.Event);
+			if (err != EFI_SUCCESS) {
+				io->token.Event = NULL;
+				goto sync;
+			}
+		}
+
+		io->done = FALSE;
+		if (f->fat)
+			err = direct_read(io, f);
+		else {
+			err = file_seek(f);
+			if (err == EFI_SUCCESS)
+				err = uefi_call_wrapper(f->fh->ReadEx, 2,
+							f->fh, &io->token);
+			if (err == EFI_SUCCESS)
+				io->file = f;
+		}
+		if (err == EFI_SUCCESS) {
+			io->pending = TRUE;
+			return err;
+		}
+
+		if (err != EFI_UNSUPPORTED)
+			return err;
+
+		/* Don't bother trying again on this file */
+		if (!f->fat)
+			f->async = FALSE;
+		io->token.BufferSize = len;
+	}
+
+sync:
+	io->token.Status = file_read(f, &io->token.BufferSize, buf);
+	io->pending = TRUE;
+	io->done = TRUE;
+	return EFI_SUCCESS;
+}
+
+/**
+ * aio_ready - Has a request completed?
+ * @io: the request to check
+ *
+ * Returns TRUE if aio_wait() would not block.
+ */
+BOOLEAN aio_ready(struct aio *io)
+{
+	if (!io->pending || io->done)
+		return TRUE;
+
+	/* Checking the event resets it, so remember that it fired */
+	if (check_event(io->token.Event) == EFI_SUCCESS)
+		io->done = TRUE;
+
+	return io->done;
+}
+
+/**
+ * aio_wait - Wait for a request to complete
+ * @io: the request to wait for
+ * @len: used to return the number of bytes read
+ */
+EFI_STATUS aio_wait(struct aio *io, UINTN *len)
+{
+	UINTN index;
+	EFI_STATUS err;
+
+	if (!io->pending)
+		return EFI_NOT_STARTED;
+
+	if (!aio_ready(io)) {
+		err = wait_for_event(1, &io->token.Event, &index);
+		if (err != EFI_SUCCESS)
+			return err;
+
+		io->done = TRUE;
+	}
+
+	io->pending = FALSE;
+	*len = io->token.BufferSize;
+	if (io->disk)
+		return io->disk_token.status;
+
+	/* The firmware moved the file handle on */
+	if (io->file) {
+		if (io->token.Status == EFI_SUCCESS) {
+			io->file->pos += *len;
+			io->file->fh_pos = io->file->pos;
+		} else
+			io->file->fh_pos = (UINT64)-1;
+		io->file = NULL;
+	}
+
+	return io->token.Status;
+}
+
+/**
+ * aio_fini - Release the resources held by a request
+ * @io: the request, which is waited for if it is still pending
+ */
+void aio_fini(struct aio *io)
+{
+	UINTN len;
+
+	if (io->pending)
+		aio_wait(io, &len);
+
+	if (io->token.Event) {
+		close_event(io->token.Event);
+		io->token.Event = NULL;
+	}
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Asynchronous file reads.
+ */
+
+#ifndef __AIO_H__
+#define __AIO_H__
+
+/*
+ * A single read request. The firmware owns the token, and the buffer
+ * it points to, from aio_read() until aio_wait() returns.
+ */
+struct aio {
+	EFI_FILE_IO_TOKEN token;
+	struct disk_io2_token disk_token;
+	BOOLEAN pending;	/* issued but not yet waited for */
+	BOOLEAN done;		/* the token is safe to look at */
+	BOOLEAN disk;		/* the status is in disk_token */
+	struct file *file;	/* whose position to advance, for ReadEx */
+};
+
+extern BOOLEAN aio_enabled;
+
+extern void aio_init(struct aio *io);
+extern EFI_STATUS aio_read(struct aio *io, struct file *f,
+			   void *buf, UINTN len);
+extern BOOLEAN aio_ready(struct aio *io);
+extern EFI_STATUS aio_wait(struct aio *io, UINTN *len);
+extern void aio_fini(struct aio *io);
+
+#endif /* __AIO_H__ */
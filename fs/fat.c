@@ -0,0 +1,695 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Some firmware filesystem drivers turn every Read() into a string of
+ * cluster-sized disk requests, which makes loading a large initrd off
+ * the ESP much slower than the disk allows. When a file lives on a FAT
+ * volume we can instead follow its cluster chain once, merge it into
+ * runs of adjacent clusters and read each run into place with as few
+ * DiskIo (or, asynchronously, DiskIo2) requests as possible.
+ *
+ * This is only ever used for reading. Anything we don't understand
+ * about a volume or a file makes fat_mount() or fat_open() fail, and
+ * the caller goes back to the firmware's filesystem driver.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "protocol.h"
+#include "stdlib.h"
+#include "fat.h"
+
+#define FAT_WINDOW_SIZE	(64 * 1024)
+#define FAT_DIR_BUF	4096
+
+#define FAT_EOC		0x0ffffff8
+
+BOOLEAN fat_direct = FALSE;
+
+struct fat_volume {
+	EFI_DISK_IO *disk;
+	struct disk_io2 *disk2;
+	UINT32 media_id;
+
+	int bits;			/* 12, 16 or 32 */
+	UINT32 cluster_size;
+	UINT32 nr_clusters;
+	UINT64 fat_offset;
+	UINT64 fat_len;
+	UINT64 data_offset;
+
+	/* FAT12 and FAT16 have a fixed root directory, FAT32 doesn't */
+	UINT64 root_offset;
+	UINT64 root_len;
+	UINT32 root_cluster;
+
+	/* The part of the FAT that we read last */
+	UINT8 *window;
+	UINT64 window_start;
+	UINTN window_len;
+};
+
+static EFI_STATUS
+disk_read(struct fat_volume *vol, UINT64 offset, UINTN len, void *buf)
+{
+	return uefi_call_wrapper(vol->disk->ReadDisk, 5, vol->disk,
+				 vol->media_id, offset, len, buf);
+}
+
+/**
+ * fat_mount - Check whether a device holds a FAT filesystem
+ * @device: the device handle of a volume
+ *
+ * Returns NULL if the device doesn't support DiskIo or doesn't look
+ * like a FAT volume.
+ */
+struct fat_volume *fat_mount(EFI_HANDLE device)
+{
+	EFI_GUID disk_io2_guid = DISK_IO2_PROTOCOL_GUID;
+	UINT32 fat_size, total, root_sectors, first_data;
+	struct fat_volume *vol;
+	EFI_BLOCK_IO *block;
+	struct fat_bpb *bpb;
+	UINT8 sector[512];
+	UINT16 bps;
+	UINT8 spc;
+	EFI_STATUS err;
+
+	vol = malloc(sizeof(*vol));
+	if (!vol)
+		return NULL;
+
+	memset(vol, 0, sizeof(*vol));
+
+	err = handle_protocol(device, &BlockIoProtocol, (void **)&block);
+	if (err != EFI_SUCCESS || !block->Media->MediaPresent)
+		goto fail;
+
+	err = handle_protocol(device, &DiskIoProtocol, (void **)&vol->disk);
+	if (err != EFI_SUCCESS)
+		goto fail;
+
+	err = handle_protocol(device, &disk_io2_guid, (void **)&vol->disk2);
+	if (err != EFI_SUCCESS)
+		vol->disk2 = NULL;
+
+	vol->media_id = block->Media->MediaId;
+
+	err = disk_read(vol, 0, sizeof(sector), sector);
+	if (err != EFI_SUCCESS)
+		goto fail;
+
+	if (sector[510] != 0x55 || sector[511] != 0xaa)
+		goto fail;
+
+	bpb = (struct fat_bpb *)sector;
+	bps = bpb->bytes_per_sector;
+	spc = bpb->sectors_per_cluster;
+
+	if (bps < 512 || bps > 4096 || (bps & (bps - 1)))
+		goto fail;
+
+	if (!spc || (spc & (spc - 1)) || !bpb->nr_fats ||
+	    !bpb->reserved_sectors)
+		goto fail;
+
+	fat_size = bpb->fat_size16 ? bpb->fat_size16 : bpb->fat_size32;
+	total = bpb->total_sectors16 ? bpb->total_sectors16 :
+		bpb->total_sectors32;
+
+	root_sectors = (bpb->root_entries * 32 + bps - 1) / bps;
+	first_data = bpb->reserved_sectors + bpb->nr_fats * fat_size +
+		root_sectors;
+
+	if (!fat_size || total <= first_data)
+		goto fail;
+
+	/* The cluster count alone decides the FAT type */
+	vol->nr_clusters = (total - first_data) / spc;
+	if (vol->nr_clusters < 4085)
+		vol->bits = 12;
+	else if (vol->nr_clusters < 65525)
+		vol->bits = 16;
+	else
+		vol->bits = 32;
+
+	if ((vol->bits == 32) != !bpb->root_entries)
+		goto fail;
+
+	vol->cluster_size = bps * spc;
+	vol->fat_offset = (UINT64)bpb->reserved_sectors * bps;
+	vol->fat_len = (UINT64)fat_size * bps;
+	vol->data_offset = (UINT64)first_data * bps;
+
+	if (vol->bits == 32) {
+		vol->root_cluster = bpb->root_cluster;
+	} else {
+		vol->root_offset = vol->data_offset - root_sectors * bps;
+		vol->root_len = (UINT64)root_sectors * bps;
+	}
+
+	vol->window = malloc(FAT_WINDOW_SIZE);
+	if (!vol->window)
+		goto fail;
+
+	return vol;
+
+fail:
+	free(vol);
+	return NULL;
+}
+
+/**
+ * fat_unmount - Free a volume returned by fat_mount()
+ * @vol: the volume
+ */
+void fat_unmount(struct fat_volume *vol)
+{
+	free(vol->window);
+	free(vol);
+}
+
+/*
+ * Return the FAT entry for @cluster in @next, reading the part of the
+ * FAT that holds it if necessary. End of chain markers are returned
+ * as FAT_EOC whatever the FAT type.
+ */
+static EFI_STATUS
+fat_entry(struct fat_volume *vol, UINT32 cluster, UINT32 *next)
+{
+	UINT64 offset, start;
+	UINTN width;
+	UINT32 val;
+	UINT8 *p;
+	EFI_STATUS err;
+
+	switch (vol->bits) {
+	case 12:
+		offset = cluster + cluster / 2;
+		width = 2;
+		break;
+	case 16:
+		offset = (UINT64)cluster * 2;
+		width = 2;
+		break;
+	default:
+		offset = (UINT64)cluster * 4;
+		width = 4;
+		break;
+	}
+
+	if (offset + width > vol->fat_len)
+		return EFI_VOLUME_CORRUPTED;
+
+	if (offset < vol->window_start ||
+	    offset + width > vol->window_start + vol->window_len) {
+		start = offset - (offset % FAT_WINDOW_SIZE);
+
+		/* A FAT12 entry can straddle two windows */
+		if (offset + width > start + FAT_WINDOW_SIZE)
+			start = offset;
+
+		vol->window_len = FAT_WINDOW_SIZE;
+		if (vol->window_len > vol->fat_len - start)
+			vol->window_len = vol->fat_len - start;
+
+		err = disk_read(vol, vol->fat_offset + start,
+				vol->window_len, vol->window);
+		if (err != EFI_SUCCESS) {
+			vol->window_len = 0;
+			return err;
+		}
+
+		vol->window_start = start;
+	}
+
+	p = vol->window + (offset - vol->window_start);
+
+	switch (vol->bits) {
+	case 12:
+		val = p[0] | (p[1] << 8);
+		val = (cluster & 1) ? val >> 4 : val & 0xfff;
+		if (val >= 0xff8)
+			val = FAT_EOC;
+		break;
+	case 16:
+		val = p[0] | (p[1] << 8);
+		if (val >= 0xfff8)
+			val = FAT_EOC;
+		break;
+	default:
+		val = p[0] | (p[1] << 8) | (p[2] << 16) | ((UINT32)p[3] << 24);
+		val &= 0x0fffffff;
+		if (val >= FAT_EOC)
+			val = FAT_EOC;
+		break;
+	}
+
+	*next = val;
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS add_extent(struct fat_file *f, UINTN *max,
+			     UINT64 pos, UINT64 offset, UINT64 len)
+{
+	struct fat_extent *e;
+
+	if (f->nr_extents) {
+		e = &f->extents[f->nr_extents - 1];
+		if (e->offset + e->len == offset) {
+			e->len += len;
+			return EFI_SUCCESS;
+		}
+	}
+
+	if (f->nr_extents == *max) {
+		*max = *max ? *max * 2 : 16;
+		e = malloc(sizeof(*e) * *max);
+		if (!e)
+			return EFI_OUT_OF_RESOURCES;
+
+		if (f->extents) {
+			memcpy(e, f->extents, sizeof(*e) * f->nr_extents);
+			free(f->extents);
+		}
+		f->extents = e;
+	}
+
+	e = &f->extents[f->nr_extents++];
+	e->pos = pos;
+	e->offset = offset;
+	e->len = len;
+
+	return EFI_SUCCESS;
+}
+
+/*
+ * Follow the cluster chain starting at @cluster and record it in @f
+ * as extents. Files stop after @size bytes, directories (@dir) at the
+ * end of the chain.
+ */
+static EFI_STATUS map_clusters(struct fat_volume *vol, UINT32 cluster,
+			       UINT64 size, BOOLEAN dir, struct fat_file *f)
+{
+	UINT64 pos = 0, len;
+	UINT32 count = 0;
+	UINTN max = 0;
+	EFI_STATUS err;
+
+	f->vol = vol;
+	f->extents = NULL;
+	f->nr_extents = 0;
+
+	while (pos < size) {
+		if (cluster == FAT_EOC && dir)
+			break;
+
+		/* Catch both bad chains and loops */
+		if (cluster < 2 || cluster >= vol->nr_clusters + 2 ||
+		    count++ > vol->nr_clusters) {
+			err = EFI_VOLUME_CORRUPTED;
+			goto fail;
+		}
+
+		len = vol->cluster_size;
+		if (len > size - pos)
+			len = size - pos;
+
+		err = add_extent(f, &max, pos, vol->data_offset +
+				 (UINT64)(cluster - 2) * vol->cluster_size,
+				 len);
+		if (err != EFI_SUCCESS)
+			goto fail;
+
+		pos += len;
+
+		err = fat_entry(vol, cluster, &cluster);
+		if (err != EFI_SUCCESS)
+			goto fail;
+	}
+
+	f->size = pos;
+	return EFI_SUCCESS;
+
+fail:
+	if (f->extents)
+		free(f->extents);
+	f->extents = NULL;
+	return err;
+}
+
+static struct fat_file *open_dir(struct fat_volume *vol, UINT32 cluster)
+{
+	struct fat_file *dir;
+	UINTN max = 0;
+	EFI_STATUS err;
+
+	dir = malloc(sizeof(*dir));
+	if (!dir)
+		return NULL;
+
+	/* Cluster 0 is how ".." refers to the root directory */
+	if (!cluster && vol->bits != 32) {
+		dir->vol = vol;
+		dir->size = vol->root_len;
+		dir->extents = NULL;
+		dir->nr_extents = 0;
+		err = add_extent(dir, &max, 0, vol->root_offset, vol->root_len);
+	} else {
+		if (!cluster)
+			cluster = vol->root_cluster;
+
+		err = map_clusters(vol, cluster,
+				   (UINT64)vol->nr_clusters * vol->cluster_size,
+				   TRUE, dir);
+	}
+
+	if (err != EFI_SUCCESS) {
+		free(dir);
+		return NULL;
+	}
+
+	return dir;
+}
+
+static CHAR16 fold(CHAR16 c)
+{
+	if (c >= 'a' && c <= 'z')
+		return c - 'a' + 'A';
+	return c;
+}
+
+static BOOLEAN name_equal(CHAR16 *a, UINTN a_len, CHAR16 *b)
+{
+	UINTN i;
+
+	for (i = 0; i < a_len; i++) {
+		if (!b[i] || fold(a[i]) != fold(b[i]))
+			return FALSE;
+	}
+
+	return !b[i];
+}
+
+static UINT8 lfn_checksum(struct fat_dirent *de)
+{
+	UINT8 sum = 0;
+	int i;
+
+	for (i = 0; i < 11; i++)
+		sum = ((sum & 1) << 7) + (sum >> 1) + (UINT8)de->name[i];
+
+	return sum;
+}
+
+/*
+ * Turn the padded 8.3 name in @de into "NAME.EXT".
+ */
+static void short_name(struct fat_dirent *de, CHAR16 *name)
+{
+	int i, n = 0, len;
+
+	for (len = 8; len && de->name[len - 1] == ' '; len--)
+		;
+	for (i = 0; i < len; i++)
+		name[n++] = (UINT8)de->name[i];
+
+	if (name[0] == 0x05)
+		name[0] = 0xe5;
+
+	for (len = 3; len && de->name[8 + len - 1] == ' '; len--)
+		;
+	if (len)
+		name[n++] = '.';
+	for (i = 0; i < len; i++)
+		name[n++] = (UINT8)de->name[8 + i];
+
+	name[n] = 0;
+}
+
+/*
+ * Search the directory @dir for the entry called @name, which is
+ * @len characters long, comparing against both long and 8.3 names.
+ */
+static EFI_STATUS dir_lookup(struct fat_file *dir, CHAR16 *name, UINTN len,
+			     struct fat_dirent *found)
+{
+	CHAR16 lfn[20 * FAT_LFN_CHARS + 1], sfn[13];
+	struct fat_dirent *de;
+	struct fat_lfn *l;
+	UINT8 *buf, expect = 0, sum = 0;
+	BOOLEAN have_lfn = FALSE;
+	UINT64 pos = 0;
+	UINTN n, i;
+	EFI_STATUS err;
+
+	buf = malloc(FAT_DIR_BUF);
+	if (!buf)
+		return EFI_OUT_OF_RESOURCES;
+
+	err = EFI_NOT_FOUND;
+	while (pos < dir->size) {
+		n = FAT_DIR_BUF;
+		err = fat_read(dir, pos, &n, buf, NULL);
+		if (err != EFI_SUCCESS)
+			break;
+
+		pos += n;
+		err = EFI_NOT_FOUND;
+
+		for (i = 0; i + sizeof(*de) <= n; i += sizeof(*de)) {
+			de = (struct fat_dirent *)(buf + i);
+
+			/* End of directory */
+			if (!de->name[0])
+				goto out;
+
+			if ((UINT8)de->name[0] == 0xe5) {
+				expect = 0;
+				have_lfn = FALSE;
+				continue;
+			}
+
+			if (de->attr == FAT_ATTR_LFN) {
+				UINT8 seq;
+				CHAR16 *p;
+				int j;
+
+				l = (struct fat_lfn *)de;
+				seq = l->order & 0x1f;
+				have_lfn = FALSE;
+
+				if (l->order & FAT_LFN_LAST) {
+					if (!seq || seq > 20) {
+						expect = 0;
+						continue;
+					}
+					lfn[seq * FAT_LFN_CHARS] = 0;
+					sum = l->checksum;
+				} else if (!seq || seq != expect ||
+					   l->checksum != sum) {
+					expect = 0;
+					continue;
+				}
+
+				p = &lfn[(seq - 1) * FAT_LFN_CHARS];
+				for (j = 0; j < 5; j++)
+					*p++ = l->name1[j];
+				for (j = 0; j < 6; j++)
+					*p++ = l->name2[j];
+				for (j = 0; j < 2; j++)
+					*p++ = l->name3[j];
+
+				expect = seq - 1;
+				have_lfn = !expect;
+				continue;
+			}
+
+			if (de->attr & FAT_ATTR_VOLUME_ID) {
+				expect = 0;
+				have_lfn = FALSE;
+				continue;
+			}
+
+			/* A complete long name belongs to this entry */
+			if (have_lfn && sum == lfn_checksum(de) &&
+			    name_equal(name, len, lfn))
+				goto match;
+
+			short_name(de, sfn);
+			if (name_equal(name, len, sfn))
+				goto match;
+
+			expect = 0;
+			have_lfn = FALSE;
+		}
+	}
+
+	goto out;
+
+match:
+	*found = *de;
+	err = EFI_SUCCESS;
+out:
+	free(buf);
+	return err;
+}
+
+/**
+ * fat_open - Map a file on a FAT volume
+ * @vol: the volume returned by fat_mount()
+ * @path: the path of the file, relative to the root directory
+ */
+struct fat_file *fat_open(struct fat_volume *vol, CHAR16 *path)
+{
+	struct fat_file *dir, *f;
+	struct fat_dirent de;
+	UINT32 cluster;
+	UINTN len;
+	EFI_STATUS err;
+
+	dir = open_dir(vol, 0);
+	if (!dir)
+		return NULL;
+
+	for (;;) {
+		while (*path == '\\' || *path == '/')
+			path++;
+
+		for (len = 0; path[len] && path[len] != '\\' &&
+			     path[len] != '/'; len++)
+			;
+
+		err = dir_lookup(dir, path, len, &de);
+		fat_close(dir);
+		if (err != EFI_SUCCESS)
+			return NULL;
+
+		cluster = de.cluster_lo;
+		if (vol->bits == 32)
+			cluster |= (UINT32)de.cluster_hi << 16;
+
+		path += len;
+		while (*path == '\\' || *path == '/')
+			path++;
+
+		if (!*path)
+			break;
+
+		if (!(de.attr & FAT_ATTR_DIRECTORY))
+			return NULL;
+
+		dir = open_dir(vol, cluster);
+		if (!dir)
+			return NULL;
+	}
+
+	if (de.attr & FAT_ATTR_DIRECTORY)
+		return NULL;
+
+	f = malloc(sizeof(*f));
+	if (!f)
+		return NULL;
+
+	err = map_clusters(vol, cluster, de.size, FALSE, f);
+	if (err != EFI_SUCCESS) {
+		free(f);
+		return NULL;
+	}
+
+	return f;
+}
+
+/**
+ * fat_close - Free a file returned by fat_open()
+ * @f: the file
+ */
+void fat_close(struct fat_file *f)
+{
+	if (f->extents)
+		free(f->extents);
+	free(f);
+}
+
+/**
+ * fat_async - Can reads from @f be asynchronous?
+ * @f: the file
+ */
+BOOLEAN fat_async(struct fat_file *f)
+{
+	return f->vol->disk2 != NULL;
+}
+
+/**
+ * fat_read - Read part of a file straight from the disk
+ * @f: the file to read
+ * @pos: the offset in @f to read from
+ * @len: the number of bytes to read, updated with the number queued
+ * @buf: where to store the data
+ * @token: if not NULL, and DiskIo2 is available, read asynchronously
+ *
+ * A single disk request never crosses the end of an extent, so fewer
+ * than @len bytes may be read. Reading at or beyond the end of the
+ * file reads nothing.
+ */
+EFI_STATUS fat_read(struct fat_file *f, UINT64 pos, UINTN *len,
+		    void *buf, struct disk_io2_token *token)
+{
+	struct fat_volume *vol = f->vol;
+	struct fat_extent *e;
+	UINTN lo, hi, mid;
+	UINT64 skip;
+
+	if (pos >= f->size || !*len) {
+		*len = 0;
+		return EFI_SUCCESS;
+	}
+
+	lo = 0;
+	hi = f->nr_extents;
+	while (hi - lo > 1) {
+		mid = (lo + hi) / 2;
+		if (f->extents[mid].pos <= pos)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	e = &f->extents[lo];
+	skip = pos - e->pos;
+	if (*len > e->len - skip)
+		*len = e->len - skip;
+
+	if (token && vol->disk2)
+		return uefi_call_wrapper(vol->disk2->read_disk_ex, 6,
+					 vol->disk2, vol->media_id,
+					 e->offset + skip, token, *len, buf);
+
+	return disk_read(vol, e->offset + skip, *len, buf);
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Reading files on FAT volumes straight from the disk.
+ */
+
+#ifndef __FAT_H__
+#define __FAT_H__
+
+/*
+ * Older gnu-efi doesn't know about the DiskIo2 protocol, so carry our
+ * own copy of its definition.
+ */
+#define DISK_IO2_PROTOCOL_GUID \
+	{ 0x151c8eae, 0x7f2c, 0x472c, \
+	  { 0x9e, 0x54, 0x98, 0x28, 0x19, 0x4f, 0x6a, 0x88 } }
+
+struct disk_io2_token {
+	EFI_EVENT event;
+	EFI_STATUS status;
+};
+
+struct disk_io2 {
+	UINT64 revision;
+	EFI_STATUS (*cancel)(struct disk_io2 *this);
+	EFI_STATUS (*read_disk_ex)(struct disk_io2 *this, UINT32 media_id,
+				   UINT64 offset, struct disk_io2_token *token,
+				   UINTN size, void *buf);
+	void *write_disk_ex;
+	void *flush_disk_ex;
+};
+
+/* On-disk structures */
+struct fat_bpb {
+	UINT8 jump[3];
+	char oem[8];
+	UINT16 bytes_per_sector;
+	UINT8 sectors_per_cluster;
+	UINT16 reserved_sectors;
+	UINT8 nr_fats;
+	UINT16 root_entries;
+	UINT16 total_sectors16;
+	UINT8 media;
+	UINT16 fat_size16;
+	UINT16 sectors_per_track;
+	UINT16 nr_heads;
+	UINT32 hidden_sectors;
+	UINT32 total_sectors32;
+
+	/* FAT32 only */
+	UINT32 fat_size32;
+	UINT16 ext_flags;
+	UINT16 version;
+	UINT32 root_cluster;
+} __attribute__((packed));
+
+#define FAT_ATTR_VOLUME_ID	0x08
+#define FAT_ATTR_DIRECTORY	0x10
+#define FAT_ATTR_LFN		0x0f
+
+struct fat_dirent {
+	char name[11];
+	UINT8 attr;
+	UINT8 nt_flags;
+	UINT8 ctime_ms;
+	UINT16 ctime;
+	UINT16 cdate;
+	UINT16 adate;
+	UINT16 cluster_hi;
+	UINT16 mtime;
+	UINT16 mdate;
+	UINT16 cluster_lo;
+	UINT32 size;
+} __attribute__((packed));
+
+struct fat_lfn {
+	UINT8 order;
+	UINT16 name1[5];
+	UINT8 attr;
+	UINT8 type;
+	UINT8 checksum;
+	UINT16 name2[6];
+	UINT16 cluster;
+	UINT16 name3[2];
+} __attribute__((packed));
+
+#define FAT_LFN_LAST		0x40
+#define FAT_LFN_CHARS		13
+#define FAT_MAX_NAME		255
+
+/*
+ * A run of clusters that are next to each other on the disk. @pos is
+ * the offset of the run in the file and @offset its byte offset from
+ * the start of the volume.
+ */
+struct fat_extent {
+	UINT64 pos;
+	UINT64 offset;
+	UINT64 len;
+};
+
+struct fat_volume;
+
+struct fat_file {
+	struct fat_volume *vol;
+	UINT64 size;
+	struct fat_extent *extents;
+	UINTN nr_extents;
+};
+
+extern BOOLEAN fat_direct;
+
+extern struct fat_volume *fat_mount(EFI_HANDLE device);
+extern void fat_unmount(struct fat_volume *vol);
+extern struct fat_file *fat_open(struct fat_volume *vol, CHAR16 *path);
+extern void fat_close(struct fat_file *f);
+extern BOOLEAN fat_async(struct fat_file *f);
+extern EFI_STATUS fat_read(struct fat_file *f, UINT64 pos, UINTN *len,
+			   void *buf, struct disk_io2_token *token);
+
+#endif /* __FAT_H__ */
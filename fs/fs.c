@@ -31,18 +31,202 @@
 #include <efilib.h>
 #include "efilinux.h"
 #include "fs.h"
+#include "log.h"
+#include "fat.h"
 #include "stdlib.h"
 #include "protocol.h"
 
 struct fs_device {
 	EFI_HANDLE handle;
-	EFI_FILE_HANDLE fh;
+	EFI_FILE_HANDLE fh;	/* NULL until a file is opened on it */
 	struct fs_ops *ops;
+
+	/* Only looked for once the first file is opened with -r */
+	struct fat_volume *fat;
+	BOOLEAN fat_probed;
+
+	/* The device path as text, upper case, see build_name_index() */
+	CHAR16 *path;
+};
+
+/*
+ * An entry in the index of device names. @str points into a device's
+ * path and isn't NUL terminated. @dev is -1 if more than one device
+ * has this name.
+ */
+struct fs_name {
+	CHAR16 *str;
+	UINTN len;
+	UINT32 hash;
+	int dev;
 };
 
 static struct fs_device *fs_devices;
 static UINTN nr_fs_devices;
 
+/*
+ * Open-addressed hash tables, both sized to a power of two at least
+ * twice the number of entries. Empty slots are -1 or have a NULL str.
+ */
+static int *handle_index;
+static UINTN handle_mask;
+static struct fs_name *name_index;
+static UINTN name_mask;
+
+struct fs_stats fs_stats;
+
+static UINTN index_size(UINTN nr)
+{
+	UINTN size = 8;
+
+	while (size < nr * 2)
+		size <<= 1;
+
+	return size;
+}
+
+static inline UINTN hash_handle(EFI_HANDLE handle)
+{
+	UINT64 h = (UINTN)handle;
+
+	/* Handles are pointers, so the low bits carry little */
+	return (UINTN)((h * 0x9e3779b97f4a7c15ULL) >> 32);
+}
+
+static inline CHAR16 to_upper(CHAR16 ch)
+{
+	if (ch >= 'a' && ch <= 'z')
+		return ch - 'a' + 'A';
+
+	return ch;
+}
+
+/*
+ * FNV-1a, ignoring case as the firmware's StriCmp() does.
+ */
+static UINT32 hash_name(CHAR16 *str, UINTN len)
+{
+	UINT32 h = 2166136261U;
+	UINTN i;
+
+	for (i = 0; i < len; i++) {
+		h ^= to_upper(str[i]);
+		h *= 16777619;
+	}
+
+	return h;
+}
+
+static BOOLEAN name_equal(struct fs_name *n, CHAR16 *str, UINTN len)
+{
+	UINTN i;
+
+	if (n->len != len)
+		return FALSE;
+
+	for (i = 0; i < len; i++) {
+		if (n->str[i] != to_upper(str[i]))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void add_name(CHAR16 *str, UINTN len, int dev)
+{
+	UINT32 hash = hash_name(str, len);
+	struct fs_name *n;
+	UINTN i;
+
+	for (i = hash & name_mask; ; i = (i + 1) & name_mask) {
+		n = &name_index[i];
+		if (!n->str)
+			break;
+
+		if (n->hash == hash && name_equal(n, str, len)) {
+			if (n->dev != dev)
+				n->dev = -1;
+			return;
+		}
+	}
+
+	n->str = str;
+	n->len = len;
+	n->hash = hash;
+	n->dev = dev;
+}
+
+/*
+ * Index every device by the text of its device path, and by the text
+ * of the path's last node, e.g. "HD(1,GPT,...)", which is usually
+ * enough to tell partitions apart. This is done once, the first time
+ * a file is opened by device name, and is the only time we convert
+ * device paths to text.
+ */
+static EFI_STATUS build_name_index(void)
+{
+	UINTN i, len;
+
+	name_mask = index_size(nr_fs_devices * 2) - 1;
+	name_index = malloc(sizeof(*name_index) * (name_mask + 1));
+	if (!name_index)
+		return EFI_OUT_OF_RESOURCES;
+
+	memset(name_index, 0, sizeof(*name_index) * (name_mask + 1));
+
+	for (i = 0; i < nr_fs_devices; i++) {
+		struct fs_device *d = &fs_devices[i];
+		EFI_DEVICE_PATH *path;
+		CHAR16 *last;
+
+		path = DevicePathFromHandle(d->handle);
+		if (!path)
+			continue;
+
+		d->path = DevicePathToStr(path);
+		if (!d->path)
+			continue;
+
+		last = d->path;
+		for (len = 0; d->path[len]; len++) {
+			d->path[len] = to_upper(d->path[len]);
+			if (d->path[len] == '/' && d->path[len + 1])
+				last = &d->path[len + 1];
+		}
+
+		add_name(d->path, len, i);
+		if (last != d->path)
+			add_name(last, len - (last - d->path), i);
+	}
+
+	return EFI_SUCCESS;
+}
+
+/*
+ * Return the device called @name, or -1.
+ */
+static int name_to_dev(CHAR16 *name)
+{
+	struct fs_name *n;
+	UINT32 hash;
+	UINTN i, len;
+
+	if (!name_index && build_name_index() != EFI_SUCCESS)
+		return -1;
+
+	len = StrLen(name);
+	hash = hash_name(name, len);
+
+	for (i = hash & name_mask; ; i = (i + 1) & name_mask) {
+		n = &name_index[i];
+		if (!n->str)
+			return -1;
+
+		if (n->hash == hash && name_equal(n, name, len))
+			return n->dev;
+	}
+}
+
 /**
  * handle_to_dev - Return the device number for a handle
  * @handle: the device handle to search for
@@ -50,17 +234,70 @@ static UINTN nr_fs_devices;
 int
 handle_to_dev(EFI_HANDLE *handle)
 {
-	int i;
+	UINTN i;
+	int dev;
 
-	for (i = 0; i < nr_fs_devices; i++) {
-		if (fs_devices[i].handle == handle)
-			break;
+	if (!handle_index)
+		return -1;
+
+	for (i = hash_handle(handle) & handle_mask; ;
+	     i = (i + 1) & handle_mask) {
+		dev = handle_index[i];
+		if (dev < 0)
+			return -1;
+
+		if (fs_devices[dev].handle == handle)
+			return dev;
 	}
+}
 
-	if (i == nr_fs_devices)
-		return -1;
+/*
+ * Open the root directory of device @dev, if it isn't open already.
+ * Opening a volume can make the firmware mount it, which is slow, so
+ * it is only done for the volumes that we actually read from.
+ */
+static EFI_STATUS volume_get(int dev, EFI_FILE_HANDLE *fh)
+{
+	struct fs_device *d = &fs_devices[dev];
+	EFI_FILE_IO_INTERFACE *io;
+	EFI_STATUS err;
+
+	if (!d->fh) {
+		err = handle_protocol(d->handle, &FileSystemProtocol,
+				      (void **)&io);
+		if (err != EFI_SUCCESS)
+			return err;
+
+		err = volume_open(io, &d->fh);
+		if (err != EFI_SUCCESS) {
+			d->fh = NULL;
+			return err;
+		}
+
+		fs_stats.opened++;
+	}
 
-	return i;
+	*fh = d->fh;
+	return EFI_SUCCESS;
+}
+
+/*
+ * Map @name on device @dev for reading straight from the disk, if
+ * the device holds a FAT volume that we understand.
+ */
+static struct fat_file *direct_open(int dev, CHAR16 *name)
+{
+	struct fs_device *d = &fs_devices[dev];
+
+	if (!d->fat_probed) {
+		d->fat = fat_mount(d->handle);
+		d->fat_probed = TRUE;
+	}
+
+	if (!d->fat)
+		return NULL;
+
+	return fat_open(d->fat, name);
 }
 
 /**
@@ -96,7 +333,6 @@ file_open(EFI_LOADED_IMAGE *image, CHAR16 *name, struct file **file)
 		if (i < 0 || i >= nr_fs_devices)
 			goto notfound;
 
-		f->handle = fs_devices[i].fh;
 		goto found;
 	} else
 		name[dev_len++] = 0;
@@ -106,30 +342,18 @@ file_open(EFI_LOADED_IMAGE *image, CHAR16 *name, struct file **file)
 		if (i >= nr_fs_devices)
 			goto notfound;
 
-		f->handle = fs_devices[i].fh;
 		goto found;
 	}
 
-	for (i = 0; i < nr_fs_devices; i++) {
-		EFI_DEVICE_PATH *path;
-		CHAR16 *dev;
-
-		path = DevicePathFromHandle(fs_devices[i].handle);
-		dev = DevicePathToStr(path);
-
-		if (!StriCmp(dev, name)) {
-			f->handle = fs_devices[i].fh;
-			free_pool(dev);
-			break;
-		}
-
-		free_pool(dev);
-	}
-
-	if (i == nr_fs_devices)
+	i = name_to_dev(name);
+	if (i < 0)
 		goto notfound;
 
 found:
+	err = volume_get(i, &f->handle);
+	if (err != EFI_SUCCESS)
+		goto fail;
+
 	/* Strip the device name */
 	filename = name + dev_len;
 
@@ -143,6 +367,19 @@ found:
 		goto fail;
 
 	f->fh = fh;
+	f->async = fh->Revision >= EFI_FILE_PROTOCOL_REVISION2 &&
+		fh->ReadEx;
+
+	f->fat = NULL;
+	f->pos = 0;
+	f->fh_pos = 0;
+	f->size_known = FALSE;
+	f->ra = NULL;
+	f->ra_pos = 0;
+	f->ra_len = 0;
+	if (fat_direct)
+		f->fat = direct_open(i, filename);
+
 	*file = f;
 
 	return err;
@@ -165,12 +402,205 @@ file_close(struct file *f)
 
 	err = uefi_call_wrapper(f->handle->Close, 1, f->fh);
 
-	if (err == EFI_SUCCESS)
+	if (err == EFI_SUCCESS) {
+		if (f->fat)
+			fat_close(f->fat);
+		if (f->ra)
+			free(f->ra);
 		free(f);
+	}
 
 	return err;
 }
 
+/*
+ * Read @size bytes at f->pos, bypassing the read-ahead buffer.
+ */
+static EFI_STATUS read_at(struct file *f, UINTN *size, void *buf)
+{
+	UINTN done, len;
+	EFI_STATUS err;
+
+	if (!f->fat) {
+		err = file_seek(f);
+		if (err != EFI_SUCCESS)
+			return err;
+
+		err = uefi_call_wrapper(f->handle->Read, 3, f->fh, size, buf);
+		if (err != EFI_SUCCESS) {
+			f->fh_pos = (UINT64)-1;
+			return err;
+		}
+
+		f->pos += *size;
+		f->fh_pos = f->pos;
+		return err;
+	}
+
+	/* fat_read() stops at the end of every extent */
+	for (done = 0; done < *size; done += len) {
+		len = *size - done;
+		err = fat_read(f->fat, f->pos, &len, (char *)buf + done, NULL);
+		if (err != EFI_SUCCESS)
+			return err;
+
+		if (!len)
+			break;
+
+		f->pos += len;
+	}
+
+	*size = done;
+	return EFI_SUCCESS;
+}
+
+/**
+ * file_read - Read from an open file
+ * @f: the file to read
+ * @size: size in bytes to read from @f, updated with the bytes read
+ * @buf: place to store the data read
+ *
+ * Small reads, like those of the bzImage header, are served from a
+ * buffer that is filled a page at a time, so that the firmware only
+ * sees reads of a useful size.
+ */
+EFI_STATUS
+file_read(struct file *f, UINTN *size, void *buf)
+{
+	UINTN done = 0, len;
+	UINT64 pos;
+	EFI_STATUS err;
+
+	while (done < *size) {
+		len = *size - done;
+
+		if (f->pos >= f->ra_pos && f->pos < f->ra_pos + f->ra_len) {
+			UINTN off = f->pos - f->ra_pos;
+
+			if (len > f->ra_len - off)
+				len = f->ra_len - off;
+
+			memcpy((char *)buf + done, &f->ra[off], len);
+			f->pos += len;
+			done += len;
+			continue;
+		}
+
+		if (!f->ra && len < FILE_READAHEAD)
+			f->ra = malloc(FILE_READAHEAD);
+
+		if (len >= FILE_READAHEAD || !f->ra) {
+			err = read_at(f, &len, (char *)buf + done);
+			if (err != EFI_SUCCESS)
+				return err;
+
+			done += len;
+			break;
+		}
+
+		/* Fill the buffer from a page boundary */
+		pos = f->pos;
+		f->pos &= ~(UINT64)(FILE_READAHEAD - 1);
+		f->ra_pos = f->pos;
+		f->ra_len = FILE_READAHEAD;
+
+		err = read_at(f, &f->ra_len, f->ra);
+		f->pos = pos;
+		if (err != EFI_SUCCESS) {
+			f->ra_len = 0;
+			return err;
+		}
+
+		/* The end of the file */
+		if (f->pos >= f->ra_pos + f->ra_len)
+			break;
+	}
+
+	*size = done;
+	return EFI_SUCCESS;
+}
+
+/**
+ * file_set_position - Set the current offset of a file
+ * @f: the file on which we're changing current file position
+ * @pos: the file offset to set the current position to
+ *
+ * The firmware isn't told until the next read from the file.
+ */
+EFI_STATUS
+file_set_position(struct file *f, UINT64 pos)
+{
+	EFI_STATUS err;
+
+	/* All ones means the end of the file */
+	if (pos == (UINT64)-1) {
+		err = file_size(f, &pos);
+		if (err != EFI_SUCCESS)
+			return err;
+	}
+
+	f->pos = pos;
+	return EFI_SUCCESS;
+}
+
+/**
+ * file_seek - Move the firmware's file handle to the current offset
+ * @f: the file to move
+ *
+ * Needed before the firmware reads from its own idea of the position.
+ */
+EFI_STATUS
+file_seek(struct file *f)
+{
+	EFI_STATUS err;
+
+	if (f->fat || f->fh_pos == f->pos)
+		return EFI_SUCCESS;
+
+	err = uefi_call_wrapper(f->fh->SetPosition, 2, f->fh, f->pos);
+	if (err != EFI_SUCCESS) {
+		f->fh_pos = (UINT64)-1;
+		return err;
+	}
+
+	f->fh_pos = f->pos;
+	return EFI_SUCCESS;
+}
+
+/**
+ * file_size - Get the size (in bytes) of @file
+ * @f: the file to query
+ * @size: where to store the size of the file
+ *
+ * The firmware is only asked once.
+ */
+EFI_STATUS
+file_size(struct file *f, UINT64 *size)
+{
+	EFI_FILE_INFO *info;
+
+	if (f->size_known) {
+		*size = f->size;
+		return EFI_SUCCESS;
+	}
+
+	if (f->fat) {
+		f->size = f->fat->size;
+	} else {
+		info = LibFileInfo(f->fh);
+		if (!info)
+			return EFI_UNSUPPORTED;
+
+		f->size = info->FileSize;
+		free_pool(info);
+	}
+
+	f->size_known = TRUE;
+	*size = f->size;
+
+	return EFI_SUCCESS;
+}
+
 /**
  * list_boot_devices - Print a list of all disks with filesystems
  */
@@ -178,7 +608,7 @@ void list_boot_devices(void)
 {
 	int i;
 
-	Print(L"Devices:\n\n");
+	con_print(L"Devices:\n\n");
 
 	for (i = 0; i < nr_fs_devices; i++) {
 		EFI_DEVICE_PATH *path;
@@ -190,15 +620,25 @@ void list_boot_devices(void)
 		path = DevicePathFromHandle(dev_handle);
 		dev = DevicePathToStr(path);
 
-		Print(L"\t%d. \"%s\"\n", i, dev);
+		con_print(L"\t%d. \"%s\"\n", i, dev);
 		free_pool(dev);
 	}
 
-	Print(L"\n");
+	con_print(L"\n");
+}
+
+/**
+ * fs_report - Print how many volumes had to be opened
+ */
+void fs_report(void)
+{
+	log_print(LOG_INFO, L"fs: %ld of %ld volumes opened\n",
+		  (UINT64)fs_stats.opened, (UINT64)fs_stats.volumes);
 }
 
 /*
- * Initialise filesystem protocol.
+ * Initialise filesystem protocol. The volumes are only enumerated
+ * here, they are opened when a file is first opened on them.
  */
 EFI_STATUS
 fs_init(void)
@@ -206,14 +646,14 @@ fs_init(void)
 	EFI_HANDLE *buf;
 	EFI_STATUS err;
 	UINTN size = 0;
-	int i, j;
+	int i;
 
 	size = 0;
 	err = locate_handle(ByProtocol, &FileSystemProtocol,
 			    NULL, &size, NULL);
 
 	if (err != EFI_SUCCESS && size == 0) {
-		Print(L"No devices support filesystems\n");
+		log_print(LOG_ERR, L"No devices support filesystems\n");
 		return err;
 	}
 
@@ -230,42 +670,49 @@ fs_init(void)
 
 	err = locate_handle(ByProtocol, &FileSystemProtocol,
 			    NULL, &size, (void **)buf);
+	if (err != EFI_SUCCESS) {
+		free(fs_devices);
+		goto out;
+	}
 
-	for (i = 0; i < nr_fs_devices; i++) {
-		EFI_FILE_IO_INTERFACE *io;
-		EFI_FILE_HANDLE fh;
-		EFI_HANDLE dev_handle;
-
-		dev_handle = buf[i];
-		err = handle_protocol(dev_handle, &FileSystemProtocol,
-				      (void **)&io);
-		if (err != EFI_SUCCESS)
-			goto close_handles;
+	handle_mask = index_size(nr_fs_devices) - 1;
+	handle_index = malloc(sizeof(*handle_index) * (handle_mask + 1));
+	if (!handle_index) {
+		free(fs_devices);
+		err = EFI_OUT_OF_RESOURCES;
+		goto out;
+	}
 
-		err = volume_open(io, &fh);
-		if (err != EFI_SUCCESS)
-			goto close_handles;
+	for (i = 0; i <= handle_mask; i++)
+		handle_index[i] = -1;
 
-		fs_devices[i].handle = dev_handle;
-		fs_devices[i].fh = fh;
+	for (i = 0; i < nr_fs_devices; i++) {
+		UINTN j;
+
+		fs_devices[i].handle = buf[i];
+		fs_devices[i].fh = NULL;
+		fs_devices[i].fat = NULL;
+		fs_devices[i].fat_probed = FALSE;
+		fs_devices[i].path = NULL;
+
+		j = hash_handle(buf[i]) & handle_mask;
+		while (handle_index[j] >= 0)
+			j = (j + 1) & handle_mask;
+		handle_index[j] = i;
 	}
 
+	fs_stats.volumes = nr_fs_devices;
+	fs_stats.opened = 0;
+
 out:
 	free(buf);
 	return err;
-
-close_handles:
-	for (j = 0; j < i; j++) {
-		EFI_FILE_HANDLE fh;
-
-		fh = fs_devices[j].fh;
-		uefi_call_wrapper(fh->Close, 1, fh);
-	}
-
-	free(fs_devices);
-	goto out;
 }
 
+/*
+ * Close the volumes that were opened. They are opened again if
+ * another file is opened on them.
+ */
 void fs_close(void)
 {
 	int i;
@@ -274,12 +721,34 @@ void fs_close(void)
 		EFI_FILE_HANDLE fh;
 
 		fh = fs_devices[i].fh;
-		uefi_call_wrapper(fh->Close, 1, fh);
+		if (fh)
+			uefi_call_wrapper(fh->Close, 1, fh);
+		fs_devices[i].fh = NULL;
+
+		if (fs_devices[i].fat)
+			fat_unmount(fs_devices[i].fat);
+		fs_devices[i].fat = NULL;
+		fs_devices[i].fat_probed = FALSE;
 	}
 }
 
 void fs_exit(void)
 {
+	int i;
+
 	fs_close();
+
+	for (i = 0; i < nr_fs_devices; i++) {
+		if (fs_devices[i].path)
+			free_pool(fs_devices[i].path);
+	}
+
+	if (name_index)
+		free(name_index);
+	name_index = NULL;
+
+	free(handle_index);
+	handle_index = NULL;
+
 	free(fs_devices);
 }
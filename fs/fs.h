@@ -33,11 +33,40 @@
 
 #define MAX_FILENAME	256
 
+/* Reads smaller than this are served from a read-ahead buffer */
+#define FILE_READAHEAD	4096
+
 struct file {
 	EFI_FILE_HANDLE handle;
 	EFI_FILE_HANDLE fh;
+	BOOLEAN async;		/* fh supports ReadEx */
+
+	/* Set if the file is read straight from the disk, see fat.c */
+	struct fat_file *fat;
+
+	/*
+	 * We keep track of the position rather than asking the
+	 * firmware, and only move fh when a read starts elsewhere.
+	 */
+	UINT64 pos;
+	UINT64 fh_pos;		/* where fh is, -1 if we don't know */
+
+	UINT64 size;
+	BOOLEAN size_known;
+
+	/* Holds ra_len bytes of the file from ra_pos, once allocated */
+	UINT8 *ra;
+	UINT64 ra_pos;
+	UINTN ra_len;
+};
+
+struct fs_stats {
+	UINTN volumes;		/* with a filesystem */
+	UINTN opened;		/* because a file was opened on them */
 };
 
+extern struct fs_stats fs_stats;
+
 /**
  * volume_open - Open the root directory on a volume
  * @vol: the volume to open
@@ -49,55 +78,15 @@ volume_open(EFI_FILE_IO_INTERFACE *vol, EFI_FILE_HANDLE *fh)
 	return uefi_call_wrapper(vol->OpenVolume, 2, vol, fh);
 }
 
-/**
- * file_read - Read from an open file
- * @f: the file to read
- * @size: size in bytes to read from @f
- * @buf: place to store the data read
- */
-static inline EFI_STATUS
-file_read(struct file *f, UINTN *size, void *buf)
-{
-	return uefi_call_wrapper(f->handle->Read, 3, f->fh, size, buf);
-}
-
-/**
- * file_set_position - Set the current offset of a file
- * @f: the file on which we're changing current file position
- * @pos: the file offset to set the current position to
- */
-static inline EFI_STATUS
-file_set_position(struct file *f, UINT64 pos)
-{
-	return uefi_call_wrapper(f->fh->SetPosition, 2, f->fh, pos);
-}
-
-/**
- * file_size - Get the size (in bytes) of @file
- * @f: the file to query
- * @size: where to store the size of the file
- */
-static inline EFI_STATUS
-file_size(struct file *f, UINT64 *size)
-{
-	EFI_FILE_INFO *info;
-
-	info = LibFileInfo(f->fh);
-
-	if (!info)
-		return EFI_UNSUPPORTED;
-
-	*size = info->FileSize;
-
-	free_pool(info);
-
-	return EFI_SUCCESS;
-}
-
 extern EFI_STATUS file_open(EFI_LOADED_IMAGE *image, CHAR16 *name, struct file **file);
 extern EFI_STATUS file_close(struct file *f);
+extern EFI_STATUS file_read(struct file *f, UINTN *size, void *buf);
+extern EFI_STATUS file_set_position(struct file *f, UINT64 pos);
+extern EFI_STATUS file_size(struct file *f, UINT64 *size);
+extern EFI_STATUS file_seek(struct file *f);
 
 extern void list_boot_devices(void);
+extern void fs_report(void);
 extern int handle_to_dev(EFI_HANDLE *handle);
 
 extern void fs_close(void);
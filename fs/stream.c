@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Some firmware filesystem drivers perform badly, or simply time
+ * out, when asked to read hundreds of megabytes in one go. The stream
+ * code splits a large read into chunks and lets the caller drive the
+ * read one chunk at a time.
+ *
+ * Each chunk is read with aio_read(), so while the firmware fills one
+ * buffer the previous one can be handed to the stream's hook, and
+ * several streams can have reads outstanding at once.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "fs.h"
+#include "fat.h"
+#include "aio.h"
+#include "stream.h"
+#include "log.h"
+#include "profile.h"
+
+UINTN stream_chunk_size = STREAM_CHUNK_SIZE;
+BOOLEAN stream_verbose = FALSE;
+
+/*
+ * Return the throughput in KB/s of reading @bytes in @ticks.
+ */
+static UINT64 rate(UINT64 bytes, UINT64 ticks)
+{
+	if (!ticks)
+		ticks = 1;
+
+	return (bytes * tsc_per_us() * 1000) / ticks;
+}
+
+/**
+ * stream_init - Prepare to read a file in chunks
+ * @s: the stream to initialise
+ * @file: the file to read, starting from its current position
+ * @dst: the buffer to read into
+ * @size: the number of bytes to read into @dst
+ */
+void stream_init(struct stream *s, struct file *file, void *dst, UINT64 size)
+{
+	s->file = file;
+	s->dst = dst;
+	s->size = size;
+	s->offset = 0;
+	s->chunk_size = stream_chunk_size;
+	if (!s->chunk_size)
+		s->chunk_size = STREAM_CHUNK_SIZE;
+
+	s->bufs[0].len = 0;
+	s->bufs[1].len = 0;
+	s->cur = 0;
+
+	s->hook = NULL;
+	s->hook_data = NULL;
+	s->finish = NULL;
+	s->finish_data = NULL;
+
+	aio_init(&s->io);
+
+	s->nr_chunks = 0;
+	s->ticks = 0;
+	s->min_rate = (UINT64)-1;
+	s->max_rate = 0;
+}
+
+/**
+ * stream_submit - Issue the read of the next chunk of a stream
+ * @s: the stream to read from
+ *
+ * Does nothing if a read is already outstanding or there is nothing
+ * left to read.
+ */
+EFI_STATUS stream_submit(struct stream *s)
+{
+	struct stream_buf *cur;
+	EFI_STATUS err;
+
+	if (s->io.pending || s->offset == s->size)
+		return EFI_SUCCESS;
+
+	cur = &s->bufs[s->cur];
+	cur->buf = s->dst + s->offset;
+	cur->len = s->chunk_size;
+	if (cur->len > s->size - s->offset)
+		cur->len = s->size - s->offset;
+
+	s->start = rdtsc();
+	err = aio_read(&s->io, s->file, cur->buf, cur->len);
+	if (err != EFI_SUCCESS) {
+		cur->len = 0;
+		aio_fini(&s->io);
+	}
+
+	return err;
+}
+
+/**
+ * stream_complete - Retire the previous chunk and wait for the current one
+ * @s: the stream to read from
+ *
+ * The previous chunk is passed to the stream's hook while the read
+ * issued by stream_submit() is still in flight. Once the final chunk
+ * has been read, one more call is needed to retire it.
+ */
+EFI_STATUS stream_complete(struct stream *s)
+{
+	struct stream_buf *cur, *prev;
+	EFI_STATUS err;
+	UINT64 ticks;
+	UINTN len;
+
+	cur = &s->bufs[s->cur];
+	prev = &s->bufs[s->cur ^ 1];
+
+	if (prev->len) {
+		if (s->hook)
+			s->hook(s, prev->buf, prev->len, s->hook_data);
+		prev->len = 0;
+	}
+
+	if (s->io.pending) {
+		err = aio_wait(&s->io, &len);
+		ticks = rdtsc() - s->start;
+
+		/* The file is shorter than we were told */
+		if (err == EFI_SUCCESS && !len)
+			err = EFI_END_OF_MEDIA;
+
+		if (err != EFI_SUCCESS) {
+			cur->len = 0;
+			aio_fini(&s->io);
+			return err;
+		}
+
+		cur->len = len;
+		s->offset += len;
+		s->ticks += ticks;
+		s->nr_chunks++;
+
+		/* Rates need the TSC calibrated, so only when asked for */
+		if (stream_verbose) {
+			if (rate(len, ticks) < s->min_rate)
+				s->min_rate = rate(len, ticks);
+			if (rate(len, ticks) > s->max_rate)
+				s->max_rate = rate(len, ticks);
+
+			log_print(LOG_INFO, L"  chunk %d: %d bytes in %ld us "
+				  "(%ld KB/s)\n", s->nr_chunks, len,
+				  ticks_to_us(ticks), rate(len, ticks));
+		}
+	}
+
+	s->cur ^= 1;
+
+	if (stream_done(s)) {
+		aio_fini(&s->io);
+		if (s->finish)
+			s->finish(s, s->finish_data);
+	}
+
+	return EFI_SUCCESS;
+}
+
+/**
+ * stream_next - Read the next chunk of a stream
+ * @s: the stream to read from
+ *
+ * Read the next chunk into one buffer and then retire the chunk held
+ * in the other buffer by passing it to the stream's hook. Once the
+ * final chunk has been read, one more call is needed to retire it.
+ */
+EFI_STATUS stream_next(struct stream *s)
+{
+	EFI_STATUS err;
+
+	err = stream_submit(s);
+	if (err != EFI_SUCCESS)
+		return err;
+
+	return stream_complete(s);
+}
+
+/**
+ * stream_read - Read every remaining chunk of a stream
+ * @s: the stream to read from
+ */
+EFI_STATUS stream_read(struct stream *s)
+{
+	return stream_read_all(s, 1);
+}
+
+/**
+ * stream_read_all - Read every remaining chunk of several streams
+ * @streams: the streams to read from
+ * @nr: the number of streams in @streams
+ *
+ * One read is kept outstanding on every stream that has data left,
+ * so that files on different devices are read in parallel when the
+ * firmware supports it. If any stream fails, the reads outstanding on
+ * the others are waited for before returning the error.
+ */
+EFI_STATUS stream_read_all(struct stream *streams, UINTN nr)
+{
+	EFI_STATUS err = EFI_SUCCESS;
+	BOOLEAN busy;
+	UINTN i;
+
+	do {
+		busy = FALSE;
+
+		for (i = 0; i < nr; i++) {
+			err = stream_submit(&streams[i]);
+			if (err != EFI_SUCCESS)
+				goto fail;
+		}
+
+		for (i = 0; i < nr; i++) {
+			struct stream *s = &streams[i];
+
+			if (stream_done(s))
+				continue;
+
+			err = stream_complete(s);
+			if (err != EFI_SUCCESS)
+				goto fail;
+
+			busy = TRUE;
+		}
+	} while (busy);
+
+	return EFI_SUCCESS;
+
+fail:
+	for (i = 0; i < nr; i++)
+		aio_fini(&streams[i].io);
+
+	return err;
+}
+
+/**
+ * stream_report - Print the throughput achieved reading a stream
+ * @s: the stream to report on
+ * @name: a description of what was read
+ */
+void stream_report(struct stream *s, CHAR16 *name)
+{
+	if (!stream_verbose || !s->nr_chunks)
+		return;
+
+	log_print(LOG_INFO, L"%s: %ld bytes in %d chunks, %ld us, %ld KB/s "
+		  "(min %ld, max %ld)\n", name, s->offset, s->nr_chunks,
+		  ticks_to_us(s->ticks), rate(s->offset, s->ticks),
+		  s->min_rate, s->max_rate);
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __STREAM_H__
+#define __STREAM_H__
+
+#define STREAM_CHUNK_SIZE	(1 << 20)
+
+struct stream;
+
+/*
+ * Called once for every chunk after the read of the following chunk
+ * has been issued, so that work on the data (hashing, progress
+ * reporting) can overlap with the firmware reading the next chunk.
+ */
+typedef void (*stream_hook_t)(struct stream *s, void *buf,
+			      UINTN len, void *data);
+
+/*
+ * Called once the last chunk of a stream has been retired, so that
+ * each of several streams read together can be timed.
+ */
+typedef void (*stream_finish_t)(struct stream *s, void *data);
+
+struct stream_buf {
+	char *buf;
+	UINTN len;
+};
+
+struct stream {
+	struct file *file;
+	char *dst;
+	UINT64 size;
+	UINT64 offset;
+	UINTN chunk_size;
+
+	/* The two chunks alternate between being filled and retired */
+	struct stream_buf bufs[2];
+	int cur;
+
+	stream_hook_t hook;
+	void *hook_data;
+	stream_finish_t finish;
+	void *finish_data;
+
+	/* The read filling bufs[cur], and when it was issued */
+	struct aio io;
+	UINT64 start;
+
+	/* Statistics */
+	UINTN nr_chunks;
+	UINT64 ticks;
+	UINT64 min_rate;
+	UINT64 max_rate;
+};
+
+extern UINTN stream_chunk_size;
+extern BOOLEAN stream_verbose;
+
+extern void stream_init(struct stream *s, struct file *file,
+			void *dst, UINT64 size);
+extern EFI_STATUS stream_submit(struct stream *s);
+extern EFI_STATUS stream_complete(struct stream *s);
+extern EFI_STATUS stream_next(struct stream *s);
+extern EFI_STATUS stream_read(struct stream *s);
+extern EFI_STATUS stream_read_all(struct stream *streams, UINTN nr);
+extern void stream_report(struct stream *s, CHAR16 *name);
+
+/**
+ * stream_done - Has every chunk of @s been read and retired?
+ * @s: the stream to check
+ */
+static inline BOOLEAN stream_done(struct stream *s)
+{
+	return s->offset == s->size &&
+		!s->bufs[0].len && !s->bufs[1].len;
+}
+
+#endif /* __STREAM_H__ */
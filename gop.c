@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Finding the graphics output protocol and choosing its mode.
+ *
+ * Firmware usually leaves the GOP in the panel's native mode, and on
+ * a 4K panel the kernel's efifb console then scrolls a 3840x2160
+ * framebuffer in software for the whole boot. "-v" picks a mode
+ * instead: a fixed resolution, the lowest, the largest up to some
+ * number of pixels, or the firmware's ("keep", the default). The
+ * modes are listed with QueryMode() and SetMode() is called at most
+ * once. As the mode is set while the arguments are parsed, it is the
+ * one both the kernel's EFI stub and setup_graphics() find.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "protocol.h"
+#include "stdlib.h"
+#include "config.h"
+#include "profile.h"
+#include "log.h"
+#include "fbcon.h"
+#include "gop.h"
+
+enum gop_policy {
+	GOP_KEEP,
+	GOP_LOWEST,
+	GOP_EXACT,	/* width x height */
+	GOP_MAX,	/* the most pixels up to max_pixels */
+};
+
+struct gop_mode_req {
+	enum gop_policy policy;
+	UINT32 width, height;
+	UINT64 max_pixels;
+};
+
+/**
+ * gop_find - Find the first usable graphics output protocol
+ * @gop: the protocol
+ * @info: its current mode, allocated by the firmware
+ */
+EFI_STATUS gop_find(EFI_GRAPHICS_OUTPUT_PROTOCOL **gop,
+		    EFI_GRAPHICS_OUTPUT_MODE_INFORMATION **info)
+{
+	EFI_GUID graphics_proto = EFI_GRAPHICS_OUTPUT_PROTOCOL_GUID;
+	EFI_HANDLE *gop_handle = NULL;
+	EFI_STATUS err;
+	UINTN nr_gops;
+	UINTN size;
+	UINTN i;
+
+	/* See if we have graphics output protocol */
+	size = 0;
+	err = locate_handle(ByProtocol, &graphics_proto, NULL,
+			    &size, (void **)gop_handle);
+	if (err != EFI_SUCCESS && err != EFI_BUFFER_TOO_SMALL)
+		goto out;
+
+	gop_handle = malloc(size);
+	if (!gop_handle) {
+		err = EFI_OUT_OF_RESOURCES;
+		goto out;
+	}
+
+	err = locate_handle(ByProtocol, &graphics_proto, NULL,
+			    &size, (void **)gop_handle);
+	if (err != EFI_SUCCESS)
+		goto out;
+
+	nr_gops = size / sizeof(EFI_HANDLE);
+	for (i = 0; i < nr_gops; i++) {
+		err = handle_protocol(gop_handle[i], &graphics_proto,
+				      (void **)gop);
+		if (err != EFI_SUCCESS)
+			continue;
+
+		err = uefi_call_wrapper((*gop)->QueryMode, 4, *gop,
+					(*gop)->Mode->Mode, &size, info);
+		if (err == EFI_SUCCESS)
+			break;
+	}
+
+	if (i == nr_gops)
+		err = EFI_NOT_FOUND;
+
+out:
+	if (gop_handle)
+		free(gop_handle);
+	return err;
+}
+
+/*
+ * Parse "<width>x<height>", or just a number if 'height' is NULL.
+ */
+static BOOLEAN parse_size(char *str, UINTN len, UINT32 *width,
+			  UINT32 *height)
+{
+	struct token t = { str, len };
+	UINTN i;
+
+	for (i = 0; i < len && str[i] >= '0' && str[i] <= '9'; i++)
+		;
+
+	if (!height) {
+		*width = token_atoi(&t);
+		return i == len && *width;
+	}
+
+	if (!i || i + 1 >= len || str[i] != 'x')
+		return FALSE;
+
+	*width = token_atoi(&t);
+	t.str = str + i + 1;
+	t.len = len - i - 1;
+	*height = token_atoi(&t);
+
+	return *width && *height;
+}
+
+static BOOLEAN parse_policy(struct token *arg, struct gop_mode_req *req)
+{
+	struct token prefix = { arg->str, 4 };
+	UINT32 width, height;
+
+	if (token_is(arg, "keep")) {
+		req->policy = GOP_KEEP;
+		return TRUE;
+	}
+
+	if (token_is(arg, "lowest")) {
+		req->policy = GOP_LOWEST;
+		return TRUE;
+	}
+
+	if (arg->len > 4 && token_is(&prefix, "max:")) {
+		req->policy = GOP_MAX;
+		if (parse_size(arg->str + 4, arg->len - 4, &width, &height)) {
+			req->max_pixels = (UINT64)width * height;
+			return TRUE;
+		}
+		if (parse_size(arg->str + 4, arg->len - 4, &width, NULL)) {
+			req->max_pixels = width;
+			return TRUE;
+		}
+		return FALSE;
+	}
+
+	req->policy = GOP_EXACT;
+	return parse_size(arg->str, arg->len, &req->width, &req->height);
+}
+
+/*
+ * Is 'mode', with 'pixels', a better choice than the best so far?
+ * Modes without a framebuffer are no use to the kernel.
+ */
+static BOOLEAN better(struct gop_mode_req *req,
+		      EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *info,
+		      UINT64 best)
+{
+	UINT64 pixels = (UINT64)info->HorizontalResolution *
+		info->VerticalResolution;
+
+	if (info->PixelFormat == PixelBltOnly)
+		return FALSE;
+
+	switch (req->policy) {
+	case GOP_LOWEST:
+		return !best || pixels < best;
+	case GOP_EXACT:
+		return !best && info->HorizontalResolution == req->width &&
+			info->VerticalResolution == req->height;
+	case GOP_MAX:
+		if (pixels > req->max_pixels)
+			return FALSE;
+		return pixels > best;
+	default:
+		return FALSE;
+	}
+}
+
+/**
+ * gop_set_policy - Choose the graphics mode
+ * @arg: keep, lowest, <width>x<height>, max:<width>x<height> or
+ *	max:<pixels>
+ *
+ * Switches the first GOP to the mode @arg selects. Where no mode
+ * matches, the firmware's mode is kept. Returns EFI_INVALID_PARAMETER
+ * if @arg can't be parsed.
+ */
+EFI_STATUS gop_set_policy(struct token *arg)
+{
+	EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *info;
+	EFI_GRAPHICS_OUTPUT_PROTOCOL *gop;
+	struct gop_mode_req req;
+	UINT32 mode, cur, best_mode;
+	UINT64 best = 0;
+	EFI_STATUS err;
+	UINTN size;
+
+	if (!parse_policy(arg, &req))
+		return EFI_INVALID_PARAMETER;
+
+	if (req.policy == GOP_KEEP)
+		return EFI_SUCCESS;
+
+	err = gop_find(&gop, &info);
+	if (err != EFI_SUCCESS) {
+		log_print(LOG_WARN, L"No graphics to set the mode of\n");
+		return err;
+	}
+	free_pool(info);
+
+	/* Where modes tie, prefer the current one and save a SetMode() */
+	cur = best_mode = gop->Mode->Mode;
+	err = uefi_call_wrapper(gop->QueryMode, 4, gop, cur, &size, &info);
+	if (err == EFI_SUCCESS) {
+		if (better(&req, info, 0))
+			best = (UINT64)info->HorizontalResolution *
+				info->VerticalResolution;
+		free_pool(info);
+	}
+
+	for (mode = 0; mode < gop->Mode->MaxMode; mode++) {
+		if (mode == cur)
+			continue;
+
+		err = uefi_call_wrapper(gop->QueryMode, 4, gop,
+					mode, &size, &info);
+		if (err != EFI_SUCCESS)
+			continue;
+
+		if (better(&req, info, best)) {
+			best = (UINT64)info->HorizontalResolution *
+				info->VerticalResolution;
+			best_mode = mode;
+		}
+		free_pool(info);
+	}
+
+	if (!best) {
+		log_print(LOG_WARN, L"No graphics mode matches, keeping %d\n",
+			  cur);
+		return EFI_NOT_FOUND;
+	}
+
+	if (best_mode == cur)
+		return EFI_SUCCESS;
+
+	err = uefi_call_wrapper(gop->SetMode, 2, gop, best_mode);
+	if (err != EFI_SUCCESS) {
+		log_print(LOG_WARN, L"Unable to set graphics mode %d\n",
+			  best_mode);
+		return err;
+	}
+
+	profile_stamp("set_mode", best_mode);
+
+	/* The framebuffer console needs to start again in the new mode */
+	if (fbcon_enabled)
+		fbcon_init();
+
+	return EFI_SUCCESS;
+}
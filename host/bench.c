@@ -0,0 +1,748 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Run efilinux as a Linux process against the mock firmware and
+ * report how long it took to get to the kernel, how many bytes it
+ * read and how many firmware calls it made.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "efi.h"
+#include "efilib.h"
+#include "mock.h"
+#include "../loaders/bzimage/bzimage.h"
+#include "../profile.h"
+#include "../exit.h"
+#include "../log.h"
+
+#define MAX_VOLUMES	64
+#define MAX_INITRDS	16
+#define SETUP_SECTS	4
+
+extern EFI_STATUS efi_main(EFI_HANDLE image, EFI_SYSTEM_TABLE *table);
+
+static jmp_buf done;
+
+static struct {
+	BOOLEAN handover;
+	EFI_STATUS status;
+	struct boot_params *bp;
+	EFI_PHYSICAL_ADDRESS kernel_start;
+} result;
+
+void host_jump(BOOLEAN handover, EFI_HANDLE image, struct boot_params *bp,
+	       EFI_PHYSICAL_ADDRESS kernel_start)
+{
+	result.handover = handover;
+	result.bp = bp;
+	result.kernel_start = kernel_start;
+	longjmp(done, 1);
+}
+
+void host_exit(EFI_STATUS status)
+{
+	result.status = status;
+	longjmp(done, 2);
+}
+
+static UINT64 now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/*
+ * Synthetic images are filled with a cheap pseudo-random sequence so
+ * that misplaced chunks are caught when verifying what was loaded.
+ */
+static void fill(unsigned char *buf, size_t len, UINT64 *seed)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		*seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		buf[i] = *seed >> 56;
+	}
+}
+
+static int write_file(const char *path, const void *head, size_t head_len,
+		      UINT64 size, UINT64 seed)
+{
+	static unsigned char buf[1 << 20];
+	FILE *f;
+
+	f = fopen(path, "w");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+
+	if (head_len)
+		fwrite(head, 1, head_len, f);
+
+	while (size) {
+		size_t len = size < sizeof(buf) ? size : sizeof(buf);
+
+		fill(buf, len, &seed);
+		fwrite(buf, 1, len, f);
+		size -= len;
+	}
+
+	return fclose(f);
+}
+
+/*
+ * Both of the synthetic kernel's 64-bit entry points ask QEMU to exit,
+ * through an isa-debug-exit device at port 0xf4, so that the kernel
+ * can be booted for real by scripts/qemu-bench.sh.
+ */
+static const unsigned char entry_stub[] = {
+	0xb0, 0x31,	/* mov $0x31, %al */
+	0xe6, 0xf4,	/* out %al, $0xf4 */
+	0xf4,		/* 1: hlt */
+	0xeb, 0xfd,	/* jmp 1b */
+};
+
+static int write_kernel(const char *path, UINT64 size, UINT16 version,
+			UINT32 align)
+{
+	unsigned char setup[(SETUP_SECTS + 1) * 512];
+	struct setup_header *hdr;
+	FILE *f;
+
+	memset(setup, 0, sizeof(setup));
+	hdr = (struct setup_header *)&setup[0x1f1];
+
+	hdr->setup_secs = SETUP_SECTS;
+	hdr->signature = 0xAA55;
+	hdr->header = SETUP_HDR;
+	hdr->version = version;
+	hdr->relocatable_kernel = 1;
+	hdr->kernel_alignment = align;
+	hdr->min_alignment = 21;
+	hdr->xloadflags = XLF_KERNEL_64 | XLF_CAN_BE_LOADED_ABOVE_4G |
+		XLF_EFI_HANDOVER_64;
+	hdr->cmdline_size = 2048;
+	hdr->ramdisk_max = 0x7fffffff;
+	hdr->pref_address = 0x1000000;
+	hdr->init_size = (size * 3 + 0xfff) & ~0xfffULL;
+	hdr->handover_offset = 0x190;
+
+	if (write_file(path, setup, sizeof(setup), size, 1))
+		return -1;
+
+	if (size < 512 + hdr->handover_offset + sizeof(entry_stub))
+		return 0;
+
+	f = fopen(path, "r+");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+
+	fseek(f, sizeof(setup) + 512, SEEK_SET);
+	fwrite(entry_stub, 1, sizeof(entry_stub), f);
+	fseek(f, sizeof(setup) + 512 + hdr->handover_offset, SEEK_SET);
+	fwrite(entry_stub, 1, sizeof(entry_stub), f);
+
+	return fclose(f);
+}
+
+/*
+ * Compare 'len' bytes of 'path', starting at 'offset', with memory.
+ */
+static int verify(const char *path, UINT64 offset, const void *mem,
+		  UINT64 len)
+{
+	static unsigned char buf[1 << 20];
+	const unsigned char *p = mem;
+	int fd, ret = 0;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	while (len && !ret) {
+		size_t n = len < sizeof(buf) ? len : sizeof(buf);
+
+		if (pread(fd, buf, n, offset) != n || memcmp(buf, p, n))
+			ret = -1;
+
+		offset += n;
+		p += n;
+		len -= n;
+	}
+
+	close(fd);
+	return ret;
+}
+
+/*
+ * Append "-d <name>=<digest>" for 'path', as worked out by sha256sum
+ * rather than by the code under test. If 'wrong' is set, flip a bit.
+ */
+static int pin_digest(char *buf, size_t size, const char *path,
+		      const char *name, BOOLEAN wrong)
+{
+	char cmd[PATH_MAX + 32], hex[65];
+	FILE *f;
+
+	snprintf(cmd, sizeof(cmd), "sha256sum '%s'", path);
+	f = popen(cmd, "r");
+	if (!f || fscanf(f, "%64s", hex) != 1) {
+		fprintf(stderr, "sha256sum failed for %s\n", path);
+		exit(1);
+	}
+	pclose(f);
+
+	if (wrong)
+		hex[0] = hex[0] == '0' ? '1' : '0';
+
+	return snprintf(buf, size, " -d %s=%s", name, hex);
+}
+
+/*
+ * How many bytes of messages efilinux handed to the kernel, or -1 if
+ * it didn't.
+ */
+static long long log_size(struct boot_params *bp)
+{
+	struct setup_data *sd;
+	struct log_ring *ring;
+
+	sd = (struct setup_data *)(UINTN)bp->hdr.setup_data;
+	while (sd && sd->type != SETUP_EFILINUX_LOG)
+		sd = (struct setup_data *)(UINTN)sd->next;
+
+	if (!sd)
+		return -1;
+
+	ring = (struct log_ring *)sd->data;
+	if (ring->magic != LOG_MAGIC)
+		return -1;
+
+	return ring->head;
+}
+
+/*
+ * Print the e820 map handed to the kernel, in boot_params and any
+ * SETUP_E820_EXT, and check that it is sorted without overlaps.
+ */
+static BOOLEAN check_e820(struct boot_params *bp)
+{
+	struct e820_entry *e = bp->e820_map, *prev = NULL;
+	struct setup_data *sd;
+	unsigned int i, nr = bp->e820_entries, ext = 0;
+	BOOLEAN ok = TRUE;
+
+	sd = (struct setup_data *)(UINTN)bp->hdr.setup_data;
+	for (;;) {
+		for (i = 0; i < nr; i++) {
+			if (prev && prev->addr + prev->size > e[i].addr)
+				ok = FALSE;
+			prev = &e[i];
+		}
+
+		while (sd && sd->type != SETUP_E820_EXT)
+			sd = (struct setup_data *)(UINTN)sd->next;
+		if (!sd)
+			break;
+
+		e = (struct e820_entry *)sd->data;
+		nr = sd->len / sizeof(*e);
+		ext += nr;
+		sd = (struct setup_data *)(UINTN)sd->next;
+	}
+
+	printf("e820 entries:    %u", bp->e820_entries);
+	if (ext)
+		printf(" + %u in setup_data", ext);
+	printf("%s\n", ok ? "" : ", NOT SORTED");
+
+	return ok;
+}
+
+/*
+ * Where a relocatable kernel loaded at 'addr' decompresses itself:
+ * at 'addr' rounded up to kernel_alignment, but not below
+ * pref_address.
+ */
+static BOOLEAN in_place(struct boot_params *bp, UINT64 addr)
+{
+	UINT64 align = bp->hdr.kernel_alignment;
+	UINT64 target = (addr + align - 1) & ~(align - 1);
+
+	if (bp->hdr.version >= 0x20a && target < bp->hdr.pref_address)
+		target = bp->hdr.pref_address;
+
+	return target == addr;
+}
+
+/*
+ * Name 'file' on volume 'vol' as efilinux would see it. With -A the
+ * kernel gets the full device path and initrds the path's last node,
+ * otherwise both use the device number.
+ */
+static void file_name(char *buf, size_t size, int vol, const char *file,
+		      int by_path, BOOLEAN full)
+{
+	char dev[128];
+
+	if (by_path)
+		mock_volume_path(vol, dev, sizeof(dev), full);
+	else
+		snprintf(dev, sizeof(dev), "%d", vol);
+
+	snprintf(buf, size, "%s:\\%s", dev, file);
+}
+
+/*
+ * Write the load options, less the image name, as a config file with
+ * one argument per line and some comments to skip.
+ */
+static int write_config(const char *path, const char *options)
+{
+	const char *p = options + strlen("efilinux.efi");
+	FILE *f;
+
+	f = fopen(path, "w");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+
+	fprintf(f, "# written by efilinux-bench\n");
+	for (; *p; p++) {
+		if (*p != ' ')
+			fputc(*p, f);
+		else if (p[1] && p[1] != ' ')
+			fprintf(f, "\n\t# next argument\n");
+	}
+	fputc('\n', f);
+
+	return fclose(f);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+"usage: efilinux-bench [options] [-- efilinux arguments]\n"
+"\n"
+"  -d <dir>    add a volume backed by <dir> (repeatable)\n"
+"  -k <MiB>    create a synthetic bzImage on the first volume\n"
+"  -i <MiB>    create a synthetic initrd (repeatable), spread across volumes\n"
+"  -V <ver>    boot protocol version of the synthetic bzImage (hex)\n"
+"  -a <KiB>    kernel_alignment of the synthetic bzImage (default 2048)\n"
+"  -m <MiB>    RAM above 1MiB (default 2048)\n"
+"  -F <n>      split RAM into <n> memory map ranges\n"
+"  -T          separate them with reserved memory, not boot services data\n"
+"  -l <us>     latency added to every file call\n"
+"  -b <MB/s>   bandwidth of file reads\n"
+"  -C <us>     latency added to every console write\n"
+"  -g <WxH>    add a graphics device in mode WxH\n"
+"  -N <n>      split RAM into <n> NUMA nodes, the CPU is on the last\n"
+"  -S          make node 0 specific-purpose memory\n"
+"  -R          files are revision 1, without ReadEx\n"
+"  -v <n>      add <n> more, empty, volumes\n"
+"  -M <us>     latency added to every OpenVolume, as if mounting\n"
+"  -K <KiB>    the filesystem splits file reads into <KiB> disk requests\n"
+"  -B          offer each volume as a FAT32 disk as well\n"
+"  -X <n>      leave a hole every <n> clusters of a file on those disks\n"
+"  -P <n>      offer MP services with <n> processors\n"
+"  -e <n>      ExitBootServices fails <n> times, as if the map changed\n"
+"  -U          add a 16550 UART at 0x3f8, described by an ACPI SPCR\n"
+"  -H ok|bad   pin the SHA-256 of the synthetic files, or a wrong one\n"
+"  -E <args>   extra efilinux switches for the synthetic boot\n"
+"  -G          pass the arguments in a multi-line efilinux.cfg\n"
+"  -A          name devices by device path rather than by number\n"
+"  -q          don't echo the console\n"
+"  -w          write the synthetic files to the first -d volume and exit\n"
+"\n"
+"Without -d a temporary volume is used. Without efilinux arguments\n"
+"the synthetic bzImage and initrds are booted.\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	char tmpdir[] = "/tmp/efilinux-bench.XXXXXX";
+	const char *volumes[MAX_VOLUMES];
+	UINT64 initrds[MAX_INITRDS];
+	char path[PATH_MAX], empty[PATH_MAX];
+	char options[4096];
+	int nr_volumes = 0, nr_initrds = 0, nr_empty = 0;
+	UINT64 kernel_size = 0;
+	UINT16 version = 0x20c;
+	UINT32 align = 0x200000;
+	EFI_HANDLE vol0 = NULL, image;
+	UINT64 start, elapsed, total, tsc, ticks_per_us;
+	UINT32 gop_w = 0, gop_h = 0;
+	const char *extra = "";
+	BOOLEAN ok = TRUE, config = FALSE, write_only = FALSE;
+	int pin = 0, by_path = 0;
+	int c, i, len;
+
+	while ((c = getopt(argc, argv, "d:k:i:V:a:m:F:Tl:b:C:g:N:SRv:M:K:BX:P:e:UH:E:GAqwh")) != -1) {
+		switch (c) {
+		case 'd':
+			if (nr_volumes < MAX_VOLUMES)
+				volumes[nr_volumes++] = optarg;
+			break;
+		case 'k':
+			kernel_size = strtoull(optarg, NULL, 0) << 20;
+			break;
+		case 'i':
+			if (nr_initrds < MAX_INITRDS)
+				initrds[nr_initrds++] =
+					strtoull(optarg, NULL, 0) << 20;
+			break;
+		case 'V':
+			version = strtoul(optarg, NULL, 16);
+			break;
+		case 'a':
+			align = strtoul(optarg, NULL, 0) << 10;
+			break;
+		case 'm':
+			mock_config.mem_size = strtoull(optarg, NULL, 0) << 20;
+			break;
+		case 'F':
+			mock_config.fragments = strtoul(optarg, NULL, 0);
+			break;
+		case 'T':
+			mock_config.reserved_gaps = TRUE;
+			break;
+		case 'l':
+			mock_config.latency_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			mock_config.bandwidth = strtoul(optarg, NULL, 0);
+			break;
+		case 'C':
+			mock_config.console_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'g':
+			if (sscanf(optarg, "%ux%u", &gop_w, &gop_h) != 2)
+				usage();
+			break;
+		case 'N':
+			mock_config.nodes = strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			mock_config.sp_node0 = TRUE;
+			break;
+		case 'R':
+			mock_config.sync_files = TRUE;
+			break;
+		case 'v':
+			nr_empty = strtoul(optarg, NULL, 0);
+			break;
+		case 'M':
+			mock_config.mount_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'K':
+			mock_config.fs_request = strtoul(optarg, NULL, 0) << 10;
+			break;
+		case 'B':
+			mock_config.fat_disks = TRUE;
+			break;
+		case 'X':
+			mock_config.fat_gap = strtoul(optarg, NULL, 0);
+			break;
+		case 'P':
+			mock_config.cpus = strtoul(optarg, NULL, 0);
+			break;
+		case 'e':
+			mock_config.exit_races = strtoul(optarg, NULL, 0);
+			break;
+		case 'U':
+			mock_config.uart = TRUE;
+			break;
+		case 'H':
+			if (!strcmp(optarg, "ok"))
+				pin = 1;
+			else if (!strcmp(optarg, "bad"))
+				pin = 2;
+			else
+				usage();
+			break;
+		case 'E':
+			extra = optarg;
+			break;
+		case 'G':
+			config = TRUE;
+			break;
+		case 'A':
+			by_path = 1;
+			break;
+		case 'q':
+			mock_config.quiet = TRUE;
+			break;
+		case 'w':
+			write_only = TRUE;
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if (write_only && !nr_volumes)
+		usage();
+
+	if (!nr_volumes || nr_empty) {
+		if (!mkdtemp(tmpdir)) {
+			perror("mkdtemp");
+			return 1;
+		}
+		if (!nr_volumes)
+			volumes[nr_volumes++] = tmpdir;
+	}
+
+	if (kernel_size) {
+		snprintf(path, sizeof(path), "%s/bzImage", volumes[0]);
+		if (write_kernel(path, kernel_size, version, align))
+			return 1;
+	}
+
+	for (i = 0; i < nr_initrds; i++) {
+		snprintf(path, sizeof(path), "%s/initrd%d",
+			 volumes[i % nr_volumes], i);
+		if (write_file(path, NULL, 0, initrds[i], i + 2))
+			return 1;
+	}
+
+	if (write_only)
+		return 0;
+
+	/* The first word of the load options is the image name */
+	len = snprintf(options, sizeof(options), "efilinux.efi");
+	if (optind < argc) {
+		for (i = optind; i < argc; i++)
+			len += snprintf(options + len, sizeof(options) - len,
+					" %s", argv[i]);
+	} else {
+		char kernel[256], name[256], file[32];
+
+		file_name(kernel, sizeof(kernel), 0, "bzImage", by_path, TRUE);
+		if (pin && kernel_size) {
+			snprintf(path, sizeof(path), "%s/bzImage", volumes[0]);
+			len += pin_digest(options + len, sizeof(options) - len,
+					  path, kernel,
+					  pin == 2 && !nr_initrds);
+		}
+		for (i = 0; pin && i < nr_initrds; i++) {
+			snprintf(path, sizeof(path), "%s/initrd%d",
+				 volumes[i % nr_volumes], i);
+			snprintf(file, sizeof(file), "initrd%d", i);
+			file_name(name, sizeof(name), i % nr_volumes, file,
+				  by_path, FALSE);
+			len += pin_digest(options + len, sizeof(options) - len,
+					  path, name,
+					  pin == 2 && i == nr_initrds - 1);
+		}
+
+		len += snprintf(options + len, sizeof(options) - len,
+				" %s -f %s console=ttyS0", extra, kernel);
+		for (i = 0; i < nr_initrds; i++) {
+			snprintf(file, sizeof(file), "initrd%d", i);
+			file_name(name, sizeof(name), i % nr_volumes, file,
+				  by_path, FALSE);
+			len += snprintf(options + len, sizeof(options) - len,
+					" initrd=%s", name);
+		}
+	}
+
+	if (config) {
+		snprintf(path, sizeof(path), "%s/efilinux.cfg", volumes[0]);
+		if (write_config(path, options))
+			return 1;
+		options[strlen("efilinux.efi")] = '\0';
+	}
+
+	if (mock_init())
+		return 1;
+
+	for (i = 0; i < nr_volumes; i++) {
+		EFI_HANDLE h = mock_add_volume(volumes[i]);
+
+		if (!vol0)
+			vol0 = h;
+	}
+
+	if (nr_empty) {
+		snprintf(empty, sizeof(empty), "%s/empty", tmpdir);
+		if (mkdir(empty, 0755) && errno != EEXIST) {
+			perror(empty);
+			return 1;
+		}
+
+		for (i = 0; i < nr_empty; i++)
+			mock_add_volume(empty);
+	}
+
+	if (gop_w)
+		mock_add_gop(gop_w, gop_h);
+
+	image = mock_add_image(vol0, "\\efilinux.efi", options);
+
+	start = now_us();
+	tsc = __builtin_ia32_rdtsc();
+	switch (setjmp(done)) {
+	case 0:
+		result.status = efi_main(image, mock_system_table);
+		break;
+	case 1:
+		result.status = EFI_SUCCESS;
+		break;
+	}
+	elapsed = now_us() - start;
+	tsc = __builtin_ia32_rdtsc() - tsc;
+	fflush(stdout);
+
+	/* efilinux may never have calibrated, and can't once it's exited */
+	ticks_per_us = elapsed ? tsc / elapsed : 0;
+	if (!ticks_per_us)
+		ticks_per_us = 1;
+
+	printf("\n--- efilinux host benchmark ---\n");
+	if (result.bp) {
+		struct boot_params *bp = result.bp;
+		UINT64 rd = bp->hdr.ramdisk_start |
+			((UINT64)bp->ext_ramdisk_image << 32);
+		UINT64 rd_len = bp->hdr.ramdisk_len |
+			((UINT64)bp->ext_ramdisk_size << 32);
+
+		printf("result:          %s jump, kernel at 0x%llx (node %d)\n",
+		       result.handover ? "handover" : "legacy",
+		       (unsigned long long)result.kernel_start,
+		       mock_node(result.kernel_start));
+		printf("decompresses:    %s\n",
+		       in_place(bp, result.kernel_start) ?
+		       "in place" : "after moving itself");
+		printf("initrd:          0x%llx (node %d), %llu bytes\n",
+		       (unsigned long long)rd, mock_node(rd),
+		       (unsigned long long)rd_len);
+		if (!check_e820(bp))
+			ok = FALSE;
+		if (log_size(bp) >= 0)
+			printf("log:             %lld bytes in setup_data\n",
+			       log_size(bp));
+		if (exit_stats.attempts)
+			printf("exit:            %lu attempts, %lu reallocs, "
+			       "%llu us (%llu us from the final map)\n",
+			       (unsigned long)exit_stats.attempts,
+			       (unsigned long)exit_stats.reallocs,
+			       (unsigned long long)
+			       (exit_stats.ticks / ticks_per_us),
+			       (unsigned long long)
+			       (exit_stats.final_ticks / ticks_per_us));
+		printf("cmdline:         %s\n",
+		       (char *)(UINTN)bp->hdr.cmd_line_ptr);
+
+		if (kernel_size) {
+			snprintf(path, sizeof(path), "%s/bzImage", volumes[0]);
+			if (verify(path, (SETUP_SECTS + 1) * 512,
+				   (void *)(UINTN)result.kernel_start,
+				   kernel_size))
+				ok = FALSE;
+		}
+
+		/* efilinux boots without the initrds if it can't load them */
+		if (nr_initrds && optind == argc && !rd_len)
+			ok = FALSE;
+
+		for (i = 0; rd_len && i < nr_initrds && optind == argc; i++) {
+			snprintf(path, sizeof(path), "%s/initrd%d",
+				 volumes[i % nr_volumes], i);
+			if (verify(path, 0, (void *)(UINTN)rd, initrds[i]))
+				ok = FALSE;
+			rd += initrds[i];
+		}
+
+		if (kernel_size)
+			printf("verify:          %s\n",
+			       ok ? "ok" : "MISMATCH");
+	} else {
+		printf("result:          efi_main failed (0x%llx)\n",
+		       (unsigned long long)result.status);
+		ok = FALSE;
+	}
+
+	printf("time to jump:    %llu us\n", (unsigned long long)elapsed);
+	printf("bytes read:      %llu", (unsigned long long)mock_bytes_read);
+	if (elapsed)
+		printf(" (%llu MB/s)",
+		       (unsigned long long)(mock_bytes_read / elapsed));
+	printf("\nmemory map:      %lu descriptors\n",
+	       (unsigned long)mock_nr_descriptors());
+	if (mock_gop_mode(&gop_w, &gop_h))
+		printf("graphics:        %ux%u\n", gop_w, gop_h);
+	if (mock_config.uart) {
+		printf("uart:            %llu bytes, %llu overruns\n",
+		       (unsigned long long)mock_uart_bytes,
+		       (unsigned long long)mock_uart_overruns);
+
+		/* Anything lost was written without waiting for the FIFO */
+		if (mock_uart_overruns)
+			ok = FALSE;
+	}
+
+	printf("firmware calls:\n");
+	for (i = 0, total = 0; i < NR_MOCK_CALLS; i++) {
+		if (!mock_calls[i])
+			continue;
+		printf("  %-24s %8lu\n", mock_call_names[i], mock_calls[i]);
+		total += mock_calls[i];
+	}
+	printf("  %-24s %8llu\n", "total", (unsigned long long)total);
+
+	if (config) {
+		snprintf(path, sizeof(path), "%s/efilinux.cfg", volumes[0]);
+		unlink(path);
+	}
+
+	if (volumes[0] == tmpdir || nr_empty) {
+		snprintf(path, sizeof(path), "rm -rf '%s'", tmpdir);
+		if (system(path))
+			fprintf(stderr, "failed to remove %s\n", tmpdir);
+	}
+
+	return ok ? 0 : 1;
+}
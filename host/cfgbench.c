@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Check the argument tokenizer in config.c and compare it, on configs
+ * from 1KiB up to CFGBENCH_MAX MiB, with what efilinux used to do:
+ * widen the whole file to UTF-16, then narrow the kernel command
+ * line back into a fresh buffer.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "efi.h"
+#include "../config.h"
+
+#define MIN_SIZE	(1ULL << 10)
+#define MAX_SIZE	(64ULL << 20)
+
+/* Enough iterations at each size to keep the clock honest */
+#define WORK		(256ULL << 20)
+
+/* config.c allocates through efilinux's malloc() */
+void *efi_malloc(UINTN size)
+{
+	return malloc(size);
+}
+
+void efi_free(void *buf)
+{
+	free(buf);
+}
+
+/* Keeps the parsing from being optimized away */
+static volatile UINTN sink;
+
+/*
+ * The old read_config_file() and parse_args(), less the switches. The
+ * EFI build compiles them without optimization, so stop the compiler
+ * from vectorizing them here.
+ */
+#define REFERENCE __attribute__((noinline, \
+	optimize("no-tree-vectorize,no-tree-loop-distribute-patterns")))
+
+static REFERENCE UINTN ref_parse(const char *a_buf, UINTN size)
+{
+	CHAR16 *u_buf, *n;
+	char *cmdline, *s1;
+	UINTN i, j;
+
+	u_buf = malloc(size * 2);
+	for (i = 0; i < size; i++)
+		u_buf[i] = a_buf[i];
+
+	n = u_buf;
+	while (n < u_buf + size && *n == '-') {
+		while (*n > ' ')
+			n++;
+		while (n < u_buf + size && *n <= ' ')
+			n++;
+		while (n < u_buf + size && *n > ' ')
+			n++;
+		while (n < u_buf + size && *n <= ' ')
+			n++;
+	}
+
+	j = u_buf + size - n;
+	cmdline = malloc(j + 1);
+	for (s1 = cmdline; j--; )
+		*s1++ = *n++;
+	*s1 = '\0';
+
+	i = s1 - cmdline;
+	free(cmdline);
+	free(u_buf);
+
+	return i;
+}
+
+static __attribute__((noinline)) UINTN new_parse(char *buf, UINTN size)
+{
+	struct tokenizer t;
+	struct token tok;
+
+	token_init(&t, buf, size);
+	while (token_next(&t, &tok)) {
+		if (tok.str[0] != '-') {
+			token_unget(&t, &tok);
+			break;
+		}
+		token_next(&t, &tok);
+	}
+
+	return strlen(token_rest(&t));
+}
+
+static const char multi[] =
+	"# a comment\r\n"
+	"-p\n"
+	"  -c512   # chunk size\n"
+	"-f\t0:\\bzImage\n"
+	"\n"
+	"#-x commented out\n"
+	"console=ttyS0,115200  dyndbg=\"file foo.c +p\" # trailing\n"
+	"initrd=\\a.img\n"
+	"   initrd=\\b.img";
+
+static const char *multi_tokens[] = {
+	"-p", "-c512", "-f", "0:\\bzImage", "console=ttyS0,115200",
+	"dyndbg=\"file foo.c +p\"", "initrd=\\a.img", "initrd=\\b.img",
+};
+
+static int check(void)
+{
+	char buf[sizeof(multi)];
+	struct tokenizer t;
+	struct token tok;
+	const char *rest;
+	UINTN i;
+
+	memcpy(buf, multi, sizeof(multi));
+	token_init(&t, buf, sizeof(multi) - 1);
+	for (i = 0; token_next(&t, &tok); i++) {
+		if (i >= sizeof(multi_tokens) / sizeof(multi_tokens[0]) ||
+		    !token_is(&tok, (char *)multi_tokens[i])) {
+			fprintf(stderr, "token %lu: got '%.*s'\n",
+				(unsigned long)i, (int)tok.len, tok.str);
+			return 1;
+		}
+	}
+
+	if (i != sizeof(multi_tokens) / sizeof(multi_tokens[0])) {
+		fprintf(stderr, "got %lu tokens\n", (unsigned long)i);
+		return 1;
+	}
+
+	memcpy(buf, multi, sizeof(multi));
+	token_init(&t, buf, sizeof(multi) - 1);
+	for (i = 0; i < 4; i++)
+		token_next(&t, &tok);
+
+	rest = token_rest(&t);
+	if (strcmp(rest, "console=ttyS0,115200 dyndbg=\"file foo.c +p\" "
+		   "initrd=\\a.img initrd=\\b.img")) {
+		fprintf(stderr, "rest: got '%s'\n", rest);
+		return 1;
+	}
+
+	token_init(&t, buf, 0);
+	if (token_next(&t, &tok) || *token_rest(&t)) {
+		fprintf(stderr, "empty buffer has tokens\n");
+		return 1;
+	}
+
+	tok.str = "4096x";
+	tok.len = 5;
+	if (token_atoi(&tok) != 4096) {
+		fprintf(stderr, "token_atoi failed\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * A single line of switches followed by kernel parameters, which the
+ * old parser can also handle.
+ */
+static void fill(char *buf, UINTN size)
+{
+	UINTN len = 0;
+	int i = 0;
+
+	len += snprintf(buf, size, "-c 512 -f 0:\\bzImage");
+	while (len < size) {
+		int n = snprintf(buf + len, size - len,
+				 " param%d=value%d", i, i * 7);
+
+		if (n >= size - len)
+			break;
+		len += n;
+		i++;
+	}
+
+	memset(buf + len, ' ', size - len);
+	buf[size] = '\0';
+}
+
+/*
+ * The same arguments one per line, with a comment every so often,
+ * which makes the tokenizer move the kernel command line together.
+ */
+static void fill_lines(char *buf, UINTN size)
+{
+	UINTN i, n = 0;
+
+	for (i = 0; i < size; i++) {
+		if (buf[i] != ' ' || (i && buf[i - 1] == ' '))
+			continue;
+
+		buf[i] = '\n';
+		if (++n % 8 == 0 && i + 3 < size && buf[i + 1] != ' ')
+			buf[i + 1] = '#';
+	}
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	UINT64 max = MAX_SIZE, size;
+	char *src, *buf;
+
+	if (argc > 1)
+		max = strtoull(argv[1], NULL, 0) << 20;
+
+	if (check())
+		return 1;
+
+	src = malloc(max + 1);
+	buf = malloc(max + 1);
+	if (!src || !buf)
+		return 1;
+
+	printf("%10s %12s %12s %8s %12s\n", "size", "tokenizer", "old", "x",
+	       "multi-line");
+
+	for (size = MIN_SIZE; size <= max; size <<= 2) {
+		UINT64 iters = WORK / size ? WORK / size : 1;
+		double t, r[3];
+		UINT64 i;
+
+		fill(src, size);
+
+		t = now();
+		for (i = 0; i < iters; i++) {
+			/* The real thing reads the file straight into buf */
+			memcpy(buf, src, size + 1);
+			sink = new_parse(buf, size);
+		}
+		r[0] = size * iters / (now() - t) / (1 << 20);
+
+		t = now();
+		for (i = 0; i < iters; i++) {
+			memcpy(buf, src, size + 1);
+			sink = ref_parse(buf, size);
+		}
+		r[1] = size * iters / (now() - t) / (1 << 20);
+
+		fill_lines(src, size);
+
+		t = now();
+		for (i = 0; i < iters; i++) {
+			memcpy(buf, src, size + 1);
+			sink = new_parse(buf, size);
+		}
+		r[2] = size * iters / (now() - t) / (1 << 20);
+
+		printf("%10llu %7.0f MB/s %7.0f MB/s %7.2fx %7.0f MB/s\n",
+		       (unsigned long long)size, r[0], r[1], r[0] / r[1],
+		       r[2]);
+	}
+
+	return 0;
+}
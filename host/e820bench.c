@@ -0,0 +1,368 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Check the EFI to e820 conversion in e820.c on synthetic memory maps
+ * of up to E820BENCH_MAX descriptors, and compare it with what
+ * efilinux used to do: merge a descriptor into the entry before it if
+ * they happen to be adjacent, and otherwise append, without sorting
+ * or a bound.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "efi.h"
+#include "../loaders/bzimage/bzimage.h"
+#include "../loaders/bzimage/e820.h"
+
+#define MIN_DESCS	16
+#define MAX_DESCS	10000
+
+/* Firmware descriptors are usually bigger than the structure */
+#define DESC_SIZE	48
+
+/* Enough iterations at each size to keep the clock honest */
+#define WORK		(1ULL << 24)
+
+/* Keeps the conversion from being optimized away */
+static volatile UINTN sink;
+
+enum layout {
+	SORTED,		/* as firmware usually reports it */
+	SHUFFLED,	/* the same, in random order */
+	SPLIT,		/* RAM split by reserved pages, nothing merges */
+	NR_LAYOUTS,
+};
+
+static const char *layout_names[] = { "sorted", "shuffled", "split" };
+
+/*
+ * The old loop at the end of load_kernel(). The EFI build compiles it
+ * without optimization, so stop the compiler from vectorizing it.
+ */
+#define REFERENCE __attribute__((noinline, \
+	optimize("no-tree-vectorize,no-tree-loop-distribute-patterns")))
+
+static REFERENCE UINTN ref_convert(struct e820_entry *e820_map,
+				   EFI_MEMORY_DESCRIPTOR *map_buf,
+				   UINTN map_size, UINTN desc_size)
+{
+	UINTN i, j = 0;
+
+	for (i = 0; i < map_size / desc_size; i++) {
+		EFI_MEMORY_DESCRIPTOR *d;
+		unsigned int e820_type = 0;
+
+		d = (EFI_MEMORY_DESCRIPTOR *)((unsigned long)map_buf + (i * desc_size));
+		switch(d->Type) {
+		case EfiReservedMemoryType:
+		case EfiRuntimeServicesCode:
+		case EfiRuntimeServicesData:
+		case EfiMemoryMappedIO:
+		case EfiMemoryMappedIOPortSpace:
+		case EfiPalCode:
+			e820_type = E820_RESERVED;
+			break;
+
+		case EfiUnusableMemory:
+			e820_type = E820_UNUSABLE;
+			break;
+
+		case EfiACPIReclaimMemory:
+			e820_type = E820_ACPI;
+			break;
+
+		case EfiLoaderCode:
+		case EfiLoaderData:
+		case EfiBootServicesCode:
+		case EfiBootServicesData:
+		case EfiConventionalMemory:
+			e820_type = E820_RAM;
+			break;
+
+		case EfiACPIMemoryNVS:
+			e820_type = E820_NVS;
+			break;
+
+		default:
+			continue;
+		}
+
+		if (j && e820_map[j-1].type == e820_type &&
+			(e820_map[j-1].addr + e820_map[j-1].size) == d->PhysicalStart) {
+			e820_map[j-1].size += d->NumberOfPages << EFI_PAGE_SHIFT;
+		} else {
+			e820_map[j].addr = d->PhysicalStart;
+			e820_map[j].size = d->NumberOfPages << EFI_PAGE_SHIFT;
+			e820_map[j].type = e820_type;
+			j++;
+		}
+	}
+
+	return j;
+}
+
+/* Room for sorting, at least MAX_DESCS entries for check() */
+static struct e820_entry *tmp;
+
+static __attribute__((noinline)) UINTN new_convert(struct e820_entry *e820,
+						   EFI_MEMORY_DESCRIPTOR *map,
+						   UINTN nr)
+{
+	return e820_from_efi(e820, nr, tmp, map, nr * DESC_SIZE, DESC_SIZE);
+}
+
+static EFI_MEMORY_DESCRIPTOR *desc(void *map, UINTN i)
+{
+	return (EFI_MEMORY_DESCRIPTOR *)((char *)map + i * DESC_SIZE);
+}
+
+/*
+ * A map of 'nr' descriptors, mostly RAM of various kinds with some
+ * ACPI, runtime and MMIO ranges, or for SPLIT, alternating RAM and
+ * reserved pages.
+ */
+static void fill(void *map, UINTN nr, enum layout layout)
+{
+	static const UINT32 types[] = {
+		EfiConventionalMemory, EfiBootServicesData,
+		EfiConventionalMemory, EfiBootServicesCode,
+		EfiLoaderData, EfiConventionalMemory,
+		EfiACPIReclaimMemory, EfiRuntimeServicesData,
+		EfiConventionalMemory, EfiACPIMemoryNVS,
+		EfiConventionalMemory, EfiMemoryMappedIO,
+	};
+	EFI_PHYSICAL_ADDRESS addr = 1 << 20;
+	unsigned int seed = 1;
+	UINTN i;
+
+	memset(map, 0, nr * DESC_SIZE);
+
+	for (i = 0; i < nr; i++) {
+		EFI_MEMORY_DESCRIPTOR *d = desc(map, i);
+
+		if (layout == SPLIT)
+			d->Type = i & 1 ? EfiReservedMemoryType :
+				EfiConventionalMemory;
+		else
+			d->Type = types[rand_r(&seed) % 12];
+
+		d->PhysicalStart = addr;
+		d->NumberOfPages = 1 + rand_r(&seed) % 64;
+		addr += d->NumberOfPages << EFI_PAGE_SHIFT;
+	}
+
+	if (layout != SHUFFLED)
+		return;
+
+	for (i = nr - 1; i > 0; i--) {
+		UINTN j = rand_r(&seed) % (i + 1);
+		char tmp[DESC_SIZE];
+
+		memcpy(tmp, desc(map, i), DESC_SIZE);
+		memcpy(desc(map, i), desc(map, j), DESC_SIZE);
+		memcpy(desc(map, j), tmp, DESC_SIZE);
+	}
+}
+
+/*
+ * The converted map must be sorted, have no neighbours of the same
+ * type that could have been merged, and cover the same bytes of each
+ * type as the descriptors did.
+ */
+static int check_map(void *map, UINTN nr, struct e820_entry *e820,
+		     UINTN nr_e820, const char *what)
+{
+	UINT64 in[8] = { 0 }, out[8] = { 0 };
+	UINTN i;
+
+	for (i = 0; i < nr; i++) {
+		EFI_MEMORY_DESCRIPTOR *d = desc(map, i);
+		struct e820_entry e;
+
+		if (!e820_from_efi(&e, 1, tmp, d, DESC_SIZE, DESC_SIZE))
+			continue;
+		in[e.type] += e.size;
+	}
+
+	for (i = 0; i < nr_e820; i++) {
+		struct e820_entry *e = &e820[i];
+
+		out[e->type] += e->size;
+		if (!i)
+			continue;
+
+		if (e[-1].addr + e[-1].size > e->addr ||
+		    (e[-1].addr + e[-1].size == e->addr &&
+		     e[-1].type == e->type)) {
+			fprintf(stderr, "%s: entry %lu out of place\n",
+				what, (unsigned long)i);
+			return 1;
+		}
+	}
+
+	if (memcmp(in, out, sizeof(in))) {
+		fprintf(stderr, "%s: coverage differs\n", what);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int check(void)
+{
+	static const struct {
+		UINT32 type;
+		UINT64 start, pages;
+	} descs[] = {
+		{ EfiConventionalMemory, 0x300000, 1 },
+		{ EfiReservedMemoryType, 0x200000, 16 },
+		{ EfiConventionalMemory, 0x100000, 1 },
+		{ EfiBootServicesData, 0x101000, 255 },
+		{ EfiConventionalMemory, 0x301000, 1 },
+		{ EfiMaxMemoryType, 0x400000, 1 },
+	};
+	static const struct e820_entry want[] = {
+		{ 0x100000, 0x100000, E820_RAM },
+		{ 0x200000, 0x10000, E820_RESERVED },
+		{ 0x300000, 0x2000, E820_RAM },
+	};
+	char map[6 * DESC_SIZE];
+	struct e820_entry e820[6];
+	enum layout layout;
+	UINTN i, nr;
+
+	memset(map, 0, sizeof(map));
+	for (i = 0; i < 6; i++) {
+		desc(map, i)->Type = descs[i].type;
+		desc(map, i)->PhysicalStart = descs[i].start;
+		desc(map, i)->NumberOfPages = descs[i].pages;
+	}
+
+	nr = e820_from_efi(e820, 6, tmp, (void *)map, sizeof(map), DESC_SIZE);
+	if (nr != 3 || memcmp(e820, want, sizeof(want))) {
+		fprintf(stderr, "small map: wrong conversion\n");
+		return 1;
+	}
+
+	for (layout = 0; layout < NR_LAYOUTS; layout++) {
+		void *big = malloc(MAX_DESCS * DESC_SIZE);
+		struct e820_entry *out = malloc(MAX_DESCS * sizeof(*out));
+
+		fill(big, MAX_DESCS, layout);
+		nr = new_convert(out, big, MAX_DESCS);
+		if (check_map(big, MAX_DESCS, out, nr, layout_names[layout]))
+			return 1;
+
+		free(big);
+		free(out);
+	}
+
+	return 0;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	UINTN max = MAX_DESCS, nr;
+	struct e820_entry *e820;
+	enum layout layout;
+	void *map, *src;
+
+	if (argc > 1)
+		max = strtoul(argv[1], NULL, 0);
+
+	tmp = malloc((max > MAX_DESCS ? max : MAX_DESCS) * sizeof(*tmp));
+	if (!tmp)
+		return 1;
+
+	if (check())
+		return 1;
+
+	src = malloc(max * DESC_SIZE);
+	map = malloc(max * DESC_SIZE);
+	e820 = malloc(max * sizeof(*e820));
+	if (!src || !map || !e820)
+		return 1;
+
+	printf("%-9s %6s %12s %8s %12s %8s\n", "map", "descs",
+	       "new", "entries", "old", "entries");
+
+	for (layout = 0; layout < NR_LAYOUTS; layout++) {
+		for (nr = MIN_DESCS; nr <= max; nr *= 4) {
+			UINT64 iters = WORK / nr / 16 ? WORK / nr / 16 : 1;
+			UINTN n[2];
+			double t, r[2];
+			UINT64 i;
+
+			if (nr * 4 > max && nr != max)
+				nr = max;
+
+			fill(src, nr, layout);
+
+			/* Each run gets the unsorted map back */
+			t = now();
+			for (i = 0; i < iters; i++) {
+				memcpy(map, src, nr * DESC_SIZE);
+				n[0] = new_convert(e820, map, nr);
+			}
+			r[0] = (now() - t) / iters * 1e6;
+
+			t = now();
+			for (i = 0; i < iters; i++) {
+				memcpy(map, src, nr * DESC_SIZE);
+				n[1] = ref_convert(e820, map, nr * DESC_SIZE,
+						   DESC_SIZE);
+			}
+			r[1] = (now() - t) / iters * 1e6;
+			sink = n[0] + n[1];
+
+			printf("%-9s %6lu %9.1f us %8lu %9.1f us %8lu%s\n",
+			       layout_names[layout], (unsigned long)nr,
+			       r[0], (unsigned long)n[0], r[1],
+			       (unsigned long)n[1],
+			       n[1] > E820_ZEROPAGE_ENTRIES ?
+			       " (overflows)" : "");
+
+			if (nr == max)
+				break;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,587 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * A userspace stand-in for the parts of gnu-efi's <efi.h> that
+ * efilinux uses. The names and layouts follow gnu-efi so that the
+ * loader sources build unmodified against the mock firmware in
+ * host/firmware.c.
+ */
+
+#ifndef __HOST_EFI_H__
+#define __HOST_EFI_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+
+typedef uint8_t		UINT8;
+typedef uint16_t	UINT16;
+typedef uint32_t	UINT32;
+typedef uint64_t	UINT64;
+typedef int8_t		INT8;
+typedef int16_t		INT16;
+typedef int32_t		INT32;
+typedef int64_t		INT64;
+typedef uint64_t	UINTN;
+typedef int64_t		INTN;
+
+typedef UINT8		BOOLEAN;
+typedef UINT8		CHAR8;
+typedef UINT16		CHAR16;
+typedef CHAR16		WCHAR;
+typedef void		VOID;
+
+typedef UINTN		EFI_STATUS;
+typedef void		*EFI_HANDLE;
+typedef void		*EFI_EVENT;
+typedef UINTN		EFI_TPL;
+typedef UINT64		EFI_LBA;
+typedef UINT64		EFI_PHYSICAL_ADDRESS;
+typedef UINT64		EFI_VIRTUAL_ADDRESS;
+
+#define TRUE		((BOOLEAN)1)
+#define FALSE		((BOOLEAN)0)
+
+#ifndef NULL
+#define NULL		((void *)0)
+#endif
+
+#define IN
+#define OUT
+#define OPTIONAL
+#define CONST		const
+#define EFIAPI		__attribute__((ms_abi))
+
+/* The mock firmware uses the host calling convention throughout */
+#define uefi_call_wrapper(func, va_num, ...)	((func)(__VA_ARGS__))
+
+typedef struct {
+	UINT32 Data1;
+	UINT16 Data2;
+	UINT16 Data3;
+	UINT8 Data4[8];
+} EFI_GUID;
+
+/*
+ * Status codes
+ */
+#define EFI_MAX_BIT		0x8000000000000000ULL
+#define EFIERR(a)		(EFI_MAX_BIT | (a))
+#define EFI_ERROR(a)		(((INTN)(a)) < 0)
+
+#define EFI_SUCCESS			0
+#define EFI_LOAD_ERROR			EFIERR(1)
+#define EFI_INVALID_PARAMETER		EFIERR(2)
+#define EFI_UNSUPPORTED			EFIERR(3)
+#define EFI_BAD_BUFFER_SIZE		EFIERR(4)
+#define EFI_BUFFER_TOO_SMALL		EFIERR(5)
+#define EFI_NOT_READY			EFIERR(6)
+#define EFI_DEVICE_ERROR		EFIERR(7)
+#define EFI_WRITE_PROTECTED		EFIERR(8)
+#define EFI_OUT_OF_RESOURCES		EFIERR(9)
+#define EFI_VOLUME_CORRUPTED		EFIERR(10)
+#define EFI_VOLUME_FULL			EFIERR(11)
+#define EFI_NO_MEDIA			EFIERR(12)
+#define EFI_MEDIA_CHANGED		EFIERR(13)
+#define EFI_NOT_FOUND			EFIERR(14)
+#define EFI_ACCESS_DENIED		EFIERR(15)
+#define EFI_NO_RESPONSE			EFIERR(16)
+#define EFI_NO_MAPPING			EFIERR(17)
+#define EFI_TIMEOUT			EFIERR(18)
+#define EFI_NOT_STARTED			EFIERR(19)
+#define EFI_ALREADY_STARTED		EFIERR(20)
+#define EFI_ABORTED			EFIERR(21)
+#define EFI_ICMP_ERROR			EFIERR(22)
+#define EFI_TFTP_ERROR			EFIERR(23)
+#define EFI_PROTOCOL_ERROR		EFIERR(24)
+#define EFI_INCOMPATIBLE_VERSION	EFIERR(25)
+#define EFI_SECURITY_VIOLATION		EFIERR(26)
+#define EFI_CRC_ERROR			EFIERR(27)
+#define EFI_END_OF_MEDIA		EFIERR(28)
+#define EFI_END_OF_FILE			EFIERR(31)
+
+/*
+ * Memory
+ */
+#define EFI_PAGE_SIZE		4096
+#define EFI_PAGE_MASK		0xFFF
+#define EFI_PAGE_SHIFT		12
+
+#define EFI_SIZE_TO_PAGES(a)	\
+	(((a) >> EFI_PAGE_SHIFT) + ((a) & EFI_PAGE_MASK ? 1 : 0))
+
+typedef enum {
+	AllocateAnyPages,
+	AllocateMaxAddress,
+	AllocateAddress,
+	MaxAllocateType
+} EFI_ALLOCATE_TYPE;
+
+typedef enum {
+	EfiReservedMemoryType,
+	EfiLoaderCode,
+	EfiLoaderData,
+	EfiBootServicesCode,
+	EfiBootServicesData,
+	EfiRuntimeServicesCode,
+	EfiRuntimeServicesData,
+	EfiConventionalMemory,
+	EfiUnusableMemory,
+	EfiACPIReclaimMemory,
+	EfiACPIMemoryNVS,
+	EfiMemoryMappedIO,
+	EfiMemoryMappedIOPortSpace,
+	EfiPalCode,
+	EfiPersistentMemory,
+	EfiMaxMemoryType
+} EFI_MEMORY_TYPE;
+
+#define EFI_MEMORY_UC		0x0000000000000001ULL
+#define EFI_MEMORY_WC		0x0000000000000002ULL
+#define EFI_MEMORY_WT		0x0000000000000004ULL
+#define EFI_MEMORY_WB		0x0000000000000008ULL
+#define EFI_MEMORY_UCE		0x0000000000000010ULL
+#define EFI_MEMORY_WP		0x0000000000001000ULL
+#define EFI_MEMORY_RP		0x0000000000002000ULL
+#define EFI_MEMORY_XP		0x0000000000004000ULL
+#define EFI_MEMORY_SP		0x0000000000040000ULL
+#define EFI_MEMORY_RUNTIME	0x8000000000000000ULL
+
+#define EFI_MEMORY_DESCRIPTOR_VERSION	1
+
+typedef struct {
+	UINT32 Type;
+	UINT32 Pad;
+	EFI_PHYSICAL_ADDRESS PhysicalStart;
+	EFI_VIRTUAL_ADDRESS VirtualStart;
+	UINT64 NumberOfPages;
+	UINT64 Attribute;
+} EFI_MEMORY_DESCRIPTOR;
+
+typedef enum {
+	AllHandles,
+	ByRegisterNotify,
+	ByProtocol
+} EFI_LOCATE_SEARCH_TYPE;
+
+typedef struct {
+	UINT16 Year;
+	UINT8 Month;
+	UINT8 Day;
+	UINT8 Hour;
+	UINT8 Minute;
+	UINT8 Second;
+	UINT8 Pad1;
+	UINT32 Nanosecond;
+	INT16 TimeZone;
+	UINT8 Daylight;
+	UINT8 Pad2;
+} EFI_TIME;
+
+/*
+ * Device paths
+ */
+typedef struct _EFI_DEVICE_PATH {
+	UINT8 Type;
+	UINT8 SubType;
+	UINT8 Length[2];
+} EFI_DEVICE_PATH;
+
+typedef EFI_DEVICE_PATH EFI_DEVICE_PATH_PROTOCOL;
+
+/*
+ * Tables
+ */
+typedef struct {
+	UINT64 Signature;
+	UINT32 Revision;
+	UINT32 HeaderSize;
+	UINT32 CRC32;
+	UINT32 Reserved;
+} EFI_TABLE_HEADER;
+
+typedef struct {
+	EFI_GUID VendorGuid;
+	VOID *VendorTable;
+} EFI_CONFIGURATION_TABLE;
+
+/*
+ * Console output
+ */
+struct _SIMPLE_TEXT_OUTPUT_INTERFACE;
+
+typedef EFI_STATUS (*EFI_TEXT_STRING)(
+	struct _SIMPLE_TEXT_OUTPUT_INTERFACE *This, CHAR16 *String);
+
+typedef struct _SIMPLE_TEXT_OUTPUT_INTERFACE {
+	VOID *Reset;
+	EFI_TEXT_STRING OutputString;
+	VOID *TestString;
+	VOID *QueryMode;
+	VOID *SetMode;
+	VOID *SetAttribute;
+	VOID *ClearScreen;
+	VOID *SetCursorPosition;
+	VOID *EnableCursor;
+	VOID *Mode;
+} SIMPLE_TEXT_OUTPUT_INTERFACE, EFI_SIMPLE_TEXT_OUT_PROTOCOL;
+
+/*
+ * Boot services
+ */
+typedef EFI_STATUS (*EFI_ALLOCATE_PAGES)(EFI_ALLOCATE_TYPE Type,
+	EFI_MEMORY_TYPE MemoryType, UINTN NoPages,
+	EFI_PHYSICAL_ADDRESS *Memory);
+typedef EFI_STATUS (*EFI_FREE_PAGES)(EFI_PHYSICAL_ADDRESS Memory,
+	UINTN NoPages);
+typedef EFI_STATUS (*EFI_GET_MEMORY_MAP)(UINTN *MemoryMapSize,
+	EFI_MEMORY_DESCRIPTOR *MemoryMap, UINTN *MapKey,
+	UINTN *DescriptorSize, UINT32 *DescriptorVersion);
+typedef EFI_STATUS (*EFI_ALLOCATE_POOL)(EFI_MEMORY_TYPE PoolType,
+	UINTN Size, VOID **Buffer);
+typedef EFI_STATUS (*EFI_FREE_POOL)(VOID *Buffer);
+typedef EFI_STATUS (*EFI_HANDLE_PROTOCOL)(EFI_HANDLE Handle,
+	EFI_GUID *Protocol, VOID **Interface);
+typedef EFI_STATUS (*EFI_LOCATE_HANDLE)(EFI_LOCATE_SEARCH_TYPE SearchType,
+	EFI_GUID *Protocol, VOID *SearchKey, UINTN *BufferSize,
+	EFI_HANDLE *Buffer);
+typedef EFI_STATUS (*EFI_LOCATE_PROTOCOL)(EFI_GUID *Protocol,
+	VOID *Registration, VOID **Interface);
+typedef EFI_STATUS (*EFI_EXIT)(EFI_HANDLE ImageHandle,
+	EFI_STATUS ExitStatus, UINTN ExitDataSize, CHAR16 *ExitData);
+typedef EFI_STATUS (*EFI_EXIT_BOOT_SERVICES)(EFI_HANDLE ImageHandle,
+	UINTN MapKey);
+typedef EFI_STATUS (*EFI_STALL)(UINTN Microseconds);
+
+#define TPL_APPLICATION	4
+#define TPL_CALLBACK	8
+#define TPL_NOTIFY	16
+
+typedef void (*EFI_EVENT_NOTIFY)(EFI_EVENT Event, VOID *Context);
+typedef EFI_STATUS (*EFI_CREATE_EVENT)(UINT32 Type, EFI_TPL NotifyTpl,
+	EFI_EVENT_NOTIFY NotifyFunction, VOID *NotifyContext,
+	EFI_EVENT *Event);
+typedef EFI_STATUS (*EFI_WAIT_FOR_EVENT)(UINTN NumberOfEvents,
+	EFI_EVENT *Event, UINTN *Index);
+typedef EFI_STATUS (*EFI_SIGNAL_EVENT)(EFI_EVENT Event);
+typedef EFI_STATUS (*EFI_CLOSE_EVENT)(EFI_EVENT Event);
+typedef EFI_STATUS (*EFI_CHECK_EVENT)(EFI_EVENT Event);
+
+typedef struct {
+	EFI_TABLE_HEADER Hdr;
+
+	VOID *RaiseTPL;
+	VOID *RestoreTPL;
+
+	EFI_ALLOCATE_PAGES AllocatePages;
+	EFI_FREE_PAGES FreePages;
+	EFI_GET_MEMORY_MAP GetMemoryMap;
+	EFI_ALLOCATE_POOL AllocatePool;
+	EFI_FREE_POOL FreePool;
+
+	EFI_CREATE_EVENT CreateEvent;
+	VOID *SetTimer;
+	EFI_WAIT_FOR_EVENT WaitForEvent;
+	EFI_SIGNAL_EVENT SignalEvent;
+	EFI_CLOSE_EVENT CloseEvent;
+	EFI_CHECK_EVENT CheckEvent;
+
+	VOID *InstallProtocolInterface;
+	VOID *ReinstallProtocolInterface;
+	VOID *UninstallProtocolInterface;
+	EFI_HANDLE_PROTOCOL HandleProtocol;
+	EFI_HANDLE_PROTOCOL PCHandleProtocol;
+	VOID *RegisterProtocolNotify;
+	EFI_LOCATE_HANDLE LocateHandle;
+	VOID *LocateDevicePath;
+	VOID *InstallConfigurationTable;
+
+	VOID *LoadImage;
+	VOID *StartImage;
+	EFI_EXIT Exit;
+	VOID *UnloadImage;
+	EFI_EXIT_BOOT_SERVICES ExitBootServices;
+
+	VOID *GetNextMonotonicCount;
+	EFI_STALL Stall;
+	VOID *SetWatchdogTimer;
+
+	VOID *ConnectController;
+	VOID *DisconnectController;
+
+	VOID *OpenProtocol;
+	VOID *CloseProtocol;
+	VOID *OpenProtocolInformation;
+
+	VOID *ProtocolsPerHandle;
+	VOID *LocateHandleBuffer;
+	EFI_LOCATE_PROTOCOL LocateProtocol;
+	VOID *InstallMultipleProtocolInterfaces;
+	VOID *UninstallMultipleProtocolInterfaces;
+
+	VOID *CalculateCrc32;
+
+	VOID *CopyMem;
+	VOID *SetMem;
+	VOID *CreateEventEx;
+} EFI_BOOT_SERVICES;
+
+typedef struct {
+	EFI_TABLE_HEADER Hdr;
+	VOID *GetTime;
+	VOID *SetTime;
+	VOID *GetWakeupTime;
+	VOID *SetWakeupTime;
+	VOID *SetVirtualAddressMap;
+	VOID *ConvertPointer;
+	VOID *GetVariable;
+	VOID *GetNextVariableName;
+	VOID *SetVariable;
+	VOID *GetNextHighMonotonicCount;
+	VOID *ResetSystem;
+} EFI_RUNTIME_SERVICES;
+
+typedef struct _EFI_SYSTEM_TABLE {
+	EFI_TABLE_HEADER Hdr;
+
+	CHAR16 *FirmwareVendor;
+	UINT32 FirmwareRevision;
+
+	EFI_HANDLE ConsoleInHandle;
+	VOID *ConIn;
+
+	EFI_HANDLE ConsoleOutHandle;
+	SIMPLE_TEXT_OUTPUT_INTERFACE *ConOut;
+
+	EFI_HANDLE StandardErrorHandle;
+	SIMPLE_TEXT_OUTPUT_INTERFACE *StdErr;
+
+	EFI_RUNTIME_SERVICES *RuntimeServices;
+	EFI_BOOT_SERVICES *BootServices;
+
+	UINTN NumberOfTableEntries;
+	EFI_CONFIGURATION_TABLE *ConfigurationTable;
+} EFI_SYSTEM_TABLE;
+
+/*
+ * Loaded image protocol
+ */
+typedef struct {
+	UINT32 Revision;
+	EFI_HANDLE ParentHandle;
+	struct _EFI_SYSTEM_TABLE *SystemTable;
+
+	EFI_HANDLE DeviceHandle;
+	EFI_DEVICE_PATH *FilePath;
+	VOID *Reserved;
+
+	UINT32 LoadOptionsSize;
+	VOID *LoadOptions;
+
+	VOID *ImageBase;
+	UINT64 ImageSize;
+	EFI_MEMORY_TYPE ImageCodeType;
+	EFI_MEMORY_TYPE ImageDataType;
+
+	VOID *Unload;
+} EFI_LOADED_IMAGE;
+
+/*
+ * File protocols
+ */
+#define EFI_FILE_MODE_READ	0x0000000000000001ULL
+#define EFI_FILE_MODE_WRITE	0x0000000000000002ULL
+#define EFI_FILE_MODE_CREATE	0x8000000000000000ULL
+
+#define EFI_FILE_DIRECTORY	0x0000000000000010ULL
+
+#define EFI_FILE_PROTOCOL_REVISION	0x00010000
+#define EFI_FILE_PROTOCOL_REVISION2	0x00020000
+
+typedef struct {
+	EFI_EVENT Event;
+	EFI_STATUS Status;
+	UINTN BufferSize;
+	VOID *Buffer;
+} EFI_FILE_IO_TOKEN;
+
+struct _EFI_FILE_HANDLE;
+
+typedef EFI_STATUS (*EFI_FILE_OPEN)(struct _EFI_FILE_HANDLE *File,
+	struct _EFI_FILE_HANDLE **NewHandle, CHAR16 *FileName,
+	UINT64 OpenMode, UINT64 Attributes);
+typedef EFI_STATUS (*EFI_FILE_CLOSE)(struct _EFI_FILE_HANDLE *File);
+typedef EFI_STATUS (*EFI_FILE_READ)(struct _EFI_FILE_HANDLE *File,
+	UINTN *BufferSize, VOID *Buffer);
+typedef EFI_STATUS (*EFI_FILE_GET_POSITION)(struct _EFI_FILE_HANDLE *File,
+	UINT64 *Position);
+typedef EFI_STATUS (*EFI_FILE_SET_POSITION)(struct _EFI_FILE_HANDLE *File,
+	UINT64 Position);
+typedef EFI_STATUS (*EFI_FILE_GET_INFO)(struct _EFI_FILE_HANDLE *File,
+	EFI_GUID *InformationType, UINTN *BufferSize, VOID *Buffer);
+typedef EFI_STATUS (*EFI_FILE_OPEN_EX)(struct _EFI_FILE_HANDLE *File,
+	struct _EFI_FILE_HANDLE **NewHandle, CHAR16 *FileName,
+	UINT64 OpenMode, UINT64 Attributes, EFI_FILE_IO_TOKEN *Token);
+typedef EFI_STATUS (*EFI_FILE_READ_EX)(struct _EFI_FILE_HANDLE *File,
+	EFI_FILE_IO_TOKEN *Token);
+
+typedef struct _EFI_FILE_HANDLE {
+	UINT64 Revision;
+	EFI_FILE_OPEN Open;
+	EFI_FILE_CLOSE Close;
+	VOID *Delete;
+	EFI_FILE_READ Read;
+	VOID *Write;
+	EFI_FILE_GET_POSITION GetPosition;
+	EFI_FILE_SET_POSITION SetPosition;
+	EFI_FILE_GET_INFO GetInfo;
+	VOID *SetInfo;
+	VOID *Flush;
+	EFI_FILE_OPEN_EX OpenEx;
+	EFI_FILE_READ_EX ReadEx;
+	VOID *WriteEx;
+	VOID *FlushEx;
+} EFI_FILE, *EFI_FILE_HANDLE, EFI_FILE_PROTOCOL;
+
+typedef struct {
+	UINT64 Size;
+	UINT64 FileSize;
+	UINT64 PhysicalSize;
+	EFI_TIME CreateTime;
+	EFI_TIME LastAccessTime;
+	EFI_TIME ModificationTime;
+	UINT64 Attribute;
+	CHAR16 FileName[1];
+} EFI_FILE_INFO;
+
+struct _EFI_FILE_IO_INTERFACE;
+
+typedef EFI_STATUS (*EFI_VOLUME_OPEN)(struct _EFI_FILE_IO_INTERFACE *This,
+	EFI_FILE_HANDLE *Root);
+
+typedef struct _EFI_FILE_IO_INTERFACE {
+	UINT64 Revision;
+	EFI_VOLUME_OPEN OpenVolume;
+} EFI_FILE_IO_INTERFACE, EFI_SIMPLE_FILE_SYSTEM_PROTOCOL;
+
+/*
+ * Block and disk I/O protocols
+ */
+typedef struct {
+	UINT32 MediaId;
+	BOOLEAN RemovableMedia;
+	BOOLEAN MediaPresent;
+	BOOLEAN LogicalPartition;
+	BOOLEAN ReadOnly;
+	BOOLEAN WriteCaching;
+	UINT32 BlockSize;
+	UINT32 IoAlign;
+	EFI_LBA LastBlock;
+} EFI_BLOCK_IO_MEDIA;
+
+struct _EFI_BLOCK_IO;
+
+typedef EFI_STATUS (*EFI_BLOCK_READ)(struct _EFI_BLOCK_IO *This,
+	UINT32 MediaId, EFI_LBA LBA, UINTN BufferSize, VOID *Buffer);
+
+typedef struct _EFI_BLOCK_IO {
+	UINT64 Revision;
+	EFI_BLOCK_IO_MEDIA *Media;
+	VOID *Reset;
+	EFI_BLOCK_READ ReadBlocks;
+	VOID *WriteBlocks;
+	VOID *FlushBlocks;
+} EFI_BLOCK_IO;
+
+struct _EFI_DISK_IO;
+
+typedef EFI_STATUS (*EFI_DISK_READ)(struct _EFI_DISK_IO *This,
+	UINT32 MediaId, UINT64 Offset, UINTN BufferSize, VOID *Buffer);
+
+typedef struct _EFI_DISK_IO {
+	UINT64 Revision;
+	EFI_DISK_READ ReadDisk;
+	VOID *WriteDisk;
+} EFI_DISK_IO;
+
+/*
+ * Graphics output protocol
+ */
+#define EFI_GRAPHICS_OUTPUT_PROTOCOL_GUID \
+	{ 0x9042a9de, 0x23dc, 0x4a38, \
+	  { 0x96, 0xfb, 0x7a, 0xde, 0xd0, 0x80, 0x51, 0x6a } }
+
+typedef struct {
+	UINT32 RedMask;
+	UINT32 GreenMask;
+	UINT32 BlueMask;
+	UINT32 ReservedMask;
+} EFI_PIXEL_BITMASK;
+
+typedef enum {
+	PixelRedGreenBlueReserved8BitPerColor,
+	PixelBlueGreenRedReserved8BitPerColor,
+	PixelBitMask,
+	PixelBltOnly,
+	PixelFormatMax
+} EFI_GRAPHICS_PIXEL_FORMAT;
+
+typedef struct {
+	UINT32 Version;
+	UINT32 HorizontalResolution;
+	UINT32 VerticalResolution;
+	EFI_GRAPHICS_PIXEL_FORMAT PixelFormat;
+	EFI_PIXEL_BITMASK PixelInformation;
+	UINT32 PixelsPerScanLine;
+} EFI_GRAPHICS_OUTPUT_MODE_INFORMATION;
+
+typedef struct {
+	UINT32 MaxMode;
+	UINT32 Mode;
+	EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *Info;
+	UINTN SizeOfInfo;
+	EFI_PHYSICAL_ADDRESS FrameBufferBase;
+	UINTN FrameBufferSize;
+} EFI_GRAPHICS_OUTPUT_PROTOCOL_MODE;
+
+struct _EFI_GRAPHICS_OUTPUT_PROTOCOL;
+
+typedef EFI_STATUS (*EFI_GRAPHICS_OUTPUT_PROTOCOL_QUERY_MODE)(
+	struct _EFI_GRAPHICS_OUTPUT_PROTOCOL *This, UINT32 ModeNumber,
+	UINTN *SizeOfInfo, EFI_GRAPHICS_OUTPUT_MODE_INFORMATION **Info);
+typedef EFI_STATUS (*EFI_GRAPHICS_OUTPUT_PROTOCOL_SET_MODE)(
+	struct _EFI_GRAPHICS_OUTPUT_PROTOCOL *This, UINT32 ModeNumber);
+
+typedef struct _EFI_GRAPHICS_OUTPUT_PROTOCOL {
+	EFI_GRAPHICS_OUTPUT_PROTOCOL_QUERY_MODE QueryMode;
+	EFI_GRAPHICS_OUTPUT_PROTOCOL_SET_MODE SetMode;
+	VOID *Blt;
+	EFI_GRAPHICS_OUTPUT_PROTOCOL_MODE *Mode;
+} EFI_GRAPHICS_OUTPUT_PROTOCOL;
+
+#endif /* __HOST_EFI_H__ */
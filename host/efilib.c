@@ -0,0 +1,509 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Just enough of gnu-efi's library for efilinux. Everything that
+ * gnu-efi implements with firmware calls goes through the mock boot
+ * services so that the calls are counted.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "efi.h"
+#include "efilib.h"
+#include "mock.h"
+
+EFI_SYSTEM_TABLE *ST;
+EFI_BOOT_SERVICES *BS;
+EFI_RUNTIME_SERVICES *RT;
+
+EFI_GUID LoadedImageProtocol = { 0x5b1b31a1, 0x9562, 0x11d2,
+	{ 0x8e, 0x3f, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID FileSystemProtocol = { 0x964e5b22, 0x6459, 0x11d2,
+	{ 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID BlockIoProtocol = { 0x964e5b21, 0x6459, 0x11d2,
+	{ 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID DiskIoProtocol = { 0xce345171, 0xba0b, 0x11d2,
+	{ 0x8e, 0x4f, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID GenericFileInfo = { 0x09576e92, 0x6d3f, 0x11d2,
+	{ 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID DevicePathProtocol = { 0x09576e91, 0x6d3f, 0x11d2,
+	{ 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID AcpiTableGuid = { 0xeb9d2d30, 0x2d88, 0x11d3,
+	{ 0x9a, 0x16, 0x00, 0x90, 0x27, 0x3f, 0xc1, 0x4d } };
+EFI_GUID Acpi20TableGuid = { 0x8868e871, 0xe4f1, 0x11d3,
+	{ 0xbc, 0x22, 0x00, 0x80, 0xc7, 0x3c, 0x88, 0x81 } };
+
+void InitializeLib(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable)
+{
+	ST = SystemTable;
+	BS = SystemTable->BootServices;
+	RT = SystemTable->RuntimeServices;
+}
+
+BOOLEAN CheckCrc(UINTN MaxSize, EFI_TABLE_HEADER *Hdr)
+{
+	return Hdr->HeaderSize <= MaxSize;
+}
+
+/*
+ * Formatted output, following gnu-efi's conventions: %s is a CHAR16
+ * string, %a is an ASCII string and integers are 32 bits wide unless
+ * prefixed with 'l'.
+ */
+struct writer {
+	CHAR16 *buf;
+	UINTN size;		/* in characters, including the NUL */
+	UINTN len;
+	BOOLEAN flush;
+	UINTN total;
+};
+
+static void flush(struct writer *w)
+{
+	w->buf[w->len] = 0;
+	if (w->flush && w->len)
+		ST->ConOut->OutputString(ST->ConOut, w->buf);
+	w->len = 0;
+}
+
+static void put(struct writer *w, CHAR16 c)
+{
+	w->total++;
+
+	if (w->len + 1 >= w->size) {
+		if (!w->flush)
+			return;
+		flush(w);
+	}
+
+	w->buf[w->len++] = c;
+}
+
+static void put_padded(struct writer *w, const char *s, int width,
+		       BOOLEAN left, char pad)
+{
+	int len = strlen(s);
+
+	if (!left) {
+		for (; len < width; width--)
+			put(w, pad);
+	}
+
+	while (*s)
+		put(w, *s++);
+
+	if (left) {
+		for (; len < width; width--)
+			put(w, ' ');
+	}
+}
+
+static const char *status_str(EFI_STATUS status)
+{
+	static const char *errors[] = {
+		"Success", "Load Error", "Invalid Parameter", "Unsupported",
+		"Bad Buffer Size", "Buffer Too Small", "Not Ready",
+		"Device Error", "Write Protected", "Out of Resources",
+		"Volume Corrupt", "Volume Full", "No Media", "Media changed",
+		"Not Found", "Access Denied", "No Response", "No mapping",
+		"Time out", "Not started", "Already started", "Aborted",
+		"ICMP Error", "TFTP Error", "Protocol Error",
+		"Incompatible Version", "Security Violation", "CRC Error",
+		"End of Media", "Reserved (29)", "Reserved (30)",
+		"End of File",
+	};
+	UINTN code = status & ~EFI_MAX_BIT;
+
+	if (code < sizeof(errors) / sizeof(errors[0]))
+		return errors[code];
+
+	return "Unknown";
+}
+
+static void format(struct writer *w, const CHAR16 *fmt, va_list args)
+{
+	char num[64];
+
+	for (; *fmt; fmt++) {
+		BOOLEAN left = FALSE, is_long = FALSE;
+		char pad = ' ';
+		int width = 0;
+		UINT64 v;
+
+		if (*fmt != '%') {
+			put(w, *fmt);
+			continue;
+		}
+
+		fmt++;
+		for (;; fmt++) {
+			if (*fmt == '-')
+				left = TRUE;
+			else if (*fmt == '0')
+				pad = '0';
+			else if (*fmt == ',')
+				;
+			else
+				break;
+		}
+
+		if (*fmt == '*') {
+			width = va_arg(args, int);
+			fmt++;
+		}
+		while (*fmt >= '0' && *fmt <= '9')
+			width = width * 10 + *fmt++ - '0';
+
+		/* Precision is accepted and ignored */
+		if (*fmt == '.') {
+			fmt++;
+			while ((*fmt >= '0' && *fmt <= '9') || *fmt == '*')
+				fmt++;
+		}
+
+		while (*fmt == 'l') {
+			is_long = TRUE;
+			fmt++;
+		}
+
+		switch (*fmt) {
+		case 'a': {
+			const char *s = va_arg(args, const char *);
+
+			put_padded(w, s ? s : "(null)", width, left, ' ');
+			break;
+		}
+		case 's': {
+			const CHAR16 *s = va_arg(args, const CHAR16 *);
+			char buf[512];
+			int i;
+
+			if (!s)
+				s = (const CHAR16 *)L"(null)";
+			for (i = 0; s[i] && i < sizeof(buf) - 1; i++)
+				buf[i] = s[i] < 0x80 ? s[i] : '?';
+			buf[i] = '\0';
+			put_padded(w, buf, width, left, ' ');
+			break;
+		}
+		case 'c':
+			put(w, (CHAR16)va_arg(args, int));
+			break;
+		case 'd':
+			if (is_long)
+				snprintf(num, sizeof(num), "%lld",
+					 (long long)va_arg(args, INT64));
+			else
+				snprintf(num, sizeof(num), "%d",
+					 va_arg(args, INT32));
+			put_padded(w, num, width, left, pad);
+			break;
+		case 'u':
+			v = is_long ? va_arg(args, UINT64) :
+				va_arg(args, UINT32);
+			snprintf(num, sizeof(num), "%llu",
+				 (unsigned long long)v);
+			put_padded(w, num, width, left, pad);
+			break;
+		case 'X':
+			width = is_long ? 16 : 8;
+			pad = '0';
+			/* fall through */
+		case 'x':
+			v = is_long ? va_arg(args, UINT64) :
+				va_arg(args, UINT32);
+			snprintf(num, sizeof(num), "%llx",
+				 (unsigned long long)v);
+			put_padded(w, num, width, left, pad);
+			break;
+		case 'p':
+			snprintf(num, sizeof(num), "%llx",
+				 (unsigned long long)(UINTN)
+				 va_arg(args, void *));
+			put_padded(w, num, 16, FALSE, '0');
+			break;
+		case 'r':
+			put_padded(w, status_str(va_arg(args, EFI_STATUS)),
+				   width, left, ' ');
+			break;
+		case 'N':
+		case 'H':
+		case 'E':
+		case 'B':
+		case 'V':
+			/* Colour attributes */
+			break;
+		case '%':
+			put(w, '%');
+			break;
+		default:
+			put(w, '?');
+			break;
+		}
+	}
+}
+
+UINTN Print(const CHAR16 *fmt, ...)
+{
+	CHAR16 buf[256];
+	struct writer w = { buf, sizeof(buf) / sizeof(buf[0]), 0, TRUE, 0 };
+	va_list args;
+
+	va_start(args, fmt);
+	format(&w, fmt, args);
+	va_end(args);
+
+	flush(&w);
+	return w.total;
+}
+
+UINTN VSPrint(CHAR16 *Str, UINTN StrSize, const CHAR16 *fmt, va_list args)
+{
+	struct writer w = { Str, StrSize / sizeof(CHAR16), 0, FALSE, 0 };
+
+	if (!w.size)
+		return 0;
+
+	format(&w, fmt, args);
+	Str[w.len] = 0;
+	return w.len;
+}
+
+UINTN SPrint(CHAR16 *Str, UINTN StrSize, const CHAR16 *fmt, ...)
+{
+	va_list args;
+	UINTN len;
+
+	va_start(args, fmt);
+	len = VSPrint(Str, StrSize, fmt, args);
+	va_end(args);
+
+	return len;
+}
+
+void StatusToString(CHAR16 *Buffer, EFI_STATUS Status)
+{
+	const char *s = status_str(Status);
+
+	while (*s)
+		*Buffer++ = *s++;
+	*Buffer = 0;
+}
+
+/*
+ * Strings
+ */
+UINTN StrLen(const CHAR16 *s1)
+{
+	UINTN len;
+
+	for (len = 0; s1[len]; len++)
+		;
+
+	return len;
+}
+
+void StrCpy(CHAR16 *Dest, const CHAR16 *Src)
+{
+	while ((*Dest++ = *Src++))
+		;
+}
+
+INTN StrCmp(const CHAR16 *s1, const CHAR16 *s2)
+{
+	while (*s1 && *s1 == *s2) {
+		s1++;
+		s2++;
+	}
+
+	return *s1 - *s2;
+}
+
+static CHAR16 upper(CHAR16 c)
+{
+	return (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c;
+}
+
+INTN StriCmp(const CHAR16 *s1, const CHAR16 *s2)
+{
+	while (*s1 && upper(*s1) == upper(*s2)) {
+		s1++;
+		s2++;
+	}
+
+	return upper(*s1) - upper(*s2);
+}
+
+UINTN Atoi(const CHAR16 *str)
+{
+	UINTN v = 0;
+
+	while (*str == ' ')
+		str++;
+
+	for (; *str >= '0' && *str <= '9'; str++)
+		v = v * 10 + *str - '0';
+
+	return v;
+}
+
+UINTN xtoi(const CHAR16 *str)
+{
+	UINTN v = 0;
+
+	while (*str == ' ')
+		str++;
+
+	if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X'))
+		str += 2;
+
+	for (;; str++) {
+		CHAR16 c = upper(*str);
+
+		if (c >= '0' && c <= '9')
+			v = (v << 4) | (c - '0');
+		else if (c >= 'A' && c <= 'F')
+			v = (v << 4) | (c - 'A' + 10);
+		else
+			break;
+	}
+
+	return v;
+}
+
+UINTN strlena(const CHAR8 *s1)
+{
+	return strlen((const char *)s1);
+}
+
+UINTN strncmpa(const CHAR8 *s1, const CHAR8 *s2, UINTN len)
+{
+	return strncmp((const char *)s1, (const char *)s2, len);
+}
+
+/*
+ * Memory
+ */
+INTN CompareGuid(EFI_GUID *Guid1, EFI_GUID *Guid2)
+{
+	return memcmp(Guid1, Guid2, sizeof(*Guid1));
+}
+
+void CopyMem(VOID *Dest, const VOID *Src, UINTN len)
+{
+	memmove(Dest, Src, len);
+}
+
+void ZeroMem(VOID *Buffer, UINTN Size)
+{
+	memset(Buffer, 0, Size);
+}
+
+VOID *AllocatePool(UINTN Size)
+{
+	VOID *p;
+
+	if (BS->AllocatePool(EfiBootServicesData, Size, &p) != EFI_SUCCESS)
+		return NULL;
+
+	return p;
+}
+
+VOID *AllocateZeroPool(UINTN Size)
+{
+	VOID *p = AllocatePool(Size);
+
+	if (p)
+		memset(p, 0, Size);
+
+	return p;
+}
+
+void FreePool(VOID *p)
+{
+	BS->FreePool(p);
+}
+
+/*
+ * Protocol helpers
+ */
+EFI_FILE_INFO *LibFileInfo(EFI_FILE_HANDLE FHand)
+{
+	EFI_FILE_INFO *info;
+	EFI_STATUS err;
+	UINTN size;
+
+	size = sizeof(EFI_FILE_INFO) + 200;
+	for (;;) {
+		info = AllocatePool(size);
+		if (!info)
+			return NULL;
+
+		err = FHand->GetInfo(FHand, &GenericFileInfo, &size, info);
+		if (err == EFI_SUCCESS)
+			return info;
+
+		FreePool(info);
+		if (err != EFI_BUFFER_TOO_SMALL)
+			return NULL;
+	}
+}
+
+EFI_DEVICE_PATH *DevicePathFromHandle(EFI_HANDLE Handle)
+{
+	EFI_DEVICE_PATH *dp;
+
+	if (BS->HandleProtocol(Handle, &DevicePathProtocol,
+			       (VOID **)&dp) != EFI_SUCCESS)
+		return NULL;
+
+	return dp;
+}
+
+CHAR16 *DevicePathToStr(EFI_DEVICE_PATH *DevPath)
+{
+	struct mock_devpath *dp = (struct mock_devpath *)DevPath;
+	CHAR16 *str;
+	UINTN i, len;
+
+	len = strlen(dp->text);
+	str = AllocatePool((len + 1) * sizeof(CHAR16));
+	if (!str)
+		return NULL;
+
+	for (i = 0; i <= len; i++)
+		str[i] = dp->text[i];
+
+	return str;
+}
+
+EFI_STATUS LibLocateProtocol(EFI_GUID *ProtocolGuid, VOID **Interface)
+{
+	return BS->LocateProtocol(ProtocolGuid, NULL, Interface);
+}
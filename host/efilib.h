@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The subset of gnu-efi's library that efilinux calls, implemented
+ * in host/efilib.c on top of the mock firmware.
+ */
+
+#ifndef __HOST_EFILIB_H__
+#define __HOST_EFILIB_H__
+
+extern EFI_SYSTEM_TABLE *ST;
+extern EFI_BOOT_SERVICES *BS;
+extern EFI_RUNTIME_SERVICES *RT;
+
+extern EFI_GUID LoadedImageProtocol;
+extern EFI_GUID FileSystemProtocol;
+extern EFI_GUID BlockIoProtocol;
+extern EFI_GUID DiskIoProtocol;
+extern EFI_GUID GenericFileInfo;
+extern EFI_GUID DevicePathProtocol;
+extern EFI_GUID AcpiTableGuid;
+extern EFI_GUID Acpi20TableGuid;
+
+extern void InitializeLib(EFI_HANDLE ImageHandle,
+			  EFI_SYSTEM_TABLE *SystemTable);
+extern BOOLEAN CheckCrc(UINTN MaxSize, EFI_TABLE_HEADER *Hdr);
+
+extern UINTN Print(const CHAR16 *fmt, ...);
+extern UINTN SPrint(CHAR16 *Str, UINTN StrSize, const CHAR16 *fmt, ...);
+extern UINTN VSPrint(CHAR16 *Str, UINTN StrSize, const CHAR16 *fmt,
+		     va_list args);
+extern void StatusToString(CHAR16 *Buffer, EFI_STATUS Status);
+
+extern UINTN StrLen(const CHAR16 *s1);
+extern void StrCpy(CHAR16 *Dest, const CHAR16 *Src);
+extern INTN StrCmp(const CHAR16 *s1, const CHAR16 *s2);
+extern INTN StriCmp(const CHAR16 *s1, const CHAR16 *s2);
+extern UINTN Atoi(const CHAR16 *str);
+extern UINTN xtoi(const CHAR16 *str);
+extern UINTN strlena(const CHAR8 *s1);
+extern UINTN strncmpa(const CHAR8 *s1, const CHAR8 *s2, UINTN len);
+
+extern INTN CompareGuid(EFI_GUID *Guid1, EFI_GUID *Guid2);
+extern void CopyMem(VOID *Dest, const VOID *Src, UINTN len);
+extern void ZeroMem(VOID *Buffer, UINTN Size);
+
+extern VOID *AllocatePool(UINTN Size);
+extern VOID *AllocateZeroPool(UINTN Size);
+extern void FreePool(VOID *p);
+
+extern EFI_FILE_INFO *LibFileInfo(EFI_FILE_HANDLE FHand);
+extern EFI_DEVICE_PATH *DevicePathFromHandle(EFI_HANDLE Handle);
+extern CHAR16 *DevicePathToStr(EFI_DEVICE_PATH *DevPath);
+extern EFI_STATUS LibLocateProtocol(EFI_GUID *ProtocolGuid,
+				    VOID **Interface);
+
+#endif /* __HOST_EFILIB_H__ */
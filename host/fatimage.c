@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Build a FAT32 image holding the files in a volume's directory, so
+ * that the mock can offer block and disk I/O on the same volume as
+ * the directory-backed filesystem.
+ */
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "efi.h"
+#include "mock.h"
+#include "../fs/fat.h"
+
+#define SECTOR_SIZE		512
+#define SECTORS_PER_CLUSTER	8
+#define CLUSTER_SIZE		(SECTOR_SIZE * SECTORS_PER_CLUSTER)
+#define RESERVED_SECTORS	32
+#define MIN_CLUSTERS		65536	/* anything less isn't FAT32 */
+#define MAX_FILES		64
+
+struct image_file {
+	char name[FAT_MAX_NAME + 1];
+	UINT64 size;
+	UINT32 cluster;
+};
+
+static void put16(UINT8 *p, UINT16 v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static void put32(UINT8 *p, UINT32 v)
+{
+	put16(p, v);
+	put16(p + 2, v >> 16);
+}
+
+static UINT32 file_clusters(UINT64 size)
+{
+	UINT32 n = (size + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+
+	/* Leave a hole after every fat_gap clusters */
+	if (mock_config.fat_gap && n)
+		n += (n - 1) / mock_config.fat_gap;
+
+	return n;
+}
+
+static void short_name(struct image_file *f, int nr, char *out)
+{
+	char tail[8];
+	const char *ext;
+	int i, n, len;
+
+	memset(out, ' ', 11);
+
+	ext = strrchr(f->name, '.');
+	if (ext == f->name)
+		ext = NULL;
+
+	len = snprintf(tail, sizeof(tail), "~%d", nr);
+	for (i = 0, n = 0; f->name + i != ext && f->name[i] &&
+		     n < 8 - len; i++) {
+		if (f->name[i] == '.' || f->name[i] == ' ')
+			continue;
+		out[n++] = toupper(f->name[i]);
+	}
+	memcpy(out + n, tail, len);
+
+	for (i = 0; ext && ext[i + 1] && i < 3; i++)
+		out[8 + i] = toupper(ext[i + 1]);
+}
+
+static UINT8 checksum(const char *name)
+{
+	UINT8 sum = 0;
+	int i;
+
+	for (i = 0; i < 11; i++)
+		sum = ((sum & 1) << 7) + (sum >> 1) + (UINT8)name[i];
+
+	return sum;
+}
+
+/*
+ * Write the long name entries and the 8.3 entry for @f at @p and
+ * return the number of bytes used.
+ */
+static UINTN write_dirent(UINT8 *p, struct image_file *f, int nr)
+{
+	struct fat_dirent *de;
+	struct fat_lfn *l;
+	char sfn[11];
+	UINT16 chars[20 * FAT_LFN_CHARS];
+	int len, nr_lfn, i, j, k;
+
+	short_name(f, nr, sfn);
+
+	len = strlen(f->name);
+	nr_lfn = (len + FAT_LFN_CHARS - 1) / FAT_LFN_CHARS;
+	for (i = 0; i < nr_lfn * FAT_LFN_CHARS; i++) {
+		if (i < len)
+			chars[i] = (UINT8)f->name[i];
+		else
+			chars[i] = i == len ? 0 : 0xffff;
+	}
+
+	/* Long name entries are stored last part first */
+	for (i = nr_lfn; i > 0; i--) {
+		l = (struct fat_lfn *)p;
+		memset(l, 0, sizeof(*l));
+
+		l->order = i | (i == nr_lfn ? FAT_LFN_LAST : 0);
+		l->attr = FAT_ATTR_LFN;
+		l->checksum = checksum(sfn);
+
+		k = (i - 1) * FAT_LFN_CHARS;
+		for (j = 0; j < 5; j++)
+			l->name1[j] = chars[k++];
+		for (j = 0; j < 6; j++)
+			l->name2[j] = chars[k++];
+		for (j = 0; j < 2; j++)
+			l->name3[j] = chars[k++];
+
+		p += sizeof(*l);
+	}
+
+	de = (struct fat_dirent *)p;
+	memset(de, 0, sizeof(*de));
+	memcpy(de->name, sfn, sizeof(sfn));
+	de->cluster_hi = f->cluster >> 16;
+	de->cluster_lo = f->cluster;
+	de->size = f->size;
+
+	return (nr_lfn + 1) * sizeof(*de);
+}
+
+static void set_fat(UINT8 *image, UINT32 fat_sectors, UINT32 cluster,
+		    UINT32 val)
+{
+	UINT64 offset = RESERVED_SECTORS * SECTOR_SIZE + cluster * 4ULL;
+
+	put32(image + offset, val);
+	put32(image + offset + (UINT64)fat_sectors * SECTOR_SIZE, val);
+}
+
+static UINT8 *cluster_ptr(UINT8 *image, UINT32 fat_sectors, UINT32 cluster)
+{
+	UINT64 data = (RESERVED_SECTORS + 2ULL * fat_sectors) * SECTOR_SIZE;
+
+	return image + data + (UINT64)(cluster - 2) * CLUSTER_SIZE;
+}
+
+/**
+ * mock_fat_image - Build a FAT32 image of the regular files in @root
+ * @root: the volume's directory
+ * @size: used to return the size of the image in bytes
+ *
+ * Subdirectories are left out. The image is never freed.
+ */
+UINT8 *mock_fat_image(const char *root, UINT64 *size)
+{
+	struct image_file files[MAX_FILES];
+	UINT32 nr_clusters, fat_sectors, total, cluster, root_clusters;
+	UINT32 i, n, prev;
+	UINT64 dir_bytes = 32;
+	char path[PATH_MAX];
+	struct dirent *d;
+	struct stat st;
+	UINT8 *image, *p;
+	int nr_files = 0, fd;
+	DIR *dir;
+
+	dir = opendir(root);
+	if (!dir)
+		return NULL;
+
+	nr_clusters = 0;
+	while ((d = readdir(dir)) && nr_files < MAX_FILES) {
+		snprintf(path, sizeof(path), "%s/%s", root, d->d_name);
+		if (stat(path, &st) || !S_ISREG(st.st_mode) ||
+		    strlen(d->d_name) > FAT_MAX_NAME)
+			continue;
+
+		snprintf(files[nr_files].name, sizeof(files[0].name),
+			 "%s", d->d_name);
+		files[nr_files].size = st.st_size;
+		nr_clusters += file_clusters(st.st_size);
+		dir_bytes += 32 * (1 + (strlen(d->d_name) +
+					FAT_LFN_CHARS - 1) / FAT_LFN_CHARS);
+		nr_files++;
+	}
+	closedir(dir);
+
+	root_clusters = (dir_bytes + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+	nr_clusters += root_clusters + 16;
+	if (nr_clusters < MIN_CLUSTERS)
+		nr_clusters = MIN_CLUSTERS;
+
+	fat_sectors = ((nr_clusters + 2) * 4 + SECTOR_SIZE - 1) / SECTOR_SIZE;
+	total = RESERVED_SECTORS + 2 * fat_sectors +
+		nr_clusters * SECTORS_PER_CLUSTER;
+	*size = (UINT64)total * SECTOR_SIZE;
+
+	image = mmap(NULL, *size, PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (image == MAP_FAILED)
+		return NULL;
+
+	/* Boot sector */
+	image[0] = 0xeb;
+	image[1] = 0x58;
+	image[2] = 0x90;
+	memcpy(image + 3, "MSWIN4.1", 8);
+	put16(image + 11, SECTOR_SIZE);
+	image[13] = SECTORS_PER_CLUSTER;
+	put16(image + 14, RESERVED_SECTORS);
+	image[16] = 2;
+	image[21] = 0xf8;
+	put32(image + 32, total);
+	put32(image + 36, fat_sectors);
+	put32(image + 44, 2);
+	put16(image + 48, 1);
+	put16(image + 50, 6);
+	image[64] = 0x80;
+	image[66] = 0x29;
+	memcpy(image + 71, "EFILINUX   ", 11);
+	memcpy(image + 82, "FAT32   ", 8);
+	image[510] = 0x55;
+	image[511] = 0xaa;
+
+	set_fat(image, fat_sectors, 0, 0x0ffffff8);
+	set_fat(image, fat_sectors, 1, 0x0fffffff);
+
+	/* The root directory comes first */
+	cluster = 2;
+	for (i = 0; i < root_clusters; i++, cluster++)
+		set_fat(image, fat_sectors, cluster, i == root_clusters - 1 ?
+			0x0fffffff : cluster + 1);
+
+	for (i = 0; i < nr_files; i++) {
+		UINT64 left = files[i].size;
+
+		if (snprintf(path, sizeof(path), "%s/%s", root,
+			     files[i].name) >= (int)sizeof(path))
+			goto fail;
+
+		fd = open(path, O_RDONLY);
+		if (fd < 0)
+			goto fail;
+
+		files[i].cluster = left ? cluster : 0;
+		prev = 0;
+		for (n = 0; left; n++) {
+			UINTN len = left < CLUSTER_SIZE ? left : CLUSTER_SIZE;
+
+			if (mock_config.fat_gap && n == mock_config.fat_gap) {
+				cluster++;
+				n = 0;
+			}
+
+			if (pread(fd, cluster_ptr(image, fat_sectors, cluster),
+				  len, files[i].size - left) != (ssize_t)len) {
+				close(fd);
+				goto fail;
+			}
+
+			if (prev)
+				set_fat(image, fat_sectors, prev, cluster);
+			prev = cluster++;
+			left -= len;
+		}
+
+		if (prev)
+			set_fat(image, fat_sectors, prev, 0x0fffffff);
+		close(fd);
+	}
+
+	p = cluster_ptr(image, fat_sectors, 2);
+	for (i = 0; i < nr_files; i++)
+		p += write_dirent(p, &files[i], i + 1);
+
+	return image;
+
+fail:
+	munmap(image, *size);
+	return NULL;
+}
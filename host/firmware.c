@@ -0,0 +1,1885 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * A mock UEFI firmware that runs as an ordinary Linux process.
+ *
+ * "Physical" memory is a region of our own address space, mapped at
+ * the same addresses that the memory map reports, so that efilinux
+ * can keep treating physical addresses as pointers. Volumes are
+ * directories on the host and every firmware call is counted.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "efi.h"
+#include "efilib.h"
+#include "mock.h"
+#include "../acpi.h"
+#include "../fs/fat.h"
+#include "../mp.h"
+
+#define LOW_MEM_START	0x10000ULL
+#define LOW_MEM_END	0x9f000ULL
+#define HIGH_MEM_START	0x100000ULL
+
+#define MAX_REGIONS	65536
+#define MAX_HANDLES	256
+#define MAX_PROTOCOLS	8
+
+struct mock_config mock_config = {
+	.mem_size = 2048ULL << 20,
+	.fragments = 1,
+};
+
+static EFI_GUID DiskIo2Protocol = DISK_IO2_PROTOCOL_GUID;
+static EFI_GUID MpServicesProtocol = MP_SERVICES_PROTOCOL_GUID;
+
+unsigned long mock_calls[NR_MOCK_CALLS];
+UINT64 mock_bytes_read;
+EFI_SYSTEM_TABLE *mock_system_table;
+
+const char *mock_call_names[NR_MOCK_CALLS] = {
+	[CALL_ALLOCATE_PAGES] = "AllocatePages",
+	[CALL_FREE_PAGES] = "FreePages",
+	[CALL_GET_MEMORY_MAP] = "GetMemoryMap",
+	[CALL_ALLOCATE_POOL] = "AllocatePool",
+	[CALL_FREE_POOL] = "FreePool",
+	[CALL_HANDLE_PROTOCOL] = "HandleProtocol",
+	[CALL_LOCATE_HANDLE] = "LocateHandle",
+	[CALL_LOCATE_PROTOCOL] = "LocateProtocol",
+	[CALL_EXIT_BOOT_SERVICES] = "ExitBootServices",
+	[CALL_STALL] = "Stall",
+	[CALL_OUTPUT_STRING] = "ConOut->OutputString",
+	[CALL_OPEN_VOLUME] = "SimpleFS->OpenVolume",
+	[CALL_FILE_OPEN] = "File->Open",
+	[CALL_FILE_CLOSE] = "File->Close",
+	[CALL_FILE_READ] = "File->Read",
+	[CALL_FILE_READ_EX] = "File->ReadEx",
+	[CALL_FILE_GET_POSITION] = "File->GetPosition",
+	[CALL_FILE_SET_POSITION] = "File->SetPosition",
+	[CALL_FILE_GET_INFO] = "File->GetInfo",
+	[CALL_DISK_READ] = "DiskIo->ReadDisk",
+	[CALL_DISK_READ_EX] = "DiskIo2->ReadDiskEx",
+	[CALL_GOP_QUERY_MODE] = "GOP->QueryMode",
+	[CALL_GOP_SET_MODE] = "GOP->SetMode",
+	[CALL_CREATE_EVENT] = "CreateEvent",
+	[CALL_WAIT_FOR_EVENT] = "WaitForEvent",
+	[CALL_SIGNAL_EVENT] = "SignalEvent",
+	[CALL_CLOSE_EVENT] = "CloseEvent",
+	[CALL_CHECK_EVENT] = "CheckEvent",
+	[CALL_MP_GET_NR_PROCESSORS] = "MP->GetNumberOfProcessors",
+	[CALL_MP_STARTUP_ALL_APS] = "MP->StartupAllAPs",
+	[CALL_MP_STARTUP_THIS_AP] = "MP->StartupThisAP",
+	[CALL_MP_WHO_AM_I] = "MP->WhoAmI",
+};
+
+static BOOLEAN exited;
+static BOOLEAN exit_failed;
+static pthread_t bsp;
+static BOOLEAN aps_busy(void);
+
+static void called(enum mock_call call)
+{
+	if (!pthread_equal(pthread_self(), bsp)) {
+		fprintf(stderr, "mock: %s called on an AP\n",
+			mock_call_names[call]);
+		abort();
+	}
+
+	mock_calls[call]++;
+
+	if (exited && call != CALL_EXIT_BOOT_SERVICES) {
+		fprintf(stderr, "mock: %s called after ExitBootServices\n",
+			mock_call_names[call]);
+		abort();
+	}
+
+	/*
+	 * Once ExitBootServices() has been called, even unsuccessfully,
+	 * the firmware may have shut down everything but the memory
+	 * allocation services.
+	 */
+	if (exit_failed && call != CALL_EXIT_BOOT_SERVICES &&
+	    call != CALL_ALLOCATE_PAGES && call != CALL_FREE_PAGES &&
+	    call != CALL_GET_MEMORY_MAP && call != CALL_ALLOCATE_POOL &&
+	    call != CALL_FREE_POOL) {
+		fprintf(stderr, "mock: %s called after a failed "
+			"ExitBootServices\n", mock_call_names[call]);
+		abort();
+	}
+}
+
+void mock_delay(unsigned long usecs)
+{
+	struct timespec ts;
+
+	if (!usecs)
+		return;
+
+	ts.tv_sec = usecs / 1000000;
+	ts.tv_nsec = (usecs % 1000000) * 1000;
+	while (nanosleep(&ts, &ts) && errno == EINTR)
+		;
+}
+
+/*
+ * Memory
+ */
+struct region {
+	UINT32 type;
+	UINT64 start;
+	UINT64 pages;
+	UINT64 attr;
+};
+
+static struct region regions[MAX_REGIONS];
+static UINTN nr_regions;
+static UINTN map_key = 1;
+
+static UINT64 region_end(struct region *r)
+{
+	return r->start + (r->pages << EFI_PAGE_SHIFT);
+}
+
+static void add_region(UINT32 type, UINT64 start, UINT64 end)
+{
+	struct region *r;
+
+	if (nr_regions == MAX_REGIONS || end <= start)
+		return;
+
+	r = &regions[nr_regions++];
+	r->type = type;
+	r->start = start;
+	r->pages = (end - start) >> EFI_PAGE_SHIFT;
+	r->attr = EFI_MEMORY_WB;
+}
+
+static void merge_regions(void)
+{
+	UINTN i, j;
+
+	for (i = 0, j = 0; i < nr_regions; i++) {
+		if (j && regions[j - 1].type == regions[i].type &&
+		    regions[j - 1].attr == regions[i].attr &&
+		    region_end(&regions[j - 1]) == regions[i].start) {
+			regions[j - 1].pages += regions[i].pages;
+			continue;
+		}
+		regions[j++] = regions[i];
+	}
+
+	nr_regions = j;
+}
+
+/*
+ * Make sure no region straddles 'addr'.
+ */
+static void split_at(UINT64 addr)
+{
+	UINTN i;
+
+	for (i = 0; i < nr_regions; i++) {
+		struct region *r = &regions[i];
+
+		if (r->start >= addr || region_end(r) <= addr)
+			continue;
+
+		if (nr_regions == MAX_REGIONS) {
+			fprintf(stderr, "mock: out of memory regions\n");
+			abort();
+		}
+
+		memmove(&regions[i + 1], r, (nr_regions - i) * sizeof(*r));
+		nr_regions++;
+		r->pages = (addr - r->start) >> EFI_PAGE_SHIFT;
+		regions[i + 1].start = addr;
+		regions[i + 1].pages -= r->pages;
+		return;
+	}
+}
+
+/*
+ * Set the type of [start, start + pages) to 'type', splitting
+ * regions as necessary. The range must already be described by the
+ * map.
+ */
+static void set_type(UINT64 start, UINT64 pages, UINT32 type)
+{
+	UINT64 end = start + (pages << EFI_PAGE_SHIFT);
+	UINTN i;
+
+	split_at(start);
+	split_at(end);
+
+	for (i = 0; i < nr_regions; i++) {
+		if (regions[i].start >= start && region_end(&regions[i]) <= end)
+			regions[i].type = type;
+	}
+
+	merge_regions();
+	map_key++;
+}
+
+/*
+ * Add 'attr' to the attributes of [start, end).
+ */
+static void set_attr(UINT64 start, UINT64 end, UINT64 attr)
+{
+	UINTN i;
+
+	split_at(start);
+	split_at(end);
+
+	for (i = 0; i < nr_regions; i++) {
+		if (regions[i].start >= start && region_end(&regions[i]) <= end)
+			regions[i].attr |= attr;
+	}
+
+	merge_regions();
+	map_key++;
+}
+
+static BOOLEAN range_is(UINT64 start, UINT64 pages, UINT32 type)
+{
+	UINT64 end = start + (pages << EFI_PAGE_SHIFT);
+	UINT64 covered = start;
+	UINTN i;
+
+	for (i = 0; i < nr_regions && covered < end; i++) {
+		struct region *r = &regions[i];
+
+		if (region_end(r) <= covered)
+			continue;
+		if (r->start > covered || r->type != type)
+			return FALSE;
+		covered = region_end(r);
+	}
+
+	return covered >= end;
+}
+
+UINTN mock_nr_descriptors(void)
+{
+	return nr_regions;
+}
+
+static EFI_STATUS
+allocate_pages(EFI_ALLOCATE_TYPE type, EFI_MEMORY_TYPE mtype,
+	       UINTN pages, EFI_PHYSICAL_ADDRESS *memory)
+{
+	UINT64 max = (UINT64)-1;
+	INTN i;
+
+	called(CALL_ALLOCATE_PAGES);
+
+	if (!pages)
+		return EFI_INVALID_PARAMETER;
+
+	if (type == AllocateAddress) {
+		if (*memory & EFI_PAGE_MASK)
+			return EFI_INVALID_PARAMETER;
+		if (!range_is(*memory, pages, EfiConventionalMemory))
+			return EFI_NOT_FOUND;
+		set_type(*memory, pages, mtype);
+		return EFI_SUCCESS;
+	}
+
+	if (type == AllocateMaxAddress)
+		max = *memory;
+
+	/* Allocate top-down, like most firmware does */
+	for (i = nr_regions - 1; i >= 0; i--) {
+		struct region *r = &regions[i];
+		UINT64 top = region_end(r);
+
+		if (r->type != EfiConventionalMemory ||
+		    (r->attr & EFI_MEMORY_SP))
+			continue;
+
+		if (top - 1 > max)
+			top = (max + 1) & ~(UINT64)EFI_PAGE_MASK;
+
+		if (top < r->start + (pages << EFI_PAGE_SHIFT))
+			continue;
+
+		*memory = top - (pages << EFI_PAGE_SHIFT);
+		set_type(*memory, pages, mtype);
+		return EFI_SUCCESS;
+	}
+
+	return EFI_OUT_OF_RESOURCES;
+}
+
+static EFI_STATUS free_pages(EFI_PHYSICAL_ADDRESS memory, UINTN pages)
+{
+	called(CALL_FREE_PAGES);
+
+	if (!range_is(memory, pages, EfiLoaderData) &&
+	    !range_is(memory, pages, EfiLoaderCode))
+		return EFI_NOT_FOUND;
+
+	set_type(memory, pages, EfiConventionalMemory);
+	return EFI_SUCCESS;
+}
+
+/* Real firmware pads its descriptors, so make sure efilinux copes */
+#define DESC_SIZE	(sizeof(EFI_MEMORY_DESCRIPTOR) + 8)
+
+static EFI_STATUS
+get_memory_map(UINTN *size, EFI_MEMORY_DESCRIPTOR *map, UINTN *key,
+	       UINTN *desc_size, UINT32 *desc_version)
+{
+	UINTN i;
+
+	called(CALL_GET_MEMORY_MAP);
+
+	/* Like EDK2, return the descriptor size even if the buffer is small */
+	if (desc_size)
+		*desc_size = DESC_SIZE;
+
+	if (*size < nr_regions * DESC_SIZE) {
+		*size = nr_regions * DESC_SIZE;
+		return EFI_BUFFER_TOO_SMALL;
+	}
+
+	for (i = 0; i < nr_regions; i++) {
+		EFI_MEMORY_DESCRIPTOR *d;
+
+		d = (EFI_MEMORY_DESCRIPTOR *)((char *)map + i * DESC_SIZE);
+		memset(d, 0, DESC_SIZE);
+		d->Type = regions[i].type;
+		d->PhysicalStart = regions[i].start;
+		d->VirtualStart = 0;
+		d->NumberOfPages = regions[i].pages;
+		d->Attribute = regions[i].attr;
+	}
+
+	*size = nr_regions * DESC_SIZE;
+	if (key)
+		*key = map_key;
+	if (desc_version)
+		*desc_version = EFI_MEMORY_DESCRIPTOR_VERSION;
+
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS
+allocate_pool(EFI_MEMORY_TYPE type, UINTN size, VOID **buffer)
+{
+	called(CALL_ALLOCATE_POOL);
+
+	*buffer = malloc(size ? size : 1);
+	if (!*buffer)
+		return EFI_OUT_OF_RESOURCES;
+
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS free_pool(VOID *buffer)
+{
+	called(CALL_FREE_POOL);
+	free(buffer);
+	return EFI_SUCCESS;
+}
+
+static void timer_allocation(void)
+{
+	INTN i;
+
+	for (i = nr_regions - 1; i >= 0; i--) {
+		struct region *r = &regions[i];
+
+		if (r->type != EfiConventionalMemory ||
+		    (r->attr & EFI_MEMORY_SP))
+			continue;
+
+		set_type(region_end(r) - EFI_PAGE_SIZE, 1,
+			 EfiBootServicesData);
+		return;
+	}
+}
+
+static EFI_STATUS exit_boot_services(EFI_HANDLE image, UINTN key)
+{
+	called(CALL_EXIT_BOOT_SERVICES);
+
+	/*
+	 * Pretend a timer callback allocated a page since the map was
+	 * taken, as real firmware does now and then.
+	 */
+	if (key == map_key && mock_config.exit_races) {
+		mock_config.exit_races--;
+		timer_allocation();
+	}
+
+	if (key != map_key) {
+		exit_failed = TRUE;
+		return EFI_INVALID_PARAMETER;
+	}
+
+	if (aps_busy()) {
+		fprintf(stderr, "mock: APs still running at ExitBootServices\n");
+		abort();
+	}
+
+	exited = TRUE;
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS stall(UINTN usecs)
+{
+	called(CALL_STALL);
+	mock_delay(usecs);
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS
+efi_exit(EFI_HANDLE image, EFI_STATUS status, UINTN size, CHAR16 *data)
+{
+	host_exit(status);
+}
+
+/*
+ * Handles and protocols
+ */
+struct mock_handle {
+	struct {
+		EFI_GUID *guid;
+		VOID *interface;
+	} protocols[MAX_PROTOCOLS];
+	int nr_protocols;
+};
+
+static struct mock_handle handles[MAX_HANDLES];
+static int nr_handles;
+
+static struct mock_handle *new_handle(void)
+{
+	if (nr_handles == MAX_HANDLES) {
+		fprintf(stderr, "mock: too many handles\n");
+		exit(1);
+	}
+
+	return &handles[nr_handles++];
+}
+
+static void install(struct mock_handle *h, EFI_GUID *guid, VOID *interface)
+{
+	h->protocols[h->nr_protocols].guid = guid;
+	h->protocols[h->nr_protocols].interface = interface;
+	h->nr_protocols++;
+}
+
+static VOID *lookup(struct mock_handle *h, EFI_GUID *guid)
+{
+	int i;
+
+	for (i = 0; i < h->nr_protocols; i++) {
+		if (!memcmp(h->protocols[i].guid, guid, sizeof(*guid)))
+			return h->protocols[i].interface;
+	}
+
+	return NULL;
+}
+
+static EFI_STATUS
+handle_protocol(EFI_HANDLE handle, EFI_GUID *guid, VOID **interface)
+{
+	called(CALL_HANDLE_PROTOCOL);
+
+	*interface = lookup(handle, guid);
+	if (!*interface)
+		return EFI_UNSUPPORTED;
+
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS
+locate_handle(EFI_LOCATE_SEARCH_TYPE type, EFI_GUID *guid, VOID *key,
+	      UINTN *size, EFI_HANDLE *buffer)
+{
+	UINTN needed = 0, n = 0;
+	int i;
+
+	called(CALL_LOCATE_HANDLE);
+
+	for (i = 0; i < nr_handles; i++) {
+		if (type == AllHandles || lookup(&handles[i], guid))
+			needed += sizeof(EFI_HANDLE);
+	}
+
+	if (!needed)
+		return EFI_NOT_FOUND;
+
+	if (*size < needed) {
+		*size = needed;
+		return EFI_BUFFER_TOO_SMALL;
+	}
+
+	for (i = 0; i < nr_handles; i++) {
+		if (type == AllHandles || lookup(&handles[i], guid))
+			buffer[n++] = &handles[i];
+	}
+
+	*size = needed;
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS
+locate_protocol(EFI_GUID *guid, VOID *registration, VOID **interface)
+{
+	int i;
+
+	called(CALL_LOCATE_PROTOCOL);
+
+	for (i = 0; i < nr_handles; i++) {
+		*interface = lookup(&handles[i], guid);
+		if (*interface)
+			return EFI_SUCCESS;
+	}
+
+	return EFI_NOT_FOUND;
+}
+
+/*
+ * Events
+ *
+ * Only plain events, without notification functions, are supported.
+ * They can be signaled from the threads that complete asynchronous
+ * file reads, so every event shares one lock and condition variable.
+ */
+struct mock_event {
+	BOOLEAN signaled;
+};
+
+static pthread_mutex_t event_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t event_cond = PTHREAD_COND_INITIALIZER;
+
+static void event_signal(struct mock_event *e)
+{
+	pthread_mutex_lock(&event_lock);
+	e->signaled = TRUE;
+	pthread_cond_broadcast(&event_cond);
+	pthread_mutex_unlock(&event_lock);
+}
+
+static EFI_STATUS
+create_event(UINT32 type, EFI_TPL tpl, EFI_EVENT_NOTIFY fn,
+	     VOID *ctx, EFI_EVENT *event)
+{
+	struct mock_event *e;
+
+	called(CALL_CREATE_EVENT);
+
+	if (type || fn)
+		return EFI_UNSUPPORTED;
+
+	e = calloc(1, sizeof(*e));
+	if (!e)
+		return EFI_OUT_OF_RESOURCES;
+
+	*event = e;
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS wait_for_event(UINTN nr, EFI_EVENT *events, UINTN *index)
+{
+	UINTN i;
+
+	called(CALL_WAIT_FOR_EVENT);
+
+	if (!nr)
+		return EFI_INVALID_PARAMETER;
+
+	pthread_mutex_lock(&event_lock);
+	for (;;) {
+		for (i = 0; i < nr; i++) {
+			struct mock_event *e = events[i];
+
+			if (e->signaled) {
+				e->signaled = FALSE;
+				pthread_mutex_unlock(&event_lock);
+				*index = i;
+				return EFI_SUCCESS;
+			}
+		}
+
+		pthread_cond_wait(&event_cond, &event_lock);
+	}
+}
+
+static EFI_STATUS signal_event(EFI_EVENT event)
+{
+	called(CALL_SIGNAL_EVENT);
+	event_signal(event);
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS close_event(EFI_EVENT event)
+{
+	called(CALL_CLOSE_EVENT);
+	free(event);
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS check_event(EFI_EVENT event)
+{
+	struct mock_event *e = event;
+	BOOLEAN signaled;
+
+	called(CALL_CHECK_EVENT);
+
+	pthread_mutex_lock(&event_lock);
+	signaled = e->signaled;
+	e->signaled = FALSE;
+	pthread_mutex_unlock(&event_lock);
+
+	return signaled ? EFI_SUCCESS : EFI_NOT_READY;
+}
+
+/*
+ * MP services
+ *
+ * Each AP is a thread, started afresh for every procedure.
+ */
+struct mock_ap {
+	UINTN cpu;
+	BOOLEAN busy;
+	pthread_t thread;
+	mp_procedure_t proc;
+	void *arg;
+	struct mock_event *event;
+	unsigned int *group;		/* APs left in a StartupAllAPs() */
+};
+
+static struct mock_ap *aps;
+static __thread UINTN this_cpu;
+
+static void *ap_main(void *data)
+{
+	struct mock_ap *ap = data;
+	BOOLEAN last = TRUE;
+
+	this_cpu = ap->cpu;
+	ap->proc(ap->arg);
+
+	pthread_mutex_lock(&event_lock);
+	ap->busy = FALSE;
+	if (ap->group) {
+		last = !--*ap->group;
+		if (last)
+			free(ap->group);
+		ap->group = NULL;
+	}
+	if (last && ap->event)
+		ap->event->signaled = TRUE;
+	pthread_cond_broadcast(&event_cond);
+	pthread_mutex_unlock(&event_lock);
+
+	return NULL;
+}
+
+static EFI_STATUS start_ap(struct mock_ap *ap, mp_procedure_t proc,
+			   void *arg, EFI_EVENT event, unsigned int *group)
+{
+	ap->proc = proc;
+	ap->arg = arg;
+	ap->event = event;
+	ap->group = group;
+	ap->busy = TRUE;
+
+	if (pthread_create(&ap->thread, NULL, ap_main, ap)) {
+		ap->busy = FALSE;
+		return EFI_DEVICE_ERROR;
+	}
+
+	if (event)
+		pthread_detach(ap->thread);
+	else
+		pthread_join(ap->thread, NULL);
+
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS
+mp_get_nr_processors(struct mp_services *this, UINTN *nr, UINTN *nr_enabled)
+{
+	called(CALL_MP_GET_NR_PROCESSORS);
+
+	*nr = mock_config.cpus;
+	*nr_enabled = mock_config.cpus;
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS
+mp_startup_all_aps(struct mp_services *this, mp_procedure_t proc,
+		   BOOLEAN single, EFI_EVENT event, UINTN timeout,
+		   void *arg, UINTN **failed)
+{
+	unsigned int *group = NULL;
+	UINTN i;
+
+	called(CALL_MP_STARTUP_ALL_APS);
+
+	if (mock_config.cpus < 2)
+		return EFI_NOT_STARTED;
+
+	for (i = 1; i < mock_config.cpus; i++) {
+		if (aps[i].busy)
+			return EFI_NOT_READY;
+	}
+
+	if (event) {
+		group = malloc(sizeof(*group));
+		if (!group)
+			return EFI_OUT_OF_RESOURCES;
+		*group = mock_config.cpus - 1;
+	}
+
+	/* Blocking calls run the APs one after another */
+	for (i = 1; i < mock_config.cpus; i++)
+		start_ap(&aps[i], proc, arg, event, group);
+
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS
+mp_startup_this_ap(struct mp_services *this, mp_procedure_t proc,
+		   UINTN cpu, EFI_EVENT event, UINTN timeout, void *arg,
+		   BOOLEAN *finished)
+{
+	called(CALL_MP_STARTUP_THIS_AP);
+
+	if (!cpu || cpu >= mock_config.cpus)
+		return EFI_INVALID_PARAMETER;
+
+	if (aps[cpu].busy)
+		return EFI_NOT_READY;
+
+	return start_ap(&aps[cpu], proc, arg, event, NULL);
+}
+
+static EFI_STATUS mp_who_am_i(struct mp_services *this, UINTN *cpu)
+{
+	called(CALL_MP_WHO_AM_I);
+
+	*cpu = this_cpu;
+	return EFI_SUCCESS;
+}
+
+static struct mp_services mp_services = {
+	.get_nr_processors = mp_get_nr_processors,
+	.startup_all_aps = mp_startup_all_aps,
+	.startup_this_ap = mp_startup_this_ap,
+	.who_am_i = mp_who_am_i,
+};
+
+static BOOLEAN aps_busy(void)
+{
+	BOOLEAN busy = FALSE;
+	UINTN i;
+
+	pthread_mutex_lock(&event_lock);
+	for (i = 1; i < mock_config.cpus; i++)
+		busy |= aps[i].busy;
+	pthread_mutex_unlock(&event_lock);
+
+	return busy;
+}
+
+/*
+ * Files
+ */
+struct mock_volume {
+	EFI_FILE_IO_INTERFACE io;
+	char root[PATH_MAX];
+	pthread_mutex_t lock;		/* one request at a time per device */
+};
+
+struct mock_file {
+	EFI_FILE file;
+	struct mock_volume *vol;
+	char path[PATH_MAX];
+	int fd;
+	BOOLEAN dir;
+	UINT64 pos;
+	UINT64 size;
+	unsigned int inflight;		/* ReadEx requests, under event_lock */
+};
+
+static void disk_delay(UINT64 bytes)
+{
+	unsigned long usecs = mock_config.latency_us;
+
+	if (mock_config.bandwidth)
+		usecs += bytes / mock_config.bandwidth;
+
+	mock_delay(usecs);
+}
+
+/*
+ * The filesystem driver may split a read into many small disk
+ * requests, each of which pays the latency.
+ */
+static void file_delay(UINT64 bytes)
+{
+	unsigned long requests = 1;
+
+	if (mock_config.fs_request && bytes > mock_config.fs_request)
+		requests = (bytes + mock_config.fs_request - 1) /
+			mock_config.fs_request;
+
+	mock_delay(mock_config.latency_us * (requests - 1));
+	disk_delay(bytes);
+}
+
+static struct mock_file *new_file(struct mock_volume *vol, const char *path);
+
+static EFI_STATUS
+file_open(EFI_FILE *this, EFI_FILE **new, CHAR16 *name,
+	  UINT64 mode, UINT64 attr)
+{
+	struct mock_file *dir = (struct mock_file *)this;
+	struct mock_file *f;
+	char path[PATH_MAX];
+	size_t len;
+
+	called(CALL_FILE_OPEN);
+	file_delay(0);
+
+	if (mode != EFI_FILE_MODE_READ)
+		return EFI_WRITE_PROTECTED;
+
+	if (*name == '\\') {
+		snprintf(path, sizeof(path), "%s", dir->vol->root);
+	} else
+		snprintf(path, sizeof(path), "%s", dir->path);
+
+	len = strlen(path);
+	for (; *name && len < sizeof(path) - 2; name++) {
+		if (*name == '\\' || *name == '/') {
+			if (path[len - 1] != '/')
+				path[len++] = '/';
+			continue;
+		}
+		path[len++] = (char)*name;
+	}
+	path[len] = '\0';
+
+	f = new_file(dir->vol, path);
+	if (!f)
+		return EFI_NOT_FOUND;
+
+	*new = &f->file;
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS file_close(EFI_FILE *this)
+{
+	struct mock_file *f = (struct mock_file *)this;
+
+	called(CALL_FILE_CLOSE);
+
+	pthread_mutex_lock(&event_lock);
+	while (f->inflight)
+		pthread_cond_wait(&event_cond, &event_lock);
+	pthread_mutex_unlock(&event_lock);
+
+	close(f->fd);
+	free(f);
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS file_read(EFI_FILE *this, UINTN *size, VOID *buf)
+{
+	struct mock_file *f = (struct mock_file *)this;
+	ssize_t n;
+
+	called(CALL_FILE_READ);
+
+	if (f->dir)
+		return EFI_UNSUPPORTED;
+
+	pthread_mutex_lock(&f->vol->lock);
+	n = pread(f->fd, buf, *size, f->pos);
+	if (n >= 0)
+		file_delay(n);
+	pthread_mutex_unlock(&f->vol->lock);
+
+	if (n < 0)
+		return EFI_DEVICE_ERROR;
+
+	*size = n;
+	f->pos += n;
+	__atomic_fetch_add(&mock_bytes_read, n, __ATOMIC_RELAXED);
+	return EFI_SUCCESS;
+}
+
+struct read_request {
+	struct mock_file *f;
+	EFI_FILE_IO_TOKEN *token;
+	UINT64 pos;
+};
+
+/*
+ * Complete a ReadEx request. Requests on the same volume queue behind
+ * each other, those on different volumes proceed in parallel.
+ */
+static void *read_worker(void *arg)
+{
+	struct read_request *req = arg;
+	struct mock_file *f = req->f;
+	EFI_FILE_IO_TOKEN *token = req->token;
+	ssize_t n;
+
+	pthread_mutex_lock(&f->vol->lock);
+	n = pread(f->fd, token->Buffer, token->BufferSize, req->pos);
+	if (n >= 0)
+		file_delay(n);
+	pthread_mutex_unlock(&f->vol->lock);
+
+	if (n < 0)
+		token->Status = EFI_DEVICE_ERROR;
+	else {
+		token->BufferSize = n;
+		token->Status = EFI_SUCCESS;
+		__atomic_fetch_add(&mock_bytes_read, n, __ATOMIC_RELAXED);
+	}
+
+	pthread_mutex_lock(&event_lock);
+	f->inflight--;
+	((struct mock_event *)token->Event)->signaled = TRUE;
+	pthread_cond_broadcast(&event_cond);
+	pthread_mutex_unlock(&event_lock);
+
+	free(req);
+	return NULL;
+}
+
+static EFI_STATUS file_read_ex(EFI_FILE *this, EFI_FILE_IO_TOKEN *token)
+{
+	struct mock_file *f = (struct mock_file *)this;
+	struct read_request *req;
+	pthread_t thread;
+	UINT64 len;
+
+	called(CALL_FILE_READ_EX);
+
+	if (f->dir)
+		return EFI_UNSUPPORTED;
+
+	if (!token->Event) {
+		token->Status = file_read(this, &token->BufferSize,
+					  token->Buffer);
+		return token->Status;
+	}
+
+	req = malloc(sizeof(*req));
+	if (!req)
+		return EFI_OUT_OF_RESOURCES;
+
+	req->f = f;
+	req->token = token;
+	req->pos = f->pos;
+
+	/* The position moves as soon as the request is queued */
+	len = f->pos < f->size ? f->size - f->pos : 0;
+	if (len > token->BufferSize)
+		len = token->BufferSize;
+	f->pos += len;
+
+	pthread_mutex_lock(&event_lock);
+	f->inflight++;
+	pthread_mutex_unlock(&event_lock);
+
+	if (pthread_create(&thread, NULL, read_worker, req)) {
+		pthread_mutex_lock(&event_lock);
+		f->inflight--;
+		pthread_mutex_unlock(&event_lock);
+		f->pos = req->pos;
+		free(req);
+		return EFI_OUT_OF_RESOURCES;
+	}
+
+	pthread_detach(thread);
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS file_get_position(EFI_FILE *this, UINT64 *pos)
+{
+	struct mock_file *f = (struct mock_file *)this;
+
+	called(CALL_FILE_GET_POSITION);
+
+	*pos = f->pos;
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS file_set_position(EFI_FILE *this, UINT64 pos)
+{
+	struct mock_file *f = (struct mock_file *)this;
+
+	called(CALL_FILE_SET_POSITION);
+	file_delay(0);
+
+	if (pos == (UINT64)-1)
+		pos = f->size;
+
+	f->pos = pos;
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS
+file_get_info(EFI_FILE *this, EFI_GUID *type, UINTN *size, VOID *buf)
+{
+	struct mock_file *f = (struct mock_file *)this;
+	EFI_FILE_INFO *info = buf;
+	const char *name;
+	UINTN needed, i;
+
+	called(CALL_FILE_GET_INFO);
+	file_delay(0);
+
+	if (memcmp(type, &GenericFileInfo, sizeof(*type)))
+		return EFI_UNSUPPORTED;
+
+	name = strrchr(f->path, '/');
+	name = name ? name + 1 : f->path;
+
+	needed = sizeof(*info) + strlen(name) * sizeof(CHAR16);
+	if (*size < needed) {
+		*size = needed;
+		return EFI_BUFFER_TOO_SMALL;
+	}
+
+	memset(info, 0, needed);
+	info->Size = needed;
+	info->FileSize = f->size;
+	info->PhysicalSize = (f->size + 511) & ~511ULL;
+	info->Attribute = f->dir ? EFI_FILE_DIRECTORY : 0;
+	for (i = 0; name[i]; i++)
+		info->FileName[i] = name[i];
+	info->FileName[i] = 0;
+
+	*size = needed;
+	return EFI_SUCCESS;
+}
+
+static struct mock_file *new_file(struct mock_volume *vol, const char *path)
+{
+	struct mock_file *f;
+	struct stat st;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st)) {
+		close(fd);
+		return NULL;
+	}
+
+	f = calloc(1, sizeof(*f));
+	if (!f) {
+		close(fd);
+		return NULL;
+	}
+
+	f->file.Revision = EFI_FILE_PROTOCOL_REVISION;
+	f->file.Open = file_open;
+	f->file.Close = file_close;
+	f->file.Read = file_read;
+	f->file.GetPosition = file_get_position;
+	f->file.SetPosition = file_set_position;
+	f->file.GetInfo = file_get_info;
+
+	if (!mock_config.sync_files) {
+		f->file.Revision = EFI_FILE_PROTOCOL_REVISION2;
+		f->file.ReadEx = file_read_ex;
+	}
+
+	f->vol = vol;
+	f->fd = fd;
+	f->dir = S_ISDIR(st.st_mode);
+	f->size = f->dir ? 0 : st.st_size;
+	snprintf(f->path, sizeof(f->path), "%s", path);
+
+	return f;
+}
+
+static EFI_STATUS open_volume(EFI_FILE_IO_INTERFACE *this, EFI_FILE **root)
+{
+	struct mock_volume *vol = (struct mock_volume *)this;
+	struct mock_file *f;
+
+	called(CALL_OPEN_VOLUME);
+	file_delay(0);
+	mock_delay(mock_config.mount_us);
+
+	f = new_file(vol, vol->root);
+	if (!f)
+		return EFI_NO_MEDIA;
+
+	*root = &f->file;
+	return EFI_SUCCESS;
+}
+
+/*
+ * Disks
+ *
+ * With fat_disks set, every volume is also offered as a FAT32 disk
+ * holding the same files, with BlockIo, DiskIo and DiskIo2. Requests
+ * share the volume's lock with file reads.
+ */
+struct mock_disk {
+	EFI_BLOCK_IO block;
+	EFI_BLOCK_IO_MEDIA media;
+	EFI_DISK_IO disk;
+	struct disk_io2 disk2;
+	struct mock_volume *vol;
+	UINT8 *image;
+	UINT64 size;
+};
+
+#define disk_of(p, member) \
+	((struct mock_disk *)((char *)(p) - offsetof(struct mock_disk, member)))
+
+static EFI_STATUS do_disk_read(struct mock_disk *d, UINT32 media_id,
+			       UINT64 offset, UINTN size, VOID *buf)
+{
+	if (media_id != d->media.MediaId)
+		return EFI_MEDIA_CHANGED;
+
+	if (offset > d->size || size > d->size - offset)
+		return EFI_INVALID_PARAMETER;
+
+	pthread_mutex_lock(&d->vol->lock);
+	memcpy(buf, d->image + offset, size);
+	disk_delay(size);
+	pthread_mutex_unlock(&d->vol->lock);
+
+	__atomic_fetch_add(&mock_bytes_read, size, __ATOMIC_RELAXED);
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS disk_read(EFI_DISK_IO *this, UINT32 media_id,
+			    UINT64 offset, UINTN size, VOID *buf)
+{
+	called(CALL_DISK_READ);
+	return do_disk_read(disk_of(this, disk), media_id, offset, size, buf);
+}
+
+struct disk_request {
+	struct mock_disk *d;
+	UINT32 media_id;
+	UINT64 offset;
+	struct disk_io2_token *token;
+	UINTN size;
+	VOID *buf;
+};
+
+static void *disk_worker(void *arg)
+{
+	struct disk_request *req = arg;
+
+	req->token->status = do_disk_read(req->d, req->media_id, req->offset,
+					  req->size, req->buf);
+	event_signal(req->token->event);
+
+	free(req);
+	return NULL;
+}
+
+static EFI_STATUS
+disk_read_ex(struct disk_io2 *this, UINT32 media_id, UINT64 offset,
+	     struct disk_io2_token *token, UINTN size, void *buf)
+{
+	struct mock_disk *d = disk_of(this, disk2);
+	struct disk_request *req;
+	pthread_t thread;
+
+	called(CALL_DISK_READ_EX);
+
+	if (!token || !token->event)
+		return do_disk_read(d, media_id, offset, size, buf);
+
+	req = malloc(sizeof(*req));
+	if (!req)
+		return EFI_OUT_OF_RESOURCES;
+
+	req->d = d;
+	req->media_id = media_id;
+	req->offset = offset;
+	req->token = token;
+	req->size = size;
+	req->buf = buf;
+
+	if (pthread_create(&thread, NULL, disk_worker, req)) {
+		free(req);
+		return EFI_OUT_OF_RESOURCES;
+	}
+
+	pthread_detach(thread);
+	return EFI_SUCCESS;
+}
+
+static struct mock_disk *new_disk(struct mock_volume *vol)
+{
+	struct mock_disk *d;
+
+	d = calloc(1, sizeof(*d));
+	if (!d)
+		return NULL;
+
+	d->image = mock_fat_image(vol->root, &d->size);
+	if (!d->image) {
+		free(d);
+		return NULL;
+	}
+
+	d->vol = vol;
+
+	d->media.MediaId = 1;
+	d->media.MediaPresent = TRUE;
+	d->media.LogicalPartition = TRUE;
+	d->media.ReadOnly = TRUE;
+	d->media.BlockSize = 512;
+	d->media.LastBlock = d->size / 512 - 1;
+
+	d->block.Revision = 0x00010000;
+	d->block.Media = &d->media;
+
+	d->disk.Revision = 0x00010000;
+	d->disk.ReadDisk = disk_read;
+
+	d->disk2.revision = 0x00020000;
+	d->disk2.read_disk_ex = disk_read_ex;
+
+	return d;
+}
+
+static struct mock_devpath *new_devpath(const char *text)
+{
+	struct mock_devpath *dp;
+
+	dp = calloc(1, sizeof(*dp));
+	if (!dp)
+		return NULL;
+
+	dp->hdr.Type = 0x7f;
+	dp->hdr.SubType = 0xff;
+	dp->hdr.Length[0] = sizeof(dp->hdr);
+	snprintf(dp->text, sizeof(dp->text), "%s", text);
+
+	return dp;
+}
+
+/*
+ * The text of the device path of the @nr'th volume added, or just of
+ * its last node if !@full.
+ */
+void mock_volume_path(int nr, char *buf, UINTN size, BOOLEAN full)
+{
+	int len = 0;
+
+	if (full)
+		len = snprintf(buf, size, "PciRoot(0x0)/Pci(0x1F,0x2)/"
+			       "Sata(0x%x,0xFFFF,0x0)/", nr);
+
+	snprintf(buf + len, size - len,
+		 "HD(1,GPT,00000000-0000-0000-0000-%012x,0x800,0x100000)",
+		 nr);
+}
+
+EFI_HANDLE mock_add_volume(const char *root)
+{
+	static int nr_volumes;
+	struct mock_volume *vol;
+	struct mock_handle *h;
+	char text[128];
+
+	vol = calloc(1, sizeof(*vol));
+	if (!vol)
+		return NULL;
+
+	vol->io.Revision = 0x00010000;
+	vol->io.OpenVolume = open_volume;
+	pthread_mutex_init(&vol->lock, NULL);
+	snprintf(vol->root, sizeof(vol->root), "%s/", root);
+
+	mock_volume_path(nr_volumes++, text, sizeof(text), TRUE);
+
+	h = new_handle();
+	install(h, &FileSystemProtocol, &vol->io);
+	install(h, &DevicePathProtocol, new_devpath(text));
+
+	if (mock_config.fat_disks) {
+		struct mock_disk *d = new_disk(vol);
+
+		if (!d) {
+			fprintf(stderr, "mock: can't build a disk for %s\n",
+				root);
+			return NULL;
+		}
+
+		install(h, &BlockIoProtocol, &d->block);
+		install(h, &DiskIoProtocol, &d->disk);
+		install(h, &DiskIo2Protocol, &d->disk2);
+	}
+
+	return h;
+}
+
+EFI_HANDLE mock_add_image(EFI_HANDLE device, const char *path,
+			  const char *options)
+{
+	EFI_LOADED_IMAGE *info;
+	struct mock_handle *h;
+	CHAR16 *opts;
+	size_t i, len;
+
+	info = calloc(1, sizeof(*info));
+	if (!info)
+		return NULL;
+
+	len = strlen(options);
+	opts = calloc(len + 1, sizeof(CHAR16));
+	if (!opts)
+		return NULL;
+
+	for (i = 0; i < len; i++)
+		opts[i] = options[i];
+
+	info->Revision = 0x1000;
+	info->SystemTable = mock_system_table;
+	info->DeviceHandle = device;
+	info->FilePath = &new_devpath(path)->hdr;
+	info->LoadOptions = opts;
+	info->LoadOptionsSize = (len + 1) * sizeof(CHAR16);
+	info->ImageCodeType = EfiLoaderCode;
+	info->ImageDataType = EfiLoaderData;
+
+	h = new_handle();
+	install(h, &LoadedImageProtocol, info);
+
+	return h;
+}
+
+/*
+ * Graphics
+ */
+static EFI_GRAPHICS_OUTPUT_MODE_INFORMATION gop_modes[] = {
+	{ 0, 640, 480, PixelBlueGreenRedReserved8BitPerColor, {0}, 640 },
+	{ 0, 800, 600, PixelBlueGreenRedReserved8BitPerColor, {0}, 800 },
+	{ 0, 1024, 768, PixelBlueGreenRedReserved8BitPerColor, {0}, 1024 },
+	{ 0, 1280, 1024, PixelBlueGreenRedReserved8BitPerColor, {0}, 1280 },
+	{ 0, 1920, 1080, PixelBlueGreenRedReserved8BitPerColor, {0}, 1920 },
+	{ 0, 3840, 2160, PixelBlueGreenRedReserved8BitPerColor, {0}, 3840 },
+};
+
+#define NR_GOP_MODES	(sizeof(gop_modes) / sizeof(gop_modes[0]))
+
+/* The mode of the last GOP added, for the harness to report */
+static EFI_GRAPHICS_OUTPUT_PROTOCOL_MODE *last_gop_mode;
+
+static EFI_STATUS
+gop_query_mode(EFI_GRAPHICS_OUTPUT_PROTOCOL *gop, UINT32 mode,
+	       UINTN *size, EFI_GRAPHICS_OUTPUT_MODE_INFORMATION **info)
+{
+	called(CALL_GOP_QUERY_MODE);
+
+	if (mode >= gop->Mode->MaxMode)
+		return EFI_INVALID_PARAMETER;
+
+	allocate_pool(EfiBootServicesData, sizeof(**info), (VOID **)info);
+	memcpy(*info, &gop_modes[mode], sizeof(**info));
+	*size = sizeof(**info);
+
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS
+gop_set_mode(EFI_GRAPHICS_OUTPUT_PROTOCOL *gop, UINT32 mode)
+{
+	EFI_GRAPHICS_OUTPUT_PROTOCOL_MODE *m = gop->Mode;
+
+	called(CALL_GOP_SET_MODE);
+
+	if (mode >= m->MaxMode)
+		return EFI_UNSUPPORTED;
+
+	/* Mode switches are slow on real hardware */
+	mock_delay(20000);
+
+	m->Mode = mode;
+	m->Info = &gop_modes[mode];
+	m->FrameBufferSize = (UINTN)m->Info->PixelsPerScanLine *
+		m->Info->VerticalResolution * 4;
+
+	return EFI_SUCCESS;
+}
+
+EFI_HANDLE mock_add_gop(UINT32 width, UINT32 height)
+{
+	static EFI_GUID gop_guid = EFI_GRAPHICS_OUTPUT_PROTOCOL_GUID;
+	EFI_GRAPHICS_OUTPUT_PROTOCOL *gop;
+	EFI_GRAPHICS_OUTPUT_PROTOCOL_MODE *mode;
+	struct mock_handle *h;
+	UINT32 i;
+	void *fb;
+
+	gop = calloc(1, sizeof(*gop));
+	mode = calloc(1, sizeof(*mode));
+	if (!gop || !mode)
+		return NULL;
+
+	/* Big enough for the largest mode */
+	fb = mmap(NULL, 3840 * 2160 * 4, PROT_READ | PROT_WRITE,
+		  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (fb == MAP_FAILED)
+		return NULL;
+
+	gop->QueryMode = gop_query_mode;
+	gop->SetMode = gop_set_mode;
+	gop->Mode = mode;
+
+	mode->MaxMode = NR_GOP_MODES;
+	mode->SizeOfInfo = sizeof(EFI_GRAPHICS_OUTPUT_MODE_INFORMATION);
+	mode->FrameBufferBase = (EFI_PHYSICAL_ADDRESS)(UINTN)fb;
+
+	/* Start in the requested mode, as the firmware would have */
+	for (i = 0; i < NR_GOP_MODES - 1; i++) {
+		if (gop_modes[i].HorizontalResolution == width &&
+		    gop_modes[i].VerticalResolution == height)
+			break;
+	}
+	mode->Mode = i;
+	mode->Info = &gop_modes[i];
+	mode->FrameBufferSize = (UINTN)mode->Info->PixelsPerScanLine *
+		mode->Info->VerticalResolution * 4;
+
+	h = new_handle();
+	install(h, &gop_guid, gop);
+	last_gop_mode = mode;
+
+	return h;
+}
+
+/**
+ * mock_gop_mode - The resolution of the last GOP added
+ * @width: filled in with its width
+ * @height: filled in with its height
+ *
+ * Returns FALSE if there is no GOP.
+ */
+BOOLEAN mock_gop_mode(UINT32 *width, UINT32 *height)
+{
+	if (!last_gop_mode)
+		return FALSE;
+
+	*width = last_gop_mode->Info->HorizontalResolution;
+	*height = last_gop_mode->Info->VerticalResolution;
+	return TRUE;
+}
+
+/*
+ * Console
+ */
+static EFI_STATUS
+output_string(SIMPLE_TEXT_OUTPUT_INTERFACE *this, CHAR16 *str)
+{
+	called(CALL_OUTPUT_STRING);
+	mock_delay(mock_config.console_us);
+
+	if (mock_config.quiet)
+		return EFI_SUCCESS;
+
+	for (; *str; str++) {
+		if (*str == '\r')
+			continue;
+		putchar(*str < 0x80 ? *str : '?');
+	}
+
+	return EFI_SUCCESS;
+}
+
+/*
+ * System table
+ */
+static SIMPLE_TEXT_OUTPUT_INTERFACE con_out = {
+	.OutputString = output_string,
+};
+
+static EFI_BOOT_SERVICES boot_services = {
+	.Hdr = { .Signature = 0x56524553544f4f42ULL,
+		 .HeaderSize = sizeof(EFI_BOOT_SERVICES) },
+	.AllocatePages = allocate_pages,
+	.FreePages = free_pages,
+	.GetMemoryMap = get_memory_map,
+	.AllocatePool = allocate_pool,
+	.FreePool = free_pool,
+	.HandleProtocol = handle_protocol,
+	.LocateHandle = locate_handle,
+	.Exit = efi_exit,
+	.ExitBootServices = exit_boot_services,
+	.Stall = stall,
+	.CreateEvent = create_event,
+	.WaitForEvent = wait_for_event,
+	.SignalEvent = signal_event,
+	.CloseEvent = close_event,
+	.CheckEvent = check_event,
+	.LocateProtocol = locate_protocol,
+};
+
+static EFI_RUNTIME_SERVICES runtime_services = {
+	.Hdr = { .Signature = 0x56524553544e5552ULL,
+		 .HeaderSize = sizeof(EFI_RUNTIME_SERVICES) },
+};
+
+static CHAR16 vendor[] = { 'm', 'o', 'c', 'k', 0 };
+
+static EFI_SYSTEM_TABLE system_table = {
+	.Hdr = { .Signature = 0x5453595320494249ULL,
+		 .Revision = (2 << 16) | 70,
+		 .HeaderSize = sizeof(EFI_SYSTEM_TABLE) },
+	.FirmwareVendor = vendor,
+	.FirmwareRevision = 1,
+	.ConOut = &con_out,
+	.StdErr = &con_out,
+	.RuntimeServices = &runtime_services,
+	.BootServices = &boot_services,
+};
+
+/*
+ * ACPI
+ *
+ * With more than one node, RAM above 1MiB is split evenly between
+ * that many proximity domains and every CPU is put in the last one.
+ * The HMAT makes node 0 slowest, like CXL memory, and node 1 a touch
+ * faster than the local node on paper, as remote DRAM can be, when
+ * there are enough nodes. The local node is described in GB/s and
+ * the others in MB/s, by two locality structures.
+ *
+ * With a UART, the SPCR points at it.
+ */
+#define MAX_APIC_IDS	256
+
+static EFI_CONFIGURATION_TABLE config_tables[1];
+
+static UINT64 node_step(void)
+{
+	return (mock_config.mem_size / mock_config.nodes) &
+		~(UINT64)EFI_PAGE_MASK;
+}
+
+int mock_node(EFI_PHYSICAL_ADDRESS addr)
+{
+	UINT64 n;
+
+	if (addr < HIGH_MEM_START ||
+	    addr >= HIGH_MEM_START + mock_config.mem_size)
+		return -1;
+
+	if (mock_config.nodes <= 1)
+		return 0;
+
+	n = (addr - HIGH_MEM_START) / node_step();
+	if (n >= mock_config.nodes)
+		n = mock_config.nodes - 1;
+
+	return n;
+}
+
+static void fill_header(struct acpi_header *h, const char *sig, UINT32 len)
+{
+	UINT8 sum = 0;
+	UINT32 i;
+
+	memcpy(h->signature, sig, 4);
+	h->length = len;
+	h->revision = 1;
+	memcpy(h->oem_id, "MOCK  ", 6);
+	memcpy(h->oem_table_id, "EFILINUX", 8);
+
+	for (i = 0; i < len; i++)
+		sum += ((UINT8 *)h)[i];
+	h->checksum = -sum;
+}
+
+/*
+ * Add a read bandwidth locality structure from 'initiator' to
+ * 'nr' targets, starting at 'first', at 'p'. Returns its length.
+ */
+static UINT32 build_locality(void *p, UINT32 initiator, UINT32 first,
+			     UINT32 nr, UINT64 unit)
+{
+	struct acpi_hmat_locality *loc = p;
+	UINT32 *initiators, *targets;
+	UINT16 *entries;
+	unsigned int nodes = mock_config.nodes, i;
+
+	loc->hdr.type = ACPI_HMAT_LOCALITY;
+	loc->hdr.length = sizeof(*loc) + (1 + nr) * sizeof(UINT32) +
+		nr * sizeof(UINT16);
+	loc->data_type = ACPI_HMAT_READ_BANDWIDTH;
+	loc->nr_initiators = 1;
+	loc->nr_targets = nr;
+	loc->entry_base_unit = unit;
+
+	initiators = (UINT32 *)(loc + 1);
+	targets = initiators + 1;
+	entries = (UINT16 *)(targets + nr);
+	initiators[0] = initiator;
+	for (i = 0; i < nr; i++) {
+		UINT64 mbps;
+
+		targets[i] = first + i;
+		if (first + i == initiator)
+			mbps = 20000;
+		else if (first + i == 0 && nodes > 2)
+			mbps = 4000;
+		else if (first + i == 1 && nodes > 3)
+			mbps = 22000;
+		else
+			mbps = 10000;
+		entries[i] = mbps / unit;
+	}
+
+	return loc->hdr.length;
+}
+
+static unsigned int build_numa(UINT64 *tables)
+{
+	unsigned int nodes = mock_config.nodes, cpu_node = nodes - 1;
+	struct acpi_srat_x2apic_affinity *cpu;
+	struct acpi_srat_mem_affinity *mem;
+	struct acpi_srat *srat;
+	struct acpi_hmat *hmat;
+	UINT32 len, loc_len;
+	unsigned int i;
+
+	len = sizeof(*srat) + nodes * sizeof(*mem) +
+		MAX_APIC_IDS * sizeof(*cpu);
+	srat = calloc(1, len);
+	mem = (struct acpi_srat_mem_affinity *)(srat + 1);
+	for (i = 0; i < nodes; i++, mem++) {
+		UINT64 start = HIGH_MEM_START + i * node_step();
+		UINT64 end = start + node_step();
+
+		if (i == nodes - 1)
+			end = HIGH_MEM_START + mock_config.mem_size;
+
+		mem->type = ACPI_SRAT_MEM_AFFINITY;
+		mem->length = sizeof(*mem);
+		mem->proximity_domain = i;
+		mem->base = start;
+		mem->size = end - start;
+		mem->flags = ACPI_SRAT_ENABLED;
+	}
+
+	/* Whichever CPU we run on, it's in cpu_node */
+	cpu = (struct acpi_srat_x2apic_affinity *)mem;
+	for (i = 0; i < MAX_APIC_IDS; i++, cpu++) {
+		cpu->type = ACPI_SRAT_X2APIC_AFFINITY;
+		cpu->length = sizeof(*cpu);
+		cpu->proximity_domain = cpu_node;
+		cpu->apic_id = i;
+		cpu->flags = ACPI_SRAT_ENABLED;
+	}
+	fill_header(&srat->hdr, ACPI_SRAT_SIGNATURE, len);
+
+	/* Room for both locality structures */
+	loc_len = 2 * sizeof(struct acpi_hmat_locality) +
+		(2 + nodes) * sizeof(UINT32) + nodes * sizeof(UINT16);
+	hmat = calloc(1, sizeof(*hmat) + loc_len);
+	len = sizeof(*hmat);
+	len += build_locality((char *)hmat + len, cpu_node, cpu_node, 1, 1000);
+	if (cpu_node)
+		len += build_locality((char *)hmat + len, cpu_node, 0,
+				      cpu_node, 1);
+	fill_header(&hmat->hdr, ACPI_HMAT_SIGNATURE, len);
+
+	if (mock_config.sp_node0)
+		set_attr(HIGH_MEM_START, HIGH_MEM_START + node_step(),
+			 EFI_MEMORY_SP);
+
+	tables[0] = (UINTN)srat;
+	tables[1] = (UINTN)hmat;
+	return 2;
+}
+
+static UINT64 build_spcr(void)
+{
+	struct acpi_spcr *spcr;
+
+	spcr = calloc(1, sizeof(*spcr));
+	spcr->interface_type = ACPI_SPCR_16550;
+	spcr->base.space_id = ACPI_GAS_IO;
+	spcr->base.bit_width = 8;
+	spcr->base.access_size = ACPI_GAS_ACCESS_BYTE;
+	spcr->base.address = MOCK_UART_BASE;
+	spcr->baud_rate = ACPI_SPCR_BAUD_115200;
+	spcr->stop_bits = 1;
+	spcr->pci_device_id = 0xffff;
+	spcr->pci_vendor_id = 0xffff;
+	fill_header(&spcr->hdr, ACPI_SPCR_SIGNATURE, sizeof(*spcr));
+
+	return (UINTN)spcr;
+}
+
+static void build_acpi(void)
+{
+	struct acpi_header *xsdt;
+	struct acpi_rsdp *rsdp;
+	UINT64 tables[3];
+	unsigned int i, nr = 0;
+	UINT32 len;
+	UINT8 sum = 0;
+
+	if (mock_config.nodes > 1)
+		nr += build_numa(tables);
+	if (mock_config.uart)
+		tables[nr++] = build_spcr();
+
+	len = sizeof(*xsdt) + nr * sizeof(UINT64);
+	xsdt = calloc(1, len);
+	memcpy(xsdt + 1, tables, nr * sizeof(UINT64));
+	fill_header(xsdt, ACPI_XSDT_SIGNATURE, len);
+
+	rsdp = calloc(1, sizeof(*rsdp));
+	memcpy(rsdp->signature, ACPI_RSDP_SIGNATURE, 8);
+	memcpy(rsdp->oem_id, "MOCK  ", 6);
+	rsdp->revision = 2;
+	rsdp->length = sizeof(*rsdp);
+	rsdp->xsdt_address = (UINTN)xsdt;
+	for (i = 0; i < 20; i++)
+		sum += ((UINT8 *)rsdp)[i];
+	rsdp->checksum = -sum;
+
+	config_tables[0].VendorGuid = Acpi20TableGuid;
+	config_tables[0].VendorTable = rsdp;
+	system_table.NumberOfTableEntries = 1;
+	system_table.ConfigurationTable = config_tables;
+}
+
+/**
+ * mock_init - Map "physical" memory and build the memory map
+ *
+ * RAM is mapped at its physical address: the 640K of low memory
+ * used for the command line and mock_config.mem_size bytes from 1MiB
+ * upwards. If fragments > 1, RAM is carved up into that many
+ * conventional ranges to produce a large memory map.
+ */
+int mock_init(void)
+{
+	UINT64 start, end, step;
+	unsigned int i;
+	void *p;
+
+	p = mmap((void *)LOW_MEM_START, LOW_MEM_END - LOW_MEM_START,
+		 PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+	if (p != (void *)LOW_MEM_START) {
+		perror("mock: mapping low memory");
+		return -1;
+	}
+
+	p = mmap((void *)HIGH_MEM_START, mock_config.mem_size,
+		 PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS |
+		 MAP_NORESERVE | MAP_FIXED_NOREPLACE, -1, 0);
+	if (p != (void *)HIGH_MEM_START) {
+		perror("mock: mapping high memory");
+		return -1;
+	}
+
+	add_region(EfiConventionalMemory, LOW_MEM_START, LOW_MEM_END);
+	add_region(EfiReservedMemoryType, LOW_MEM_END, HIGH_MEM_START);
+
+	end = HIGH_MEM_START + mock_config.mem_size;
+	if (mock_config.fragments < 1)
+		mock_config.fragments = 1;
+
+	step = (mock_config.mem_size / mock_config.fragments) &
+		~(UINT64)EFI_PAGE_MASK;
+	if (step < EFI_PAGE_SIZE)
+		step = EFI_PAGE_SIZE;
+
+	for (i = 0, start = HIGH_MEM_START; start < end; i++) {
+		UINT64 next = start + step;
+
+		if (next > end || i == mock_config.fragments - 1)
+			next = end;
+
+		/* Separate fragments with a page of boot services data */
+		if (next != end) {
+			add_region(EfiConventionalMemory, start,
+				   next - EFI_PAGE_SIZE);
+			add_region(mock_config.reserved_gaps ?
+				   EfiReservedMemoryType : EfiBootServicesData,
+				   next - EFI_PAGE_SIZE, next);
+		} else
+			add_region(EfiConventionalMemory, start, next);
+
+		start = next;
+	}
+
+	if (mock_config.nodes > 1 || mock_config.uart)
+		build_acpi();
+
+	bsp = pthread_self();
+	if (mock_config.cpus) {
+		struct mock_handle *h;
+
+		aps = calloc(mock_config.cpus, sizeof(*aps));
+		if (!aps)
+			return -1;
+
+		for (i = 0; i < mock_config.cpus; i++)
+			aps[i].cpu = i;
+
+		h = new_handle();
+		install(h, &MpServicesProtocol, &mp_services);
+	}
+
+	mock_system_table = &system_table;
+	return 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The host build's replacement for x86_64.h and i386.h. Rather than
+ * jumping to the kernel, hand control back to the benchmark harness,
+ * and rather than touching I/O ports, talk to the mock's devices.
+ */
+
+#ifndef __HOST_H__
+#define __HOST_H__
+
+#define EFI_LOADER_SIGNATURE	"EL64"
+
+struct boot_params;
+
+extern void host_jump(BOOLEAN handover, EFI_HANDLE image,
+		      struct boot_params *bp,
+		      EFI_PHYSICAL_ADDRESS kernel_start)
+	__attribute__((noreturn));
+
+static inline void kernel_jump(EFI_PHYSICAL_ADDRESS kernel_start,
+			       struct boot_params *boot_params)
+{
+	host_jump(FALSE, NULL, boot_params, kernel_start);
+}
+
+static inline void handover_jump(UINT16 kernel_version, EFI_HANDLE image,
+				 struct boot_params *bp,
+				 EFI_PHYSICAL_ADDRESS kernel_start)
+{
+	host_jump(TRUE, image, bp, kernel_start);
+}
+
+extern UINT8 host_uart_in(UINT64 addr, BOOLEAN mmio);
+extern void host_uart_out(UINT64 addr, BOOLEAN mmio, UINT8 val);
+
+#endif /* __HOST_H__ */
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Interface between the mock firmware and the benchmark harness.
+ */
+
+#ifndef __HOST_MOCK_H__
+#define __HOST_MOCK_H__
+
+#include "efi.h"
+
+enum mock_call {
+	CALL_ALLOCATE_PAGES,
+	CALL_FREE_PAGES,
+	CALL_GET_MEMORY_MAP,
+	CALL_ALLOCATE_POOL,
+	CALL_FREE_POOL,
+	CALL_HANDLE_PROTOCOL,
+	CALL_LOCATE_HANDLE,
+	CALL_LOCATE_PROTOCOL,
+	CALL_EXIT_BOOT_SERVICES,
+	CALL_STALL,
+	CALL_OUTPUT_STRING,
+	CALL_OPEN_VOLUME,
+	CALL_FILE_OPEN,
+	CALL_FILE_CLOSE,
+	CALL_FILE_READ,
+	CALL_FILE_READ_EX,
+	CALL_FILE_GET_POSITION,
+	CALL_FILE_SET_POSITION,
+	CALL_FILE_GET_INFO,
+	CALL_DISK_READ,
+	CALL_DISK_READ_EX,
+	CALL_GOP_QUERY_MODE,
+	CALL_GOP_SET_MODE,
+	CALL_CREATE_EVENT,
+	CALL_WAIT_FOR_EVENT,
+	CALL_SIGNAL_EVENT,
+	CALL_CLOSE_EVENT,
+	CALL_CHECK_EVENT,
+	CALL_MP_GET_NR_PROCESSORS,
+	CALL_MP_STARTUP_ALL_APS,
+	CALL_MP_STARTUP_THIS_AP,
+	CALL_MP_WHO_AM_I,
+	NR_MOCK_CALLS
+};
+
+struct mock_config {
+	UINT64 mem_size;		/* bytes of RAM above 1MiB */
+	unsigned int fragments;		/* split RAM into this many ranges */
+	BOOLEAN reserved_gaps;		/* ...separated by reserved pages */
+	unsigned long latency_us;	/* added to every file call */
+	unsigned long bandwidth;	/* file read MB/s, 0 is unlimited */
+	unsigned long console_us;	/* added to every OutputString */
+	BOOLEAN quiet;			/* don't echo console output */
+	unsigned int nodes;		/* split RAM into NUMA nodes */
+	BOOLEAN sp_node0;		/* node 0 is specific-purpose memory */
+	BOOLEAN sync_files;		/* files don't implement ReadEx */
+	unsigned long fs_request;	/* bytes per filesystem disk request */
+	BOOLEAN fat_disks;		/* offer volumes as FAT32 disks too */
+	unsigned int fat_gap;		/* fragment files every n clusters */
+	unsigned int cpus;		/* offer MP services with n CPUs */
+	unsigned long mount_us;		/* added to every OpenVolume */
+	unsigned int exit_races;	/* fail ExitBootServices n times */
+	BOOLEAN uart;			/* 16550 at COM1, listed in the SPCR */
+};
+
+#define MOCK_UART_BASE	0x3f8
+
+/*
+ * Device paths are opaque to efilinux, apart from being turned into
+ * strings, so the mock just carries the string around.
+ */
+struct mock_devpath {
+	EFI_DEVICE_PATH hdr;
+	char text[128];
+};
+
+extern struct mock_config mock_config;
+extern unsigned long mock_calls[NR_MOCK_CALLS];
+extern const char *mock_call_names[NR_MOCK_CALLS];
+extern UINT64 mock_bytes_read;
+extern UINT64 mock_uart_bytes;
+extern UINT64 mock_uart_overruns;
+extern EFI_SYSTEM_TABLE *mock_system_table;
+
+extern int mock_init(void);
+extern EFI_HANDLE mock_add_volume(const char *root);
+extern void mock_volume_path(int nr, char *buf, UINTN size, BOOLEAN full);
+extern EFI_HANDLE mock_add_gop(UINT32 width, UINT32 height);
+extern BOOLEAN mock_gop_mode(UINT32 *width, UINT32 *height);
+extern EFI_HANDLE mock_add_image(EFI_HANDLE device, const char *path,
+				 const char *options);
+extern UINTN mock_nr_descriptors(void);
+extern int mock_node(EFI_PHYSICAL_ADDRESS addr);
+extern void mock_delay(unsigned long usecs);
+extern UINT8 *mock_fat_image(const char *root, UINT64 *size);
+
+/* Provided by the harness */
+extern void host_exit(EFI_STATUS status) __attribute__((noreturn));
+
+#endif /* __HOST_MOCK_H__ */
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * A 16550 UART at the legacy COM1 address, for the direct serial
+ * console. Bytes drain at the programmed baud rate, so a writer that
+ * doesn't wait for the FIFO to empty loses them, as it would on real
+ * hardware, and those losses are counted.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "efi.h"
+#include "mock.h"
+#include "host.h"
+#include "../uart.h"
+
+UINT64 mock_uart_bytes;
+UINT64 mock_uart_overruns;
+
+static struct {
+	UINT8 ier, fcr, lcr, mcr, scr;
+	UINT16 divisor;
+	UINT64 idle_at;		/* ns, when the last byte leaves the wire */
+} uart = { .divisor = 1 };
+
+static UINT64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* A start bit, eight data bits and a stop bit */
+static UINT64 byte_ns(void)
+{
+	return 10 * 1000000000ULL * uart.divisor / UART_BASE_BAUD;
+}
+
+static void check_port(UINT64 addr, BOOLEAN mmio)
+{
+	if (!mmio)
+		return;
+
+	fprintf(stderr, "mock: UART access to MMIO address 0x%llx\n",
+		(unsigned long long)addr);
+	abort();
+}
+
+UINT8 host_uart_in(UINT64 addr, BOOLEAN mmio)
+{
+	UINT64 reg = addr - MOCK_UART_BASE;
+	UINT64 now;
+
+	check_port(addr, mmio);
+
+	/* Nothing answers on an empty port */
+	if (!mock_config.uart || addr < MOCK_UART_BASE || reg > UART_SCR)
+		return 0xff;
+
+	switch (reg) {
+	case UART_DLL:
+		if (uart.lcr & UART_LCR_DLAB)
+			return uart.divisor & 0xff;
+		return 0;
+	case UART_IER:
+		if (uart.lcr & UART_LCR_DLAB)
+			return uart.divisor >> 8;
+		return uart.ier;
+	case UART_LCR:
+		return uart.lcr;
+	case UART_MCR:
+		return uart.mcr;
+	case UART_LSR:
+		now = now_ns();
+		if (now >= uart.idle_at)
+			return UART_LSR_THRE | UART_LSR_TEMT;
+		/* Only the shift register is still busy */
+		if (uart.idle_at - now <= byte_ns())
+			return UART_LSR_THRE;
+		return 0;
+	case UART_SCR:
+		return uart.scr;
+	}
+
+	return 0;
+}
+
+static void transmit(UINT8 val)
+{
+	UINT64 now = now_ns(), queued;
+	UINT64 depth = (uart.fcr & UART_FCR_ENABLE) ? UART_FIFO_SIZE : 1;
+
+	if (uart.idle_at < now)
+		uart.idle_at = now;
+
+	/* Bytes still waiting, counting the one in the shift register */
+	queued = (uart.idle_at - now + byte_ns() - 1) / byte_ns();
+	if (queued > depth) {
+		mock_uart_overruns++;
+		return;
+	}
+
+	uart.idle_at += byte_ns();
+	mock_uart_bytes++;
+
+	if (!mock_config.quiet && val != '\r')
+		putchar(val);
+}
+
+void host_uart_out(UINT64 addr, BOOLEAN mmio, UINT8 val)
+{
+	UINT64 reg = addr - MOCK_UART_BASE;
+
+	check_port(addr, mmio);
+
+	if (!mock_config.uart || addr < MOCK_UART_BASE || reg > UART_SCR)
+		return;
+
+	switch (reg) {
+	case UART_THR:
+		if (uart.lcr & UART_LCR_DLAB)
+			uart.divisor = (uart.divisor & 0xff00) | val;
+		else
+			transmit(val);
+		break;
+	case UART_IER:
+		if (uart.lcr & UART_LCR_DLAB)
+			uart.divisor = (uart.divisor & 0xff) | (val << 8);
+		else
+			uart.ier = val;
+		break;
+	case UART_FCR:
+		uart.fcr = val;
+		break;
+	case UART_LCR:
+		uart.lcr = val;
+		break;
+	case UART_MCR:
+		uart.mcr = val;
+		break;
+	case UART_SCR:
+		uart.scr = val;
+		break;
+	}
+
+	if (!uart.divisor)
+		uart.divisor = 1;
+}
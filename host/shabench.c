@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Check efilinux's SHA-256 against the FIPS 180-4 examples and
+ * measure how fast each compression function hashes.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "efi.h"
+#include "../sha256.h"
+
+#define BUF_SIZE	(64 << 20)
+
+static const struct {
+	const char *msg;
+	UINTN repeat;
+	const char *digest;
+} vectors[] = {
+	{ "", 1,
+	  "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+	{ "abc", 1,
+	  "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+	{ "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+	  "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+	{ "a", 1000000,
+	  "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" },
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void hex(const UINT8 *digest, char *str)
+{
+	int i;
+
+	for (i = 0; i < SHA256_DIGEST_SIZE; i++)
+		sprintf(str + i * 2, "%02x", digest[i]);
+}
+
+static int check_vectors(void)
+{
+	UINT8 digest[SHA256_DIGEST_SIZE];
+	char str[SHA256_DIGEST_SIZE * 2 + 1];
+	struct sha256 ctx;
+	UINTN i, j;
+
+	for (i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+		sha256_init(&ctx);
+		for (j = 0; j < vectors[i].repeat; j++)
+			sha256_update(&ctx, vectors[i].msg,
+				      strlen(vectors[i].msg));
+		sha256_final(&ctx, digest);
+
+		hex(digest, str);
+		if (strcmp(str, vectors[i].digest)) {
+			fprintf(stderr, "%s: vector %lu: got %s\n",
+				sha256_impl(), (unsigned long)i, str);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Hash the same buffer in pieces of every length up to a few blocks,
+ * so that the partial block handling is exercised too.
+ */
+static void hash_pieces(const UINT8 *buf, UINTN len, UINT8 *digest)
+{
+	struct sha256 ctx;
+	UINTN off, n;
+
+	sha256_init(&ctx);
+	for (off = 0, n = 0; off < len; off += n) {
+		n = (off * 7 + 1) % 200;
+		if (n > len - off)
+			n = len - off;
+		sha256_update(&ctx, buf + off, n);
+	}
+	sha256_final(&ctx, digest);
+}
+
+static int check_pieces(const UINT8 *buf)
+{
+	UINT8 one[SHA256_DIGEST_SIZE], pieces[SHA256_DIGEST_SIZE];
+	struct sha256 ctx;
+	UINTN len;
+
+	for (len = 0; len < 4096; len += 13) {
+		sha256_init(&ctx);
+		sha256_update(&ctx, buf, len);
+		sha256_final(&ctx, one);
+
+		hash_pieces(buf, len, pieces);
+		if (memcmp(one, pieces, sizeof(one))) {
+			fprintf(stderr, "%s: pieces mismatch: len %lu\n",
+				sha256_impl(), (unsigned long)len);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static double measure(const UINT8 *buf, UINTN len, UINT8 *digest)
+{
+	struct sha256 ctx;
+	double t;
+
+	t = now();
+	sha256_init(&ctx);
+	sha256_update(&ctx, buf, len);
+	sha256_final(&ctx, digest);
+	t = now() - t;
+
+	return len / t / (1 << 20);
+}
+
+int main(int argc, char **argv)
+{
+	UINT8 accel[SHA256_DIGEST_SIZE], generic[SHA256_DIGEST_SIZE];
+	UINT8 *buf;
+	UINTN i;
+	double r;
+
+	buf = malloc(BUF_SIZE);
+	if (!buf)
+		return 1;
+
+	for (i = 0; i < BUF_SIZE; i++)
+		buf[i] = (i * 7 + 1) % 255;
+
+	sha256_accel = FALSE;
+	if (check_vectors() || check_pieces(buf))
+		return 1;
+
+	r = measure(buf, BUF_SIZE, generic);
+	printf("%-8s %8.0f MB/s\n", sha256_impl(), r);
+
+	sha256_accel = TRUE;
+	if (!strcmp(sha256_impl(), "generic"))
+		return 0;
+
+	if (check_vectors() || check_pieces(buf))
+		return 1;
+
+	r = measure(buf, BUF_SIZE, accel);
+	printf("%-8s %8.0f MB/s\n", sha256_impl(), r);
+
+	if (memcmp(accel, generic, sizeof(accel))) {
+		fprintf(stderr, "%s and generic disagree\n", sha256_impl());
+		return 1;
+	}
+
+	return 0;
+}
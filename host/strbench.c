@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Compare efilinux's memcpy(), memset() and strlen() with the byte
+ * loops they replaced, for buffers from 16 bytes to 1GiB.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "efi.h"
+
+#define MIN_SIZE	16ULL
+#define MAX_SIZE	(1ULL << 30)
+
+/* Enough iterations at each size to keep the clock honest */
+#define WORK		(256ULL << 20)
+
+/* Keeps the strlen() calls from being optimized away */
+static volatile UINT64 sink;
+
+extern void *efi_memcpy(void *dst, const void *src, UINTN size);
+extern void *efi_memset(void *dst, int ch, UINTN size);
+extern UINTN efi_strlen(const char *str);
+
+/*
+ * The original stdlib.h loops. The EFI build compiles them without
+ * optimization, so stop the compiler from vectorizing them here.
+ */
+#define REFERENCE __attribute__((noinline, \
+	optimize("no-tree-vectorize,no-tree-loop-distribute-patterns")))
+
+static REFERENCE void ref_memset(char *dst, char ch, UINTN size)
+{
+	int i;
+
+	for (i = 0; i < size; i++)
+		dst[i] = ch;
+}
+
+static REFERENCE void ref_memcpy(char *dst, char *src, UINTN size)
+{
+	int i;
+
+	for (i = 0; i < size; i++)
+		*dst++ = *src++;
+}
+
+static REFERENCE int ref_strlen(char *str)
+{
+	int len;
+
+	len = 0;
+	while (*str++)
+		len++;
+
+	return len;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *map(UINT64 size)
+{
+	void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (p == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+
+	return p;
+}
+
+static void fill(unsigned char *buf, UINT64 size)
+{
+	UINT64 i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = (i * 7 + 1) % 255 + 1;
+}
+
+/*
+ * Check every alignment and length up to a few vector loops, plus a
+ * handful of large sizes, against the C library.
+ */
+static int check(unsigned char *a, unsigned char *b, unsigned char *c)
+{
+	UINTN len, da, sa;
+
+	for (len = 0; len < 1200; len += (len < 300) ? 1 : 37) {
+		for (da = 0; da < 33; da += 3) {
+			for (sa = 0; sa < 33; sa += 5) {
+				memset(a, 0x11, len + 128);
+				memset(c, 0x11, len + 128);
+				efi_memcpy(a + da, b + sa, len);
+				memcpy(c + da, b + sa, len);
+				if (memcmp(a, c, len + 128))
+					goto fail_memcpy;
+			}
+
+			efi_memset(a + da, 0xa5, len);
+			memset(c + da, 0xa5, len);
+			if (memcmp(a, c, len + 128))
+				goto fail_memset;
+
+			b[da + len] = '\0';
+			if (efi_strlen((char *)b + da) != strlen((char *)b + da))
+				goto fail_strlen;
+			b[da + len] = 1;
+		}
+	}
+
+	for (len = (5 << 20) - 3; len < (32 << 20); len *= 3) {
+		efi_memset(a + 1, 0x5a, len);
+		memset(c + 1, 0x5a, len);
+		efi_memcpy(c + 3, b + 1, len);
+		memcpy(a + 3, b + 1, len);
+		if (memcmp(a, c, len + 3))
+			goto fail_memcpy;
+	}
+
+	return 0;
+
+fail_memcpy:
+	fprintf(stderr, "memcpy mismatch: len %lu\n", (unsigned long)len);
+	return 1;
+fail_memset:
+	fprintf(stderr, "memset mismatch: len %lu\n", (unsigned long)len);
+	return 1;
+fail_strlen:
+	fprintf(stderr, "strlen mismatch: len %lu\n", (unsigned long)len);
+	return 1;
+}
+
+static double rate(UINT64 bytes, double secs)
+{
+	return bytes / secs / (1 << 20);
+}
+
+int main(int argc, char **argv)
+{
+	UINT64 max = MAX_SIZE, size;
+	unsigned char *src, *dst;
+
+	if (argc > 1)
+		max = strtoull(argv[1], NULL, 0) << 20;
+
+	src = map(max + 64);
+	dst = map(max + 64);
+	fill(src, max + 64);
+	memset(dst, 0, max + 64);
+
+	if (check(dst, src, map(64 << 20)))
+		return 1;
+
+	printf("%10s %10s %10s %8s %10s %10s %8s %10s %10s %8s\n", "size",
+	       "memcpy", "old", "x", "memset", "old", "x",
+	       "strlen", "old", "x");
+
+	for (size = MIN_SIZE; size <= max; size <<= 2) {
+		UINT64 iters = WORK / size ? WORK / size : 1;
+		double t, r[6];
+		UINT64 i;
+
+		t = now();
+		for (i = 0; i < iters; i++)
+			efi_memcpy(dst, src, size);
+		r[0] = rate(size * iters, now() - t);
+
+		t = now();
+		for (i = 0; i < iters; i++)
+			ref_memcpy((char *)dst, (char *)src, size);
+		r[1] = rate(size * iters, now() - t);
+
+		t = now();
+		for (i = 0; i < iters; i++)
+			efi_memset(dst, i, size);
+		r[2] = rate(size * iters, now() - t);
+
+		t = now();
+		for (i = 0; i < iters; i++)
+			ref_memset((char *)dst, i, size);
+		r[3] = rate(size * iters, now() - t);
+
+		src[size - 1] = '\0';
+		t = now();
+		for (i = 0; i < iters; i++)
+			sink += efi_strlen((char *)src);
+		r[4] = rate(size * iters, now() - t);
+
+		t = now();
+		for (i = 0; i < iters; i++)
+			sink += ref_strlen((char *)src);
+		r[5] = rate(size * iters, now() - t);
+		src[size - 1] = 1;
+
+		printf("%10llu %8.0fMB %8.0fMB %7.1fx %8.0fMB %8.0fMB %7.1fx "
+		       "%8.0fMB %8.0fMB %7.1fx\n", (unsigned long long)size,
+		       r[0], r[1], r[0] / r[1], r[2], r[3], r[2] / r[3],
+		       r[4], r[5], r[4] / r[5]);
+	}
+
+	return 0;
+}
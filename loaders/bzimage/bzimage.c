@@ -32,11 +32,25 @@
 #include "efilinux.h"
 #include "bzimage.h"
 #include "fs.h"
+#include "fat.h"
+#include "aio.h"
+#include "stream.h"
 #include "loader.h"
+#include "profile.h"
 #include "protocol.h"
 #include "stdlib.h"
-
-#ifdef x86_64
+#include "numa.h"
+#include "mp.h"
+#include "sha256.h"
+#include "digest.h"
+#include "place.h"
+#include "e820.h"
+#include "exit.h"
+#include "log.h"
+
+#ifdef HOST_BENCH
+#include "host.h"
+#elif defined(x86_64)
 #include "x86_64.h"
 #else
 #include "i386.h"
@@ -48,17 +62,168 @@ dt_addr_t idt = { 0, 0 };
 struct initrd {
 	UINT64 size;
 	struct file *file;
+	BOOLEAN verify;
+	struct digest digest;
 };
 
-static void parse_initrd(EFI_LOADED_IMAGE *image,
-		 struct boot_params *boot_params, char *cmdline)
+/*
+ * Append @sd to the list of setup_data passed to the kernel.
+ */
+static void add_setup_data(struct boot_params *boot_params,
+			   struct setup_data *sd)
+{
+	struct setup_data *d;
+
+	sd->next = 0;
+
+	if (!boot_params->hdr.setup_data) {
+		boot_params->hdr.setup_data = (UINT64)(UINTN)sd;
+		return;
+	}
+
+	d = (struct setup_data *)(UINTN)boot_params->hdr.setup_data;
+	while (d->next)
+		d = (struct setup_data *)(UINTN)d->next;
+
+	d->next = (UINT64)(UINTN)sd;
+}
+
+/*
+ * Hand the boot profile to the kernel so that the timings can be
+ * read back from /sys/kernel/boot_params/setup_data once booted.
+ * Stamps taken after this point are still recorded in the copy.
+ */
+static void export_profile(struct boot_params *boot_params)
+{
+	EFI_PHYSICAL_ADDRESS addr;
+	struct setup_data *sd;
+	UINTN size;
+	EFI_STATUS err;
+
+	/* setup_data was introduced in boot protocol 2.09 */
+	if (boot_params->hdr.version < 0x209)
+		return;
+
+	size = sizeof(*sd) + sizeof(struct profile_log);
+	err = allocate_pages(AllocateAnyPages, EfiLoaderData,
+			     EFI_SIZE_TO_PAGES(size), &addr);
+	if (err != EFI_SUCCESS)
+		return;
+
+	sd = (struct setup_data *)(UINTN)addr;
+	sd->type = SETUP_EFILINUX_PROFILE;
+	sd->len = sizeof(struct profile_log);
+
+	profile_export((struct profile_log *)sd->data);
+	add_setup_data(boot_params, sd);
+}
+
+/*
+ * Hand our messages to the kernel too, so that a quiet boot can be
+ * looked into once booted. Messages logged after this point are
+ * still recorded in the copy.
+ */
+static void export_log(struct boot_params *boot_params)
+{
+	EFI_PHYSICAL_ADDRESS addr;
+	struct setup_data *sd;
+	UINTN size;
+	EFI_STATUS err;
+
+	if (boot_params->hdr.version < 0x209)
+		return;
+
+	size = sizeof(*sd) + sizeof(struct log_ring);
+	err = allocate_pages(AllocateAnyPages, EfiLoaderData,
+			     EFI_SIZE_TO_PAGES(size), &addr);
+	if (err != EFI_SUCCESS)
+		return;
+
+	sd = (struct setup_data *)(UINTN)addr;
+	sd->type = SETUP_EFILINUX_LOG;
+	sd->len = sizeof(struct log_ring);
+
+	log_export((struct log_ring *)sd->data);
+	add_setup_data(boot_params, sd);
+}
+
+/*
+ * With -p, print where the time went and then what each part of the
+ * boot got up to.
+ */
+static void print_profile(void)
+{
+	if (!profile_enabled)
+		return;
+
+	profile_print();
+	log_print(LOG_INFO, L"\n");
+	malloc_report();
+	fs_report();
+	mp_report();
+	place_report();
+	digest_report();
+	log_print(LOG_INFO, L"\n");
+}
+
+/* Stamp each initrd as its read completes, even when read together */
+static void initrd_read(struct stream *s, void *data)
+{
+	profile_stamp("initrd", s->size);
+}
+
+/*
+ * Copy the name of the next initrd on the command line, from 'p'
+ * on, into 'filename'. Returns where to carry on from, or NULL if
+ * there are no more.
+ */
+static char *next_initrd(char *p, CHAR16 *filename)
+{
+	CHAR16 *n;
+
+	p = strstr(p, "initrd=");
+	if (!p)
+		return NULL;
+
+	p += strlen("initrd=");
+	for (n = filename; *p && *p != ' '; p++, n++)
+		*n = *p;
+
+	*n = '\0';
+	return p;
+}
+
+/* Does any initrd on the command line have a pinned digest? */
+static BOOLEAN initrd_pinned(char *cmdline)
+{
+	CHAR16 filename[MAX_FILENAME];
+	char *p = cmdline;
+
+	while ((p = next_initrd(p, filename))) {
+		if (digest_pinned(filename))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/*
+ * Load every initrd named on the command line. Failing to load them
+ * isn't fatal, we just boot without, unless one of them has a pinned
+ * digest. Then EFI_SECURITY_VIOLATION is returned if any initrd
+ * can't be opened, placed or read, just as if one doesn't match.
+ */
+static EFI_STATUS parse_initrd(EFI_LOADED_IMAGE *image,
+			       struct boot_params *boot_params, char *cmdline)
 {
 	EFI_PHYSICAL_ADDRESS addr;
 	struct initrd *initrds;
+	struct stream *streams;
 	int nr_initrds;
-	EFI_STATUS err;
+	EFI_STATUS err = EFI_SUCCESS;
+	BOOLEAN verified = FALSE;
 	UINT64 size = 0;
-	char *initrd;
+	char *initrd, *dst;
 	int i, j;
 
 	/*
@@ -85,34 +250,27 @@ static void parse_initrd(EFI_LOADED_IMAGE *image,
 	}
 
 	if (!nr_initrds)
-		return;
+		return EFI_SUCCESS;
 
 	initrds = malloc(sizeof(*initrds) * nr_initrds);
-	if (!initrds)
-		return;
+	if (!initrds) {
+		err = EFI_OUT_OF_RESOURCES;
+		goto out;
+	}
 
 	initrd = cmdline;
 	for (i = 0; i < nr_initrds; i++) {
-		CHAR16 filename[MAX_FILENAME], *n;
+		CHAR16 filename[MAX_FILENAME];
 		struct initrd *rd = &initrds[i];
 		struct file *rdfile;
-		char *o, *p;
 		UINT64 sz;
 
-		initrd = strstr(initrd, "initrd=");
+		initrd = next_initrd(initrd, filename);
 		if (!initrd)
 			break;
 
-		initrd += strlen("initrd=");
-		p = initrd;
-		while (*p && *p != ' ')
-			p++;
-
-		for (o = initrd, n = filename;
-		     o != p; o++, n++)
-			*n = *o;
-
-		*n = '\0';
+		/* file_open() mangles the name */
+		rd->verify = digest_start(&rd->digest, filename);
 
 		err = file_open(image, filename, &rdfile);
 		if (err != EFI_SUCCESS)
@@ -126,15 +284,10 @@ static void parse_initrd(EFI_LOADED_IMAGE *image,
 		size += sz;
 	}
 
-	err = emalloc(size, 0x1000, &addr);
-	if (err != EFI_SUCCESS)
-		goto close_handles;
-
-	if ((boot_params->hdr.version < 0x20c ||
-	     !(boot_params->hdr.xloadflags & XLF_CAN_BE_LOADED_ABOVE_4G)) &&
-	    (UINTN)addr > boot_params->hdr.ramdisk_max) {
-		Print(L"ramdisk address is too high!\n");
-		efree(addr, size);
+	err = place_initrd(&boot_params->hdr, size, &addr);
+	if (err != EFI_SUCCESS) {
+		log_print(LOG_WARN,
+			  L"No room for the initrds below the ramdisk limit\n");
 		goto close_handles;
 	}
 
@@ -146,17 +299,68 @@ static void parse_initrd(EFI_LOADED_IMAGE *image,
 		boot_params->ext_ramdisk_size = size >> 32;
 	}
 
+	streams = malloc(sizeof(*streams) * nr_initrds);
+	if (!streams) {
+		err = EFI_OUT_OF_RESOURCES;
+		goto free_initrd;
+	}
+
+	/*
+	 * Read every initrd at once so that those on different devices
+	 * are read in parallel.
+	 */
+	dst = (char *)(UINTN)addr;
 	for (j = 0; j < nr_initrds; j++) {
 		struct initrd *rd = &initrds[j];
 
-		size = rd->size;
-		err = file_read(rd->file, (UINTN *)&size, (void *)(UINTN)addr);
-		if (err != EFI_SUCCESS) {
-			efree(addr, size);
-			goto close_handles;
+		stream_init(&streams[j], rd->file, dst, rd->size);
+		streams[j].finish = initrd_read;
+
+		/* An empty initrd has nothing to read, so never finishes */
+		if (!rd->size)
+			profile_stamp("initrd", 0);
+
+		if (rd->verify) {
+			streams[j].hook = digest_hook;
+			streams[j].hook_data = &rd->digest;
 		}
+		dst += rd->size;
+	}
+
+	err = stream_read_all(streams, nr_initrds);
 
-		addr += size;
+	for (j = 0; j < nr_initrds; j++) {
+		struct initrd *rd = &initrds[j];
+
+		if (!rd->verify)
+			continue;
+
+		verified = TRUE;
+		if (err == EFI_SUCCESS)
+			err = digest_finish(&rd->digest);
+		else
+			digest_cancel(&rd->digest);
+	}
+
+	if (err != EFI_SUCCESS)
+		goto free_streams;
+
+	for (j = 0; j < nr_initrds; j++)
+		stream_report(&streams[j], L"initrd");
+
+	/* Waiting for the last of the hashing */
+	if (verified)
+		profile_stamp("initrd_digest", size);
+
+free_streams:
+	free(streams);
+free_initrd:
+	if (err != EFI_SUCCESS) {
+		efree(addr, size);
+		boot_params->hdr.ramdisk_start = 0;
+		boot_params->hdr.ramdisk_len = 0;
+		boot_params->ext_ramdisk_image = 0;
+		boot_params->ext_ramdisk_size = 0;
 	}
 
 close_handles:
@@ -166,81 +370,112 @@ close_handles:
 	}
 
 	free(initrds);
+out:
+	/* Booting without a pinned initrd is no better than a bad one */
+	if (err != EFI_SUCCESS && err != EFI_SECURITY_VIOLATION &&
+	    initrd_pinned(cmdline)) {
+		log_print(LOG_ERR, L"Couldn't load the pinned initrds, "
+			  "refusing to boot\n");
+		err = EFI_SECURITY_VIOLATION;
+	}
+
+	return err;
+}
+
+/**
+ * probe_kernel - Does the image look like a bzImage?
+ * @f: the image
+ *
+ * The checks that it's a kernel we can boot are left to load_kernel(),
+ * which can report why not.
+ */
+static UINTN probe_kernel(struct loader_file *f)
+{
+	struct boot_params *buf = (struct boot_params *)f->header;
+
+	/* The setup header ends well within the second sector */
+	if (f->header_len < 1024)
+		return LOADER_NO_MATCH;
+
+	if (buf->hdr.header == SETUP_HDR)
+		return LOADER_MATCH;
+
+	if (buf->hdr.signature == 0xAA55)
+		return LOADER_WEAK_MATCH;
+
+	return LOADER_NO_MATCH;
 }
 
 /**
  * load_kernel - Load a kernel image into memory from the boot device
  */
-EFI_STATUS
-load_kernel(EFI_HANDLE image, CHAR16 *name, char *_cmdline)
+static EFI_STATUS
+load_kernel(EFI_HANDLE image, struct loader_file *f, char *_cmdline)
 {
-	UINTN map_size, _map_size, map_key;
 	EFI_PHYSICAL_ADDRESS kernel_start, addr;
-	EFI_PHYSICAL_ADDRESS pref_address;
 	struct boot_params *boot_params;
-	EFI_MEMORY_DESCRIPTOR *map_buf;
-	EFI_LOADED_IMAGE *info = NULL;
+	EFI_LOADED_IMAGE *info = f->info;
+	UINTN nr_e820;
+	struct setup_data *e820_ext;
 	struct e820_entry *e820_map;
-	UINT64 setup_sz, init_size;
+	UINTN setup_sz, rest;
 	struct boot_params *buf;
 	struct efi_info *efi;
-	UINT32 desc_version;
 	UINT8 nr_setup_secs;
-	struct file *file;
-	UINTN desc_size;
+	struct stream stream;
+	struct file *file = f->file;
 	EFI_STATUS err;
 	char *cmdline;
 	UINT64 size;
-	int i, j = 0;
-
-	err = handle_protocol(image, &LoadedImageProtocol, (void **)&info);
-	if (err != EFI_SUCCESS)
-		info = NULL;
-
-	err = file_open(info, name, &file);
-
-	if (err != EFI_SUCCESS)
-		goto out;
-
-	err = file_set_position(file, (UINT64)0x1F1);
-	if (err != EFI_SUCCESS)
-		goto out;
-
-	size = 1;
-	err = file_read(file, (UINTN *)&size, &nr_setup_secs);
-	if (err != EFI_SUCCESS)
-		goto out;
+	UINTN i, j;
 
+	buf = (struct boot_params *)f->header;
+	nr_setup_secs = buf->hdr.setup_secs;
 	nr_setup_secs++;	/* Add the boot sector */
 	setup_sz = nr_setup_secs * 512;
 
-	buf = malloc(setup_sz);
-	if (!buf)
-		goto out;
+	if (setup_sz > f->size) {
+		log_print(LOG_ERR, L"bzImage kernel corrupt");
+		return EFI_INVALID_PARAMETER;
+	}
 
-	err = file_set_position(file, (UINT64)0);
-	if (err != EFI_SUCCESS)
-		goto out;
+	/* Setup code that didn't fit in the header is read after it */
+	if (setup_sz > f->header_len) {
+		buf = malloc(setup_sz);
+		if (!buf)
+			return EFI_OUT_OF_RESOURCES;
 
-	err = file_read(file, (UINTN *)&setup_sz, buf);
-	if (err != EFI_SUCCESS)
-		goto out;
+		memcpy((char *)buf, f->header, f->header_len);
 
-	err = file_size(file, &size);
-	if (err != EFI_SUCCESS)
-		goto out;
+		rest = setup_sz - f->header_len;
+		err = file_read(file, &rest, (char *)buf + f->header_len);
+		if (err != EFI_SUCCESS)
+			goto out;
 
-	size -= setup_sz;
+		if (rest != setup_sz - f->header_len) {
+			log_print(LOG_ERR, L"bzImage kernel corrupt");
+			err = EFI_INVALID_PARAMETER;
+			goto out;
+		}
+	} else {
+		err = file_set_position(file, setup_sz);
+		if (err != EFI_SUCCESS)
+			goto out;
+	}
+
+	size = f->size - setup_sz;
+
+	profile_stamp("bzimage_header", setup_sz);
 
 	/* Check boot sector signature */
 	if (buf->hdr.signature != 0xAA55) {
-		Print(L"bzImage kernel corrupt");
+		log_print(LOG_ERR, L"bzImage kernel corrupt");
 		err = EFI_INVALID_PARAMETER;
 		goto out;
 	}
 
 	if (buf->hdr.header != SETUP_HDR) {
-		Print(L"Setup code version is invalid");
+		log_print(LOG_ERR, L"Setup code version is invalid");
 		err = EFI_INVALID_PARAMETER;
 		goto out;
 	}
@@ -252,31 +487,17 @@ load_kernel(EFI_HANDLE image, CHAR16 *name, char *_cmdline)
 	 * code version >= 2.05.
 	 */
 	if (buf->hdr.version < 0x205) {
-		Print(L"Setup code version unsupported (too old)");
+		log_print(LOG_ERR, L"Setup code version unsupported (too old)");
 		err = EFI_INVALID_PARAMETER;
 		goto out;
 	}
 
 	if (!buf->hdr.relocatable_kernel) {
-		Print(L"Expected relocatable kernel");
+		log_print(LOG_ERR, L"Expected relocatable kernel");
 		err = EFI_INVALID_PARAMETER;
 		goto out;
 	}
 
-	if (buf->hdr.version >= 0x20a) {
-		pref_address = buf->hdr.pref_address;
-		init_size = buf->hdr.init_size;
-	} else {
-		pref_address = 0x100000;
-
-		/*
-		 * We need to account for the fact that the kernel
-		 * needs room for decompression, otherwise we could
-		 * end up trashing other chunks of allocated memory.
-		 */
-		init_size = size * 3;
-	}
-
 	/*
 	 * The kernel expects cmdline to be allocated pretty low,
 	 * Documentation/x86/boot.txt says,
@@ -312,31 +533,54 @@ load_kernel(EFI_HANDLE image, CHAR16 *name, char *_cmdline)
 
 	boot_params->hdr.cmd_line_ptr = (UINT32)(UINTN)cmdline;
 
-	parse_initrd(info, boot_params, cmdline);
+	/* Never pass on whatever setup_data the image was built with */
+	boot_params->hdr.setup_data = 0;
+	export_profile(boot_params);
+	export_log(boot_params);
 
-	addr = pref_address;
-	err = allocate_pages(AllocateAddress, EfiLoaderData,
-			     EFI_SIZE_TO_PAGES(init_size), &addr);
-	if (err != EFI_SUCCESS) {
-		/*
-		 * We failed to allocate the preferred address, so
-		 * just allocate some memory and hope for the best.
-		 */
-		err = emalloc(init_size, boot_params->hdr.kernel_alignment,
-				 &addr);
-		if (err != EFI_SUCCESS)
-			goto out;
-	}
+	/* Before the initrds, which need to keep out of its way */
+	err = place_kernel(&boot_params->hdr, size, &addr);
+	if (err != EFI_SUCCESS)
+		goto out;
 
 	kernel_start = addr;
 
+	err = parse_initrd(info, boot_params, cmdline);
+	if (err == EFI_SECURITY_VIOLATION)
+		goto out;
+
 	/*
-	 * Read the rest of the kernel image.
+	 * Read the rest of the kernel image a chunk at a time. If it
+	 * has a pinned digest, hash the setup code we've already read
+	 * and then each chunk as it arrives.
 	 */
-	err = file_read(file, (UINTN *)&size, (void *)(UINTN)kernel_start);
+	stream_init(&stream, file, (void *)(UINTN)kernel_start, size);
+
+	if (f->digest) {
+		digest_update(f->digest, buf, setup_sz);
+		stream.hook = digest_hook;
+		stream.hook_data = f->digest;
+	}
+
+	while (!stream_done(&stream)) {
+		err = stream_next(&stream);
+		if (err != EFI_SUCCESS)
+			break;
+	}
+
+	if (f->digest) {
+		if (err == EFI_SUCCESS)
+			err = digest_finish(f->digest);
+		else
+			digest_cancel(f->digest);
+	}
+
 	if (err != EFI_SUCCESS)
 		goto out;
 
+	stream_report(&stream, L"kernel");
+	profile_stamp("payload", size);
+
 	boot_params->hdr.code32_start = (UINT32)((UINT64)kernel_start);
 
 	/*
@@ -344,15 +588,33 @@ load_kernel(EFI_HANDLE image, CHAR16 *name, char *_cmdline)
 	 * protocol.
 	 */
 	if (boot_params->hdr.version >= 0x20b) {
+		profile_stamp("handover", 0);
+		print_profile();
+		mp_fini();
+		arena_release();
 		handover_jump(boot_params->hdr.version, image,
 			      boot_params, kernel_start);
 		goto out;
 	}
 
+	/*
+	 * Reserve room for the final memory map now, along with room
+	 * to convert it to e820, as we can't allocate once we've tried
+	 * to exit boot services. There is never more than one e820
+	 * entry per descriptor and sorting the entries needs as much
+	 * room again.
+	 */
+	err = exit_reserve(2 * sizeof(struct e820_entry),
+			   sizeof(struct setup_data));
+	if (err != EFI_SUCCESS)
+		goto out;
+
 	err = setup_graphics(buf);
 	if (err != EFI_SUCCESS)
 		goto out;
 
+	profile_stamp("setup_graphics", 0);
+
 	err = emalloc(gdt.limit, 8, (EFI_PHYSICAL_ADDRESS *)&gdt.base);
 	if (err != EFI_SUCCESS)
 		goto out;
@@ -378,52 +640,37 @@ load_kernel(EFI_HANDLE image, CHAR16 *name, char *_cmdline)
 	/* Task segment value */
 	gdt.base[4] = 0x0080890000000000;
 
-	/* We're just interested in the map's size for now */
-	map_size = 0;
-	err = get_memory_map(&map_size, NULL, NULL, NULL, NULL);
-	if (err != EFI_SUCCESS && err != EFI_BUFFER_TOO_SMALL)
-		goto out;
-
-again:
-	_map_size = map_size;
-	err = emalloc(map_size, 1, &addr);
-	if (err != EFI_SUCCESS)
-		goto out;
-
-	map_buf = (EFI_MEMORY_DESCRIPTOR *)(UINTN)addr;
-	err = get_memory_map(&map_size, map_buf, &map_key,
-			     &desc_size, &desc_version);
-	if (err != EFI_SUCCESS) {
-		if (err == EFI_BUFFER_TOO_SMALL) {
-			/*
-			 * Argh! The buffer that we allocated further
-			 * up wasn't large enough which means we need
-			 * to allocate them again, but this time
-			 * larger. 'map_size' has been updated by the
-			 * call to memory_map().
-			 */
-			efree((UINTN)map_buf, _map_size);
-			goto again;
-		}
-		goto out;
-	}
+	/*
+	 * Printing may allocate memory and change the memory map key,
+	 * so this is the last chance to display the profile.
+	 */
+	print_profile();
 
-	/* Close all open file handles */
+	/*
+	 * Closing files, stopping the APs and freeing the arena also
+	 * change the memory map, so do them before taking the final copy.
+	 * load_image() can't close the kernel for us once we've tried
+	 * to exit boot services.
+	 */
+	file_close(file);
+	f->file = NULL;
 	fs_close();
+	mp_fini();
+	arena_release();
 
-	err = exit_boot_services(image, map_key);
+	err = exit_boot(image);
 	if (err != EFI_SUCCESS)
 		goto out;
 
 	efi = &boot_params->efi_info;
 	efi->efi_systab = (UINT32)(UINTN)sys_table;
-	efi->efi_memdesc_size = desc_size;
-	efi->efi_memdesc_version = desc_version;
-	efi->efi_memmap = (UINT32)(UINTN)map_buf;
-	efi->efi_memmap_size = map_size;
+	efi->efi_memdesc_size = exit_map.desc_size;
+	efi->efi_memdesc_version = exit_map.desc_version;
+	efi->efi_memmap = (UINT32)(UINTN)exit_map.map;
+	efi->efi_memmap_size = exit_map.size;
 #ifdef x86_64
 	efi->efi_systab_hi = (unsigned long)sys_table >> 32;
-	efi->efi_memmap_hi = (unsigned long)map_buf >> 32;
+	efi->efi_memmap_hi = (unsigned long)exit_map.map >> 32;
 #endif
 
 	memcpy((char *)&efi->efi_loader_signature,
@@ -431,71 +678,47 @@ again:
 
 	boot_params->alt_mem_k = 32 * 1024;
 
-	e820_map = &boot_params->e820_map[0];
-
 	/*
-	 * Convert the EFI memory map to E820.
+	 * Convert the EFI memory map to E820. Entries that don't fit
+	 * in boot_params go in a SETUP_E820_EXT setup_data.
 	 */
-	for (i = 0; i < map_size / desc_size; i++) {
-		EFI_MEMORY_DESCRIPTOR *d;
-		unsigned int e820_type = 0;
-
-		d = (EFI_MEMORY_DESCRIPTOR *)((unsigned long)map_buf + (i * desc_size));
-		switch(d->Type) {
-		case EfiReservedMemoryType:
-		case EfiRuntimeServicesCode:
-		case EfiRuntimeServicesData:
-		case EfiMemoryMappedIO:
-		case EfiMemoryMappedIOPortSpace:
-		case EfiPalCode:
-			e820_type = E820_RESERVED;
-			break;
-
-		case EfiUnusableMemory:
-			e820_type = E820_UNUSABLE;
-			break;
-
-		case EfiACPIReclaimMemory:
-			e820_type = E820_ACPI;
-			break;
-
-		case EfiLoaderCode:
-		case EfiLoaderData:
-		case EfiBootServicesCode:
-		case EfiBootServicesData:
-		case EfiConventionalMemory:
-			e820_type = E820_RAM;
-			break;
-
-		case EfiACPIMemoryNVS:
-			e820_type = E820_NVS;
-			break;
+	e820_ext = exit_map.extra;
+	e820_map = (struct e820_entry *)e820_ext->data;
+	nr_e820 = e820_from_efi(e820_map, exit_map.max_desc,
+				e820_map + exit_map.max_desc, exit_map.map,
+				exit_map.size, exit_map.desc_size);
+
+	j = nr_e820;
+	if (j > E820_ZEROPAGE_ENTRIES)
+		j = E820_ZEROPAGE_ENTRIES;
+
+	memcpy((char *)boot_params->e820_map, (char *)e820_map,
+	       j * sizeof(*e820_map));
+	boot_params->e820_entries = j;
 
-		default:
-			continue;
-		}
+	/* setup_data was introduced in boot protocol 2.09 */
+	if (nr_e820 > j && boot_params->hdr.version >= 0x209) {
+		for (i = j; i < nr_e820; i++)
+			e820_map[i - j] = e820_map[i];
 
-		if (j && e820_map[j-1].type == e820_type &&
-			(e820_map[j-1].addr + e820_map[j-1].size) == d->PhysicalStart) {
-			e820_map[j-1].size += d->NumberOfPages << EFI_PAGE_SHIFT;
-		} else {
-			e820_map[j].addr = d->PhysicalStart;
-			e820_map[j].size = d->NumberOfPages << EFI_PAGE_SHIFT;
-			e820_map[j].type = e820_type;
-			j++;
-		}
+		e820_ext->type = SETUP_E820_EXT;
+		e820_ext->len = (nr_e820 - j) * sizeof(*e820_map);
+		add_setup_data(boot_params, e820_ext);
 	}
 
-	boot_params->e820_entries = j;
-
+#ifndef HOST_BENCH
 	asm volatile ("lidt %0" :: "m" (idt));
 	asm volatile ("lgdt %0" :: "m" (gdt));
+#endif
 
 	kernel_jump(kernel_start, boot_params);
 out:
+	if ((UINT8 *)buf != f->header)
+		free(buf);
 	return err;
 }
 
 struct loader bzimage_loader = {
+	probe_kernel,
 	load_kernel,
 };
@@ -40,6 +40,12 @@
 #define E820_NVS		4
 #define E820_UNUSABLE		5
 
+/* setup_data types */
+#define SETUP_NONE		0
+#define SETUP_E820_EXT		1
+#define SETUP_EFILINUX_PROFILE	0x45464c50	/* struct profile_log */
+#define SETUP_EFILINUX_LOG	0x45464c4c	/* struct log_ring */
+
 /* xloadflags */
 #define XLF_KERNEL_64                   (1<<0)
 #define XLF_CAN_BE_LOADED_ABOVE_4G      (1<<1)
@@ -89,6 +95,17 @@ struct setup_header {
 	UINT32 handover_offset;
 } __attribute__((packed));
 
+/*
+ * A singly-linked list of setup_data is passed to the kernel through
+ * hdr.setup_data (boot protocol 2.09+).
+ */
+struct setup_data {
+	UINT64 next;
+	UINT32 type;
+	UINT32 len;
+	UINT8 data[0];
+} __attribute__((packed));
+
 struct efi_info {
 	UINT32 efi_loader_signature;
 	UINT32 efi_systab;
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Conversion of the EFI memory map to e820.
+ *
+ * Firmware memory maps aren't guaranteed to be sorted, and on large
+ * machines they can hold thousands of descriptors. Each descriptor
+ * becomes an e820 entry, which are then sorted by address if need be
+ * and ranges of the same type that touch are coalesced. This runs
+ * after ExitBootServices(), so the caller provides the buffers.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "bzimage.h"
+#include "e820.h"
+
+static UINT32 e820_type(UINT32 type)
+{
+	switch (type) {
+	case EfiReservedMemoryType:
+	case EfiRuntimeServicesCode:
+	case EfiRuntimeServicesData:
+	case EfiMemoryMappedIO:
+	case EfiMemoryMappedIOPortSpace:
+	case EfiPalCode:
+		return E820_RESERVED;
+
+	case EfiUnusableMemory:
+		return E820_UNUSABLE;
+
+	case EfiACPIReclaimMemory:
+		return E820_ACPI;
+
+	case EfiLoaderCode:
+	case EfiLoaderData:
+	case EfiBootServicesCode:
+	case EfiBootServicesData:
+	case EfiConventionalMemory:
+		return E820_RAM;
+
+	case EfiACPIMemoryNVS:
+		return E820_NVS;
+
+	default:
+		return 0;
+	}
+}
+
+static inline BOOLEAN e820_before(struct e820_entry *a, struct e820_entry *b)
+{
+	return a->addr < b->addr;
+}
+
+/*
+ * Merge the sorted runs src[lo, mid) and src[mid, hi) into dst.
+ */
+static void merge_runs(struct e820_entry *dst, struct e820_entry *src,
+		       UINTN lo, UINTN mid, UINTN hi)
+{
+	UINTN i = lo, j = mid, k = lo, right;
+
+	/* Which side is taken is unpredictable, so don't branch on it */
+	while (i < mid && j < hi) {
+		right = e820_before(&src[j], &src[i]);
+		dst[k++] = src[right ? j : i];
+		j += right;
+		i += !right;
+	}
+
+	while (i < mid)
+		dst[k++] = src[i++];
+	while (j < hi)
+		dst[k++] = src[j++];
+}
+
+/**
+ * e820_sort - Sort e820 entries by address
+ * @e820: the entries
+ * @nr: the number of entries
+ * @tmp: room for another @nr entries
+ *
+ * A bottom-up merge sort, as we can't allocate memory. Maps that are
+ * already in order, as most are, are only scanned.
+ */
+void e820_sort(struct e820_entry *e820, UINTN nr, struct e820_entry *tmp)
+{
+	struct e820_entry *src = e820, *dst = tmp, *t;
+	UINTN i, lo, width;
+
+	for (i = 1; i < nr; i++) {
+		if (e820_before(&e820[i], &e820[i - 1]))
+			break;
+	}
+
+	if (i >= nr)
+		return;
+
+	for (width = 1; width < nr; width *= 2) {
+		for (lo = 0; lo < nr; lo += 2 * width) {
+			UINTN mid = lo + width, hi = lo + 2 * width;
+
+			if (mid > nr)
+				mid = nr;
+			if (hi > nr)
+				hi = nr;
+			merge_runs(dst, src, lo, mid, hi);
+		}
+
+		t = src;
+		src = dst;
+		dst = t;
+	}
+
+	if (src != e820) {
+		for (i = 0; i < nr; i++)
+			e820[i] = src[i];
+	}
+}
+
+/**
+ * e820_merge - Coalesce sorted e820 entries
+ * @e820: the entries, sorted by address
+ * @nr: the number of entries
+ *
+ * Entries of the same type that touch or overlap are combined.
+ * Returns the number of entries left.
+ */
+UINTN e820_merge(struct e820_entry *e820, UINTN nr)
+{
+	struct e820_entry *prev;
+	UINT64 end;
+	UINTN i, j;
+
+	if (!nr)
+		return 0;
+
+	for (i = 1, j = 0; i < nr; i++) {
+		prev = &e820[j];
+
+		if (prev->type == e820[i].type &&
+		    prev->addr + prev->size >= e820[i].addr) {
+			end = e820[i].addr + e820[i].size;
+			if (end > prev->addr + prev->size)
+				prev->size = end - prev->addr;
+			continue;
+		}
+
+		e820[++j] = e820[i];
+	}
+
+	return j + 1;
+}
+
+/**
+ * e820_from_efi - Convert the EFI memory map to e820
+ * @e820: where to store the entries
+ * @max: the number of entries @e820 has room for
+ * @tmp: room for another @max entries, used for sorting
+ * @map: the EFI memory map
+ * @map_size: the size of @map in bytes
+ * @desc_size: the size of each descriptor in @map
+ *
+ * Returns the number of entries, sorted and coalesced. There are
+ * never more than there are descriptors.
+ */
+UINTN e820_from_efi(struct e820_entry *e820, UINTN max,
+		    struct e820_entry *tmp, EFI_MEMORY_DESCRIPTOR *map, UINTN map_size,
+		    UINTN desc_size)
+{
+	EFI_MEMORY_DESCRIPTOR *d;
+	UINTN i, nr = 0;
+	UINT32 type;
+
+	for (i = 0; i < map_size / desc_size; i++) {
+		d = (EFI_MEMORY_DESCRIPTOR *)((UINTN)map + i * desc_size);
+
+		type = e820_type(d->Type);
+		if (!type)
+			continue;
+
+		/* Most neighbours can be merged straight away */
+		if (nr && e820[nr - 1].type == type &&
+		    e820[nr - 1].addr + e820[nr - 1].size == d->PhysicalStart) {
+			e820[nr - 1].size += d->NumberOfPages << EFI_PAGE_SHIFT;
+			continue;
+		}
+
+		if (nr == max)
+			break;
+
+		e820[nr].addr = d->PhysicalStart;
+		e820[nr].size = d->NumberOfPages << EFI_PAGE_SHIFT;
+		e820[nr].type = type;
+		nr++;
+	}
+
+	e820_sort(e820, nr, tmp);
+	return e820_merge(e820, nr);
+}
@@ -32,6 +32,7 @@
 #include "bzimage.h"
 #include "protocol.h"
 #include "stdlib.h"
+#include "gop.h"
 
 static void find_bits(unsigned long mask, UINT8 *pos, UINT8 *size)
 {
@@ -58,118 +59,85 @@ static void find_bits(unsigned long mask, UINT8 *pos, UINT8 *size)
 EFI_STATUS setup_graphics(struct boot_params *buf)
 {
 	EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *info;
-	EFI_GUID graphics_proto = EFI_GRAPHICS_OUTPUT_PROTOCOL_GUID;
 	EFI_GRAPHICS_OUTPUT_PROTOCOL *gop;
-	EFI_HANDLE *gop_handle = NULL;
 	struct screen_info *si;
 	EFI_STATUS err;
-	UINTN nr_gops;
-	UINTN size;
-	int i;
 
-	/* See if we have graphics output protocol */
-	size = 0;
-	err = locate_handle(ByProtocol, &graphics_proto, NULL,
-			    &size, (void **)gop_handle);
-	if (err != EFI_SUCCESS && err != EFI_BUFFER_TOO_SMALL)
-		goto out;
-
-	gop_handle = malloc(size);
-	if (!gop_handle)
-		goto out;
-
-	err = locate_handle(ByProtocol, &graphics_proto, NULL,
-			    &size, (void **)gop_handle);
+	err = gop_find(&gop, &info);
 	if (err != EFI_SUCCESS)
 		goto out;
 
-	nr_gops = size / sizeof(EFI_HANDLE);
-	for (i = 0; i < nr_gops; i++) {
-		EFI_HANDLE *h = &gop_handle[i];
-
-		err = handle_protocol(*h, &graphics_proto, (void **)&gop);
-		if (err != EFI_SUCCESS)
-			continue;
-
-		err = uefi_call_wrapper(gop->QueryMode, 4, gop,
-					gop->Mode->Mode, &size, &info);
-		if (err == EFI_SUCCESS)
-			break;
-	}
-
-	/* We found a GOP */
-	if (i != nr_gops) {
-		si = &buf->screen_info;
-
-		/* EFI framebuffer */
-		si->orig_video_isVGA = 0x70;
-
-		si->orig_x = 0;
-		si->orig_y = 0;
-		si->orig_video_page = 0;
-		si->orig_video_mode = 0;
-		si->orig_video_cols = 0;
-		si->orig_video_lines = 0;
-		si->orig_video_ega_bx = 0;
-		si->orig_video_points = 0;
-
-		si->lfb_base = gop->Mode->FrameBufferBase;
-		si->lfb_size = gop->Mode->FrameBufferSize;
-		si->lfb_width = info->HorizontalResolution;
-		si->lfb_height = info->VerticalResolution;
-		si->pages = 1;
-		si->vesapm_seg = 0;
-		si->vesapm_off = 0;
-
-		if (info->PixelFormat == PixelRedGreenBlueReserved8BitPerColor) {
-			si->lfb_depth = 32;
-			si->red_size = 8;
-			si->red_pos = 0;
-			si->green_size = 8;
-			si->green_pos = 8;
-			si->blue_size = 8;
-			si->blue_pos = 16;
-			si->rsvd_size = 8;
-			si->rsvd_pos = 24;
-			si->lfb_linelength = info->PixelsPerScanLine * 4;
-
-		} else if (info->PixelFormat == PixelBlueGreenRedReserved8BitPerColor) {
-			si->lfb_depth = 32;
-			si->red_size = 8;
-			si->red_pos = 16;
-			si->green_size = 8;
-			si->green_pos = 8;
-			si->blue_size = 8;
-			si->blue_pos = 0;
-			si->rsvd_size = 8;
-			si->rsvd_pos = 24;
-			si->lfb_linelength = info->PixelsPerScanLine * 4;
-		} else if (info->PixelFormat == PixelBitMask) {
-			find_bits(info->PixelInformation.RedMask,
-				  &si->red_pos, &si->red_size);
-			find_bits(info->PixelInformation.GreenMask,
-				  &si->green_pos, &si->green_size);
-			find_bits(info->PixelInformation.BlueMask,
-				  &si->blue_pos, &si->blue_size);
-			find_bits(info->PixelInformation.ReservedMask,
-				  &si->rsvd_pos, &si->rsvd_size);
-			si->lfb_depth = si->red_size + si->green_size +
-				si->blue_size + si->rsvd_size;
-			si->lfb_linelength = (info->PixelsPerScanLine * si->lfb_depth) / 8;
-		} else {
-			si->lfb_depth = 4;
-			si->red_size = 0;
-			si->red_pos = 0;
-			si->green_size = 0;
-			si->green_pos = 0;
-			si->blue_size = 0;
-			si->blue_pos = 0;
-			si->rsvd_size = 0;
-			si->rsvd_pos = 0;
-			si->lfb_linelength = si->lfb_width / 2;
-		}
+	si = &buf->screen_info;
+
+	/* EFI framebuffer */
+	si->orig_video_isVGA = 0x70;
+
+	si->orig_x = 0;
+	si->orig_y = 0;
+	si->orig_video_page = 0;
+	si->orig_video_mode = 0;
+	si->orig_video_cols = 0;
+	si->orig_video_lines = 0;
+	si->orig_video_ega_bx = 0;
+	si->orig_video_points = 0;
+
+	si->lfb_base = gop->Mode->FrameBufferBase;
+	si->lfb_size = gop->Mode->FrameBufferSize;
+	si->lfb_width = info->HorizontalResolution;
+	si->lfb_height = info->VerticalResolution;
+	si->pages = 1;
+	si->vesapm_seg = 0;
+	si->vesapm_off = 0;
+
+	if (info->PixelFormat == PixelRedGreenBlueReserved8BitPerColor) {
+		si->lfb_depth = 32;
+		si->red_size = 8;
+		si->red_pos = 0;
+		si->green_size = 8;
+		si->green_pos = 8;
+		si->blue_size = 8;
+		si->blue_pos = 16;
+		si->rsvd_size = 8;
+		si->rsvd_pos = 24;
+		si->lfb_linelength = info->PixelsPerScanLine * 4;
+
+	} else if (info->PixelFormat == PixelBlueGreenRedReserved8BitPerColor) {
+		si->lfb_depth = 32;
+		si->red_size = 8;
+		si->red_pos = 16;
+		si->green_size = 8;
+		si->green_pos = 8;
+		si->blue_size = 8;
+		si->blue_pos = 0;
+		si->rsvd_size = 8;
+		si->rsvd_pos = 24;
+		si->lfb_linelength = info->PixelsPerScanLine * 4;
+	} else if (info->PixelFormat == PixelBitMask) {
+		find_bits(info->PixelInformation.RedMask,
+			  &si->red_pos, &si->red_size);
+		find_bits(info->PixelInformation.GreenMask,
+			  &si->green_pos, &si->green_size);
+		find_bits(info->PixelInformation.BlueMask,
+			  &si->blue_pos, &si->blue_size);
+		find_bits(info->PixelInformation.ReservedMask,
+			  &si->rsvd_pos, &si->rsvd_size);
+		si->lfb_depth = si->red_size + si->green_size +
+			si->blue_size + si->rsvd_size;
+		si->lfb_linelength = (info->PixelsPerScanLine * si->lfb_depth) / 8;
+	} else {
+		si->lfb_depth = 4;
+		si->red_size = 0;
+		si->red_pos = 0;
+		si->green_size = 0;
+		si->green_pos = 0;
+		si->blue_size = 0;
+		si->blue_pos = 0;
+		si->rsvd_size = 0;
+		si->rsvd_pos = 0;
+		si->lfb_linelength = si->lfb_width / 2;
 	}
 
+	free_pool(info);
 out:
 	return err;
 }
@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Kernel placement.
+ *
+ * A relocatable kernel decompresses itself at its load address
+ * rounded up to hdr.kernel_alignment, or at pref_address if that is
+ * higher, and needs init_size bytes there. If we put it anywhere
+ * else the decompressor first copies itself somewhere we never
+ * reserved, and if it doesn't end up at pref_address it also has to
+ * apply its relocations. So try, in order: pref_address itself, then
+ * the lowest address above pref_address at kernel_alignment, then at
+ * any alignment down to 1 << min_alignment, which the boot protocol
+ * (2.10+) allows if we update kernel_alignment to match.
+ *
+ * The initrds go as high as the kernel allows, away from where it
+ * decompresses, so that it never has to move them out of the way.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "bzimage.h"
+#include "place.h"
+#include "stdlib.h"
+#include "numa.h"
+#include "log.h"
+
+struct place_stats place_stats;
+
+static const char *place_names[] = {
+	[PLACE_NONE] = "not placed",
+	[PLACE_PREFERRED] = "at the preferred address",
+	[PLACE_ALIGNED] = "aligned, in place",
+	[PLACE_MIN_ALIGNED] = "minimum alignment, in place",
+	[PLACE_RELOCATED] = "will relocate itself",
+};
+
+/**
+ * place_kernel - Allocate the memory the kernel decompresses into
+ * @hdr: the kernel's setup header, kernel_alignment may be updated
+ * @size: the size of the protected-mode code in bytes
+ * @addr: used to return the address to load the kernel at
+ *
+ * Reserves the kernel's whole init_size window, not just @size.
+ */
+EFI_STATUS place_kernel(struct setup_header *hdr, UINT64 size,
+			EFI_PHYSICAL_ADDRESS *addr)
+{
+	EFI_PHYSICAL_ADDRESS pref, max = EMALLOC_MAX_ADDR;
+	UINT32 align, want, min_align;
+	UINT64 init_size;
+	EFI_STATUS err;
+
+	if (hdr->version >= 0x20a) {
+		pref = hdr->pref_address;
+		init_size = hdr->init_size;
+	} else {
+		pref = 0x100000;
+
+		/*
+		 * We need to account for the fact that the kernel
+		 * needs room for decompression, otherwise we could
+		 * end up trashing other chunks of allocated memory.
+		 */
+		init_size = size * 3;
+	}
+
+	if (init_size < size)
+		init_size = size;
+
+	align = hdr->kernel_alignment;
+	if (align < EFI_PAGE_SIZE || (align & (align - 1)))
+		align = EFI_PAGE_SIZE;
+	want = align;
+
+	min_align = align;
+	if (hdr->version >= 0x20a && hdr->min_alignment < 32) {
+		min_align = (UINT32)1 << hdr->min_alignment;
+		if (min_align < EFI_PAGE_SIZE)
+			min_align = EFI_PAGE_SIZE;
+		if (min_align > align)
+			min_align = align;
+	}
+
+	/* The legacy 32-bit entry can't reach above 4GiB */
+	if (hdr->version < 0x20c ||
+	    !(hdr->xloadflags & XLF_CAN_BE_LOADED_ABOVE_4G))
+		max = 1ULL << 32;
+
+	place_stats.init_size = init_size;
+
+	/*
+	 * Only use the kernel's preferred address if it is in the
+	 * memory we'd choose anyway, there's no point decompressing
+	 * on a remote node just to avoid relocating. Going through
+	 * emalloc_range() keeps us out of specific-purpose memory.
+	 */
+	if (!(pref & (align - 1)) && numa_preferred(pref, init_size) &&
+	    emalloc_range(init_size, EFI_PAGE_SIZE, pref, pref + init_size,
+			  EMALLOC_FIRST_FIT, addr) == EFI_SUCCESS) {
+		place_stats.how = PLACE_PREFERRED;
+		goto out;
+	}
+
+	for (; align >= min_align; align >>= 1) {
+		err = numa_emalloc(init_size, align, pref, max,
+				   EMALLOC_FIRST_FIT, addr);
+		if (err == EFI_SUCCESS) {
+			if (align == want)
+				place_stats.how = PLACE_ALIGNED;
+			else
+				place_stats.how = PLACE_MIN_ALIGNED;
+			hdr->kernel_alignment = align;
+			goto out;
+		}
+	}
+
+	/*
+	 * Nowhere above pref_address is big enough, so just allocate
+	 * some memory and hope for the best.
+	 */
+	err = numa_emalloc(init_size, want, 0, max, EMALLOC_FIRST_FIT, addr);
+	if (err != EFI_SUCCESS)
+		return err;
+
+	place_stats.how = PLACE_RELOCATED;
+
+out:
+	place_stats.kernel = *addr;
+	place_stats.align = hdr->kernel_alignment;
+
+	/* Relocating costs the kernel a copy of itself, so say so */
+	log_print(place_stats.how == PLACE_RELOCATED ? LOG_WARN : LOG_DEBUG,
+		  L"Kernel at 0x%lx, %a\n", *addr,
+		  place_names[place_stats.how]);
+	return EFI_SUCCESS;
+}
+
+/**
+ * place_initrd - Allocate memory for the initrds
+ * @hdr: the kernel's setup header
+ * @size: the size of all the initrds in bytes
+ * @addr: used to return the address to load the initrds at
+ *
+ * Must be called after place_kernel(). The initrds are put as high as
+ * possible below ramdisk_max, or anywhere if the kernel can take them
+ * above 4GiB, and never where the kernel decompresses.
+ */
+EFI_STATUS place_initrd(struct setup_header *hdr, UINT64 size,
+			EFI_PHYSICAL_ADDRESS *addr)
+{
+	EFI_PHYSICAL_ADDRESS max, start, end;
+	EFI_STATUS err;
+	UINT64 gap;
+
+	if (hdr->version >= 0x20c &&
+	    (hdr->xloadflags & XLF_CAN_BE_LOADED_ABOVE_4G))
+		max = EMALLOC_MAX_ADDR;
+	else
+		max = (EFI_PHYSICAL_ADDRESS)hdr->ramdisk_max + 1;
+
+	/* Where the kernel decompresses, once it has moved if need be */
+	start = place_stats.kernel;
+	end = start + place_stats.init_size;
+	if (place_stats.how == PLACE_RELOCATED &&
+	    hdr->version >= 0x20a && hdr->pref_address > start) {
+		start = hdr->pref_address;
+		end = start + place_stats.init_size;
+	}
+
+	err = numa_emalloc(size, EFI_PAGE_SIZE, end, max,
+			   EMALLOC_TOP_DOWN, addr);
+	if (err != EFI_SUCCESS) {
+		if (max > start)
+			max = start;
+		err = numa_emalloc(size, EFI_PAGE_SIZE, 0, max,
+				   EMALLOC_TOP_DOWN, addr);
+		if (err != EFI_SUCCESS)
+			return err;
+	}
+
+	place_stats.initrd = *addr;
+	place_stats.initrd_size = size;
+	if (*addr >= end) {
+		gap = *addr - end;
+		place_stats.initrd_gap = gap;
+	} else {
+		gap = start - (*addr + size);
+		place_stats.initrd_gap = -(INT64)gap;
+	}
+
+	log_print(LOG_DEBUG, L"Initrds at 0x%lx, %ld KiB %a the kernel\n",
+		  *addr, gap >> 10, *addr >= end ? "above" : "below");
+	return EFI_SUCCESS;
+}
+
+/**
+ * place_report - Print where the kernel and initrds went
+ */
+void place_report(void)
+{
+	INT64 gap = place_stats.initrd_gap;
+
+	if (place_stats.how != PLACE_NONE)
+		log_print(LOG_INFO, L"place: kernel at 0x%lx, %ld bytes at "
+			  "%ld KiB alignment, %a\n", place_stats.kernel,
+			  place_stats.init_size,
+			  (UINT64)place_stats.align >> 10,
+			  place_names[place_stats.how]);
+	if (place_stats.initrd_size)
+		log_print(LOG_INFO, L"place: initrd at 0x%lx, %ld bytes, "
+			  "%ld MiB %a the kernel\n", place_stats.initrd,
+			  place_stats.initrd_size,
+			  (gap < 0 ? -gap : gap) >> 20,
+			  gap < 0 ? "below" : "above");
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Where to put the kernel in memory.
+ */
+
+#ifndef __PLACE_H__
+#define __PLACE_H__
+
+/*
+ * How the kernel was placed, best first. The decompressor runs at
+ * the load address rounded up to kernel_alignment, but never below
+ * pref_address. Anywhere else it has to move itself first.
+ */
+enum place_kernel {
+	PLACE_NONE,
+	PLACE_PREFERRED,	/* at pref_address, nothing to relocate */
+	PLACE_ALIGNED,		/* above pref_address at kernel_alignment */
+	PLACE_MIN_ALIGNED,	/* as above, at a smaller alignment */
+	PLACE_RELOCATED,	/* the kernel will move itself */
+};
+
+struct place_stats {
+	enum place_kernel how;
+	EFI_PHYSICAL_ADDRESS kernel;
+	UINT64 init_size;	/* bytes reserved at kernel */
+	UINT32 align;		/* the alignment we told the kernel */
+
+	EFI_PHYSICAL_ADDRESS initrd;
+	UINT64 initrd_size;
+	INT64 initrd_gap;	/* bytes from the kernel, < 0 if below it */
+};
+
+extern struct place_stats place_stats;
+
+struct setup_header;
+
+extern EFI_STATUS place_kernel(struct setup_header *hdr, UINT64 size,
+			       EFI_PHYSICAL_ADDRESS *addr);
+extern EFI_STATUS place_initrd(struct setup_header *hdr, UINT64 size,
+			       EFI_PHYSICAL_ADDRESS *addr);
+extern void place_report(void);
+
+#endif /* __PLACE_H__ */
@@ -1,4 +1,14 @@
 #include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "fs.h"
+#include "protocol.h"
+#include "stdlib.h"
+#include "profile.h"
+#include "sha256.h"
+#include "mp.h"
+#include "digest.h"
+#include "log.h"
 #include "loader.h"
 
 extern struct loader bzimage_loader;
@@ -14,22 +24,75 @@ struct loader *loaders[] = {
  * @name: filename of the new image to load
  * @cmdline: ascii command-line argument
  *
- * Try all of the registered loaders to see if any of them want to
- * load @name. If a loader successfully loads @name, it may not return
- * control to load_image(), for example see the bzImage loader.
+ * Open @name once, read its header and ask every registered loader
+ * how well it matches, before anything large is allocated or read.
+ * The best match is handed the open file, which is closed here if
+ * the loader fails. If a loader successfully loads @name, it may not
+ * return control to load_image(), for example see the bzImage loader.
  */
 EFI_STATUS
 load_image(EFI_HANDLE handle, CHAR16 *name, char *cmdline)
 {
-	struct loader **loader;
+	struct loader **loader, *best = NULL;
+	struct loader_file f;
+	struct digest digest;
+	UINTN match, best_match = LOADER_NO_MATCH;
 	EFI_STATUS err;
+	UINTN len;
+
+	err = handle_protocol(handle, &LoadedImageProtocol, (void **)&f.info);
+	if (err != EFI_SUCCESS)
+		f.info = NULL;
+
+	/* file_open() mangles the name */
+	f.digest = digest_start(&digest, name) ? &digest : NULL;
+
+	err = file_open(f.info, name, &f.file);
+	if (err != EFI_SUCCESS)
+		return err;
+
+	err = file_size(f.file, &f.size);
+	if (err != EFI_SUCCESS)
+		goto close;
+
+	f.header = malloc(LOADER_HEADER_SIZE);
+	if (!f.header) {
+		err = EFI_OUT_OF_RESOURCES;
+		goto close;
+	}
+
+	len = LOADER_HEADER_SIZE;
+	if (len > f.size)
+		len = f.size;
+
+	err = file_read(f.file, &len, f.header);
+	if (err != EFI_SUCCESS)
+		goto free_header;
+
+	f.header_len = len;
+	profile_stamp("image_header", len);
 
-	err = EFI_UNSUPPORTED;
 	for (loader = loaders; *loader != NULL; loader++) {
-		err = (*loader)->load(handle, name, cmdline);
-		if (err == EFI_SUCCESS)
-			break;
+		match = (*loader)->probe(&f);
+		if (match > best_match) {
+			best = *loader;
+			best_match = match;
+		}
 	}
 
+	if (!best) {
+		log_print(LOG_ERR, L"Unrecognised kernel image format");
+		err = EFI_UNSUPPORTED;
+		goto free_header;
+	}
+
+	err = best->load(handle, &f, cmdline);
+
+free_header:
+	free(f.header);
+close:
+	/* Unless load() has closed it already */
+	if (f.file)
+		file_close(f.file);
 	return err;
 }
@@ -31,8 +31,43 @@
 #ifndef __LOADER_H__
 #define __LOADER_H__
 
+/*
+ * Enough of the start of an image for every loader to recognise it,
+ * and for a bzImage, its setup code.
+ */
+#define LOADER_HEADER_SIZE	32768
+
+/* How well an image matches a loader, from probe() */
+#define LOADER_NO_MATCH		0
+#define LOADER_WEAK_MATCH	1	/* e.g. a boot sector signature */
+#define LOADER_MATCH		2	/* the format's own magic number */
+
+struct digest;
+struct file;
+
+/*
+ * An image that has been opened and had its header read, shared by
+ * all of the loaders.
+ */
+struct loader_file {
+	EFI_LOADED_IMAGE *info;	/* efilinux's image, or NULL */
+	struct file *file;	/* positioned just after the header */
+	UINT64 size;
+	UINT8 *header;		/* the first header_len bytes */
+	UINTN header_len;	/* less than LOADER_HEADER_SIZE if small */
+	struct digest *digest;	/* if the image's digest is pinned */
+};
+
+/*
+ * probe() scores an image from its header alone, without reading or
+ * allocating anything. load() is handed the open file but doesn't
+ * own it: if load() returns, load_image() closes the file. A loader
+ * that has to close it first, e.g. before ExitBootServices(), clears
+ * f->file.
+ */
 struct loader {
-	EFI_STATUS (*load)(EFI_HANDLE, CHAR16 *, char *);
+	UINTN (*probe)(struct loader_file *);
+	EFI_STATUS (*load)(EFI_HANDLE, struct loader_file *, char *);
 };
 
 extern struct loader *loaders[];
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * A log of efilinux's messages, kept in memory.
+ *
+ * Every message is appended to a ring of ASCII text. Unless we're
+ * quiet, messages at LOG_INFO and above also go straight to the
+ * console, as they always have, and debug messages are only printed
+ * ahead of an error. With -q nothing is written to the console until
+ * an error is logged, when everything that hasn't been printed yet is
+ * flushed ahead of it, or until log_flush() is called. Where ConOut
+ * is a serial console, each line can cost milliseconds.
+ *
+ * The ring is handed to the kernel as setup_data, so the messages of
+ * a quiet boot aren't lost.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "stdlib.h"
+#include "log.h"
+#include "uart.h"
+#include "fbcon.h"
+
+/* Hold messages until the arguments say whether to be quiet */
+BOOLEAN log_quiet = TRUE;
+
+static struct log_ring early_ring = { LOG_MAGIC, LOG_RING_SIZE, 0 };
+static struct log_ring *ring = &early_ring;
+
+/* How much of the ring has made it to the console */
+static UINT64 printed;
+
+/* Whether the next byte logged starts a line */
+static BOOLEAN line_start = TRUE;
+
+/*
+ * Write NUL-terminated ASCII to the console: the UART and the
+ * framebuffer if we've taken them over, otherwise ConOut.
+ */
+static void output(char *buf, UINTN len)
+{
+	BOOLEAN done = FALSE;
+
+	if (uart_enabled) {
+		uart_write(buf, len);
+		done = uart_enabled;
+	}
+
+	if (fbcon_enabled) {
+		fbcon_write(buf, len);
+		done = TRUE;
+	}
+
+	if (!done)
+		Print(L"%a", buf);
+}
+
+static void append(char c)
+{
+	ring->text[ring->head++ % LOG_RING_SIZE] = c;
+}
+
+/*
+ * Print the ring from 'printed' up to its head, without the "<n>"
+ * prefixes, in as few console writes as possible.
+ */
+static void flush(void)
+{
+	char buf[512];
+	BOOLEAN start;
+	UINT64 pos;
+	UINTN len;
+
+	/* Whatever was overwritten before it was printed is lost */
+	if (ring->head - printed > LOG_RING_SIZE) {
+		con_print(L"[%ld bytes of log lost]\n",
+			  ring->head - printed - LOG_RING_SIZE);
+		printed = ring->head - LOG_RING_SIZE;
+	}
+
+	/* Only a prefix can start with '<' at the start of a line */
+	start = !printed || ring->text[(printed - 1) % LOG_RING_SIZE] == '\n';
+
+	pos = printed;
+	len = 0;
+	while (pos < ring->head) {
+		char c = ring->text[pos++ % LOG_RING_SIZE];
+
+		if (start && c == '<') {
+			pos += 2;
+			start = FALSE;
+			continue;
+		}
+
+		start = (c == '\n');
+		buf[len++] = c;
+
+		if (len == sizeof(buf) - 1) {
+			buf[len] = '\0';
+			output(buf, len);
+			len = 0;
+		}
+	}
+
+	if (len) {
+		buf[len] = '\0';
+		output(buf, len);
+	}
+
+	printed = ring->head;
+}
+
+/**
+ * log_print - Log a message
+ * @level: the message's level, LOG_ERR to LOG_DEBUG
+ * @fmt: a Print() format string
+ *
+ * Messages of more than 255 characters are truncated. Logging an
+ * error flushes the log to the console.
+ */
+void log_print(enum log_level level, CHAR16 *fmt, ...)
+{
+	CHAR16 line[256];
+	UINT64 start = ring->head;
+	va_list args;
+	UINTN len, i;
+
+	va_start(args, fmt);
+	len = VSPrint(line, sizeof(line), fmt, args);
+	va_end(args);
+
+	for (i = 0; i < len; i++) {
+		if (line_start) {
+			append('<');
+			append('0' + level);
+			append('>');
+		}
+
+		append((char)line[i]);
+		line_start = (line[i] == '\n');
+	}
+
+	/*
+	 * When we're not quiet, the console is only ever behind by the
+	 * debug messages, and those are only printed with an error.
+	 */
+	if (!log_quiet && level != LOG_ERR && level <= LOG_INFO) {
+		printed = start;
+		flush();
+	} else if (level == LOG_ERR)
+		flush();
+}
+
+/**
+ * con_print - Print to the console without logging
+ * @fmt: a Print() format string
+ *
+ * For output that has been asked for, such as the memory map, rather
+ * than messages. Like log_print() it goes to the UART if there is one
+ * and is truncated at 255 characters.
+ */
+void con_print(CHAR16 *fmt, ...)
+{
+	CHAR16 line[256];
+	char buf[256];
+	va_list args;
+	UINTN len, i;
+
+	va_start(args, fmt);
+	len = VSPrint(line, sizeof(line), fmt, args);
+	va_end(args);
+
+	for (i = 0; i < len; i++)
+		buf[i] = (char)line[i];
+	buf[len] = '\0';
+
+	output(buf, len);
+}
+
+/**
+ * log_flush - Print everything logged that hasn't been printed yet
+ */
+void log_flush(void)
+{
+	if (printed != ring->head)
+		flush();
+}
+
+/**
+ * log_export - Move the log into a new buffer
+ * @buf: the buffer, which must be at least sizeof(struct log_ring)
+ *
+ * Copy the ring into @buf and log every later message there too, so
+ * that the buffer can be handed to the kernel before the last
+ * messages are logged.
+ */
+void log_export(struct log_ring *buf)
+{
+	memcpy((char *)buf, (char *)ring, sizeof(*ring));
+	ring = buf;
+}
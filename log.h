@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * A log of efilinux's messages, kept in memory.
+ */
+
+#ifndef __LOG_H__
+#define __LOG_H__
+
+#define LOG_MAGIC		0x4c4c4645	/* "EFLL" */
+#define LOG_RING_SIZE		16384
+
+/*
+ * Message levels, numbered like the kernel's so that each line of
+ * the ring can carry a printk-style "<n>" prefix.
+ */
+enum log_level {
+	LOG_ERR = 3,
+	LOG_WARN = 4,
+	LOG_INFO = 6,
+	LOG_DEBUG = 7,
+};
+
+/*
+ * The ring holds the last LOG_RING_SIZE bytes of ASCII text logged,
+ * text[head % LOG_RING_SIZE] being the next byte to be written. This
+ * layout is handed to the kernel as-is, so don't change it without
+ * bumping LOG_MAGIC.
+ */
+struct log_ring {
+	UINT32 magic;
+	UINT32 size;
+	UINT64 head;
+	char text[LOG_RING_SIZE];
+};
+
+extern BOOLEAN log_quiet;
+
+extern void log_print(enum log_level level, CHAR16 *fmt, ...);
+extern void log_flush(void);
+extern void con_print(CHAR16 *fmt, ...);
+extern void log_export(struct log_ring *buf);
+
+#endif /* __LOG_H__ */
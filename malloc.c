@@ -30,41 +30,124 @@
 #include <efi.h>
 #include <efilib.h>
 #include "efilinux.h"
+#include "stdlib.h"
+#include "log.h"
+
+/*
+ * emalloc() used to fetch and scan the whole firmware memory map on
+ * every call. Instead, keep a sorted index of the free
+ * (EfiConventionalMemory) extents, built from one copy of the map and
+ * updated as we allocate and free pages ourselves. If the firmware
+ * has changed the map behind our back, e.g. because a driver
+ * allocated memory, the AllocateAddress call for an extent we believe
+ * is free fails and we re-read the map before trying again.
+ */
+#define EXTENT_SLACK	64
+
+struct extent {
+	EFI_PHYSICAL_ADDRESS start;
+	EFI_PHYSICAL_ADDRESS end;
+};
+
+static struct {
+	struct extent *extents;
+	UINTN nr_extents;
+	UINTN max_extents;
+	UINTN pages;		/* size of 'extents' in pages */
+	BOOLEAN valid;
+} free_index;
+
+static void extent_remove(UINTN i)
+{
+	for (; i + 1 < free_index.nr_extents; i++)
+		free_index.extents[i] = free_index.extents[i + 1];
+
+	free_index.nr_extents--;
+}
+
+static BOOLEAN extent_insert(UINTN i, EFI_PHYSICAL_ADDRESS start,
+			     EFI_PHYSICAL_ADDRESS end)
+{
+	UINTN j;
+
+	if (free_index.nr_extents == free_index.max_extents)
+		return FALSE;
+
+	for (j = free_index.nr_extents; j > i; j--)
+		free_index.extents[j] = free_index.extents[j - 1];
+
+	free_index.extents[i].start = start;
+	free_index.extents[i].end = end;
+	free_index.nr_extents++;
+
+	return TRUE;
+}
 
 /**
- * emalloc - Allocate memory with a strict alignment requirement
- * @size: size in bytes of the requested allocation
- * @align: the required alignment of the allocation
- * @addr: a pointer to the allocated address on success
+ * index_sync - Rebuild the free extent index from the firmware map
  *
- * If we cannot satisfy @align we return 0.
+ * The index lives in its own pages, allocated before the map is read
+ * so that the map we index already accounts for them.
  */
-EFI_STATUS emalloc(UINTN size, UINTN align, EFI_PHYSICAL_ADDRESS *addr)
+static EFI_STATUS index_sync(void)
 {
-	UINTN map_size, map_key, desc_size;
 	EFI_MEMORY_DESCRIPTOR *map_buf;
-	UINTN d, map_end;
+	UINTN map_size, map_key, desc_size;
+	UINTN d, map_end, max_extents, i;
+	EFI_PHYSICAL_ADDRESS addr;
 	UINT32 desc_version;
 	EFI_STATUS err;
-	UINTN nr_pages = EFI_SIZE_TO_PAGES(size);
+
+	free_index.valid = FALSE;
+	malloc_stats.emalloc_syncs++;
+
+	map_size = 0;
+	err = get_memory_map(&map_size, NULL, NULL, NULL, NULL);
+	if (err != EFI_SUCCESS && err != EFI_BUFFER_TOO_SMALL)
+		return err;
+
+	/*
+	 * Every descriptor is at least sizeof(EFI_MEMORY_DESCRIPTOR)
+	 * bytes, so this over-estimates the number of extents.
+	 */
+	max_extents = map_size / sizeof(EFI_MEMORY_DESCRIPTOR) + EXTENT_SLACK;
+	if (max_extents > free_index.max_extents) {
+		UINTN pages;
+
+		pages = EFI_SIZE_TO_PAGES(max_extents * sizeof(struct extent));
+		err = allocate_pages(AllocateAnyPages, EfiLoaderData,
+				     pages, &addr);
+		if (err != EFI_SUCCESS)
+			return err;
+
+		if (free_index.extents)
+			free_pages((UINTN)free_index.extents, free_index.pages);
+
+		free_index.extents = (struct extent *)(UINTN)addr;
+		free_index.pages = pages;
+		free_index.max_extents = pages * EFI_PAGE_SIZE /
+			sizeof(struct extent);
+	}
 
 	err = memory_map(&map_buf, &map_size, &map_key,
 			 &desc_size, &desc_version);
 	if (err != EFI_SUCCESS)
-		goto fail;
+		return err;
 
+	free_index.nr_extents = 0;
 	d = (UINTN)map_buf;
 	map_end = (UINTN)map_buf + map_size;
 
 	for (; d < map_end; d += desc_size) {
 		EFI_MEMORY_DESCRIPTOR *desc;
-		EFI_PHYSICAL_ADDRESS start, end, aligned;
+		EFI_PHYSICAL_ADDRESS start, end;
 
 		desc = (EFI_MEMORY_DESCRIPTOR *)d;
 		if (desc->Type != EfiConventionalMemory)
 			continue;
 
-		if (desc->NumberOfPages < nr_pages)
+		/* Specific-purpose memory is for the OS to hand out */
+		if (desc->Attribute & EFI_MEMORY_SP)
 			continue;
 
 		start = desc->PhysicalStart;
@@ -73,29 +156,262 @@ EFI_STATUS emalloc(UINTN size, UINTN align, EFI_PHYSICAL_ADDRESS *addr)
 		/* Low-memory is super-precious! */
 		if (end <= 1 << 20)
 			continue;
-		if (start < 1 << 20) {
-			size -= (1 << 20) - start;
-			start = (1 << 20);
-		}
+		if (start < 1 << 20)
+			start = 1 << 20;
 
-		aligned = (start + align -1) & ~(align -1);
-
-		if ((aligned + size) <= end) {
-			err = allocate_pages(AllocateAddress, EfiLoaderData,
-					     nr_pages, &aligned);
-			if (err == EFI_SUCCESS) {
-				*addr = aligned;
+		/* The firmware map needn't be sorted, the index is */
+		for (i = free_index.nr_extents; i > 0; i--) {
+			if (free_index.extents[i - 1].start < start)
 				break;
-			}
 		}
+
+		if (!extent_insert(i, start, end))
+			break;
 	}
 
-	if (d == map_end)
-		err = EFI_OUT_OF_RESOURCES;
+	/* Coalesce adjacent extents */
+	for (i = 1; i < free_index.nr_extents; ) {
+		if (free_index.extents[i - 1].end == free_index.extents[i].start) {
+			free_index.extents[i - 1].end = free_index.extents[i].end;
+			extent_remove(i);
+		} else
+			i++;
+	}
 
 	free_pool(map_buf);
-fail:
-	return err;
+
+	free_index.valid = TRUE;
+
+	return EFI_SUCCESS;
+}
+
+/*
+ * Return the first extent that ends above 'addr'.
+ */
+static UINTN index_lookup(EFI_PHYSICAL_ADDRESS addr)
+{
+	UINTN lo = 0, hi = free_index.nr_extents;
+
+	while (lo < hi) {
+		UINTN mid = lo + (hi - lo) / 2;
+
+		if (free_index.extents[mid].end <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/*
+ * Find where an allocation of 'size' bytes aligned to 'align' would
+ * go in extent 'e', between 'min' and 'max', returning 0 if it
+ * doesn't fit. Top-down allocations are placed as high as possible.
+ */
+static EFI_PHYSICAL_ADDRESS extent_fit(struct extent *e, UINTN size,
+				       UINTN align, EFI_PHYSICAL_ADDRESS min,
+				       EFI_PHYSICAL_ADDRESS max,
+				       enum emalloc_policy policy)
+{
+	EFI_PHYSICAL_ADDRESS start, end, aligned;
+
+	start = e->start > min ? e->start : min;
+	end = e->end < max ? e->end : max;
+
+	if (end <= start || end - start < size)
+		return 0;
+
+	if (policy == EMALLOC_TOP_DOWN)
+		aligned = (end - size) & ~((EFI_PHYSICAL_ADDRESS)align - 1);
+	else
+		aligned = (start + align - 1) & ~((EFI_PHYSICAL_ADDRESS)align - 1);
+
+	if (aligned < start || aligned + size > end)
+		return 0;
+
+	return aligned;
+}
+
+static EFI_PHYSICAL_ADDRESS index_find(UINTN size, UINTN align,
+				       EFI_PHYSICAL_ADDRESS min,
+				       EFI_PHYSICAL_ADDRESS max,
+				       enum emalloc_policy policy)
+{
+	EFI_PHYSICAL_ADDRESS addr, best = 0;
+	UINT64 best_len = 0;
+	UINTN i, first;
+
+	first = index_lookup(min);
+
+	if (policy == EMALLOC_TOP_DOWN) {
+		for (i = free_index.nr_extents; i > first; i--) {
+			if (free_index.extents[i - 1].start >= max)
+				continue;
+
+			addr = extent_fit(&free_index.extents[i - 1], size,
+					  align, min, max, policy);
+			if (addr)
+				return addr;
+		}
+
+		return 0;
+	}
+
+	for (i = first; i < free_index.nr_extents; i++) {
+		struct extent *e = &free_index.extents[i];
+
+		if (e->start >= max)
+			break;
+
+		addr = extent_fit(e, size, align, min, max, policy);
+		if (!addr)
+			continue;
+
+		if (policy == EMALLOC_FIRST_FIT)
+			return addr;
+
+		if (!best || e->end - e->start < best_len) {
+			best = addr;
+			best_len = e->end - e->start;
+		}
+	}
+
+	return best;
+}
+
+/*
+ * Remove [start, end) from the index after allocating it.
+ */
+static void index_carve(EFI_PHYSICAL_ADDRESS start, EFI_PHYSICAL_ADDRESS end)
+{
+	struct extent *e;
+	UINTN i;
+
+	i = index_lookup(start);
+	if (i == free_index.nr_extents)
+		return;
+
+	e = &free_index.extents[i];
+	if (e->start > start || e->end < end) {
+		free_index.valid = FALSE;
+		return;
+	}
+
+	if (e->start == start && e->end == end)
+		extent_remove(i);
+	else if (e->start == start)
+		e->start = end;
+	else if (e->end == end)
+		e->end = start;
+	else {
+		EFI_PHYSICAL_ADDRESS tail = e->end;
+
+		e->end = start;
+		if (!extent_insert(i + 1, end, tail))
+			free_index.valid = FALSE;
+	}
+}
+
+/*
+ * Return [start, end) to the index after freeing it.
+ */
+static void index_release(EFI_PHYSICAL_ADDRESS start, EFI_PHYSICAL_ADDRESS end)
+{
+	struct extent *prev, *next;
+	UINTN i;
+
+	if (end <= 1 << 20)
+		return;
+	if (start < 1 << 20)
+		start = 1 << 20;
+
+	i = index_lookup(start);
+	prev = i ? &free_index.extents[i - 1] : NULL;
+	next = i < free_index.nr_extents ? &free_index.extents[i] : NULL;
+
+	if (next && next->start < end) {
+		/* Already free? The index is confused, start over */
+		free_index.valid = FALSE;
+		return;
+	}
+
+	if (prev && prev->end == start) {
+		prev->end = end;
+		if (next && next->start == end) {
+			prev->end = next->end;
+			extent_remove(i);
+		}
+	} else if (next && next->start == end) {
+		next->start = start;
+	} else if (!extent_insert(i, start, end))
+		free_index.valid = FALSE;
+}
+
+/**
+ * emalloc_range - Allocate pages within an address range
+ * @size: size in bytes of the requested allocation
+ * @align: the required alignment of the allocation, at least a page
+ * @min: lowest acceptable address
+ * @max: the allocation must end at or below this address
+ * @policy: which of the fitting free extents to use
+ * @addr: a pointer to the allocated address on success
+ *
+ * Memory below 1MiB is never returned.
+ */
+EFI_STATUS emalloc_range(UINTN size, UINTN align, EFI_PHYSICAL_ADDRESS min,
+			 EFI_PHYSICAL_ADDRESS max, enum emalloc_policy policy,
+			 EFI_PHYSICAL_ADDRESS *addr)
+{
+	UINTN nr_pages = EFI_SIZE_TO_PAGES(size);
+	EFI_PHYSICAL_ADDRESS aligned;
+	EFI_STATUS err;
+	int tries;
+
+	if (align < EFI_PAGE_SIZE)
+		align = EFI_PAGE_SIZE;
+
+	size = nr_pages << EFI_PAGE_SHIFT;
+	malloc_stats.emalloc_calls++;
+
+	for (tries = 0; tries < 2; tries++) {
+		if (!free_index.valid) {
+			err = index_sync();
+			if (err != EFI_SUCCESS)
+				return err;
+		}
+
+		aligned = index_find(size, align, min, max, policy);
+		if (!aligned)
+			break;
+
+		err = allocate_pages(AllocateAddress, EfiLoaderData,
+				     nr_pages, &aligned);
+		if (err == EFI_SUCCESS) {
+			index_carve(aligned, aligned + size);
+			*addr = aligned;
+			return EFI_SUCCESS;
+		}
+
+		/* The map has changed under us */
+		free_index.valid = FALSE;
+	}
+
+	return EFI_OUT_OF_RESOURCES;
+}
+
+/**
+ * emalloc - Allocate memory with a strict alignment requirement
+ * @size: size in bytes of the requested allocation
+ * @align: the required alignment of the allocation
+ * @addr: a pointer to the allocated address on success
+ *
+ * Return the lowest suitable address above 1MiB.
+ */
+EFI_STATUS emalloc(UINTN size, UINTN align, EFI_PHYSICAL_ADDRESS *addr)
+{
+	return emalloc_range(size, align, 0, EMALLOC_MAX_ADDR,
+			     EMALLOC_FIRST_FIT, addr);
 }
 
 /**
@@ -107,7 +423,124 @@ void efree(EFI_PHYSICAL_ADDRESS memory, UINTN size)
 {
 	UINTN nr_pages = EFI_SIZE_TO_PAGES(size);
 
-	free_pages(memory, nr_pages);
+	if (free_pages(memory, nr_pages) == EFI_SUCCESS && free_index.valid)
+		index_release(memory, memory + (nr_pages << EFI_PAGE_SHIFT));
+}
+
+/*
+ * Small allocations that only live as long as the loader are carved
+ * out of a single block of pages, rather than each costing a call to
+ * AllocatePool() and FreePool(), either of which may change the
+ * memory map key. Every chunk is rounded up to a power-of-two size
+ * class and freed chunks are kept on a per-class list for reuse.
+ * Anything larger than the biggest class, or anything that doesn't
+ * fit once the arena is full, still comes from the pool.
+ */
+#define ARENA_PAGES		64
+#define ARENA_MIN_SHIFT		4	/* 16 bytes */
+#define ARENA_MAX_SHIFT		12	/* 4KiB */
+#define ARENA_NR_CLASSES	(ARENA_MAX_SHIFT - ARENA_MIN_SHIFT + 1)
+
+/*
+ * The header keeps the returned pointer 16-byte aligned. While a
+ * chunk is on a free list its first word points to the next chunk.
+ */
+struct arena_chunk {
+	UINT32 class;
+	UINT32 pad[3];
+};
+
+static struct {
+	EFI_PHYSICAL_ADDRESS base;
+	UINTN top;
+	UINTN end;
+	BOOLEAN released;
+	void *free[ARENA_NR_CLASSES];
+} arena;
+
+struct malloc_stats malloc_stats;
+
+static void arena_init(void)
+{
+	EFI_STATUS err;
+
+	err = allocate_pages(AllocateAnyPages, EfiLoaderData,
+			     ARENA_PAGES, &arena.base);
+	if (err != EFI_SUCCESS) {
+		/* Just use the pool for everything */
+		arena.released = TRUE;
+		return;
+	}
+
+	arena.top = (UINTN)arena.base;
+	arena.end = arena.top + ARENA_PAGES * EFI_PAGE_SIZE;
+}
+
+static inline BOOLEAN in_arena(void *buffer)
+{
+	return arena.base && (UINTN)buffer >= (UINTN)arena.base &&
+		(UINTN)buffer < arena.end;
+}
+
+static void *arena_alloc(UINTN size)
+{
+	struct arena_chunk *c;
+	UINTN class, chunk_size;
+	void **head;
+
+	if (!arena.base && !arena.released)
+		arena_init();
+
+	if (arena.released || size > (1 << ARENA_MAX_SHIFT))
+		return NULL;
+
+	for (class = 0; ((UINTN)1 << (class + ARENA_MIN_SHIFT)) < size; class++)
+		;
+
+	head = &arena.free[class];
+	if (*head) {
+		void *buffer = *head;
+
+		*head = *(void **)buffer;
+		return buffer;
+	}
+
+	chunk_size = sizeof(*c) + ((UINTN)1 << (class + ARENA_MIN_SHIFT));
+	if (arena.end - arena.top < chunk_size)
+		return NULL;
+
+	c = (struct arena_chunk *)arena.top;
+	c->class = class;
+	arena.top += chunk_size;
+
+	return c + 1;
+}
+
+static void arena_free(void *buffer)
+{
+	struct arena_chunk *c = (struct arena_chunk *)buffer - 1;
+
+	*(void **)buffer = arena.free[c->class];
+	arena.free[c->class] = buffer;
+}
+
+/**
+ * arena_release - Give the allocation arena back to the firmware
+ *
+ * Must be called before the final memory map is taken on the way to
+ * the kernel. The arena's pages are freed wholesale, so nothing that
+ * was allocated from it may be used afterwards. Any later free() of
+ * such an allocation is ignored and later allocations come from the
+ * pool.
+ */
+void arena_release(void)
+{
+	if (arena.released)
+		return;
+
+	arena.released = TRUE;
+	if (arena.base)
+		free_pages(arena.base, ARENA_PAGES);
 }
 
 /**
@@ -115,17 +548,26 @@ void efree(EFI_PHYSICAL_ADDRESS memory, UINTN size)
  * @size: size in bytes of the requested allocation
  *
  * Return a pointer to an allocation of @size bytes of type
- * EfiLoaderData.
+ * EfiLoaderData. Small allocations are served from the arena without
+ * calling the firmware.
  */
 void *malloc(UINTN size)
 {
 	EFI_STATUS err;
 	void *buffer;
 
+	buffer = arena_alloc(size);
+	if (buffer) {
+		malloc_stats.arena_allocs++;
+		malloc_stats.arena_bytes += size;
+		return buffer;
+	}
+
 	err = allocate_pool(EfiLoaderData, size, &buffer);
 	if (err != EFI_SUCCESS)
 		buffer = NULL;
 
+	malloc_stats.pool_allocs++;
 	return buffer;
 }
 
@@ -135,5 +577,32 @@ void *malloc(UINTN size)
  */
 void free(void *buffer)
 {
+	if (in_arena(buffer)) {
+		if (!arena.released) {
+			arena_free(buffer);
+			malloc_stats.arena_frees++;
+		}
+		return;
+	}
+
 	free_pool(buffer);
+	malloc_stats.pool_frees++;
+}
+
+/**
+ * malloc_report - Print how many firmware calls the arena saved
+ */
+void malloc_report(void)
+{
+	log_print(LOG_INFO, L"malloc: %ld bytes in %ld allocations from "
+		  "the arena, %ld firmware calls avoided, %ld made\n",
+		  (UINT64)malloc_stats.arena_bytes,
+		  (UINT64)malloc_stats.arena_allocs,
+		  (UINT64)(malloc_stats.arena_allocs +
+			   malloc_stats.arena_frees),
+		  (UINT64)(malloc_stats.pool_allocs +
+			   malloc_stats.pool_frees));
+	log_print(LOG_INFO, L"emalloc: %ld page allocations, %ld memory map "
+		  "reads\n", (UINT64)malloc_stats.emalloc_calls,
+		  (UINT64)malloc_stats.emalloc_syncs);
 }
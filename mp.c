@@ -0,0 +1,321 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * A worker pool built on the PI MP Services protocol.
+ *
+ * Every AP that we are allowed to use runs worker() for as long as the
+ * loader does, taking jobs off a lock-free queue. Only the BSP puts
+ * jobs on the queue, so the tail needs no atomic read-modify-write;
+ * the BSP and the APs race to claim the head with a compare-and-swap.
+ * A BSP waiting for a job runs queued jobs itself rather than spin.
+ *
+ * APs can't call firmware services and run on small firmware stacks,
+ * so jobs must be self-contained computation: hashing, decompression,
+ * filling memory. Without MP services, with a single processor, or if
+ * the firmware won't start the APs without blocking, jobs simply run
+ * on the BSP when they are submitted.
+ *
+ * The APs must be back in the firmware's hands before we exit boot
+ * services, which is what mp_fini() is for.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "protocol.h"
+#include "stdlib.h"
+#include "mp.h"
+#include "log.h"
+
+UINTN mp_max_workers = (UINTN)-1;
+struct mp_stats mp_stats;
+
+static struct mp_services *mp;
+static UINTN nr_workers;
+
+/* One event per StartupThisAP() call, or one for StartupAllAPs() */
+static EFI_EVENT *events;
+static UINTN nr_events;
+
+static struct mp_job *queue[MP_QUEUE_SIZE];
+static UINTN queue_head;
+static UINTN queue_tail;
+static UINT32 workers_stop;
+
+static inline void cpu_relax(void)
+{
+	asm volatile ("pause" ::: "memory");
+}
+
+/*
+ * Claim the job at the head of the queue, or return NULL if it is
+ * empty. Callable from any processor.
+ */
+static struct mp_job *take_job(void)
+{
+	struct mp_job *job;
+	UINTN head, tail;
+
+	head = __atomic_load_n(&queue_head, __ATOMIC_ACQUIRE);
+	for (;;) {
+		tail = __atomic_load_n(&queue_tail, __ATOMIC_ACQUIRE);
+		if (head == tail)
+			return NULL;
+
+		/*
+		 * The slot can only be reused once the head has moved
+		 * past it, in which case the compare-and-swap fails.
+		 */
+		job = __atomic_load_n(&queue[head % MP_QUEUE_SIZE],
+				      __ATOMIC_RELAXED);
+		if (__atomic_compare_exchange_n(&queue_head, &head, head + 1,
+						FALSE, __ATOMIC_ACQ_REL,
+						__ATOMIC_ACQUIRE))
+			return job;
+	}
+}
+
+static void run_job(struct mp_job *job, BOOLEAN ap)
+{
+	job->fn(job->arg);
+
+	if (ap)
+		__atomic_fetch_add(&mp_stats.ap_jobs, 1, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&job->done, 1, __ATOMIC_RELEASE);
+}
+
+static void MP_ABI worker(void *arg)
+{
+	struct mp_job *job;
+
+	while (!__atomic_load_n(&workers_stop, __ATOMIC_ACQUIRE)) {
+		job = take_job();
+		if (job)
+			run_job(job, TRUE);
+		else
+			cpu_relax();
+	}
+}
+
+/*
+ * Start @nr APs, one at a time, for when we may not use all of them.
+ */
+static EFI_STATUS start_some_aps(UINTN nr_cpus, UINTN nr)
+{
+	EFI_STATUS err;
+	UINTN bsp, cpu;
+
+	err = uefi_call_wrapper(mp->who_am_i, 2, mp, &bsp);
+	if (err != EFI_SUCCESS)
+		return err;
+
+	events = malloc(sizeof(*events) * nr);
+	if (!events)
+		return EFI_OUT_OF_RESOURCES;
+
+	for (cpu = 0; cpu < nr_cpus && nr_events < nr; cpu++) {
+		EFI_EVENT *event = &events[nr_events];
+
+		if (cpu == bsp)
+			continue;
+
+		err = create_event(event);
+		if (err != EFI_SUCCESS)
+			break;
+
+		/* Disabled processors fail here and are skipped */
+		err = uefi_call_wrapper(mp->startup_this_ap, 7, mp, worker,
+					cpu, *event, 0, NULL, NULL);
+		if (err != EFI_SUCCESS) {
+			close_event(*event);
+			continue;
+		}
+
+		nr_events++;
+	}
+
+	nr_workers = nr_events;
+	return nr_workers ? EFI_SUCCESS : EFI_NOT_STARTED;
+}
+
+static EFI_STATUS start_all_aps(UINTN nr)
+{
+	EFI_STATUS err;
+
+	events = malloc(sizeof(*events));
+	if (!events)
+		return EFI_OUT_OF_RESOURCES;
+
+	err = create_event(&events[0]);
+	if (err != EFI_SUCCESS)
+		return err;
+
+	err = uefi_call_wrapper(mp->startup_all_aps, 7, mp, worker, FALSE,
+				events[0], 0, NULL, NULL);
+	if (err != EFI_SUCCESS) {
+		close_event(events[0]);
+		return err;
+	}
+
+	nr_events = 1;
+	nr_workers = nr;
+	return EFI_SUCCESS;
+}
+
+/**
+ * mp_init - Put the application processors to work
+ *
+ * Start a worker on every enabled AP, or on at most mp_max_workers of
+ * them. If that isn't possible jobs run on the BSP.
+ */
+void mp_init(void)
+{
+	EFI_GUID guid = MP_SERVICES_PROTOCOL_GUID;
+	UINTN nr_cpus, nr_enabled;
+	EFI_STATUS err;
+
+	if (!mp_max_workers)
+		return;
+
+	err = locate_protocol(&guid, (void **)&mp);
+	if (err != EFI_SUCCESS)
+		return;
+
+	err = uefi_call_wrapper(mp->get_nr_processors, 3, mp,
+				&nr_cpus, &nr_enabled);
+	if (err != EFI_SUCCESS || nr_enabled < 2)
+		return;
+
+	workers_stop = 0;
+
+	if (mp_max_workers < nr_enabled - 1)
+		err = start_some_aps(nr_cpus, mp_max_workers);
+	else
+		err = start_all_aps(nr_enabled - 1);
+
+	if (err != EFI_SUCCESS) {
+		/* Stop any APs that did start */
+		mp_fini();
+	}
+}
+
+/**
+ * mp_fini - Stop the workers and hand the APs back to the firmware
+ *
+ * Jobs that are still queued are run on the BSP first.
+ */
+void mp_fini(void)
+{
+	struct mp_job *job;
+	UINTN i, index;
+
+	while ((job = take_job()))
+		run_job(job, FALSE);
+
+	__atomic_store_n(&workers_stop, 1, __ATOMIC_RELEASE);
+
+	for (i = 0; i < nr_events; i++) {
+		wait_for_event(1, &events[i], &index);
+		close_event(events[i]);
+	}
+
+	if (events)
+		free(events);
+
+	events = NULL;
+	nr_events = 0;
+	nr_workers = 0;
+}
+
+/**
+ * mp_nr_workers - How many APs are taking jobs?
+ */
+UINTN mp_nr_workers(void)
+{
+	return nr_workers;
+}
+
+/**
+ * mp_report - Print how much of the work the APs took on
+ */
+void mp_report(void)
+{
+	log_print(LOG_INFO, L"mp: %ld workers, %ld of %ld jobs run on APs\n",
+		  (UINT64)nr_workers, (UINT64)mp_stats.ap_jobs,
+		  (UINT64)mp_stats.jobs);
+}
+
+/**
+ * mp_submit - Queue a job
+ * @job: the job, which must stay valid until mp_wait() returns
+ * @fn: the function to run
+ * @arg: the argument to pass to @fn
+ *
+ * Must only be called on the BSP. If there are no workers, or the
+ * queue is full, @fn runs before mp_submit() returns.
+ */
+void mp_submit(struct mp_job *job, mp_fn_t fn, void *arg)
+{
+	UINTN tail;
+
+	job->fn = fn;
+	job->arg = arg;
+	job->done = 0;
+	mp_stats.jobs++;
+
+	tail = queue_tail;
+	if (!nr_workers ||
+	    tail - __atomic_load_n(&queue_head, __ATOMIC_ACQUIRE) ==
+	    MP_QUEUE_SIZE) {
+		run_job(job, FALSE);
+		return;
+	}
+
+	__atomic_store_n(&queue[tail % MP_QUEUE_SIZE], job, __ATOMIC_RELAXED);
+	__atomic_store_n(&queue_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * mp_wait - Wait for a job to finish
+ * @job: a job passed to mp_submit()
+ *
+ * While waiting, the BSP helps out by running queued jobs.
+ */
+void mp_wait(struct mp_job *job)
+{
+	struct mp_job *other;
+
+	while (!__atomic_load_n(&job->done, __ATOMIC_ACQUIRE)) {
+		other = take_job();
+		if (other)
+			run_job(other, FALSE);
+		else
+			cpu_relax();
+	}
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * A pool of application processors for offloading CPU-bound work.
+ */
+
+#ifndef __MP_H__
+#define __MP_H__
+
+/*
+ * The MP Services protocol comes from the PI specification, not UEFI,
+ * so gnu-efi doesn't define it.
+ */
+#define MP_SERVICES_PROTOCOL_GUID \
+	{ 0x3fdda605, 0xa76e, 0x4f46, \
+	  { 0xad, 0x29, 0x12, 0xf4, 0x53, 0x1b, 0x3d, 0x08 } }
+
+/*
+ * The firmware calls AP procedures with its own calling convention,
+ * which on x86_64 isn't the one we're compiled with.
+ */
+#ifdef x86_64
+#define MP_ABI	__attribute__((ms_abi))
+#else
+#define MP_ABI
+#endif
+
+typedef void (MP_ABI *mp_procedure_t)(void *arg);
+
+struct mp_services {
+	EFI_STATUS (*get_nr_processors)(struct mp_services *this,
+					UINTN *nr, UINTN *nr_enabled);
+	void *get_processor_info;
+	EFI_STATUS (*startup_all_aps)(struct mp_services *this,
+				      mp_procedure_t proc,
+				      BOOLEAN single_thread,
+				      EFI_EVENT wait_event,
+				      UINTN timeout_us, void *arg,
+				      UINTN **failed_cpus);
+	EFI_STATUS (*startup_this_ap)(struct mp_services *this,
+				      mp_procedure_t proc, UINTN cpu,
+				      EFI_EVENT wait_event,
+				      UINTN timeout_us, void *arg,
+				      BOOLEAN *finished);
+	void *switch_bsp;
+	void *enable_disable_ap;
+	EFI_STATUS (*who_am_i)(struct mp_services *this, UINTN *cpu);
+};
+
+#define MP_QUEUE_SIZE	256
+
+typedef void (*mp_fn_t)(void *arg);
+
+/*
+ * A unit of work. Jobs run on an AP if one is free and on the BSP
+ * otherwise, so @fn must not call any firmware services.
+ */
+struct mp_job {
+	mp_fn_t fn;
+	void *arg;
+	volatile UINT32 done;
+};
+
+struct mp_stats {
+	UINTN jobs;
+	UINTN ap_jobs;
+};
+
+extern UINTN mp_max_workers;
+extern struct mp_stats mp_stats;
+
+extern void mp_init(void);
+extern void mp_fini(void);
+extern UINTN mp_nr_workers(void);
+extern void mp_report(void);
+extern void mp_submit(struct mp_job *job, mp_fn_t fn, void *arg);
+extern void mp_wait(struct mp_job *job);
+
+#endif /* __MP_H__ */
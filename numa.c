@@ -0,0 +1,488 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Kernel and initrd placement on NUMA and tiered memory systems.
+ *
+ * The lowest free address is not a good place for the kernel and
+ * initrd on a multi-socket machine, or one with CXL memory, because
+ * it may be on a remote node or a slow tier and the early kernel
+ * decompresses and unpacks them at that memory's speed. The SRAT
+ * tells us which proximity domain the boot CPU and each memory range
+ * are in, and the HMAT, if there is one, how fast each domain is from
+ * the boot CPU. We sort the memory domains into tiers, prefer the
+ * boot CPU's own domain within a tier, and try them in order.
+ *
+ * Memory marked EFI_MEMORY_SP is never used, see malloc.c.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "acpi.h"
+#include "stdlib.h"
+#include "numa.h"
+
+enum numa_policy numa_policy = NUMA_FASTEST;
+
+struct numa_range {
+	EFI_PHYSICAL_ADDRESS start;
+	EFI_PHYSICAL_ADDRESS end;
+	UINT32 domain;
+};
+
+struct numa_domain {
+	UINT32 id;
+	UINT64 bandwidth;	/* MB/s from the boot CPU, 0 if unknown */
+	UINT64 latency;		/* ps from the boot CPU, 0 if unknown */
+	UINT32 tier;		/* 0 is the fastest */
+	BOOLEAN usable;		/* has memory that isn't EFI_MEMORY_SP */
+};
+
+/* The tier of a domain we can't allocate from */
+#define NUMA_TIER_UNUSABLE	((UINT32)-1)
+
+static struct numa_range ranges[NUMA_MAX_RANGES];
+static UINTN nr_ranges;
+
+/* Memory domains, best first */
+static struct numa_domain domains[NUMA_MAX_DOMAINS];
+static UINTN nr_domains;
+
+static UINT32 boot_domain;
+
+/*
+ * The local APIC ID of the CPU we're running on, preferring the
+ * 32-bit x2APIC ID when the processor reports one.
+ */
+static UINT32 boot_cpu_apic_id(BOOLEAN *x2apic)
+{
+	UINT32 regs[4];
+
+	cpuid(0, 0, regs);
+	if (regs[0] >= 0xb) {
+		cpuid(0xb, 0, regs);
+		if (regs[1]) {
+			*x2apic = TRUE;
+			return regs[3];
+		}
+	}
+
+	cpuid(1, 0, regs);
+	*x2apic = FALSE;
+	return regs[1] >> 24;
+}
+
+static struct numa_domain *domain_lookup(UINT32 id)
+{
+	UINTN i;
+
+	for (i = 0; i < nr_domains; i++) {
+		if (domains[i].id == id)
+			return &domains[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Fill in the boot CPU's domain and the memory ranges from the SRAT.
+ * Returns FALSE if the boot CPU isn't described.
+ */
+static BOOLEAN parse_srat(struct acpi_srat *srat)
+{
+	char *p = (char *)(srat + 1);
+	char *end = (char *)srat + srat->hdr.length;
+	BOOLEAN x2apic, found = FALSE;
+	UINT32 apic_id;
+
+	apic_id = boot_cpu_apic_id(&x2apic);
+
+	while (p + sizeof(struct acpi_subtable) <= end) {
+		struct acpi_subtable *s = (struct acpi_subtable *)p;
+		struct acpi_srat_cpu_affinity *cpu;
+		struct acpi_srat_x2apic_affinity *x2;
+		struct acpi_srat_mem_affinity *mem;
+
+		if (s->length < sizeof(*s) || p + s->length > end)
+			break;
+
+		switch (s->type) {
+		case ACPI_SRAT_CPU_AFFINITY:
+			cpu = (struct acpi_srat_cpu_affinity *)s;
+			if (!(cpu->flags & ACPI_SRAT_ENABLED) ||
+			    cpu->apic_id != apic_id || found)
+				break;
+
+			boot_domain = cpu->proximity_lo |
+				cpu->proximity_hi[0] << 8 |
+				cpu->proximity_hi[1] << 16 |
+				cpu->proximity_hi[2] << 24;
+			found = TRUE;
+			break;
+		case ACPI_SRAT_X2APIC_AFFINITY:
+			x2 = (struct acpi_srat_x2apic_affinity *)s;
+			if (!(x2->flags & ACPI_SRAT_ENABLED) ||
+			    x2->apic_id != apic_id || found)
+				break;
+
+			boot_domain = x2->proximity_domain;
+			found = TRUE;
+			break;
+		case ACPI_SRAT_MEM_AFFINITY:
+			mem = (struct acpi_srat_mem_affinity *)s;
+			if (!(mem->flags & ACPI_SRAT_ENABLED) ||
+			    (mem->flags & ACPI_SRAT_MEM_NON_VOLATILE) ||
+			    !mem->size || nr_ranges == NUMA_MAX_RANGES)
+				break;
+
+			ranges[nr_ranges].start = mem->base;
+			ranges[nr_ranges].end = mem->base + mem->size;
+			ranges[nr_ranges].domain = mem->proximity_domain;
+			nr_ranges++;
+
+			if (!domain_lookup(mem->proximity_domain) &&
+			    nr_domains < NUMA_MAX_DOMAINS) {
+				memset((char *)&domains[nr_domains], 0,
+				       sizeof(domains[0]));
+				domains[nr_domains++].id = mem->proximity_domain;
+			}
+			break;
+		}
+
+		p += s->length;
+	}
+
+	return found;
+}
+
+/*
+ * Record the bandwidth and latency from the boot CPU's domain to
+ * every memory domain.
+ */
+static void parse_hmat(struct acpi_hmat *hmat)
+{
+	char *p = (char *)(hmat + 1);
+	char *end = (char *)hmat + hmat->hdr.length;
+
+	while (p + sizeof(struct acpi_hmat_structure) <= end) {
+		struct acpi_hmat_structure *s = (struct acpi_hmat_structure *)p;
+		struct acpi_hmat_locality *l;
+		UINT32 *initiators, *targets;
+		UINT16 *entries;
+		UINT64 unit;
+		UINTN i, j;
+
+		if (s->length < sizeof(*s) || p + s->length > end)
+			break;
+
+		p += s->length;
+
+		if (s->type != ACPI_HMAT_LOCALITY)
+			continue;
+
+		l = (struct acpi_hmat_locality *)s;
+		if ((l->flags & ACPI_HMAT_MEMORY_HIERARCHY) != 0)
+			continue;
+
+		if (sizeof(*l) + (l->nr_initiators + l->nr_targets) * 4 +
+		    l->nr_initiators * l->nr_targets * 2 > s->length)
+			continue;
+
+		initiators = (UINT32 *)(l + 1);
+		targets = initiators + l->nr_initiators;
+		entries = (UINT16 *)(targets + l->nr_targets);
+
+		for (i = 0; i < l->nr_initiators; i++) {
+			if (initiators[i] == boot_domain)
+				break;
+		}
+
+		if (i == l->nr_initiators)
+			continue;
+
+		/* Entries are in this structure's own units */
+		unit = l->entry_base_unit;
+		if (!unit)
+			continue;
+
+		for (j = 0; j < l->nr_targets; j++) {
+			struct numa_domain *d = domain_lookup(targets[j]);
+			UINT16 e = entries[i * l->nr_targets + j];
+			UINT64 v = e * unit;
+
+			/* 0 and 0xffff mean "no information" */
+			if (!d || !e || e == 0xffff)
+				continue;
+
+			switch (l->data_type) {
+			case ACPI_HMAT_ACCESS_BANDWIDTH:
+				if (d->bandwidth)
+					break;
+				/* fall through */
+			case ACPI_HMAT_READ_BANDWIDTH:
+				d->bandwidth = v;
+				break;
+			case ACPI_HMAT_ACCESS_LATENCY:
+				if (d->latency)
+					break;
+				/* fall through */
+			case ACPI_HMAT_READ_LATENCY:
+				d->latency = v;
+				break;
+			}
+		}
+	}
+}
+
+/*
+ * Mark the domains that have memory we can allocate from. If we
+ * can't get the memory map, assume they all do.
+ */
+static void find_usable(void)
+{
+	EFI_MEMORY_DESCRIPTOR *map_buf;
+	UINTN map_size, map_key, desc_size;
+	UINT32 desc_version;
+	UINTN d, map_end, i;
+	EFI_STATUS err;
+
+	err = memory_map(&map_buf, &map_size, &map_key,
+			 &desc_size, &desc_version);
+	if (err != EFI_SUCCESS) {
+		for (i = 0; i < nr_domains; i++)
+			domains[i].usable = TRUE;
+		return;
+	}
+
+	d = (UINTN)map_buf;
+	map_end = (UINTN)map_buf + map_size;
+
+	for (; d < map_end; d += desc_size) {
+		EFI_MEMORY_DESCRIPTOR *desc = (EFI_MEMORY_DESCRIPTOR *)d;
+		EFI_PHYSICAL_ADDRESS start, end;
+
+		if (desc->Type != EfiConventionalMemory ||
+		    (desc->Attribute & EFI_MEMORY_SP))
+			continue;
+
+		start = desc->PhysicalStart;
+		end = start + (desc->NumberOfPages << EFI_PAGE_SHIFT);
+
+		for (i = 0; i < nr_ranges; i++) {
+			struct numa_range *r = &ranges[i];
+			struct numa_domain *dom;
+
+			if (r->start >= end || start >= r->end)
+				continue;
+
+			/* There may have been too many domains to track */
+			dom = domain_lookup(r->domain);
+			if (dom)
+				dom->usable = TRUE;
+		}
+	}
+
+	free_pool(map_buf);
+}
+
+/*
+ * Put each domain in a tier, much like the kernel's memory tiers.
+ * Every halving of bandwidth, or doubling of latency, from the best
+ * memory we can use is a tier further down, so DRAM on another
+ * socket that is a little faster on paper is in the same tier as
+ * the boot CPU's own. A figure the HMAT doesn't give doesn't count.
+ */
+static void assign_tiers(void)
+{
+	UINT64 best_bw = 0, best_lat = 0, v;
+	UINTN i;
+
+	for (i = 0; i < nr_domains; i++) {
+		struct numa_domain *d = &domains[i];
+
+		if (!d->usable)
+			continue;
+
+		if (d->bandwidth > best_bw)
+			best_bw = d->bandwidth;
+		if (d->latency && (!best_lat || d->latency < best_lat))
+			best_lat = d->latency;
+	}
+
+	for (i = 0; i < nr_domains; i++) {
+		struct numa_domain *d = &domains[i];
+
+		if (!d->usable) {
+			d->tier = NUMA_TIER_UNUSABLE;
+			continue;
+		}
+
+		d->tier = 0;
+		for (v = d->bandwidth; v && v * 2 <= best_bw; v *= 2)
+			d->tier++;
+		for (v = best_lat; v && d->latency && v * 2 <= d->latency;
+		     v *= 2)
+			d->tier++;
+	}
+}
+
+/*
+ * Is 'a' a better place for the kernel than 'b'? The fastest tier
+ * wins, then the boot CPU's own domain, then the raw figures.
+ */
+static BOOLEAN domain_better(struct numa_domain *a, struct numa_domain *b)
+{
+	if (a->tier != b->tier)
+		return a->tier < b->tier;
+
+	if (a->id == boot_domain || b->id == boot_domain)
+		return a->id == boot_domain;
+
+	if (a->bandwidth != b->bandwidth)
+		return a->bandwidth > b->bandwidth;
+
+	return a->latency && b->latency && a->latency < b->latency;
+}
+
+/**
+ * numa_init - Work out which memory to prefer for the kernel
+ *
+ * Does nothing if numa_policy is NUMA_OFF or the firmware doesn't
+ * provide an SRAT that describes the boot CPU. With NUMA_LOCAL only
+ * the boot CPU's domain is preferred.
+ */
+void numa_init(void)
+{
+	struct acpi_header *srat, *hmat;
+	struct acpi_rsdp *rsdp;
+	UINTN i, j;
+
+	nr_ranges = 0;
+	nr_domains = 0;
+
+	if (numa_policy == NUMA_OFF)
+		return;
+
+	rsdp = acpi_find_rsdp();
+	if (!rsdp)
+		return;
+
+	srat = acpi_find_table(rsdp, ACPI_SRAT_SIGNATURE);
+	if (!srat || !parse_srat((struct acpi_srat *)srat)) {
+		nr_ranges = 0;
+		return;
+	}
+
+	if (numa_policy == NUMA_LOCAL) {
+		nr_domains = 1;
+		domains[0].id = boot_domain;
+		return;
+	}
+
+	hmat = acpi_find_table(rsdp, ACPI_HMAT_SIGNATURE);
+	if (hmat)
+		parse_hmat((struct acpi_hmat *)hmat);
+
+	find_usable();
+	assign_tiers();
+
+	/* Insertion sort, there are only a handful of domains */
+	for (i = 1; i < nr_domains; i++) {
+		struct numa_domain d = domains[i];
+
+		for (j = i; j > 0 && domain_better(&d, &domains[j - 1]); j--)
+			domains[j] = domains[j - 1];
+
+		domains[j] = d;
+	}
+}
+
+/**
+ * numa_preferred - Is a range in the most preferred memory domain?
+ * @start: the start of the range
+ * @size: the size of the range in bytes
+ *
+ * Always TRUE if we know nothing about the topology.
+ */
+BOOLEAN numa_preferred(EFI_PHYSICAL_ADDRESS start, UINTN size)
+{
+	UINTN i;
+
+	if (!nr_ranges || !nr_domains)
+		return TRUE;
+
+	for (i = 0; i < nr_ranges; i++) {
+		struct numa_range *r = &ranges[i];
+
+		if (r->domain == domains[0].id &&
+		    start >= r->start && start + size <= r->end)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/**
+ * numa_emalloc - Allocate pages from the best memory domain possible
+ * @size: size in bytes of the requested allocation
+ * @align: the required alignment of the allocation
+ * @min: lowest acceptable address
+ * @max: the allocation must end at or below this address
+ * @policy: how to choose between free extents within a domain
+ * @addr: a pointer to the allocated address on success
+ *
+ * Try each memory domain in order of preference, falling back to
+ * anywhere between @min and @max.
+ */
+EFI_STATUS numa_emalloc(UINTN size, UINTN align, EFI_PHYSICAL_ADDRESS min,
+			EFI_PHYSICAL_ADDRESS max, enum emalloc_policy policy,
+			EFI_PHYSICAL_ADDRESS *addr)
+{
+	UINTN i, j;
+
+	for (i = 0; i < nr_domains; i++) {
+		for (j = 0; j < nr_ranges; j++) {
+			struct numa_range *r = &ranges[j];
+			EFI_PHYSICAL_ADDRESS lo, hi;
+
+			if (r->domain != domains[i].id)
+				continue;
+
+			lo = r->start > min ? r->start : min;
+			hi = r->end < max ? r->end : max;
+			if (hi <= lo || hi - lo < size)
+				continue;
+
+			if (emalloc_range(size, align, lo, hi, policy,
+					  addr) == EFI_SUCCESS)
+				return EFI_SUCCESS;
+		}
+	}
+
+	return emalloc_range(size, align, min, max, policy, addr);
+}
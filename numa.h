@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __NUMA_H__
+#define __NUMA_H__
+
+#define NUMA_MAX_DOMAINS	64
+#define NUMA_MAX_RANGES		256
+
+/*
+ * Where to put the kernel and initrd on machines with more than one
+ * memory node or tier, selected with -n.
+ */
+enum numa_policy {
+	NUMA_OFF,	/* ignore the topology */
+	NUMA_LOCAL,	/* memory local to the boot CPU */
+	NUMA_FASTEST,	/* the fastest memory the boot CPU can see */
+};
+
+extern enum numa_policy numa_policy;
+
+extern void numa_init(void);
+extern BOOLEAN numa_preferred(EFI_PHYSICAL_ADDRESS start, UINTN size);
+extern EFI_STATUS numa_emalloc(UINTN size, UINTN align,
+			       EFI_PHYSICAL_ADDRESS min,
+			       EFI_PHYSICAL_ADDRESS max,
+			       enum emalloc_policy policy,
+			       EFI_PHYSICAL_ADDRESS *addr);
+
+#endif /* __NUMA_H__ */
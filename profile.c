@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Record where boot time goes. Every phase of the boot ends with a
+ * call to profile_stamp(), which records the TSC. The records can be
+ * printed as a table and are also handed to the kernel, see
+ * profile_export().
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "profile.h"
+#include "stdlib.h"
+#include "log.h"
+
+BOOLEAN profile_enabled = FALSE;
+
+static UINT64 tsc_rate;
+
+static struct profile_log early_log;
+static struct profile_log *plog = &early_log;
+
+/*
+ * Ask the processor for the TSC frequency. Leaf 0x15 gives it
+ * exactly, as a ratio to the crystal clock, and leaf 0x16 gives the
+ * base frequency that the TSC runs at. Returns 0 if neither says.
+ */
+static UINT64 cpuid_tsc_per_us(void)
+{
+	UINT32 regs[4], max;
+
+	cpuid(0, 0, regs);
+	max = regs[0];
+
+	if (max >= 0x15) {
+		cpuid(0x15, 0, regs);
+		if (regs[0] && regs[1] && regs[2])
+			return (UINT64)regs[2] * regs[1] / regs[0] / 1000000;
+	}
+
+	if (max >= 0x16) {
+		cpuid(0x16, 0, regs);
+		return regs[0] & 0xffff;
+	}
+
+	return 0;
+}
+
+/**
+ * tsc_per_us - The number of TSC ticks in a microsecond
+ *
+ * Nothing needs to know unless we're printing times, so the TSC is
+ * only calibrated on first use. If the processor won't tell us its
+ * frequency we stall for a millisecond, which is accurate enough for
+ * phases that take tens of microseconds. Stalling needs boot
+ * services, so the first call must come before exit_boot().
+ */
+UINT64 tsc_per_us(void)
+{
+	UINT64 start;
+
+	if (tsc_rate)
+		return tsc_rate;
+
+	tsc_rate = cpuid_tsc_per_us();
+	if (!tsc_rate) {
+		start = rdtsc();
+		stall(1000);
+		tsc_rate = (rdtsc() - start) / 1000;
+		if (!tsc_rate)
+			tsc_rate = 1;
+	}
+
+	plog->tsc_per_us = tsc_rate;
+	return tsc_rate;
+}
+
+/**
+ * profile_init - Record the start of the boot
+ */
+void profile_init(void)
+{
+	plog->magic = PROFILE_MAGIC;
+	plog->nr_records = 0;
+	plog->tsc_per_us = tsc_rate;
+
+	profile_stamp("efi_main", 0);
+}
+
+/**
+ * profile_stamp - Record the end of a boot phase
+ * @name: the name of the phase, truncated to PROFILE_NAME_LEN - 1 bytes
+ * @data: an arbitrary value to store alongside the stamp
+ */
+void profile_stamp(char *name, UINT64 data)
+{
+	struct profile_record *r;
+	int i;
+
+	if (plog->nr_records == PROFILE_MAX_RECORDS)
+		return;
+
+	r = &plog->records[plog->nr_records++];
+	r->tsc = rdtsc();
+	r->data = data;
+
+	for (i = 0; i < PROFILE_NAME_LEN - 1 && name[i]; i++)
+		r->name[i] = name[i];
+	for (; i < PROFILE_NAME_LEN; i++)
+		r->name[i] = '\0';
+}
+
+/**
+ * profile_export - Move the profile log into a new buffer
+ * @buf: the buffer, which must be at least sizeof(struct profile_log)
+ *
+ * Copy the records gathered so far into @buf and record every later
+ * stamp there too. This allows the log to be handed to the kernel
+ * before the final stamps, e.g. exit_boot_services(), are taken.
+ */
+void profile_export(struct profile_log *buf)
+{
+	memcpy((char *)buf, (char *)plog, sizeof(*plog));
+	plog = buf;
+}
+
+/**
+ * profile_print - Print the time spent in each boot phase
+ */
+void profile_print(void)
+{
+	struct profile_record *r;
+	UINT64 base;
+	int i;
+
+	if (!profile_enabled || !plog->nr_records)
+		return;
+
+	base = plog->records[0].tsc;
+
+	log_print(LOG_INFO, L"\nBoot profile (%ld TSC ticks/us)\n",
+		  tsc_per_us());
+	log_print(LOG_INFO, L"%-16a %12a %12a %12a\n", "phase", "at (us)",
+		  "took (us)", "data");
+
+	for (i = 0; i < plog->nr_records; i++) {
+		UINT64 prev;
+
+		r = &plog->records[i];
+		prev = i ? plog->records[i - 1].tsc : base;
+
+		log_print(LOG_INFO, L"%-16a %12ld %12ld %12ld\n", r->name,
+			  ticks_to_us(r->tsc - base),
+			  ticks_to_us(r->tsc - prev), r->data);
+	}
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#define PROFILE_MAGIC		0x504c4645	/* "EFLP" */
+#define PROFILE_MAX_RECORDS	64
+#define PROFILE_NAME_LEN	16
+
+/*
+ * A profile record marks the end of a boot phase. The time spent in
+ * the phase is the difference between its TSC stamp and the stamp of
+ * the record before it. This layout is handed to the kernel as-is,
+ * so don't change it without bumping PROFILE_MAGIC.
+ */
+struct profile_record {
+	UINT64 tsc;
+	UINT64 data;		/* phase-specific, e.g. bytes read */
+	char name[PROFILE_NAME_LEN];
+};
+
+struct profile_log {
+	UINT32 magic;
+	UINT32 nr_records;
+	UINT64 tsc_per_us;	/* 0 if efilinux never needed to know */
+	struct profile_record records[PROFILE_MAX_RECORDS];
+};
+
+extern BOOLEAN profile_enabled;
+
+extern UINT64 tsc_per_us(void);
+extern void profile_init(void);
+extern void profile_stamp(char *name, UINT64 data);
+extern void profile_export(struct profile_log *log);
+extern void profile_print(void);
+
+/**
+ * ticks_to_us - Convert a number of TSC ticks to microseconds
+ * @ticks: the TSC delta to convert
+ */
+static inline UINT64 ticks_to_us(UINT64 ticks)
+{
+	return ticks / tsc_per_us();
+}
+
+#endif /* __PROFILE_H__ */
@@ -64,4 +64,19 @@ locate_handle(EFI_LOCATE_SEARCH_TYPE type, EFI_GUID *protocol, void *key,
 				 key, size, buffer);
 }
 
+/**
+ * locate_protocol - Find the first instance of @protocol
+ * @protocol: the GUID of the protocol
+ * @interface: used to return the protocol interface
+ *
+ * Useful for protocols that are not tied to a device, where any
+ * instance will do.
+ */
+static inline EFI_STATUS
+locate_protocol(EFI_GUID *protocol, void **interface)
+{
+	return uefi_call_wrapper(boot->LocateProtocol, 3, protocol,
+				 NULL, interface);
+}
+
 #endif /* __PROTOCOL_H__ */
@@ -0,0 +1,199 @@
+#!/bin/sh
+#
+# Copyright (c) 2011, Intel Corporation
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+#    * Redistributions of source code must retain the above copyright
+#      notice, this list of conditions and the following disclaimer.
+#    * Redistributions in binary form must reproduce the above copyright
+#      notice, this list of conditions and the following disclaimer
+#      in the documentation and/or other materials provided with the
+#      distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+# FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+# COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+# SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+# STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+# OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+# Boot efilinux.efi under QEMU and OVMF with synthetic kernels and
+# initrds of several sizes and print the boot profile of each run as
+# CSV on stdout, one row per phase:
+#
+#	kernel_mib,initrd_mib,run,phase,at_us,took_us,data
+#
+# The "wall" row is the time from starting QEMU to the kernel's entry
+# point asking it to exit, in microseconds. A run that doesn't get
+# that far gets a "failed" row with QEMU's exit status instead.
+#
+# usage: qemu-bench.sh <efilinux.efi> <efilinux-bench>
+#
+# The synthetic files are written by efilinux-bench -w. Tunables, from
+# the environment:
+#
+#	BENCH_CASES	kernel:initrd sizes in MiB (default below)
+#	BENCH_RUNS	boots per case (3)
+#	BENCH_VERSION	boot protocol version of the bzImage (20c)
+#	BENCH_ARGS	extra efilinux switches
+#	BENCH_TMPDIR	where to build the ESP images (/var/tmp)
+#	BENCH_TIMEOUT	seconds before a boot is given up on (300)
+#	QEMU		QEMU binary (qemu-system-x86_64)
+#	QEMU_ARGS	extra QEMU arguments, e.g. -enable-kvm
+#	OVMF		OVMF firmware image (searched for)
+#	OVMF_VARS	variable store for a split OVMF_CODE image (the
+#			OVMF_VARS image next to it)
+#
+
+set -e
+
+if [ $# -ne 2 ]; then
+	echo "usage: $0 <efilinux.efi> <efilinux-bench>" >&2
+	exit 1
+fi
+
+efi=$1
+gen=$2
+
+BENCH_CASES=${BENCH_CASES:-"10:10 10:100 10:500 20:1000 20:2000"}
+BENCH_RUNS=${BENCH_RUNS:-3}
+BENCH_VERSION=${BENCH_VERSION:-20c}
+BENCH_TMPDIR=${BENCH_TMPDIR:-/var/tmp}
+BENCH_TIMEOUT=${BENCH_TIMEOUT:-300}
+QEMU=${QEMU:-qemu-system-x86_64}
+
+if [ -z "$OVMF" ]; then
+	for f in /usr/share/OVMF/OVMF.fd /usr/share/ovmf/OVMF.fd \
+		 /usr/share/qemu/OVMF.fd /usr/share/edk2/ovmf/OVMF_CODE.fd \
+		 /usr/share/OVMF/OVMF_CODE.fd /usr/share/OVMF/OVMF_CODE_4M.fd; do
+		if [ -r "$f" ]; then
+			OVMF=$f
+			break
+		fi
+	done
+fi
+
+if [ -z "$OVMF" ]; then
+	echo "$0: no OVMF image found, set OVMF" >&2
+	exit 1
+fi
+
+# A split image won't boot from -bios, it wants its variables in flash
+vars=
+case "$OVMF" in
+*_CODE*.fd)
+	vars=${OVMF_VARS:-${OVMF%_CODE*}_VARS${OVMF##*_CODE}}
+	if [ ! -r "$vars" ]; then
+		echo "$0: no $vars to go with $OVMF, set OVMF_VARS" >&2
+		exit 1
+	fi
+	;;
+esac
+
+for tool in "$QEMU" mformat mcopy timeout; do
+	if ! command -v "$tool" >/dev/null; then
+		echo "$0: $tool is needed" >&2
+		exit 1
+	fi
+done
+
+work=$(mktemp -d "$BENCH_TMPDIR/efilinux-qemu.XXXXXX")
+trap 'rm -rf "$work"' EXIT INT TERM
+
+# Microseconds since the epoch, as close as date(1) gets us
+now_us() {
+	echo $(( $(date +%s%N) / 1000 ))
+}
+
+#
+# Turn the "Boot profile" table on the serial console into CSV rows.
+# OVMF's console adds carriage returns and escape sequences.
+#
+scrape() {
+	sed -e 's/\r//g' -e 's/\x1b\[[0-9;]*[A-Za-z]//g' "$1" | awk -v pre="$2" '
+		/^Boot profile/	{ table = 1; next }
+		!table		{ next }
+		/^phase /	{ next }
+		NF != 4		{ exit }
+				{ print pre "," $1 "," $2 "," $3 "," $4 }'
+}
+
+echo "kernel_mib,initrd_mib,run,phase,at_us,took_us,data"
+
+for c in $BENCH_CASES; do
+	kernel=${c%%:*}
+	initrd=${c##*:}
+	esp=$work/esp
+	img=$work/esp.img
+
+	echo "$0: kernel $kernel MiB, initrd $initrd MiB" >&2
+
+	rm -rf "$esp" "$img"
+	mkdir -p "$esp/EFI/BOOT"
+	"$gen" -w -d "$esp" -k "$kernel" -i "$initrd" -V "$BENCH_VERSION"
+	cp "$efi" "$esp/EFI/BOOT/BOOTX64.EFI"
+	# Not echo: dash's turns "\b" into a backspace
+	cfg="-p $BENCH_ARGS -f \\bzImage initrd=\\initrd0 console=ttyS0"
+	printf '%s\n' "$cfg" > "$esp/EFI/BOOT/efilinux.cfg"
+
+	# A FAT32 superfloppy with some slack, which OVMF boots as is
+	size=$(( kernel + initrd + 64 ))
+	dd if=/dev/zero of="$img" bs=1M count=0 seek="$size" 2>/dev/null
+	mformat -i "$img" -F ::
+	mcopy -s -i "$img" "$esp/EFI" "$esp/bzImage" "$esp/initrd0" ::/
+	rm -rf "$esp"
+
+	# Room for the decompressed kernel, the initrd and the firmware
+	mem=$(( kernel * 4 + initrd + 1024 ))
+
+	run=1
+	while [ "$run" -le "$BENCH_RUNS" ]; do
+		log=$work/serial.log
+		pre="$kernel,$initrd,$run"
+
+		# Don't scrape the last run's log if QEMU doesn't start
+		: > "$log"
+
+		# Every boot starts from the same, writable, variable store
+		if [ -n "$vars" ]; then
+			cp "$vars" "$work/vars.fd"
+			set -- \
+			    -drive if=pflash,format=raw,readonly=on,file="$OVMF" \
+			    -drive if=pflash,format=raw,file="$work/vars.fd"
+		else
+			set -- -bios "$OVMF"
+		fi
+
+		start=$(now_us)
+		status=0
+		timeout "$BENCH_TIMEOUT" "$QEMU" -machine q35 -m "$mem" "$@" \
+			-drive file="$img",format=raw,if=virtio \
+			-device isa-debug-exit,iobase=0xf4,iosize=0x04 \
+			-display none -serial file:"$log" -net none \
+			-no-reboot $QEMU_ARGS || status=$?
+		end=$(now_us)
+
+		scrape "$log" "$pre"
+
+		# The entry stub writes 0x31, which QEMU exits with as 0x63
+		if [ "$status" -eq 99 ]; then
+			echo "$pre,wall,$(( end - start )),$(( end - start )),0"
+		else
+			echo "$pre,failed,0,0,$status"
+		fi
+
+		run=$(( run + 1 ))
+	done
+
+	rm -f "$img"
+done
@@ -0,0 +1,365 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * SHA-256, as specified in FIPS 180-4.
+ *
+ * On x86_64 processors with the SHA extensions the compression
+ * function uses sha256rnds2 and friends, which hash several times
+ * faster than the portable C. The functions here don't call the
+ * firmware or allocate memory, so they are safe to run on an AP.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "stdlib.h"
+#include "sha256.h"
+
+/*
+ * The EFI build doesn't optimize, but this is where all of the time
+ * goes when verifying a large initrd.
+ */
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize ("O2", "no-tree-loop-distribute-patterns")
+#endif
+
+#define SHA256_PROBED	(1 << 0)
+#define SHA256_SHA_NI	(1 << 1)
+
+/* Use the SHA extensions if the processor has them */
+BOOLEAN sha256_accel = TRUE;
+
+static UINT32 features;
+
+static const UINT32 K[64] __attribute__((aligned(16))) = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROR(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+
+static inline UINT32 load_be32(const UINT8 *p)
+{
+	return ((UINT32)p[0] << 24) | ((UINT32)p[1] << 16) |
+		((UINT32)p[2] << 8) | p[3];
+}
+
+static inline void store_be32(UINT8 *p, UINT32 v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static void blocks_generic(UINT32 *state, const UINT8 *data, UINTN nr)
+{
+	UINT32 a, b, c, d, e, f, g, h, t1, t2;
+	UINT32 w[64];
+	int i;
+
+	while (nr--) {
+		for (i = 0; i < 16; i++)
+			w[i] = load_be32(data + i * 4);
+
+		for (; i < 64; i++) {
+			UINT32 s0, s1;
+
+			s0 = ROR(w[i - 15], 7) ^ ROR(w[i - 15], 18) ^
+				(w[i - 15] >> 3);
+			s1 = ROR(w[i - 2], 17) ^ ROR(w[i - 2], 19) ^
+				(w[i - 2] >> 10);
+			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+		f = state[5];
+		g = state[6];
+		h = state[7];
+
+		for (i = 0; i < 64; i++) {
+			t1 = h + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) +
+				((e & f) ^ (~e & g)) + K[i] + w[i];
+			t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) +
+				((a & b) ^ (a & c) ^ (b & c));
+			h = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+
+		data += SHA256_BLOCK_SIZE;
+	}
+}
+
+#ifdef x86_64
+typedef int v4si __attribute__((vector_size(16)));
+typedef long long v2di __attribute__((vector_size(16)));
+typedef short v8hi __attribute__((vector_size(16)));
+typedef char v16qi __attribute__((vector_size(16)));
+typedef int v4si_u __attribute__((vector_size(16), aligned(1), may_alias));
+
+#define SHA_NI		__attribute__((target("sha,sse4.1")))
+
+#define shuffle(a, imm)	__builtin_ia32_pshufd((a), (imm))
+#define alignr(a, b, n)	\
+	((v4si)__builtin_ia32_palignr128((v2di)(a), (v2di)(b), (n) * 8))
+#define blend(a, b, m)	\
+	((v4si)__builtin_ia32_pblendw128((v8hi)(a), (v8hi)(b), (m)))
+
+/*
+ * The state is kept in the order that sha256rnds2 wants it, ABEF and
+ * CDGH. Each trip round the inner loop does four rounds and works out
+ * the message words for four rounds' time.
+ */
+static SHA_NI void blocks_sha_ni(UINT32 *state, const UINT8 *data, UINTN nr)
+{
+	const v16qi flip = { 3, 2, 1, 0, 7, 6, 5, 4,
+			     11, 10, 9, 8, 15, 14, 13, 12 };
+	v4si s0, s1, tmp, abef, cdgh, msg, m[4];
+	int i;
+
+	tmp = shuffle(*(v4si_u *)&state[0], 0xb1);	/* CDAB */
+	s1 = shuffle(*(v4si_u *)&state[4], 0x1b);	/* EFGH */
+	s0 = alignr(tmp, s1, 8);			/* ABEF */
+	s1 = blend(s1, tmp, 0xf0);			/* CDGH */
+
+	while (nr--) {
+		abef = s0;
+		cdgh = s1;
+
+		/* Unrolled, m[] lives in registers */
+#pragma GCC unroll 16
+		for (i = 0; i < 16; i++) {
+			v4si *w = &m[i & 3];
+
+			if (i < 4) {
+				tmp = *(v4si_u *)(data + i * 16);
+				*w = (v4si)__builtin_ia32_pshufb128(
+					(v16qi)tmp, flip);
+			} else {
+				/* m[i & 3] still holds the words from i - 4 */
+				*w = __builtin_ia32_sha256msg1(*w,
+							m[(i + 1) & 3]);
+				*w += alignr(m[(i + 3) & 3], m[(i + 2) & 3], 4);
+				*w = __builtin_ia32_sha256msg2(*w,
+							m[(i + 3) & 3]);
+			}
+
+			msg = *w + *(v4si *)&K[i * 4];
+			s1 = __builtin_ia32_sha256rnds2(s1, s0, msg);
+			msg = shuffle(msg, 0x0e);
+			s0 = __builtin_ia32_sha256rnds2(s0, s1, msg);
+		}
+
+		s0 += abef;
+		s1 += cdgh;
+		data += SHA256_BLOCK_SIZE;
+	}
+
+	tmp = shuffle(s0, 0x1b);			/* FEBA */
+	s1 = shuffle(s1, 0xb1);				/* DCHG */
+	*(v4si_u *)&state[0] = blend(tmp, s1, 0xf0);	/* DCBA */
+	*(v4si_u *)&state[4] = alignr(s1, tmp, 8);	/* HGFE */
+}
+#endif /* x86_64 */
+
+/*
+ * The SHA extensions work on %xmm registers, which UEFI guarantees
+ * are usable on x86_64.
+ */
+static UINT32 probe_features(void)
+{
+	UINT32 regs[4], f = SHA256_PROBED;
+
+#ifdef x86_64
+	cpuid(0, 0, regs);
+	if (regs[0] >= 7) {
+		BOOLEAN sse41;
+
+		cpuid(1, 0, regs);
+		sse41 = !!(regs[2] & (1 << 19));
+
+		cpuid(7, 0, regs);
+		if (sse41 && (regs[1] & (1 << 29)))
+			f |= SHA256_SHA_NI;
+	}
+#endif
+
+	features = f;
+	return f;
+}
+
+static inline BOOLEAN use_sha_ni(void)
+{
+	UINT32 f = features;
+
+	if (!f)
+		f = probe_features();
+
+	return sha256_accel && (f & SHA256_SHA_NI);
+}
+
+static void blocks(UINT32 *state, const UINT8 *data, UINTN nr)
+{
+#ifdef x86_64
+	if (use_sha_ni()) {
+		blocks_sha_ni(state, data, nr);
+		return;
+	}
+#endif
+	blocks_generic(state, data, nr);
+}
+
+/**
+ * sha256_impl - Name the compression function that will be used
+ */
+char *sha256_impl(void)
+{
+	return use_sha_ni() ? "sha-ni" : "generic";
+}
+
+/**
+ * sha256_init - Start a new hash
+ * @ctx: the hash state to initialise
+ */
+void sha256_init(struct sha256 *ctx)
+{
+	ctx->state[0] = 0x6a09e667;
+	ctx->state[1] = 0xbb67ae85;
+	ctx->state[2] = 0x3c6ef372;
+	ctx->state[3] = 0xa54ff53a;
+	ctx->state[4] = 0x510e527f;
+	ctx->state[5] = 0x9b05688c;
+	ctx->state[6] = 0x1f83d9ab;
+	ctx->state[7] = 0x5be0cd19;
+	ctx->count = 0;
+
+	/* Probe here, on the BSP, rather than racing on the APs */
+	use_sha_ni();
+}
+
+/**
+ * sha256_update - Add data to a hash
+ * @ctx: the hash state
+ * @data: the data to add
+ * @len: the number of bytes at @data
+ */
+void sha256_update(struct sha256 *ctx, const void *data, UINTN len)
+{
+	const UINT8 *p = data;
+	UINTN used, n;
+
+	used = ctx->count % SHA256_BLOCK_SIZE;
+	ctx->count += len;
+
+	if (used) {
+		n = SHA256_BLOCK_SIZE - used;
+		if (n > len)
+			n = len;
+
+		memcpy(ctx->buf + used, p, n);
+		p += n;
+		len -= n;
+
+		if (used + n < SHA256_BLOCK_SIZE)
+			return;
+
+		blocks(ctx->state, ctx->buf, 1);
+	}
+
+	if (len >= SHA256_BLOCK_SIZE) {
+		n = len / SHA256_BLOCK_SIZE;
+		blocks(ctx->state, p, n);
+		p += n * SHA256_BLOCK_SIZE;
+		len -= n * SHA256_BLOCK_SIZE;
+	}
+
+	if (len)
+		memcpy(ctx->buf, p, len);
+}
+
+/**
+ * sha256_final - Finish a hash
+ * @ctx: the hash state, which can't be used again without sha256_init()
+ * @digest: returns the SHA256_DIGEST_SIZE byte digest
+ */
+void sha256_final(struct sha256 *ctx, UINT8 *digest)
+{
+	UINT64 bits = ctx->count * 8;
+	UINTN used;
+	int i;
+
+	used = ctx->count % SHA256_BLOCK_SIZE;
+	ctx->buf[used++] = 0x80;
+
+	if (used > SHA256_BLOCK_SIZE - 8) {
+		memset(ctx->buf + used, 0, SHA256_BLOCK_SIZE - used);
+		blocks(ctx->state, ctx->buf, 1);
+		used = 0;
+	}
+
+	memset(ctx->buf + used, 0, SHA256_BLOCK_SIZE - 8 - used);
+	store_be32(ctx->buf + 56, bits >> 32);
+	store_be32(ctx->buf + 60, bits);
+	blocks(ctx->state, ctx->buf, 1);
+
+	for (i = 0; i < 8; i++)
+		store_be32(digest + i * 4, ctx->state[i]);
+}
@@ -1,44 +1,51 @@
 #ifndef __STDLIB_H__
 #define __STDLIB_H__
 
-extern void *malloc(UINTN size);
-extern void free(void *buf);
-
-extern EFI_STATUS emalloc(UINTN, UINTN, EFI_PHYSICAL_ADDRESS *);
-extern void efree(EFI_PHYSICAL_ADDRESS, UINTN);
-
-static inline void memset(char *dst, char ch, UINTN size)
-{
-	int i;
+struct malloc_stats {
+	UINTN arena_allocs;	/* malloc() calls served from the arena */
+	UINTN arena_frees;	/* free() calls returned to the arena */
+	UINTN arena_bytes;	/* bytes handed out from the arena */
+	UINTN pool_allocs;	/* malloc() calls that went to the firmware */
+	UINTN pool_frees;	/* free() calls that went to the firmware */
+	UINTN emalloc_calls;	/* page allocations made through emalloc() */
+	UINTN emalloc_syncs;	/* times the free extent index was rebuilt */
+};
 
-	for (i = 0; i < size; i++)
-		dst[i] = ch;
-}
+/*
+ * Which of the free extents that can hold an emalloc_range()
+ * allocation to use.
+ */
+enum emalloc_policy {
+	EMALLOC_FIRST_FIT,	/* the lowest address */
+	EMALLOC_BEST_FIT,	/* the smallest extent, to limit fragmentation */
+	EMALLOC_TOP_DOWN,	/* the highest address */
+};
 
-static inline void memcpy(char *dst, char *src, UINTN size)
-{
-	int i;
+#define EMALLOC_MAX_ADDR	((EFI_PHYSICAL_ADDRESS)-1)
 
-	for (i = 0; i < size; i++)
-		*dst++ = *src++;
-}
+extern struct malloc_stats malloc_stats;
 
-static inline int strlen(char *str)
-{
-	int len;
+extern void *malloc(UINTN size);
+extern void free(void *buf);
+extern void arena_release(void);
+extern void malloc_report(void);
 
-	len = 0;
-	while (*str++)
-		len++;
+extern EFI_STATUS emalloc(UINTN, UINTN, EFI_PHYSICAL_ADDRESS *);
+extern EFI_STATUS emalloc_range(UINTN, UINTN, EFI_PHYSICAL_ADDRESS,
+				EFI_PHYSICAL_ADDRESS, enum emalloc_policy,
+				EFI_PHYSICAL_ADDRESS *);
+extern void efree(EFI_PHYSICAL_ADDRESS, UINTN);
 
-	return len;
-}
+extern void *memset(void *dst, int ch, UINTN size);
+extern void *memcpy(void *dst, const void *src, UINTN size);
+extern void *memmove(void *dst, const void *src, UINTN size);
+extern UINTN strlen(const char *str);
 
 static inline char *strstr(char *haystack, char *needle)
 {
 	char *p;
 	char *word = NULL;
-	int len = strlen(needle);
+	UINTN len = strlen(needle);
 
 	if (!len)
 		return NULL;
@@ -0,0 +1,433 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * memset(), memcpy(), memmove() and strlen() for efilinux.
+ *
+ * We can't link against a C library, but these are used on buffers
+ * of any size, from the setup header right up to the kernel image, so
+ * a byte-at-a-time loop isn't good enough. Bulk work is done with the
+ * widest instructions the processor and the firmware allow, AVX2 or
+ * SSE2 on x86_64, 'rep movsb/stosb' for very large buffers when the
+ * processor has fast string support, and whole machine words
+ * otherwise. None of the paths touch the stack below %rsp, so they
+ * are safe with -mno-red-zone.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "stdlib.h"
+
+/*
+ * Stop GCC from turning the word and byte loops below back into calls
+ * to memcpy() and memset() when optimizing.
+ */
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize ("no-tree-loop-distribute-patterns")
+#endif
+
+#define STRING_PROBED	(1 << 0)
+#define STRING_AVX2	(1 << 1)
+#define STRING_ERMS	(1 << 2)
+
+/* Below this many bytes the setup cost of the vector loops dominates */
+#define VECTOR_THRESHOLD	256
+
+/* From this many bytes up 'rep movsb/stosb' beats the vector loops */
+#define REP_THRESHOLD		(4 << 20)
+
+typedef UINTN __attribute__((may_alias, aligned(1))) word_t;
+
+#define WORD_SIZE	sizeof(UINTN)
+#define ONES		((UINTN)-1 / 0xff)
+#define HIGHS		(ONES << 7)
+
+static UINT32 features;
+
+/**
+ * probe_features - Work out which string instructions we can use
+ *
+ * AVX2 needs the firmware to have enabled the SSE and AVX state in
+ * XCR0 as well as processor support.
+ */
+static UINT32 probe_features(void)
+{
+	UINT32 regs[4], max_leaf, f = STRING_PROBED;
+	BOOLEAN avx = FALSE;
+
+	cpuid(0, 0, regs);
+	max_leaf = regs[0];
+
+	cpuid(1, 0, regs);
+	if ((regs[2] & (1 << 27)) && (regs[2] & (1 << 28)))
+		avx = (xgetbv(0) & 0x6) == 0x6;
+
+	if (max_leaf >= 7) {
+		cpuid(7, 0, regs);
+		if (avx && (regs[1] & (1 << 5)))
+			f |= STRING_AVX2;
+		if (regs[1] & (1 << 9))
+			f |= STRING_ERMS;
+	}
+
+	features = f;
+	return f;
+}
+
+static inline UINT32 string_features(void)
+{
+	if (features)
+		return features;
+
+	return probe_features();
+}
+
+static inline void copy_words(char *d, const char *s, UINTN size)
+{
+	while (size && ((UINTN)d & (WORD_SIZE - 1))) {
+		*d++ = *s++;
+		size--;
+	}
+
+	for (; size >= WORD_SIZE; size -= WORD_SIZE) {
+		*(word_t *)d = *(const word_t *)s;
+		d += WORD_SIZE;
+		s += WORD_SIZE;
+	}
+
+	while (size--)
+		*d++ = *s++;
+}
+
+static inline void set_words(char *d, UINTN pattern, UINTN size)
+{
+	while (size && ((UINTN)d & (WORD_SIZE - 1))) {
+		*d++ = (char)pattern;
+		size--;
+	}
+
+	for (; size >= WORD_SIZE; size -= WORD_SIZE) {
+		*(word_t *)d = pattern;
+		d += WORD_SIZE;
+	}
+
+	while (size--)
+		*d++ = (char)pattern;
+}
+
+#ifdef x86_64
+/*
+ * The vector loops move 128 bytes per iteration. 'd' must be aligned
+ * to the vector size and 'size' must be a non-zero multiple of 128.
+ */
+static inline void copy_avx2(char *d, const char *s, UINTN size)
+{
+	asm volatile ("1:				\n"
+		      "vmovdqu    (%1), %%ymm0		\n"
+		      "vmovdqu  32(%1), %%ymm1		\n"
+		      "vmovdqu  64(%1), %%ymm2		\n"
+		      "vmovdqu  96(%1), %%ymm3		\n"
+		      "vmovdqa %%ymm0,   (%0)		\n"
+		      "vmovdqa %%ymm1, 32(%0)		\n"
+		      "vmovdqa %%ymm2, 64(%0)		\n"
+		      "vmovdqa %%ymm3, 96(%0)		\n"
+		      "add $128, %1			\n"
+		      "add $128, %0			\n"
+		      "sub $128, %2			\n"
+		      "jnz 1b				\n"
+		      "vzeroupper			\n"
+		      : "+r" (d), "+r" (s), "+r" (size)
+		      :: "xmm0", "xmm1", "xmm2", "xmm3", "memory", "cc");
+}
+
+static inline void copy_sse2(char *d, const char *s, UINTN size)
+{
+	asm volatile ("1:				\n"
+		      "movdqu    (%1), %%xmm0		\n"
+		      "movdqu  16(%1), %%xmm1		\n"
+		      "movdqu  32(%1), %%xmm2		\n"
+		      "movdqu  48(%1), %%xmm3		\n"
+		      "movdqa %%xmm0,    (%0)		\n"
+		      "movdqa %%xmm1,  16(%0)		\n"
+		      "movdqa %%xmm2,  32(%0)		\n"
+		      "movdqa %%xmm3,  48(%0)		\n"
+		      "movdqu  64(%1), %%xmm0		\n"
+		      "movdqu  80(%1), %%xmm1		\n"
+		      "movdqu  96(%1), %%xmm2		\n"
+		      "movdqu 112(%1), %%xmm3		\n"
+		      "movdqa %%xmm0,  64(%0)		\n"
+		      "movdqa %%xmm1,  80(%0)		\n"
+		      "movdqa %%xmm2,  96(%0)		\n"
+		      "movdqa %%xmm3, 112(%0)		\n"
+		      "add $128, %1			\n"
+		      "add $128, %0			\n"
+		      "sub $128, %2			\n"
+		      "jnz 1b				\n"
+		      : "+r" (d), "+r" (s), "+r" (size)
+		      :: "xmm0", "xmm1", "xmm2", "xmm3", "memory", "cc");
+}
+
+static inline void set_avx2(char *d, UINTN pattern, UINTN size)
+{
+	asm volatile ("movq %2, %%xmm0			\n"
+		      "punpcklqdq %%xmm0, %%xmm0	\n"
+		      "vinsertf128 $1, %%xmm0, %%ymm0, %%ymm0\n"
+		      "1:				\n"
+		      "vmovdqa %%ymm0,   (%0)		\n"
+		      "vmovdqa %%ymm0, 32(%0)		\n"
+		      "vmovdqa %%ymm0, 64(%0)		\n"
+		      "vmovdqa %%ymm0, 96(%0)		\n"
+		      "add $128, %0			\n"
+		      "sub $128, %1			\n"
+		      "jnz 1b				\n"
+		      "vzeroupper			\n"
+		      : "+r" (d), "+r" (size)
+		      : "r" (pattern)
+		      : "xmm0", "memory", "cc");
+}
+
+static inline void set_sse2(char *d, UINTN pattern, UINTN size)
+{
+	asm volatile ("movq %2, %%xmm0			\n"
+		      "punpcklqdq %%xmm0, %%xmm0	\n"
+		      "1:				\n"
+		      "movdqa %%xmm0,    (%0)		\n"
+		      "movdqa %%xmm0,  16(%0)		\n"
+		      "movdqa %%xmm0,  32(%0)		\n"
+		      "movdqa %%xmm0,  48(%0)		\n"
+		      "movdqa %%xmm0,  64(%0)		\n"
+		      "movdqa %%xmm0,  80(%0)		\n"
+		      "movdqa %%xmm0,  96(%0)		\n"
+		      "movdqa %%xmm0, 112(%0)		\n"
+		      "add $128, %0			\n"
+		      "sub $128, %1			\n"
+		      "jnz 1b				\n"
+		      : "+r" (d), "+r" (size)
+		      : "r" (pattern)
+		      : "xmm0", "memory", "cc");
+}
+
+/*
+ * Return a mask with bit n set if byte n of the 16 aligned bytes at
+ * 'p' is zero.
+ */
+static inline UINT32 zero_mask(const char *p)
+{
+	UINT32 mask;
+
+	asm ("pxor %%xmm0, %%xmm0		\n"
+	     "pcmpeqb (%1), %%xmm0		\n"
+	     "pmovmskb %%xmm0, %0		\n"
+	     : "=r" (mask) : "r" (p), "m" (*(const char (*)[16])p)
+	     : "xmm0");
+
+	return mask;
+}
+#endif /* x86_64 */
+
+/**
+ * memcpy - Copy memory
+ * @dst: destination buffer
+ * @src: source buffer, which must not overlap @dst
+ * @size: number of bytes to copy
+ *
+ * Returns @dst.
+ */
+void *memcpy(void *dst, const void *src, UINTN size)
+{
+	char *d = dst;
+	const char *s = src;
+	UINT32 f;
+
+	if (size < VECTOR_THRESHOLD)
+		goto tail;
+
+	f = string_features();
+
+	if (size >= REP_THRESHOLD && (f & STRING_ERMS)) {
+		asm volatile ("rep movsb"
+			      : "+D" (d), "+S" (s), "+c" (size)
+			      :: "memory");
+		return dst;
+	}
+
+#ifdef x86_64
+	{
+		UINTN align = (f & STRING_AVX2) ? 32 : 16;
+		UINTN head = -(UINTN)d & (align - 1);
+		UINTN bulk;
+
+		copy_words(d, s, head);
+		d += head;
+		s += head;
+		size -= head;
+
+		bulk = size & ~(UINTN)127;
+		if (f & STRING_AVX2)
+			copy_avx2(d, s, bulk);
+		else
+			copy_sse2(d, s, bulk);
+
+		d += bulk;
+		s += bulk;
+		size -= bulk;
+	}
+#endif
+
+tail:
+	copy_words(d, s, size);
+	return dst;
+}
+
+/**
+ * memmove - Copy memory between buffers that may overlap
+ * @dst: destination buffer
+ * @src: source buffer
+ * @size: number of bytes to copy
+ *
+ * memcpy() works from the start of the buffers and never loads bytes
+ * beyond those it has already stored, so it's safe whenever @dst is
+ * below @src, which covers scrolling. Moving a buffer up over itself
+ * is done a byte at a time from the end.
+ *
+ * Returns @dst.
+ */
+void *memmove(void *dst, const void *src, UINTN size)
+{
+	char *d = dst;
+	const char *s = src;
+
+	if (d <= s || d >= s + size)
+		return memcpy(dst, src, size);
+
+	while (size--)
+		d[size] = s[size];
+
+	return dst;
+}
+
+/**
+ * memset - Fill memory with a constant byte
+ * @dst: destination buffer
+ * @ch: the byte to fill @dst with
+ * @size: number of bytes to fill
+ *
+ * Returns @dst.
+ */
+void *memset(void *dst, int ch, UINTN size)
+{
+	UINTN pattern = ONES * (UINT8)ch;
+	char *d = dst;
+	UINT32 f;
+
+	if (size < VECTOR_THRESHOLD)
+		goto tail;
+
+	f = string_features();
+
+	if (size >= REP_THRESHOLD && (f & STRING_ERMS)) {
+		asm volatile ("rep stosb"
+			      : "+D" (d), "+c" (size)
+			      : "a" (ch)
+			      : "memory");
+		return dst;
+	}
+
+#ifdef x86_64
+	{
+		UINTN align = (f & STRING_AVX2) ? 32 : 16;
+		UINTN head = -(UINTN)d & (align - 1);
+		UINTN bulk;
+
+		set_words(d, pattern, head);
+		d += head;
+		size -= head;
+
+		bulk = size & ~(UINTN)127;
+		if (f & STRING_AVX2)
+			set_avx2(d, pattern, bulk);
+		else
+			set_sse2(d, pattern, bulk);
+
+		d += bulk;
+		size -= bulk;
+	}
+#endif
+
+tail:
+	set_words(d, pattern, size);
+	return dst;
+}
+
+/**
+ * strlen - Return the length of a NUL-terminated string
+ * @str: the string
+ *
+ * Aligned loads never cross into the next page, so it's safe to read
+ * a little either side of @str while looking for the terminator.
+ */
+UINTN strlen(const char *str)
+{
+#ifdef x86_64
+	const char *p = (const char *)((UINTN)str & ~(UINTN)15);
+	UINT32 mask;
+
+	mask = zero_mask(p) >> ((UINTN)str & 15);
+	if (mask)
+		return __builtin_ctz(mask);
+
+	for (;;) {
+		p += 16;
+		mask = zero_mask(p);
+		if (mask)
+			return p - str + __builtin_ctz(mask);
+	}
+#else
+	const char *p = str;
+	const word_t *w;
+	UINTN v;
+
+	while ((UINTN)p & (WORD_SIZE - 1)) {
+		if (!*p)
+			return p - str;
+		p++;
+	}
+
+	/* Stop at the first word containing a zero byte */
+	for (w = (const word_t *)p; ; w++) {
+		v = *w;
+		if ((v - ONES) & ~v & HIGHS)
+			break;
+	}
+
+	for (p = (const char *)w; *p; p++)
+		;
+
+	return p - str;
+#endif
+}
@@ -0,0 +1,362 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * A console on a 16550-compatible UART, bypassing ConOut.
+ *
+ * Some firmware redirects ConOut to the serial port through a
+ * terminal emulator that repaints the screen, which is far slower
+ * than the line itself. "-u" writes efilinux's output straight to the
+ * UART instead, either the one the firmware describes in the ACPI
+ * SPCR or one given on the command line. Output is written a FIFO's
+ * worth at a time, polling the line status only when the FIFO has
+ * drained, so it goes out at line rate.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "acpi.h"
+#include "profile.h"
+#include "log.h"
+#include "uart.h"
+
+#ifdef HOST_BENCH
+#include "host.h"
+#endif
+
+/* Give up on a UART whose FIFO hasn't drained after this long */
+#define UART_TIMEOUT_US		10000
+
+struct uart_port {
+	UINT64 base;
+	BOOLEAN mmio;
+	UINT8 shift;	/* log2 of the register stride */
+	UINT8 fifo;	/* bytes we can write each time the FIFO drains */
+	UINT32 baud;	/* 0 leaves the line settings alone */
+};
+
+BOOLEAN uart_enabled = FALSE;
+
+static struct uart_port port;
+
+#ifndef HOST_BENCH
+static inline UINT8 inb(UINT16 port)
+{
+	UINT8 val;
+
+	asm volatile ("inb %1, %0" : "=a" (val) : "Nd" (port));
+	return val;
+}
+
+static inline void outb(UINT8 val, UINT16 port)
+{
+	asm volatile ("outb %0, %1" :: "a" (val), "Nd" (port));
+}
+#endif
+
+static UINT8 uart_in(UINTN reg)
+{
+	UINT64 addr = port.base + (reg << port.shift);
+
+#ifdef HOST_BENCH
+	return host_uart_in(addr, port.mmio);
+#else
+	if (!port.mmio)
+		return inb((UINT16)addr);
+	if (port.shift == 2)
+		return *(volatile UINT32 *)(UINTN)addr;
+	return *(volatile UINT8 *)(UINTN)addr;
+#endif
+}
+
+static void uart_out(UINTN reg, UINT8 val)
+{
+	UINT64 addr = port.base + (reg << port.shift);
+
+#ifdef HOST_BENCH
+	host_uart_out(addr, port.mmio, val);
+#else
+	if (!port.mmio)
+		outb(val, (UINT16)addr);
+	else if (port.shift == 2)
+		*(volatile UINT32 *)(UINTN)addr = val;
+	else
+		*(volatile UINT8 *)(UINTN)addr = val;
+#endif
+}
+
+/*
+ * Wait for the line status bits in 'mask'. Returns FALSE if they
+ * don't show up in time, e.g. because there's no UART there.
+ */
+static BOOLEAN uart_wait(UINT8 mask)
+{
+	UINT64 start = rdtsc();
+
+	while ((uart_in(UART_LSR) & mask) != mask) {
+		if (rdtsc() - start > UART_TIMEOUT_US * tsc_per_us())
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+ * Parse a number in decimal, or in hex with a 0x prefix, up to 'end'
+ * or a comma. Returns FALSE if there are no digits.
+ */
+static BOOLEAN parse_number(char **pos, char *end, UINT64 *n)
+{
+	char *p = *pos;
+	UINTN base = 10;
+	BOOLEAN digits = FALSE;
+
+	if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+		base = 16;
+		p += 2;
+	}
+
+	for (*n = 0; p < end && *p != ','; p++) {
+		UINTN d;
+
+		if (*p >= '0' && *p <= '9')
+			d = *p - '0';
+		else if (base == 16 && *p >= 'a' && *p <= 'f')
+			d = *p - 'a' + 10;
+		else if (base == 16 && *p >= 'A' && *p <= 'F')
+			d = *p - 'A' + 10;
+		else
+			return FALSE;
+
+		*n = *n * base + d;
+		digits = TRUE;
+	}
+
+	*pos = p;
+	return digits;
+}
+
+static BOOLEAN word_is(char *p, char *end, char *word)
+{
+	while (p < end && *p != ',' && *word) {
+		if (*p++ != *word++)
+			return FALSE;
+	}
+
+	return !*word && (p == end || *p == ',');
+}
+
+/*
+ * "io,<port>[,<baud>]", "mmio,<addr>[,<baud>]" for byte-wide
+ * registers or "mmio32,<addr>[,<baud>]" for 32-bit registers.
+ */
+static BOOLEAN parse_port(char *p, char *end)
+{
+	UINT64 n;
+
+	if (word_is(p, end, "io"))
+		port.mmio = FALSE;
+	else if (word_is(p, end, "mmio"))
+		port.mmio = TRUE;
+	else if (word_is(p, end, "mmio32")) {
+		port.mmio = TRUE;
+		port.shift = 2;
+	} else
+		return FALSE;
+
+	while (p < end && *p != ',')
+		p++;
+	if (p == end)
+		return FALSE;
+
+	p++;
+	if (!parse_number(&p, end, &port.base))
+		return FALSE;
+
+	if (p < end) {
+		p++;
+		if (!parse_number(&p, end, &n) || !n || n > UART_BASE_BAUD)
+			return FALSE;
+		port.baud = n;
+	}
+
+	port.fifo = UART_FIFO_SIZE;
+	return TRUE;
+}
+
+/*
+ * Use the UART that the firmware describes in the SPCR.
+ */
+static BOOLEAN spcr_port(void)
+{
+	struct acpi_rsdp *rsdp;
+	struct acpi_spcr *spcr;
+
+	rsdp = acpi_find_rsdp();
+	if (!rsdp)
+		return FALSE;
+
+	spcr = (struct acpi_spcr *)acpi_find_table(rsdp, ACPI_SPCR_SIGNATURE);
+	if (!spcr || spcr->hdr.length < sizeof(*spcr))
+		return FALSE;
+
+	switch (spcr->interface_type) {
+	case ACPI_SPCR_16550:
+	case ACPI_SPCR_16550_GAS:
+		port.fifo = UART_FIFO_SIZE;
+		break;
+	case ACPI_SPCR_16450:
+		port.fifo = 1;
+		break;
+	default:
+		return FALSE;
+	}
+
+	switch (spcr->base.space_id) {
+	case ACPI_GAS_IO:
+		port.mmio = FALSE;
+		break;
+	case ACPI_GAS_MEMORY:
+		port.mmio = TRUE;
+		if (spcr->base.access_size == ACPI_GAS_ACCESS_DWORD ||
+		    spcr->base.bit_width == 32)
+			port.shift = 2;
+		break;
+	default:
+		return FALSE;
+	}
+
+	port.base = spcr->base.address;
+
+	switch (spcr->baud_rate) {
+	case ACPI_SPCR_BAUD_9600:
+		port.baud = 9600;
+		break;
+	case ACPI_SPCR_BAUD_19200:
+		port.baud = 19200;
+		break;
+	case ACPI_SPCR_BAUD_57600:
+		port.baud = 57600;
+		break;
+	case ACPI_SPCR_BAUD_115200:
+		port.baud = 115200;
+		break;
+	}
+
+	return port.base != 0;
+}
+
+/**
+ * uart_init - Switch the console to a UART
+ * @arg: "spcr", or the UART's address as "io,<port>[,<baud>]",
+ *	"mmio,<addr>[,<baud>]" or "mmio32,<addr>[,<baud>]"
+ * @len: the length of @arg, which needn't be NUL-terminated
+ *
+ * Checks that there's a UART at the address, waits for it to finish
+ * sending whatever the firmware wrote and sets it up for 8n1 with
+ * the FIFOs on, and at the baud rate if one is given. Until this
+ * succeeds output goes to ConOut.
+ */
+EFI_STATUS uart_init(char *arg, UINTN len)
+{
+	char *end = arg + len;
+	UINTN divisor;
+
+	uart_enabled = FALSE;
+	port.shift = 0;
+	port.baud = 0;
+
+	if (word_is(arg, end, "spcr")) {
+		if (!spcr_port()) {
+			log_print(LOG_WARN, L"No 16550 UART in the SPCR\n");
+			return EFI_NOT_FOUND;
+		}
+	} else if (!parse_port(arg, end)) {
+		log_print(LOG_WARN, L"Expected -u spcr, -u io,<port>[,<baud>] "
+			  "or -u mmio[32],<addr>[,<baud>]\n");
+		return EFI_INVALID_PARAMETER;
+	}
+
+	/* uart_wait() can't calibrate the TSC once boot services are gone */
+	tsc_per_us();
+
+	/* Unlike an empty port, the scratch register reads back */
+	uart_out(UART_SCR, 0x5a);
+	if (uart_in(UART_SCR) != 0x5a || !uart_wait(UART_LSR_TEMT)) {
+		log_print(LOG_WARN, L"No UART at 0x%lx\n", port.base);
+		return EFI_NOT_FOUND;
+	}
+
+	uart_out(UART_IER, 0);
+
+	if (port.baud) {
+		divisor = UART_BASE_BAUD / port.baud;
+		uart_out(UART_LCR, UART_LCR_DLAB | UART_LCR_8N1);
+		uart_out(UART_DLL, divisor & 0xff);
+		uart_out(UART_DLM, divisor >> 8);
+		uart_out(UART_LCR, UART_LCR_8N1);
+	}
+
+	uart_out(UART_FCR, UART_FCR_ENABLE | UART_FCR_CLEAR);
+	uart_out(UART_MCR, UART_MCR_DTR_RTS);
+
+	uart_enabled = TRUE;
+	return EFI_SUCCESS;
+}
+
+/**
+ * uart_write - Write to the UART
+ * @buf: the text to write, '\n' is sent as "\r\n"
+ * @len: the number of bytes of @buf to write
+ *
+ * If the UART stops draining its FIFO it's abandoned and output goes
+ * back to ConOut.
+ */
+void uart_write(const char *buf, UINTN len)
+{
+	BOOLEAN cr = FALSE;
+	UINTN i = 0, n;
+
+	while (uart_enabled && i < len) {
+		if (!uart_wait(UART_LSR_THRE)) {
+			uart_enabled = FALSE;
+			break;
+		}
+
+		for (n = 0; n < port.fifo && i < len; n++) {
+			if (buf[i] == '\n' && !cr) {
+				uart_out(UART_THR, '\r');
+				cr = TRUE;
+				continue;
+			}
+
+			uart_out(UART_THR, buf[i++]);
+			cr = FALSE;
+		}
+	}
+}
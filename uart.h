@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2011, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * A console on a 16550-compatible UART, bypassing ConOut.
+ */
+
+#ifndef __UART_H__
+#define __UART_H__
+
+/* Registers, as offsets in units of the register stride */
+#define UART_THR		0	/* transmit holding, write */
+#define UART_DLL		0	/* divisor latch low, with DLAB */
+#define UART_IER		1	/* interrupt enable */
+#define UART_DLM		1	/* divisor latch high, with DLAB */
+#define UART_FCR		2	/* FIFO control, write */
+#define UART_LCR		3	/* line control */
+#define UART_MCR		4	/* modem control */
+#define UART_LSR		5	/* line status */
+#define UART_SCR		7	/* scratch */
+
+#define UART_FCR_ENABLE		0x01
+#define UART_FCR_CLEAR		0x06	/* both FIFOs */
+#define UART_LCR_8N1		0x03
+#define UART_LCR_DLAB		0x80
+#define UART_MCR_DTR_RTS	0x03
+#define UART_LSR_THRE		0x20	/* transmit FIFO empty */
+#define UART_LSR_TEMT		0x40	/* ...and so is the shift register */
+
+/* The divisor for a baud rate is UART_BASE_BAUD / baud */
+#define UART_BASE_BAUD		115200
+#define UART_FIFO_SIZE		16
+
+extern BOOLEAN uart_enabled;
+
+extern EFI_STATUS uart_init(char *arg, UINTN len);
+extern void uart_write(const char *buf, UINTN len);
+
+#endif /* __UART_H__ */